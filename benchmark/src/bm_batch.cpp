@@ -0,0 +1,67 @@
+#include <benchmark/benchmark.h>
+
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/batch.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <numeric>
+
+namespace
+{
+constexpr auto InputsPerIteration = 1024;
+
+// fib(12) for every input, the same control flow in every lane
+auto uniformInputs() -> std::vector<int64_t> { return std::vector<int64_t>(InputsPerIteration, 12); }
+
+// fib(8) .. fib(15), neighbouring lanes diverge
+auto mixedInputs() -> std::vector<int64_t>
+{
+    auto inputs = std::vector<int64_t>(InputsPerIteration);
+    for (auto i = std::size_t {0}; i < inputs.size(); ++i) { inputs[i] = 8 + static_cast<int64_t>(i % 8); }
+    return inputs;
+}
+
+auto inputsFor(int64_t const mixed) -> std::vector<int64_t> { return mixed != 0 ? mixedInputs() : uniformInputs(); }
+}  // namespace
+
+// baseline: one scalar run per input
+static void BM_ScalarInputs(benchmark::State& state)
+{
+    auto const program = tcvm::createInputFibonacciProgram();
+    auto const inputs  = inputsFor(state.range(0));
+    auto vm            = tcc::VirtualMachine(program.data, program.entryPoint, 1, 200, false, std::cout,
+                                          tcc::VirtualMachine::Engine::Switch);
+
+    for (auto _ : state)
+    {
+        for (auto const input : inputs)
+        {
+            vm.reset(program.entryPoint);
+            vm.globals()[0] = input;
+            benchmark::DoNotOptimize(vm.cpu());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * InputsPerIteration);
+}
+BENCHMARK(BM_ScalarInputs)->ArgName("mixed")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+static void BM_BatchInputs(benchmark::State& state)
+{
+    auto const program = tcvm::createInputFibonacciProgram();
+    auto const inputs  = inputsFor(state.range(0));
+    auto options       = tcc::BatchOptions {};
+    options.width      = static_cast<std::size_t>(state.range(1));
+    auto batch         = tcc::BatchMachine {program, options};
+
+    for (auto _ : state) { benchmark::DoNotOptimize(batch.run(inputs)); }
+
+    // average number of lanes executing each step, width if the lanes never diverge
+    auto const& stats            = batch.stats();
+    state.counters["lanes/step"] = static_cast<double>(stats.laneInstructions) / static_cast<double>(stats.instructions);
+    state.counters["avx2"]       = tcc::BatchMachine::usesAvx2() ? 1.0 : 0.0;
+    state.SetItemsProcessed(state.iterations() * InputsPerIteration);
+}
+BENCHMARK(BM_BatchInputs)
+    ->ArgNames({"mixed", "width"})
+    ->ArgsProduct({{0, 1}, {4, 16, 64, 256}})
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include "bm_perf_counters.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <cstdlib>
+
+namespace
+{
+auto createProgram(int64_t const index) -> tcc::BinaryProgram
+{
+    switch (index)
+    {
+        case 0: return tcvm::createFibonacciProgram(15);
+        case 1: return tcvm::createFactorialProgram(12);
+        case 2: return tcc::fuseSuperinstructions(tcvm::createFibonacciProgram(15));
+        default: return tcvm::createMultipleFunctionsProgram(2);
+    }
+}
+
+// bytes of the program in memory & on disk, once as int64 words & once encoded
+void reportCodeSize(benchmark::State& state, tcc::BinaryProgram const& program)
+{
+    auto const compact = tcc::toCompactCode(program.data, program.entryPoint);
+    if (!compact.has_value()) { std::abort(); }
+
+    auto const words            = static_cast<double>(program.data.size() * sizeof(int64_t));
+    auto const bytes            = static_cast<double>(compact->image().size());
+    state.counters["words"]     = words;
+    state.counters["compact"]   = bytes;
+    state.counters["compact/%"] = 100.0 * bytes / words;
+}
+}  // namespace
+
+// the same programs on the stack engines, compact decodes the byte encoding
+// while running, switch & threaded run on the int64 words
+static void BM_CompactDispatch(benchmark::State& state)
+{
+    auto const program = createProgram(state.range(0));
+    auto const engine  = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm = tcc::VirtualMachine(program.data, static_cast<uint64_t>(program.entryPoint), 0, 200, false, std::cout,
+                                  engine);
+    if (vm.engine() != engine)
+    {
+        state.SkipWithError("engine not available");
+        return;
+    }
+
+    auto const instructions = tcbench::countInstructions(program.data, program.entryPoint);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
+
+    for (auto _ : state)
+    {
+        vm.reset(program.entryPoint);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
+    reportCodeSize(state, program);
+}
+// programs: 0 fibonacci, 1 factorial, 2 fused fibonacci, 3 multiple functions
+// engines: 0 switch, 1 threaded, 5 compact
+BENCHMARK(BM_CompactDispatch)
+    ->ArgNames({"program", "engine"})
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1, 5}});
+
+static void BM_CompactEncode(benchmark::State& state)
+{
+    auto const program = createProgram(state.range(0));
+    for (auto _ : state)
+    {
+        auto compact = tcc::toCompactCode(program.data, program.entryPoint);
+        benchmark::DoNotOptimize(compact);
+    }
+    reportCodeSize(state, program);
+}
+BENCHMARK(BM_CompactEncode)->ArgName("program")->DenseRange(0, 3);
+
+static void BM_CompactDecode(benchmark::State& state)
+{
+    auto const program = createProgram(state.range(0));
+    auto const compact = tcc::toCompactCode(program.data, program.entryPoint).value();
+    for (auto _ : state)
+    {
+        auto decoded = tcc::fromCompactCode(compact);
+        benchmark::DoNotOptimize(decoded);
+    }
+    reportCodeSize(state, program);
+}
+BENCHMARK(BM_CompactDecode)->ArgName("program")->DenseRange(0, 3);
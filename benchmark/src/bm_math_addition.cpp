@@ -1,5 +1,6 @@
 #include <benchmark/benchmark.h>
 
+#include "bm_perf_counters.hpp"
 #include "tcvm/vm/vm.hpp"
 
 namespace
@@ -60,13 +61,21 @@ static void BM_StackMachineAddition(benchmark::State& state)
 {
 
     auto const assembly = createAdditionAssembly(state.range(0));
-    auto vm             = tcc::VirtualMachine(assembly, 18, 0, 200, false);
+    auto const engine   = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm             = tcc::VirtualMachine(assembly, 18, 0, 200, false, std::cout, engine);
+
+    auto const instructions = tcbench::countInstructions(assembly, 18);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
 
     for (auto _ : state)
     {
-        vm.Reset(18);
-        auto const exitCode = vm.Cpu();
+        vm.reset(18);
+        auto const exitCode = vm.cpu();
         benchmark::DoNotOptimize(exitCode);
     }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
 }
-BENCHMARK(BM_StackMachineAddition)->Arg(7)->Arg(10);
\ No newline at end of file
+BENCHMARK(BM_StackMachineAddition)->ArgNames({"n", "engine"})->Args({7, 0})->Args({7, 1})->Args({10, 0})->Args({10, 1});
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <benchmark/benchmark.h>
+
+#include "bm_perf_counters.hpp"
+#include "tcc/compiler/compiler.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <optional>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#endif
+
+namespace
+{
+// same function as bm_math_addition.cpp, the arguments are constants in main
+constexpr auto additionSource = R"(
+    int addition(x, y) { int a = x + y; int b = y + 10; return a + b; }
+    int main() { int x = 7; int y = 10; return addition(x, y); }
+)";
+
+constexpr auto nestedCallsSource = R"(
+    int foo(a) { int b = 30; int q = 10 * 2; int p = b - q; int c = p * 15; return c + a; }
+    int main() { int x = 1 + 4; int y = foo(foo(x)); return x + y; }
+)";
+
+auto compile(char const* source, tcc::OutputFormat format, std::string const& output = "") -> tcc::Compiler
+{
+    auto options       = tcc::CompilerOptions {};
+    options.source     = source;
+    options.optLevel   = 1;
+    options.format     = format;
+    options.outputName = output;
+    auto compiler      = tcc::Compiler {options};
+    if (compiler.run() != EXIT_SUCCESS) { std::abort(); }
+    return compiler;
+}
+
+/**
+ * @brief tcc_main of a program translated to C & built as a shared library by
+ * the system compiler. The library stays loaded until the process exits.
+ */
+auto loadCBackend(char const* source, std::string const& name) -> std::optional<int64_t (*)()>
+{
+#if defined(__unix__) || defined(__APPLE__)
+    // a fresh path per program, dlopen hands out a loaded library again
+    auto const directory = std::filesystem::temp_directory_path();
+    auto const cFile     = (directory / ("tcc_bm_" + name + ".c")).string();
+    auto const library   = (directory / ("tcc_bm_" + name + ".so")).string();
+    compile(source, tcc::OutputFormat::C, cFile);
+
+    auto const command = "cc -std=c99 -O2 -shared -fPIC -DTCC_NO_MAIN -o " + library + " " + cFile;
+    auto const built   = std::system(command.c_str()) == 0;
+    std::filesystem::remove(cFile);
+    if (!built) { return std::nullopt; }
+
+    auto* handle = ::dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    std::filesystem::remove(library);
+    if (handle == nullptr) { return std::nullopt; }
+
+    auto* symbol = ::dlsym(handle, "tcc_main");
+    if (symbol == nullptr) { return std::nullopt; }
+    return reinterpret_cast<int64_t (*)()>(symbol);
+#else
+    tcc::ignoreUnused(source, name);
+    return std::nullopt;
+#endif
+}
+
+auto runCBackend(benchmark::State& state, char const* source, std::string const& name) -> void
+{
+    // benchmarks are run multiple times, the system compiler only once
+    static auto loaded  = std::map<std::string, std::optional<int64_t (*)()>> {};
+    auto [entry, added] = loaded.try_emplace(name);
+    if (added) { entry->second = loadCBackend(source, name); }
+
+    auto const function = entry->second;
+    if (!function.has_value())
+    {
+        state.SkipWithError("no system C compiler");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        auto const exitCode = (*function)();
+        benchmark::DoNotOptimize(exitCode);
+    }
+}
+
+auto runCompiledBytecode(benchmark::State& state, char const* source) -> void
+{
+    auto const compiler   = compile(source, tcc::OutputFormat::Bytecode);
+    auto const& assembly  = compiler.getAssembly();
+    auto const entryPoint = compiler.getEntryPoint();
+    auto const engine     = static_cast<tcc::VirtualMachine::Engine>(state.range(0));
+    auto vm               = tcc::VirtualMachine(assembly, static_cast<uint64_t>(entryPoint), 0, 200, false,
+                                  std::cout, engine);
+
+    auto const instructions = tcbench::countInstructions(assembly, entryPoint);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
+
+    for (auto _ : state)
+    {
+        vm.reset(entryPoint);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
+}
+}  // namespace
+
+// the C compiler sees the constants & folds the program, like for BM_CppAddition
+static void BM_CBackendAddition(benchmark::State& state) { runCBackend(state, additionSource, "addition"); }
+BENCHMARK(BM_CBackendAddition);
+
+static void BM_CompiledAddition(benchmark::State& state) { runCompiledBytecode(state, additionSource); }
+BENCHMARK(BM_CompiledAddition)->ArgName("engine")->Arg(0)->Arg(1)->Arg(2)->Arg(3);
+
+static void BM_CBackendNestedCalls(benchmark::State& state) { runCBackend(state, nestedCallsSource, "nested_calls"); }
+BENCHMARK(BM_CBackendNestedCalls);
+
+static void BM_CompiledNestedCalls(benchmark::State& state) { runCompiledBytecode(state, nestedCallsSource); }
+BENCHMARK(BM_CompiledNestedCalls)->ArgName("engine")->Arg(0)->Arg(1)->Arg(2)->Arg(3);
@@ -1,5 +1,6 @@
 #include <benchmark/benchmark.h>
 
+#include "bm_perf_counters.hpp"
 #include "tcvm/vm/vm.hpp"
 
 namespace
@@ -65,15 +66,36 @@ static void BM_StackMachineFactorial(benchmark::State& state)
 {
     auto const entryPoint = 22;
     auto const factorial  = createFactorialAssembly(state.range(0));
-    auto vm = tcc::VirtualMachine(factorial, entryPoint, 0, 200, false);
+    auto const engine     = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm = tcc::VirtualMachine(factorial, entryPoint, 0, 200, false, std::cout, engine);
+
+    auto const instructions = tcbench::countInstructions(factorial, entryPoint);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
 
     for (auto _ : state)
     {
-        vm.Reset(entryPoint);
-        auto const exitCode = vm.Cpu();
+        vm.reset(entryPoint);
+        auto const exitCode = vm.cpu();
         benchmark::DoNotOptimize(exitCode);
     }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
 }
-BENCHMARK(BM_StackMachineFactorial)->Arg(3)->Arg(12)->Arg(15);
+BENCHMARK(BM_StackMachineFactorial)
+    ->ArgNames({"n", "engine"})
+    ->Args({3, 0})
+    ->Args({3, 1})
+    ->Args({3, 2})
+    ->Args({3, 3})
+    ->Args({12, 0})
+    ->Args({12, 1})
+    ->Args({12, 2})
+    ->Args({12, 3})
+    ->Args({15, 0})
+    ->Args({15, 1})
+    ->Args({15, 2})
+    ->Args({15, 3});
 
 BENCHMARK_MAIN();
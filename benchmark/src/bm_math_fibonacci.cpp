@@ -1,7 +1,11 @@
 #include <benchmark/benchmark.h>
 
+#include "bm_perf_counters.hpp"
+#include "tcvm/vm/superinstructions.hpp"
 #include "tcvm/vm/vm.hpp"
 
+#include <limits>
+
 namespace
 {
 constexpr auto fibonacci(int64_t x) -> int64_t
@@ -65,13 +69,141 @@ static void BM_StackMachineFibonacci(benchmark::State& state)
 {
 
     auto const assembly = createFibonacciAssembly(state.range(0));
+    auto const engine   = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm             = tcc::VirtualMachine(assembly, 28, 0, 200, false, std::cout, engine);
+
+    auto const instructions = tcbench::countInstructions(assembly, 28);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
+
+    for (auto _ : state)
+    {
+        vm.reset(28);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
+}
+BENCHMARK(BM_StackMachineFibonacci)
+    ->ArgNames({"n", "engine"})
+    ->Args({3, 0})
+    ->Args({3, 1})
+    ->Args({3, 2})
+    ->Args({3, 3})
+    ->Args({12, 0})
+    ->Args({12, 1})
+    ->Args({12, 2})
+    ->Args({12, 3})
+    ->Args({15, 0})
+    ->Args({15, 1})
+    ->Args({15, 2})
+    ->Args({15, 3});
+
+static void BM_StackMachineFibonacciFused(benchmark::State& state)
+{
+    auto const program = tcc::fuseSuperinstructions(
+        tcc::BinaryProgram {1, "fibonacci", 28, createFibonacciAssembly(state.range(0))});
+    auto const engine = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm           = tcc::VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout, engine);
+
+    for (auto _ : state)
+    {
+        vm.reset(program.entryPoint);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+}
+BENCHMARK(BM_StackMachineFibonacciFused)
+    ->ArgNames({"n", "engine"})
+    ->Args({12, 0})
+    ->Args({12, 1})
+    ->Args({12, 3})
+    ->Args({15, 0})
+    ->Args({15, 1})
+    ->Args({15, 3});
+
+static void BM_StackMachineFibonacciPolicy(benchmark::State& state)
+{
+    auto const assembly = createFibonacciAssembly(state.range(0));
+    auto const policy   = static_cast<std::size_t>(state.range(1));
+    auto discard        = std::ostream {nullptr};
+    auto vm             = tcc::VirtualMachine(assembly, 28, 0, 200, (policy & 1U) != 0, discard);
+    vm.enableBoundsChecking((policy & 2U) != 0);
+    vm.enableStatistics((policy & 4U) != 0);
+
+    for (auto _ : state)
+    {
+        vm.reset(28);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+}
+// policy bits: 1 tracing, 2 bounds checking, 4 statistics, see tcc::policyIndex
+BENCHMARK(BM_StackMachineFibonacciPolicy)
+    ->ArgNames({"n", "policy"})
+    ->Args({12, 0})
+    ->Args({12, 2})
+    ->Args({12, 4})
+    ->Args({12, 6})
+    ->Args({12, 7});
+
+static void BM_StackMachineFibonacciSliced(benchmark::State& state)
+{
+    auto const assembly = createFibonacciAssembly(state.range(0));
+    auto const budget   = state.range(1);
     auto vm             = tcc::VirtualMachine(assembly, 28, 0, 200, false);
 
     for (auto _ : state)
     {
-        vm.Reset(28);
-        auto const exitCode = vm.Cpu();
+        vm.reset(28);
+        auto result = vm.run(budget);
+        while (result.status != tcc::VirtualMachine::RunStatus::Finished) { result = vm.run(budget); }
+        benchmark::DoNotOptimize(result.exitCode);
+    }
+}
+BENCHMARK(BM_StackMachineFibonacciSliced)
+    ->ArgNames({"n", "budget"})
+    ->Args({12, 100})
+    ->Args({12, 10000})
+    ->Args({15, 100})
+    ->Args({15, 10000});
+
+// same as BM_StackMachineFibonacci/engine:1 with gas charged per basic block
+static void BM_StackMachineFibonacciMetered(benchmark::State& state)
+{
+    auto const assembly = createFibonacciAssembly(state.range(0));
+    auto const engine   = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm             = tcc::VirtualMachine(assembly, 28, 0, 200, false, std::cout, engine);
+    vm.enableMetering(std::numeric_limits<int64_t>::max());
+
+    for (auto _ : state)
+    {
+        vm.reset(28);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+}
+BENCHMARK(BM_StackMachineFibonacciMetered)
+    ->ArgNames({"n", "engine"})
+    ->Args({12, 0})
+    ->Args({12, 1})
+    ->Args({15, 0})
+    ->Args({15, 1});
+
+// every iteration starts with an empty table
+static void BM_StackMachineFibonacciMemoized(benchmark::State& state)
+{
+    auto const assembly = createFibonacciAssembly(state.range(0));
+    auto vm = tcc::VirtualMachine(assembly, 28, 0, 200, false, std::cout, tcc::VirtualMachine::Engine::Threaded);
+
+    for (auto _ : state)
+    {
+        vm.enableMemoization(64);
+        vm.reset(28);
+        auto const exitCode = vm.cpu();
         benchmark::DoNotOptimize(exitCode);
     }
 }
-BENCHMARK(BM_StackMachineFibonacci)->Arg(3)->Arg(12)->Arg(15);
+BENCHMARK(BM_StackMachineFibonacciMemoized)->ArgName("n")->Arg(12)->Arg(15)->Arg(30);
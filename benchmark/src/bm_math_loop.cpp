@@ -0,0 +1,115 @@
+#include <benchmark/benchmark.h>
+
+#include "bm_perf_counters.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm.hpp"
+
+namespace
+{
+constexpr auto loopSum(int64_t n) -> int64_t
+{
+    auto sum = int64_t {0};
+    for (auto i = int64_t {0}; i < n; ++i) { sum += i; }
+    return sum;
+}
+
+static_assert(loopSum(10) == 45);
+
+auto const createLoopSumAssembly = [](int64_t const arg) {
+    using tcc::ByteCode;
+    return std::vector<int64_t> {
+        // .def main: args=0, locals=2
+        ByteCode::ICONST, 0,  // 0 i
+        ByteCode::ICONST, 0,  // 2 sum
+
+        // while (i < n)
+        ByteCode::LOAD, 0,      // 4 <-- loop header
+        ByteCode::ICONST, arg,  // 6
+        ByteCode::ILT,          // 8
+        ByteCode::BRF, 27,      // 9
+
+        // sum += i
+        ByteCode::LOAD, 1,   // 11
+        ByteCode::LOAD, 0,   // 13
+        ByteCode::IADD,      // 15
+        ByteCode::STORE, 1,  // 16
+
+        // ++i
+        ByteCode::LOAD, 0,    // 18
+        ByteCode::ICONST, 1,  // 20
+        ByteCode::IADD,       // 22
+        ByteCode::STORE, 0,   // 23
+        ByteCode::BR, 4,      // 25
+
+        // return sum
+        ByteCode::LOAD, 1,  // 27
+        ByteCode::EXIT,     // 29
+    };
+};
+}  // namespace
+
+static void BM_CppLoopSum(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        auto result = loopSum(state.range(0));
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_CppLoopSum)->Arg(100)->Arg(10000);
+
+static void BM_StackMachineLoopSum(benchmark::State& state)
+{
+    auto const assembly = createLoopSumAssembly(state.range(0));
+    auto const engine  = static_cast<tcc::VirtualMachine::Engine>(state.range(1));
+    auto vm            = tcc::VirtualMachine(assembly, 0, 0, 200, false, std::cout, engine);
+
+    auto const instructions = tcbench::countInstructions(assembly, 0);
+    auto counters           = tcc::PerfCounters {};
+    counters.start();
+
+    for (auto _ : state)
+    {
+        vm.reset(0);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+
+    counters.stop();
+    tcbench::reportPerfCounters(state, counters, instructions);
+}
+BENCHMARK(BM_StackMachineLoopSum)
+    ->ArgNames({"n", "engine"})
+    ->Args({100, 0})
+    ->Args({100, 1})
+    ->Args({100, 3})
+    ->Args({100, 4})
+    ->Args({10000, 0})
+    ->Args({10000, 1})
+    ->Args({10000, 3})
+    ->Args({10000, 4});
+
+// mutual recursion with CALL & RET against TAILCALL, which keeps one frame
+static void BM_StackMachineEvenOdd(benchmark::State& state)
+{
+    auto const n       = state.range(0);
+    auto const program = tcvm::createEvenOddProgram(n, state.range(1) != 0);
+    auto const engine   = static_cast<tcc::VirtualMachine::Engine>(state.range(2));
+    auto const slots   = static_cast<uint64_t>(4 * n + 8);
+    auto vm             = tcc::VirtualMachine(program.data, program.entryPoint, 0, slots, false, std::cout, engine);
+
+    for (auto _ : state)
+    {
+        vm.reset(program.entryPoint);
+        auto const exitCode = vm.cpu();
+        benchmark::DoNotOptimize(exitCode);
+    }
+}
+BENCHMARK(BM_StackMachineEvenOdd)
+    ->ArgNames({"n", "tail", "engine"})
+    ->Args({10000, 0, 0})
+    ->Args({10000, 1, 0})
+    ->Args({10000, 0, 1})
+    ->Args({10000, 1, 1})
+    ->Args({10000, 0, 3})
+    ->Args({10000, 1, 3});
@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include "tcvm/vm/output_sink.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <sstream>
+
+namespace
+{
+constexpr auto PrintsPerRun = 10'000;
+
+// for (i = 0; i < PrintsPerRun; ++i) { print(i * 1000003); } return i;
+auto const printLoop = [] {
+    using tcc::ByteCode;
+    return std::vector<int64_t> {
+        ByteCode::ICONST, 0,             // 0 i
+        ByteCode::LOAD,   0,             // 2 <-- header
+        ByteCode::ICONST, PrintsPerRun,  // 4
+        ByteCode::ILT,                   // 6
+        ByteCode::BRF,    24,            // 7
+        ByteCode::LOAD,   0,             // 9
+        ByteCode::ICONST, 1000003,       // 11
+        ByteCode::IMUL,                  // 13
+        ByteCode::PRINT,                 // 14
+        ByteCode::LOAD,   0,             // 15
+        ByteCode::ICONST, 1,             // 17
+        ByteCode::IADD,                  // 19
+        ByteCode::STORE,  0,             // 20
+        ByteCode::BR,     2,             // 22
+        ByteCode::LOAD,   0,             // 24
+        ByteCode::EXIT,                  // 26
+    };
+};
+}  // namespace
+
+// baseline: one fmt::format & stream write per value
+static void BM_PrintFormatStream(benchmark::State& state)
+{
+    auto out = std::stringstream {};
+    for (auto _ : state)
+    {
+        out.str({});
+        for (auto i = int64_t {0}; i < PrintsPerRun; ++i) { out << fmt::format("{}\n", i * 1000003); }
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations() * PrintsPerRun);
+}
+BENCHMARK(BM_PrintFormatStream);
+
+static void BM_PrintStreamSink(benchmark::State& state)
+{
+    auto out = std::stringstream {};
+    auto vm  = tcc::VirtualMachine(printLoop(), 0, 0, 50, false, out, tcc::VirtualMachine::Engine::Threaded);
+    for (auto _ : state)
+    {
+        out.str({});
+        vm.reset(0);
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+    state.SetItemsProcessed(state.iterations() * PrintsPerRun);
+}
+BENCHMARK(BM_PrintStreamSink);
+
+static void BM_PrintBufferSink(benchmark::State& state)
+{
+    auto sink = tcc::BufferSink {PrintsPerRun * 21};
+    auto vm   = tcc::VirtualMachine(printLoop(), 0, 0, 50, false, std::cout, tcc::VirtualMachine::Engine::Threaded);
+    vm.setOutput(&sink);
+    for (auto _ : state)
+    {
+        sink.clear();
+        vm.reset(0);
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+    state.SetItemsProcessed(state.iterations() * PrintsPerRun);
+}
+BENCHMARK(BM_PrintBufferSink);
+
+static void BM_PrintCallbackSink(benchmark::State& state)
+{
+    auto sum  = int64_t {0};
+    auto sink = tcc::CallbackSink {[&sum](std::span<int64_t const> values) {
+        for (auto const value : values) { sum += value; }
+    }};
+    auto vm =  tcc::VirtualMachine(printLoop(), 0, 0, 50, false, std::cout, tcc::VirtualMachine::Engine::Threaded);
+    vm.setOutput(&sink);
+    for (auto _ : state)
+    {
+        vm.reset(0);
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * PrintsPerRun);
+}
+BENCHMARK(BM_PrintCallbackSink);
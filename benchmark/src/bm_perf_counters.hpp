@@ -0,0 +1,38 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include "tcvm/vm/perf_counters.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <ostream>
+#include <vector>
+
+namespace tcbench
+{
+// bytecode instructions of one run, counted on a separate machine
+inline auto countInstructions(std::vector<int64_t> const& code, int64_t const entryPoint) -> int64_t
+{
+    auto discard = std::ostream {nullptr};
+    auto vm      = tcc::VirtualMachine(code, static_cast<uint64_t>(entryPoint), 0, 200, false, discard);
+    vm.enableStatistics(true);
+    vm.cpu();
+    return vm.stats().instructions;
+}
+
+// hardware events of the whole benchmark loop per executed bytecode instruction,
+// nothing is reported if the counters are not available
+inline void reportPerfCounters(benchmark::State& state, tcc::PerfCounters const& counters, int64_t const instructions)
+{
+    if (!counters.available()) { return; }
+
+    auto const counts = counters.read();
+    auto const total  = static_cast<double>(instructions) * static_cast<double>(state.iterations());
+    if (total <= 0.0) { return; }
+
+    state.counters["cycles/op"]        = static_cast<double>(counts.cycles) / total;
+    state.counters["instructions/op"]  = static_cast<double>(counts.instructions) / total;
+    state.counters["branch-misses/op"] = static_cast<double>(counts.branchMisses) / total;
+    state.counters["cache-misses/op"]  = static_cast<double>(counts.cacheMisses) / total;
+}
+}  // namespace tcbench
@@ -0,0 +1,47 @@
+#include <benchmark/benchmark.h>
+
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/scheduler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+constexpr auto FibonacciInput = 25;
+constexpr auto Cutoff         = 12;  // below this pfib recurses with plain calls
+
+auto threadCounts(benchmark::internal::Benchmark* bm) -> void
+{
+    auto const cores = static_cast<int64_t>(std::max(std::thread::hardware_concurrency(), 1U));
+    for (auto threads = int64_t {1}; threads < cores; threads *= 2) { bm->Arg(threads); }
+    bm->Arg(cores);
+}
+}  // namespace
+
+// baseline: the same program on one VM, SPAWN runs as a call
+static void BM_ParallelFibonacciVirtualMachine(benchmark::State& state)
+{
+    auto const program = tcvm::createParallelFibonacciProgram(FibonacciInput, Cutoff);
+    for (auto _ : state)
+    {
+        auto vm = tcc::VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                      tcc::VirtualMachine::Engine::Switch);
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+}
+BENCHMARK(BM_ParallelFibonacciVirtualMachine)->Unit(benchmark::kMillisecond);
+
+static void BM_SchedulerFibonacci(benchmark::State& state)
+{
+    auto options    = tcc::SchedulerOptions {};
+    options.threads = static_cast<std::size_t>(state.range(0));
+    auto scheduler  = tcc::Scheduler {options};
+
+    auto const program = tcvm::createParallelFibonacciProgram(FibonacciInput, Cutoff);
+    for (auto _ : state) { benchmark::DoNotOptimize(scheduler.run(program)); }
+
+    state.counters["tasks"]  = static_cast<double>(scheduler.stats().tasks);
+    state.counters["steals"] = static_cast<double>(scheduler.stats().steals);
+}
+BENCHMARK(BM_SchedulerFibonacci)->ArgName("threads")->Apply(threadCounts)->Unit(benchmark::kMillisecond)->UseRealTime();
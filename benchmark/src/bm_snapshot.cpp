@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm.hpp"
+
+namespace
+{
+constexpr auto InitializationInput = 18;
+}  // namespace
+
+// baseline: every request runs the initialization again
+static void BM_ColdStart(benchmark::State& state)
+{
+    auto const program = tcvm::createWarmStartProgram(InitializationInput);
+    auto const engine  = static_cast<tcc::VirtualMachine::Engine>(state.range(0));
+    for (auto _ : state)
+    {
+        auto vm = tcc::VirtualMachine(program.data, program.entryPoint, 2, 200, false, std::cout, engine);
+        vm.cpu();
+        vm.globals()[1] = 1;
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+}
+BENCHMARK(BM_ColdStart)->ArgName("engine")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+static void BM_ForkFromSnapshot(benchmark::State& state)
+{
+    auto const program = tcvm::createWarmStartProgram(InitializationInput);
+    auto const engine  = static_cast<tcc::VirtualMachine::Engine>(state.range(0));
+    auto warm          = tcc::VirtualMachine(program.data, program.entryPoint, 2, 200, false);
+    warm.cpu();
+    auto const snapshot = warm.snapshot();
+
+    for (auto _ : state)
+    {
+        auto vm         = tcc::VirtualMachine(snapshot, false, std::cout, engine);
+        vm.globals()[1] = 1;
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+}
+BENCHMARK(BM_ForkFromSnapshot)->ArgName("engine")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// a pooled machine restored before every request keeps its decoded program
+static void BM_RestoreSnapshot(benchmark::State& state)
+{
+    auto const program = tcvm::createWarmStartProgram(InitializationInput);
+    auto const engine  = static_cast<tcc::VirtualMachine::Engine>(state.range(0));
+    auto warm          = tcc::VirtualMachine(program.data, program.entryPoint, 2, 200, false);
+    warm.cpu();
+    auto const snapshot = warm.snapshot();
+
+    auto vm = tcc::VirtualMachine(snapshot, false, std::cout, engine);
+    for (auto _ : state)
+    {
+        vm.restore(snapshot);
+        vm.globals()[1] = 1;
+        benchmark::DoNotOptimize(vm.cpu());
+    }
+}
+BENCHMARK(BM_RestoreSnapshot)->ArgName("engine")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
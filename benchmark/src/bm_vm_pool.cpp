@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm_pool.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+constexpr auto JobsPerIteration = 256;
+constexpr auto FibonacciInput   = 12;
+
+auto threadCounts(benchmark::internal::Benchmark* bm) -> void
+{
+    auto const cores = static_cast<int64_t>(std::max(std::thread::hardware_concurrency(), 1U));
+    for (auto threads = int64_t {1}; threads < cores; threads *= 2) { bm->Arg(threads); }
+    bm->Arg(cores);
+}
+}  // namespace
+
+// baseline: a fresh VM per job on the calling thread
+static void BM_FreshVmPerJob(benchmark::State& state)
+{
+    auto const program = tcvm::createFibonacciProgram(FibonacciInput);
+    for (auto _ : state)
+    {
+        for (auto i = 0; i < JobsPerIteration; ++i)
+        {
+            auto vm = tcc::VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                          tcc::VirtualMachine::Engine::Threaded);
+            benchmark::DoNotOptimize(vm.cpu());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * JobsPerIteration);
+}
+BENCHMARK(BM_FreshVmPerJob)->Unit(benchmark::kMicrosecond);
+
+static void BM_VmPoolThroughput(benchmark::State& state)
+{
+    auto options    = tcc::VmPoolOptions {};
+    options.threads = static_cast<std::size_t>(state.range(0));
+    options.engine  = tcc::VirtualMachine::Engine::Threaded;
+    auto pool       = tcc::VmPool {options};
+
+    auto const program = std::make_shared<tcc::BinaryProgram const>(tcvm::createFibonacciProgram(FibonacciInput));
+    auto results       = std::vector<std::future<tcc::VmJobResult>>(JobsPerIteration);
+
+    for (auto _ : state)
+    {
+        for (auto& result : results) { result = pool.submit(tcc::VmJob {program, {}}); }
+        for (auto& result : results) { benchmark::DoNotOptimize(result.get().exitCode); }
+    }
+    state.SetItemsProcessed(state.iterations() * JobsPerIteration);
+}
+BENCHMARK(BM_VmPoolThroughput)->ArgName("threads")->Apply(threadCounts)->Unit(benchmark::kMicrosecond)->UseRealTime();
@@ -3,6 +3,7 @@
 #include "tcsl/tcsl.hpp"
 
 #include <algorithm>
+#include <iterator>
 #include <map>
 #include <variant>
 
@@ -23,12 +24,27 @@ private:
 
 namespace tcc
 {
+auto AssemblyGenerator::natives(tcc::IRPackage const& package) -> std::vector<std::string>
+{
+    auto result = std::vector<std::string> {};
+    std::copy_if(package.natives.begin(), package.natives.end(), std::back_inserter(result),
+                 [](auto const& name) { return !isRuntimeFunction(name); });
+    return result;
+}
+
 auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
+{
+    auto symbols = SymbolTable {};
+    return build(package, symbols);
+}
+
+auto AssemblyGenerator::build(tcc::IRPackage const& package, SymbolTable& symbols) -> Assembly
 {
     auto assembly             = std::vector<int64_t> {};
     auto mainPosition         = std::optional<FunctionPosition> {std::nullopt};
     auto functionPlaceholders = std::map<FunctionPosition, std::string> {};
     auto functionPositions    = std::map<std::string, FunctionPosition> {};
+    auto const externs        = natives(package);
 
     for (auto const& function : package.functions)
     {
@@ -36,6 +52,7 @@ auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
         if (function.name == "main") { mainPosition = funcPos; }
 
         functionPositions.insert({function.name, funcPos});
+        symbols[static_cast<int64_t>(funcPos.value())] = function.name;
 
         auto argVars = IRArgumentList {};
         for (auto const& arg : function.args) { argVars.pushBack(arg.first); }
@@ -48,6 +65,20 @@ auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
             assembly.push_back(0);
         }
 
+        // print returns its argument, which is kept in an extra local above the others
+        auto const scratch   = static_cast<int64_t>(locals.size()) + 1;
+        auto const usesPrint = std::any_of(function.blocks.begin(), function.blocks.end(), [](auto const& block) {
+            return std::any_of(block.statements.begin(), block.statements.end(), [](IRStatement const& statement) {
+                return statement.type == IRByteCode::CallNative && std::get<std::string>(statement.first) == "print";
+            });
+        });
+        if (usesPrint)
+        {
+            assembly.push_back(tcc::ByteCode::ICONST);
+            assembly.push_back(0);
+        }
+        auto const bodyPosition = assembly.size();
+
         for (auto const& block : function.blocks)
         {
             auto const& statements = block.statements;
@@ -140,8 +171,10 @@ auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
                     }
 
                     case IRByteCode::Call:
+                    case IRByteCode::Spawn:
                     {
-                        assembly.push_back(tcc::ByteCode::CALL);
+                        auto const isSpawn = statement.type == IRByteCode::Spawn;
+                        assembly.push_back(isSpawn ? tcc::ByteCode::SPAWN : tcc::ByteCode::CALL);
                         auto funcToCall = std::get<std::string>(statement.first);
                         functionPlaceholders.insert({FunctionPosition {assembly.size()}, funcToCall});
                         assembly.push_back(9999);  // func addr
@@ -151,6 +184,73 @@ auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
                         break;
                     }
 
+                    case IRByteCode::TailCall:
+                    {
+                        TCC_ASSERT(statement.second.has_value(), "Function call should have an arg list");
+                        auto const numArgs = std::get<IRArgumentList>(statement.second.value()).size();
+                        auto funcToCall    = std::get<std::string>(statement.first);
+
+                        // self recursion becomes a loop, the new args overwrite the current ones
+                        if (funcToCall == function.name)
+                        {
+                            TCC_ASSERT(numArgs == argVars.size(), "Recursive call with wrong number of args");
+                            for (auto i = 0UL; i < numArgs; ++i)
+                            {
+                                assembly.push_back(tcc::ByteCode::STORE);
+                                assembly.push_back(-3 - static_cast<int>(i));
+                            }
+                            assembly.push_back(tcc::ByteCode::BR);
+                            assembly.push_back(bodyPosition);
+                            break;
+                        }
+
+                        assembly.push_back(tcc::ByteCode::TAILCALL);
+                        functionPlaceholders.insert({FunctionPosition {assembly.size()}, funcToCall});
+                        assembly.push_back(9999);  // func addr
+                        assembly.push_back(numArgs);
+                        break;
+                    }
+
+                    case IRByteCode::CallNative:
+                    {
+                        TCC_ASSERT(statement.second.has_value(), "Function call should have an arg list");
+                        auto const numArgs = std::get<IRArgumentList>(statement.second.value()).size();
+                        auto const& name   = std::get<std::string>(statement.first);
+                        if (isRuntimeFunction(name))
+                        {
+                            // EXIT keeps its argument on the stack, like the result of a call
+                            if (name == "exit")
+                            {
+                                assembly.push_back(tcc::ByteCode::EXIT);
+                                break;
+                            }
+
+                            assembly.push_back(tcc::ByteCode::STORE);
+                            assembly.push_back(scratch);
+                            assembly.push_back(tcc::ByteCode::LOAD);
+                            assembly.push_back(scratch);
+                            assembly.push_back(tcc::ByteCode::PRINT);
+                            assembly.push_back(tcc::ByteCode::LOAD);
+                            assembly.push_back(scratch);
+                            break;
+                        }
+
+                        auto const native = std::find(externs.begin(), externs.end(), name);
+                        TCC_ASSERT(native != externs.end(), "Native function not found");
+
+                        assembly.push_back(tcc::ByteCode::CALLNATIVE);
+                        assembly.push_back(native - externs.begin());
+                        assembly.push_back(numArgs);
+                        break;
+                    }
+
+                    case IRByteCode::Join:
+                    {
+                        pushConstArgument();
+                        assembly.push_back(tcc::ByteCode::JOIN);
+                        break;
+                    }
+
                     case IRByteCode::Return:
                     {
                         pushConstArgument();
@@ -185,6 +285,7 @@ auto AssemblyGenerator::build(tcc::IRPackage const& package) -> Assembly
     // Append __init function. This calls main.
     TCC_ASSERT(mainPosition.has_value(), "");
     auto const entryPoint = assembly.size();
+    symbols[static_cast<int64_t>(entryPoint)] = "__init";
     assembly.push_back(ByteCode::CALL);
     assembly.push_back(mainPosition.value().value());
     assembly.push_back(0);
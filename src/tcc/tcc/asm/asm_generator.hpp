@@ -2,6 +2,10 @@
 
 #include "tcc/asm/asm.hpp"
 #include "tcc/ir/statement.hpp"
+#include "tcsl/tcsl.hpp"
+
+#include <string>
+#include <vector>
 
 namespace tcc
 {
@@ -9,5 +13,17 @@ class AssemblyGenerator
 {
 public:
     static auto build(tcc::IRPackage const& package) -> Assembly;
+
+    /**
+     * @brief Also records the start address of every function, the entry
+     * point is called __init.
+     */
+    static auto build(tcc::IRPackage const& package, SymbolTable& symbols) -> Assembly;
+
+    /**
+     * @brief The extern functions of the package CALLNATIVE indexes into.
+     * Runtime functions become PRINT & EXIT instead, see isRuntimeFunction().
+     */
+    [[nodiscard]] static auto natives(tcc::IRPackage const& package) -> std::vector<std::string>;
 };
 }  // namespace tcc
\ No newline at end of file
@@ -24,6 +24,8 @@ auto ASMUtils::prettyPrint(std::ostream& out, Assembly const& assembly) -> void
             case ByteCode::HALT:
             case ByteCode::RET:
             case ByteCode::EXIT:
+            case ByteCode::PRINT:
+            case ByteCode::JOIN:
             case ByteCode::IADD:
             case ByteCode::IMUL:
             case ByteCode::ISUB:
@@ -31,6 +33,7 @@ auto ASMUtils::prettyPrint(std::ostream& out, Assembly const& assembly) -> void
                 break;
             }
 
+            case ByteCode::BR:
             case ByteCode::LOAD:
             {
                 str.append(fmt::format(",\t{}", code.at(++i)));
@@ -47,6 +50,9 @@ auto ASMUtils::prettyPrint(std::ostream& out, Assembly const& assembly) -> void
                 break;
             }
             case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            case ByteCode::TAILCALL:
+            case ByteCode::CALLNATIVE:
             {
                 str.append(fmt::format(",\t{}", code.at(++i)));
                 str.append(fmt::format(",\t{}", code.at(++i)));
@@ -66,4 +66,23 @@ TEST_CASE("tcc/assembly: ASMUtil::PrettyPrint", "[tcc][assembly]")
         CHECK_THAT(str, Contains("RET"));
         CHECK_THAT(str, Contains("EXIT"));
     }
+
+    SECTION("3")
+    {
+        std::ostringstream stream;
+        tcc::ASMUtils::prettyPrint(stream, tcc::Assembly {
+                                               std::vector<int64_t> {
+                                                   tcc::ByteCode::LOAD, -3,        //
+                                                   tcc::ByteCode::TAILCALL, 5, 1,  //
+                                                   tcc::ByteCode::STORE, -3,       //
+                                                   tcc::ByteCode::BR, 5,           //
+                                               },
+                                               0,
+                                           });
+        auto const str = stream.str();
+
+        CHECK_THAT(str, Contains("TAILCALL,\t5,\t1"));
+        CHECK_THAT(str, Contains("STORE,\t-3"));
+        CHECK_THAT(str, Contains("BR,\t5"));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "tcc/c/c_generator.hpp"
+
+#include "tcsl/tcsl.hpp"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <variant>
+
+namespace tcc
+{
+namespace
+{
+// signed overflow is undefined in C, the VM wraps around
+constexpr auto Prelude = R"(#include <stdint.h>
+
+static inline int64_t tcc_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }
+static inline int64_t tcc_sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }
+static inline int64_t tcc_mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }
+
+/* declared locally, so extern functions may share names with the C library */
+static inline int64_t tcc_print(int64_t const* args)
+{
+    int printf(char const* format, ...);
+    printf("%lld\n", (long long)args[0]);
+    return args[0];
+}
+
+static inline int64_t tcc_exit(int64_t const* args)
+{
+    void exit(int status);
+    exit((int)args[0]);
+    return 0;
+}
+)";
+
+/**
+ * @brief The dot can't be part of an identifier & versions are plain numbers,
+ * so replacing it with an underscore keeps all registers apart.
+ */
+auto local(IRRegister name) -> std::string
+{
+    std::replace(name.begin(), name.end(), '.', '_');
+    return name;
+}
+
+auto mangle(std::string const& name) -> std::string { return "tcc_fn_" + name; }
+
+auto arguments(IRStatement const& statement) -> IRArgumentList const&
+{
+    TCC_ASSERT(statement.second.has_value(), "Function call should have an arg list");
+    return std::get<IRArgumentList>(statement.second.value());
+}
+
+auto join(IRArgumentList const& args) -> std::string
+{
+    auto result = std::string {};
+    for (auto const& arg : args)
+    {
+        if (!result.empty()) { result += ", "; }
+        result += local(arg);
+    }
+    return result;
+}
+
+class Emitter
+{
+public:
+    Emitter(IRPackage const& package, CSource& source) : package_ {package}, source_ {source} { }
+
+    auto run() -> void
+    {
+        auto const main = std::find_if(package_.functions.begin(), package_.functions.end(),
+                                       [](auto const& function) { return function.name == "main"; });
+        if (main == package_.functions.end())
+        {
+            source_.error = "Function not found: main";
+            return;
+        }
+
+        for (auto const& function : package_.functions) { functions_.insert(function.name); }
+
+        out_ << fmt::format("/* generated by tcc from {} */\n", package_.name) << Prelude << '\n';
+
+        for (auto const& native : package_.natives)
+        {
+            if (isRuntimeFunction(native)) { continue; }
+            out_ << fmt::format("int64_t {}(int64_t const* args);\n", native);
+        }
+        for (auto const& function : package_.functions) { out_ << signature(function) << ";\n"; }
+
+        for (auto const& function : package_.functions)
+        {
+            if (!emit(function)) { return; }
+        }
+
+        out_ << "\nint64_t tcc_main(void) { return tcc_fn_main(); }\n";
+        out_ << "\n#if !defined(TCC_NO_MAIN)\nint main(void) { return (int)tcc_main(); }\n#endif\n";
+        source_.code = out_.str();
+    }
+
+private:
+    auto fail(std::string message) -> bool
+    {
+        source_.error = std::move(message);
+        return false;
+    }
+
+    // arguments are passed in the order of IRFunction::args, like in the VM
+    static auto signature(IRFunction const& function) -> std::string
+    {
+        auto params = std::string {};
+        for (auto i = 0UL; i < function.args.size(); ++i)
+        { params += fmt::format("{}int64_t arg{}", i == 0 ? "" : ", ", i); }
+        if (params.empty()) { params = "void"; }
+
+        return fmt::format("static int64_t {}({})", mangle(function.name), params);
+    }
+
+    auto emit(IRFunction const& function) -> bool
+    {
+        function_ = &function;
+
+        auto const isLoop = [&](IRStatement const& statement) {
+            return statement.type == IRByteCode::TailCall && std::get<std::string>(statement.first) == function.name;
+        };
+        auto const loops = std::any_of(function.blocks.begin(), function.blocks.end(), [&](auto const& block) {
+            return std::any_of(block.statements.begin(), block.statements.end(), isLoop);
+        });
+
+        out_ << '\n' << signature(function) << "\n{\n";
+        if (loops) { out_ << "tcc_body:;\n"; }
+
+        for (auto const& block : function.blocks)
+        {
+            for (auto const& statement : block.statements)
+            {
+                if (!emit(statement)) { return false; }
+            }
+        }
+
+        // falling off the end returns 0
+        out_ << "    return 0;\n}\n";
+        return true;
+    }
+
+    auto emit(IRStatement const& statement) -> bool
+    {
+        switch (statement.type)
+        {
+            case IRByteCode::ArgStore:
+            {
+                auto const& args = function_->args;
+                auto const arg   = args.find(std::get<std::string>(statement.first));
+                TCC_ASSERT(arg != args.end(), "Argument not found");
+                define(statement.destination, fmt::format("arg{}", std::distance(args.begin(), arg)));
+                return true;
+            }
+
+            // a constant the optimizer folded keeps its temporary
+            case IRByteCode::Load:
+            case IRByteCode::Store:
+            case IRByteCode::Join:
+            {
+                define(statement.destination, operand(statement.first));
+                return true;
+            }
+
+            case IRByteCode::Addition:
+            case IRByteCode::Subtraction:
+            case IRByteCode::Multiplication:
+            {
+                TCC_ASSERT(statement.second.has_value(), "Binary operation should have two operands");
+                auto const* helper = statement.type == IRByteCode::Addition      ? "tcc_add"
+                                     : statement.type == IRByteCode::Subtraction ? "tcc_sub"
+                                                                                 : "tcc_mul";
+                define(statement.destination, fmt::format("{}({}, {})", helper, operand(statement.first),
+                                                          operand(statement.second.value())));
+                return true;
+            }
+
+            // tasks run to completion right away, the handle is the result
+            case IRByteCode::Call:
+            case IRByteCode::Spawn:
+            {
+                auto const name = std::get<std::string>(statement.first);
+                if (functions_.count(name) == 0) { return fail("Function not found: " + name); }
+                define(statement.destination, fmt::format("{}({})", mangle(name), join(arguments(statement))));
+                return true;
+            }
+
+            case IRByteCode::TailCall:
+            {
+                auto const name = std::get<std::string>(statement.first);
+                if (functions_.count(name) == 0) { return fail("Function not found: " + name); }
+
+                // self recursion becomes a loop, the new args are all in registers
+                auto const& args = arguments(statement);
+                if (name == function_->name)
+                {
+                    TCC_ASSERT(args.size() == function_->args.size(), "Recursive call with wrong number of args");
+                    auto i = 0;
+                    for (auto const& arg : args) { out_ << fmt::format("    arg{} = {};\n", i++, local(arg)); }
+                    out_ << "    goto tcc_body;\n";
+                    return true;
+                }
+
+                out_ << fmt::format("    return {}({});\n", mangle(name), join(args));
+                return true;
+            }
+
+            case IRByteCode::CallNative:
+            {
+                auto const name = std::get<std::string>(statement.first);
+                auto const& args = arguments(statement);
+                if (isRuntimeFunction(name) && args.size() != 1)
+                { return fail(fmt::format("Runtime function {} takes 1 argument", name)); }
+
+                // the args are passed as an array, first to last
+                auto const array = local(statement.destination) + "_args";
+                if (args.size() > 0) { out_ << fmt::format("    int64_t const {}[] = {{{}}};\n", array, join(args)); }
+                auto const target = isRuntimeFunction(name) ? "tcc_" + name : name;
+                define(statement.destination,
+                       fmt::format("{}({})", target, args.size() > 0 ? array : "(int64_t const*)0"));
+                return true;
+            }
+
+            case IRByteCode::Return:
+            {
+                out_ << fmt::format("    return {};\n", operand(statement.first));
+                return true;
+            }
+
+            default:
+            {
+                auto type = std::stringstream {};
+                type << statement.type;
+                return fail(fmt::format("Unsupported instruction in {}: {}", function_->name, type.str()));
+            }
+        }
+    }
+
+    auto define(IRRegister const& name, std::string const& value) -> void
+    {
+        out_ << fmt::format("    int64_t const {} = {};\n", local(name), value);
+    }
+
+    /**
+     * @brief Constants are unsigned 32 bit in the IR & widened like ICONST.
+     */
+    static auto operand(IRStatement::Argument const& argument) -> std::string
+    {
+        if (auto const* value = std::get_if<IRConstant>(&argument); value != nullptr)
+        { return fmt::format("INT64_C({})", *value); }
+        return local(std::get<IRRegister>(argument));
+    }
+
+    IRPackage const& package_;
+    CSource& source_;
+    std::ostringstream out_ {};
+    std::set<std::string> functions_ {};
+    IRFunction const* function_ {nullptr};
+};
+}  // namespace
+
+auto CGenerator::build(tcc::IRPackage const& package) -> CSource
+{
+    auto source = CSource {};
+    Emitter {package, source}.run();
+    if (!source.ok()) { source.code.clear(); }
+    return source;
+}
+
+}  // namespace tcc
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "tcc/ir/statement.hpp"
+#include "tcsl/tcsl.hpp"
+
+#include <string>
+
+namespace tcc
+{
+/**
+ * @brief One C translation unit for a whole package. Only valid if error is
+ * empty.
+ */
+struct CSource
+{
+    std::string code {};
+    std::string error {};
+
+    [[nodiscard]] auto ok() const noexcept -> bool { return error.empty(); }
+};
+
+/**
+ * @brief Lowers an IRPackage to portable C99. Every function becomes a static
+ * C function called tcc_fn_<name>, every SSA register (t.N, x.N) a local
+ * named t_N or x_N. main is exported as `int64_t tcc_main(void)`, a C main
+ * calling it is added unless TCC_NO_MAIN is defined.
+ *
+ * Covers the same instructions as the NativeGenerator, arithmetic wraps
+ * around like in the VM & self recursive tail calls become loops. Extern
+ * functions are called like tcvm natives: int64_t f(int64_t const* args),
+ * print & exit are provided by a small runtime on top of the C library.
+ */
+class CGenerator
+{
+public:
+    static auto build(tcc::IRPackage const& package) -> CSource;
+};
+}  // namespace tcc
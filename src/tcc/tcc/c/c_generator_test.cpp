@@ -0,0 +1,130 @@
+/**
+ * @file c_generator_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcc/c/c_generator.hpp"
+
+#include "tcc/compiler/compiler.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#endif
+
+using namespace Catch::Matchers;
+
+namespace
+{
+auto compile(std::string const& source, std::ostream& out, int optLevel = 1, std::string const& output = "")
+    -> tcc::Compiler
+{
+    auto options       = tcc::CompilerOptions {};
+    options.out        = &out;
+    options.source     = source;
+    options.outputName = output;
+    options.optLevel   = optLevel;
+    options.format     = tcc::OutputFormat::C;
+    return tcc::Compiler {options};
+}
+}  // namespace
+
+TEST_CASE("tcc/c: CGenerator", "[c]")
+{
+    SECTION("functions, registers & extern calls")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile(R"(
+            extern int min(a, b);
+            extern int print(x);
+            int foo(a) { int b = a * 2; return b; }
+            int main() { int x = 3; int y = foo(x); int z = print(y); return min(z, x); }
+        )",
+                                stream, 0);
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        auto const& source = compiler.getCSource();
+        REQUIRE(source.ok());
+        CHECK_THAT(source.code, Contains("int64_t min(int64_t const* args);"));
+        CHECK_THAT(source.code, !Contains("int64_t print(int64_t const* args);"));
+        CHECK_THAT(source.code, Contains("static int64_t tcc_fn_foo(int64_t arg0)"));
+        CHECK_THAT(source.code, Contains("int64_t const a_0 = arg0;"));
+        CHECK_THAT(source.code, Contains("int64_t const x_0 = INT64_C(3);"));
+        CHECK_THAT(source.code, Contains("= tcc_mul(t_"));
+        CHECK_THAT(source.code, Contains("= tcc_print(t_"));
+        CHECK_THAT(source.code, Contains("int64_t tcc_main(void)"));
+    }
+
+    SECTION("tail calls")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile(R"(
+            int spin(a) { int b = a + 1; return spin(b); }
+            int ping(c) { return spin(c); }
+            int main() { int x = 0; return ping(x); }
+        )",
+                                stream);
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        auto const& code = compiler.getCSource().code;
+        CHECK_THAT(code, Contains("tcc_body:;"));
+        CHECK_THAT(code, Contains("goto tcc_body;"));
+        CHECK_THAT(code, Contains("return tcc_fn_spin("));
+    }
+
+    SECTION("unsupported instruction")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("int main() { int x = 2; return 8 / x; }", stream);
+        REQUIRE(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Error while generating C source: Unsupported instruction in main: div"));
+        CHECK(compiler.getCSource().code.empty());
+    }
+
+    SECTION("runtime functions take one argument")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("extern int exit(a, b); int main() { int x = 2; return exit(x, x); }", stream);
+        REQUIRE(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Runtime function exit takes 1 argument"));
+    }
+}
+
+#if defined(__linux__)
+TEST_CASE("tcc/c: CompileWithSystemCompiler", "[c]")
+{
+    if (std::system("cc --version > /dev/null 2>&1") != 0) { return; }
+
+    auto const directory = std::filesystem::temp_directory_path();
+    auto const source    = (directory / "tcc_c_test.c").string();
+    auto const binary    = (directory / "tcc_c_test").string();
+    auto const output    = (directory / "tcc_c_test.txt").string();
+
+    auto stream   = std::ostringstream {};
+    auto compiler = compile(R"(
+        extern int print(x);
+        int twice(a) { return a * 2; }
+        int main() { int x = 21; int y = print(twice(x)); return y - 40; }
+    )",
+                            stream, 1, source);
+    REQUIRE(compiler.run() == EXIT_SUCCESS);
+    REQUIRE(stream.str().empty());
+
+    auto const command = "cc -std=c99 -O2 -Wall -Werror -Wno-unused-function -o " + binary + " " + source;
+    REQUIRE(std::system(command.c_str()) == 0);
+
+    auto const status = std::system((binary + " > " + output).c_str());
+    REQUIRE(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 2);
+
+    auto file  = std::ifstream {output};
+    auto lines = std::string {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+    CHECK(lines == "42\n");
+
+    for (auto const& path : {source, binary, output}) { std::filesystem::remove(path); }
+}
+#endif
@@ -4,12 +4,16 @@
 #include "tcc/asm/asm_generator.hpp"
 #include "tcc/asm/asm_utils.hpp"
 
+#include "tcc/c/c_generator.hpp"
 #include "tcc/compiler/options.hpp"
 #include "tcc/ir/generator.hpp"
+#include "tcc/native/elf_writer.hpp"
+#include "tcc/native/native_generator.hpp"
 #include "tcc/optimizer/optimizer.hpp"
 #include "tcc/parser/parser.hpp"
 #include "tcsl/tcsl.hpp"
 
+#include <fstream>
 #include <iostream>
 
 namespace tcc
@@ -55,13 +59,64 @@ public:
         if (options_.printIr) { fmt::print(*options_.out, "{}", irGenerator.currentPackage()); }
 
         auto const& package = irGenerator.currentPackage();
-        assembly_           = tcc::AssemblyGenerator::build(package);
+        assembly_           = tcc::AssemblyGenerator::build(package, symbols_);
+        natives_            = tcc::AssemblyGenerator::natives(package);
 
         if (options_.printAssembly) { tcc::ASMUtils::prettyPrint(*options_.out, assembly_); }
 
-        if (!options_.outputName.empty())
+        auto const isNative = options_.format == OutputFormat::Object || options_.format == OutputFormat::Executable;
+        if (isNative)
         {
-            auto binaryProgram = tcc::BinaryProgram {1, options_.outputName, assembly_.second, assembly_.first};
+            native_ = tcc::NativeGenerator::build(package);
+            if (!native_.ok())
+            {
+                fmt::print(*options_.out, "Error while generating native code: {}\n", native_.error);
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (options_.format == OutputFormat::C)
+        {
+            csource_ = tcc::CGenerator::build(package);
+            if (!csource_.ok())
+            {
+                fmt::print(*options_.out, "Error while generating C source: {}\n", csource_.error);
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (options_.format == OutputFormat::Executable && !native_.relocations.empty())
+        {
+            fmt::print(*options_.out, "Error while linking: Unresolved extern function: {}\n",
+                       native_.relocations.front().symbol);
+            return EXIT_FAILURE;
+        }
+
+        if (!options_.outputName.empty() && isNative)
+        {
+            auto const executable = options_.format == OutputFormat::Executable;
+            auto const image = executable ? tcc::ElfWriter::executable(native_) : tcc::ElfWriter::object(native_);
+            if (!tcc::ElfWriter::writeToFile(options_.outputName, image, executable))
+            {
+                fmt::print(*options_.out, "Error while writing binary!\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!options_.outputName.empty() && options_.format == OutputFormat::C)
+        {
+            auto file = std::ofstream {options_.outputName};
+            file << csource_.code;
+            file.close();
+            if (!file.good())
+            {
+                fmt::print(*options_.out, "Error while writing C source!\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!options_.outputName.empty())
+        {
+            auto binaryProgram
+                = tcc::BinaryProgram {1, options_.outputName, assembly_.second, assembly_.first, symbols_, natives_};
             if (!tcc::BinaryFormat::writeToFile(options_.outputName, binaryProgram))
             {
                 fmt::print(*options_.out, "Error while writing binary!\n");
@@ -74,10 +129,18 @@ public:
 
     [[nodiscard]] auto getAssembly() const -> std::vector<int64_t> const& { return assembly_.first; }
     [[nodiscard]] auto getEntryPoint() const -> int64_t { return assembly_.second; }
+    [[nodiscard]] auto getSymbols() const -> SymbolTable const& { return symbols_; }
+    [[nodiscard]] auto getNatives() const -> std::vector<std::string> const& { return natives_; }
+    [[nodiscard]] auto getNativeProgram() const -> NativeProgram const& { return native_; }
+    [[nodiscard]] auto getCSource() const -> CSource const& { return csource_; }
 
 private:
     CompilerOptions options_ {};
     Assembly assembly_ {};
+    SymbolTable symbols_ {};
+    std::vector<std::string> natives_ {};
+    NativeProgram native_ {};
+    CSource csource_ {};
 };
 }  // namespace tcc
 
@@ -98,4 +98,79 @@ TEST_CASE("tcc/compiler: Run", "[compiler]")
         CHECK_THAT(cliOutput, Contains("Error while compiling"));
         CHECK_THAT(cliOutput, Contains("Undeclared variable: a line 1:"));
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcc/compiler: Extern", "[compiler]")
+{
+    SECTION("calls to extern functions use CALLNATIVE")
+    {
+        auto source = std::string {
+            "extern int max(a, b); int main() { int x = 3; int y = 4; return max(x, y); } extern int hash(x);"};
+        auto stream  = std::ostringstream {};
+        auto options = tcc::CompilerOptions {
+            .out      = &stream,
+            .source   = source,
+            .optLevel = 0,
+        };
+
+        auto compiler         = tcc::Compiler {options};
+        auto const returnCode = compiler.run();
+
+        CHECK(returnCode == EXIT_SUCCESS);
+        CHECK(stream.str().empty());
+        CHECK(compiler.getNatives() == std::vector<std::string> {"max", "hash"});
+
+        auto const& code = compiler.getAssembly();
+        auto const call  = std::find(code.begin(), code.end(), tcc::ByteCode::CALLNATIVE);
+        REQUIRE(std::distance(call, code.end()) > 2);
+        CHECK(call[1] == 0);
+        CHECK(call[2] == 2);
+    }
+
+    SECTION("wrong number of arguments")
+    {
+        auto source  = std::string {"extern int max(a, b); int main() { int x = 3; return max(x); }"};
+        auto stream  = std::ostringstream {};
+        auto options = tcc::CompilerOptions {
+            .out      = &stream,
+            .source   = source,
+            .optLevel = 0,
+        };
+
+        auto compiler = tcc::Compiler {options};
+        CHECK(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Wrong number of arguments: max"));
+    }
+
+    SECTION("extern & defined function with the same name")
+    {
+        auto source  = std::string {"extern int f(a); int f(a) { return a; } int main() { return 1; }"};
+        auto stream  = std::ostringstream {};
+        auto options = tcc::CompilerOptions {
+            .out      = &stream,
+            .source   = source,
+            .optLevel = 0,
+        };
+
+        auto compiler = tcc::Compiler {options};
+        CHECK(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Duplicate function: f"));
+    }
+}
+
+TEST_CASE("tcc/compiler: Builtins", "[compiler]")
+{
+    auto const source = GENERATE(std::string {"int spawn(a) { return a; } int main() { return spawn(1); }"},
+                                 std::string {"extern int join(h); int main() { int h = 1; return join(h); }"});
+
+    auto stream  = std::ostringstream {};
+    auto options = tcc::CompilerOptions {
+        .out      = &stream,
+        .source   = source,
+        .optLevel = 0,
+    };
+
+    auto compiler = tcc::Compiler {options};
+    CHECK(compiler.run() == EXIT_FAILURE);
+    CHECK_THAT(stream.str(), Contains("Reserved function name"));
+}
@@ -5,6 +5,17 @@
 
 namespace tcc
 {
+/**
+ * @brief What the compiler writes to CompilerOptions::outputName.
+ */
+enum class OutputFormat
+{
+    Bytecode,    // tcvm binary program
+    Object,      // x86-64 ELF relocatable object
+    Executable,  // x86-64 ELF static executable
+    C,           // C source for the system compiler
+};
+
 /**
  * @brief Compiler flags.
  */
@@ -18,6 +29,7 @@ struct CompilerOptions
     bool printAst {false};
     bool printIr {false};
     bool printAssembly {false};
+    OutputFormat format {OutputFormat::Bytecode};
 };
 
 }  // namespace tcc
\ No newline at end of file
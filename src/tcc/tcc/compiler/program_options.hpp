@@ -4,6 +4,7 @@
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -46,6 +47,7 @@ public:
             options("print-ast",        po::bool_switch(&flags_.printAst),          "print parsed ast");
             options("print-ir",         po::bool_switch(&flags_.printIr),           "print generated ir");
             options("print-asm",        po::bool_switch(&flags_.printAssembly),     "print generated asm");
+            options("emit",             po::value<std::string>(&format_),           "output format: bytecode, object, executable or c");
             // clang-format on
 
             po::positional_options_description p;
@@ -60,6 +62,23 @@ public:
                 return {true, EXIT_SUCCESS};
             }
 
+            if (vm_.count("emit") != 0U)
+            {
+                auto const formats = std::map<std::string, OutputFormat> {
+                    {"bytecode", OutputFormat::Bytecode},
+                    {"object", OutputFormat::Object},
+                    {"executable", OutputFormat::Executable},
+                    {"c", OutputFormat::C},
+                };
+                auto const format = formats.find(format_);
+                if (format == formats.end())
+                {
+                    fmt::print(out_, "Unknown output format: {}\n", format_);
+                    return {true, EXIT_FAILURE};
+                }
+                flags_.format = format->second;
+            }
+
             if (vm_.count("input") != 0U)
             {
                 auto const paths = vm_["input"].as<std::vector<std::string>>();
@@ -101,6 +120,7 @@ public:
 
 private:
     CompilerOptions flags_ {};
+    std::string format_ {};
     po::variables_map vm_;
     std::ostream& out_;
 };
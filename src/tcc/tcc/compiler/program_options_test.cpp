@@ -104,6 +104,25 @@ TEST_CASE("tcc/compiler: ProgramOptions", "[tcc][compiler]")
         CHECK(exitCode == EXIT_SUCCESS);
     }
 
+    SECTION("--emit")
+    {
+        auto arguments   = std::vector<char const*> {"binary", "--emit", "executable", "unkown_file.tcc"};
+        auto const argc  = static_cast<int>(arguments.size());
+        auto const* argv = arguments.data();
+
+        auto stream         = std::ostringstream();
+        auto programOptions = tcc::ProgramOptions {stream};
+        programOptions.parseArguments(argc, argv);
+        CHECK(programOptions.getCompilerOptions().format == tcc::OutputFormat::Executable);
+
+        arguments[2]                      = "wasm";
+        auto unknown                      = tcc::ProgramOptions {stream};
+        auto const [shouldExit, exitCode] = unknown.parseArguments(argc, argv);
+        CHECK(shouldExit);
+        CHECK(exitCode == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Unknown output format: wasm"));
+    }
+
     SECTION("multiple source files not allowed currently")
     {
         auto const args  = std::vector<char const*> {"binary", "unkown_file1.tcc", "unkown_file2.tcc"};
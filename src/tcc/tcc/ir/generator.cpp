@@ -2,9 +2,25 @@
 #include "tcsl/tcsl.hpp"
 
 #include <boost/variant/apply_visitor.hpp>
+#include <boost/variant/get.hpp>
 
 namespace tcc
 {
+namespace
+{
+// a lone function call, the parser wraps it in one expression per precedence level
+auto asFunctionCall(tcc::ast::Expression const& expr) -> tcc::ast::FunctionCall const*
+{
+    if (!expr.rest.empty()) { return nullptr; }
+    if (auto const* call = boost::get<tcc::ast::FunctionCall>(&expr.first); call != nullptr) { return call; }
+    if (auto const* inner = boost::get<tcc::ast::Expression>(&expr.first); inner != nullptr)
+    { return asFunctionCall(*inner); }
+    return nullptr;
+}
+
+// handled by the generator itself, a function with the same name could never be called
+auto isBuiltin(std::string const& name) -> bool { return name == "spawn" || name == "join"; }
+}  // namespace
 
 auto IRGenerator::operator()(tcc::ast::Nil /*unused*/) -> bool
 {
@@ -126,6 +142,16 @@ auto IRGenerator::operator()(tcc::ast::Unary const& x) -> bool
 }
 auto IRGenerator::operator()(tcc::ast::FunctionCall const& call) -> bool
 {
+    if (call.funcName.name == "spawn") { return spawn(call); }
+    if (call.funcName.name == "join") { return join(call); }
+
+    auto const external = externals_.find(call.funcName.name);
+    if (external != externals_.end() && external->second != call.args.size())
+    {
+        errorHandler_(call.funcName.id, "Wrong number of arguments: " + call.funcName.name);
+        return false;
+    }
+
     auto argTemps = IRArgumentList {};
     for (auto const& expr : call.args)
     {
@@ -133,8 +159,43 @@ auto IRGenerator::operator()(tcc::ast::FunctionCall const& call) -> bool
         argTemps.pushBack(builder_.getLastTemporary());
     }
 
+    if (external != externals_.end()) { return builder_.createNativeCall(call.funcName.name, argTemps); }
     return builder_.createFunctionCall(call.funcName.name, argTemps);
 }
+// spawn(f(args...)) runs the call as a task, the result is a handle for join
+auto IRGenerator::spawn(tcc::ast::FunctionCall const& call) -> bool
+{
+    auto const* task = call.args.size() == 1 ? asFunctionCall(call.args[0]) : nullptr;
+    if (task == nullptr)
+    {
+        errorHandler_(call.funcName.id, "spawn expects a function call");
+        return false;
+    }
+
+    auto argTemps = IRArgumentList {};
+    for (auto const& expr : task->args)
+    {
+        if (!(*this)(expr)) { return false; }
+        argTemps.pushBack(builder_.getLastTemporary());
+    }
+
+    return builder_.createSpawn(task->funcName.name, argTemps);
+}
+
+// join(handle) waits for the task & yields its result
+auto IRGenerator::join(tcc::ast::FunctionCall const& call) -> bool
+{
+    if (call.args.size() != 1)
+    {
+        errorHandler_(call.funcName.id, "join expects one handle");
+        return false;
+    }
+
+    if (!(*this)(call.args[0])) { return false; }
+    builder_.createJoin();
+    return true;
+}
+
 auto IRGenerator::operator()(tcc::ast::Expression const& x) -> bool
 {
     if (!boost::apply_visitor(*this, x.first)) { return false; }
@@ -232,6 +293,20 @@ auto IRGenerator::operator()(tcc::ast::ReturnStatement const& x) -> bool
 
 auto IRGenerator::operator()(tcc::ast::Function const& func) -> bool
 {
+    if (isBuiltin(func.funcName.name))
+    {
+        errorHandler_(func.funcName.id, "Reserved function name: " + func.funcName.name);
+        return false;
+    }
+
+    // declared up front by the function list
+    if (func.external) { return true; }
+    if (externals_.contains(func.funcName.name))
+    {
+        errorHandler_(func.funcName.id, "Duplicate function: " + func.funcName.name);
+        return false;
+    }
+
     auto args = IRArgumentList {};
     for (auto const& arg : func.args) { args.pushBack(arg.name); }
 
@@ -246,6 +321,23 @@ auto IRGenerator::operator()(tcc::ast::Function const& func) -> bool
 
 auto IRGenerator::operator()(tcc::ast::FunctionList const& funcList) -> bool
 {
+    // extern functions can be called before their declaration, like all others
+    for (auto const& func : funcList)
+    {
+        if (!func.external || isBuiltin(func.funcName.name)) { continue; }
+        if (isRuntimeFunction(func.funcName.name) && func.args.size() != 1)
+        {
+            errorHandler_(func.funcName.id, "Runtime function " + func.funcName.name + " takes 1 argument");
+            return false;
+        }
+        if (!externals_.try_emplace(func.funcName.name, func.args.size()).second)
+        {
+            errorHandler_(func.funcName.id, "Duplicate function: " + func.funcName.name);
+            return false;
+        }
+        builder_.currentPackage().natives.push_back(func.funcName.name);
+    }
+
     for (auto const& func : funcList)
     {
         if (!(*this)(func)) { return false; }
@@ -428,6 +520,44 @@ auto IRGenerator::Builder::createFunctionCall(std::string name, IRArgumentList a
     return true;
 }
 
+auto IRGenerator::Builder::createSpawn(std::string name, IRArgumentList argTemps) -> bool
+{
+    currentBlock_->statements.push_back(IRStatement {
+        .type        = IRByteCode::Spawn,
+        .isTemporary = {},
+        .destination = createTemporaryOnStack(),
+        .first       = std::move(name),
+        .second      = argTemps,
+    });
+    return true;
+}
+
+auto IRGenerator::Builder::createNativeCall(std::string name, IRArgumentList argTemps) -> bool
+{
+    currentBlock_->statements.push_back(IRStatement {
+        .type        = IRByteCode::CallNative,
+        .isTemporary = {},
+        .destination = createTemporaryOnStack(),
+        .first       = std::move(name),
+        .second      = argTemps,
+    });
+    return true;
+}
+
+auto IRGenerator::Builder::createJoin() -> void
+{
+    auto handle  = popFromStack();
+    auto tmpName = createTemporaryOnStack();
+
+    currentBlock_->statements.push_back(IRStatement {
+        .type        = IRByteCode::Join,
+        .isTemporary = false,
+        .destination = std::move(tmpName),
+        .first       = std::move(handle),
+        .second      = {},
+    });
+}
+
 void IRGenerator::Builder::createIfStatementCondition()
 {
     currentBlock_->statements.push_back(IRStatement {
@@ -71,6 +71,10 @@ public:
     auto currentPackage() -> IRPackage& { return builder_.currentPackage(); }
 
 private:
+    auto spawn(tcc::ast::FunctionCall const& call) -> bool;
+
+    auto join(tcc::ast::FunctionCall const& call) -> bool;
+
     struct Builder
     {
         Builder() = default;
@@ -107,6 +111,12 @@ private:
 
         [[nodiscard]] auto createFunctionCall(std::string name, IRArgumentList argTemps) -> bool;
 
+        [[nodiscard]] auto createSpawn(std::string name, IRArgumentList argTemps) -> bool;
+
+        [[nodiscard]] auto createNativeCall(std::string name, IRArgumentList argTemps) -> bool;
+
+        auto createJoin() -> void;
+
         auto createIfStatementCondition() -> void;
 
         auto startBasicBlock(const std::string& suffix = "") -> void;
@@ -123,6 +133,7 @@ private:
     };
 
     Builder builder_ {};
+    std::map<std::string, std::size_t> externals_ {};  // extern function -> number of arguments
     boost::function<void(int tag, std::string const& what)> errorHandler_;
 };
 }  // namespace tcc
@@ -31,6 +31,10 @@ auto operator<<(std::ostream& out, IRByteCode const data) -> std::ostream&
         case IRByteCode::Jump: return out << "jump";
         case IRByteCode::StackAdjust: return out << "stk_adj";
         case IRByteCode::Call: return out << "call";
+        case IRByteCode::TailCall: return out << "tail_call";
+        case IRByteCode::Spawn: return out << "spawn";
+        case IRByteCode::Join: return out << "join";
+        case IRByteCode::CallNative: return out << "call_native";
         case IRByteCode::Return: return out << "return";
     }
 
@@ -38,6 +38,10 @@ enum class IRByteCode
 
     StackAdjust,  // adjust the stack (for args and locals)
     Call,         // function call
+    TailCall,     // function call as the last statement, replaces the current frame
+    Spawn,        // function call as a task, yields a handle
+    Join,         // wait for a task, yields its result
+    CallNative,   // call of an extern host function, by index into IRPackage::natives
     Return        // return from function
 };
 
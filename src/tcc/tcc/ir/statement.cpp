@@ -27,7 +27,9 @@ auto operator<<(std::ostream& out, IRStatement const& data) -> std::ostream&
     auto opCodeStr = std::stringstream {};
     opCodeStr << static_cast<tcc::IRByteCode>(data.type);
 
-    if (data.type == IRByteCode::Call) { std::replace(std::begin(firstStr), std::end(firstStr), '%', '@'); }
+    if (data.type == IRByteCode::Call || data.type == IRByteCode::TailCall || data.type == IRByteCode::Spawn
+        || data.type == IRByteCode::CallNative)
+    { std::replace(std::begin(firstStr), std::end(firstStr), '%', '@'); }
 
     return out << fmt::format("{0}\t:=\t{1}\t{2}\t{3}", data.destination, opCodeStr.str(), firstStr, secondStr);
 }
@@ -37,6 +39,7 @@ auto operator<<(std::ostream& out, IRFunction const& data) -> std::ostream& { re
 auto operator<<(std::ostream& out, IRPackage const& pkg) -> std::ostream&
 {
     out << fmt::format("\n; {0}: functions={1}\n", pkg.name, pkg.functions.size());
+    for (auto const& native : pkg.natives) { out << fmt::format("; extern {0}\n", native); }
     for (auto const& func : pkg.functions)
     {
         out << fmt::format("; func {0}: args={1} locals={2} instructions={3}\n", func.name, func.args.size(),
@@ -52,4 +55,6 @@ auto operator<<(std::ostream& out, IRPackage const& pkg) -> std::ostream&
 
     return out;
 }
+auto isRuntimeFunction(std::string_view const name) noexcept -> bool { return name == "print" || name == "exit"; }
+
 }  // namespace tcc
\ No newline at end of file
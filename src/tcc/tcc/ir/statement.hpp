@@ -4,6 +4,7 @@
 #include <optional>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -74,8 +75,15 @@ struct IRPackage
 {
     IRIdentifier name;
     std::vector<IRFunction> functions = {};
+    std::vector<IRIdentifier> natives = {};  // extern functions in order of declaration
 };
 
 auto operator<<(std::ostream& out, IRPackage const& pkg) -> std::ostream&;
 
+/**
+ * @brief print & exit are extern functions every backend provides itself,
+ * they take one argument.
+ */
+auto isRuntimeFunction(std::string_view name) noexcept -> bool;
+
 }  // namespace tcc
\ No newline at end of file
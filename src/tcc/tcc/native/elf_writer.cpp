@@ -0,0 +1,302 @@
+#include "tcc/native/elf_writer.hpp"
+
+#include "tcsl/tcsl.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace tcc
+{
+namespace
+{
+constexpr auto HeaderSize        = 64U;
+constexpr auto ProgramHeaderSize = 56U;
+constexpr auto SectionHeaderSize = 64U;
+constexpr auto SymbolSize        = 24U;
+constexpr auto RelocationSize    = 24U;
+
+// loaded at the usual base of static executables
+constexpr auto BaseAddress = std::uint64_t {0x400000};
+
+enum FileType : std::uint16_t
+{
+    Relocatable = 1,
+    Executable  = 2,
+};
+
+enum SectionType : std::uint32_t
+{
+    ProgBits = 1,
+    SymTab   = 2,
+    StrTab   = 3,
+    Rela     = 4,
+};
+
+enum SectionFlags : std::uint64_t
+{
+    Alloc     = 0x2,
+    ExecInstr = 0x4,
+    InfoLink  = 0x40,
+};
+
+enum SymbolInfo : std::uint8_t
+{
+    LocalFunction  = 0x02,
+    GlobalFunction = 0x12,
+    GlobalNoType   = 0x10,
+};
+
+constexpr auto RelocationPlt32 = std::uint64_t {4};
+
+/**
+ * @brief Little endian byte buffer.
+ */
+class Image
+{
+public:
+    auto u8(std::uint8_t value) -> void { bytes_.push_back(value); }
+    auto u16(std::uint16_t value) -> void { put(value, 2); }
+    auto u32(std::uint32_t value) -> void { put(value, 4); }
+    auto u64(std::uint64_t value) -> void { put(value, 8); }
+    auto append(std::vector<std::uint8_t> const& bytes) -> void
+    {
+        bytes_.insert(bytes_.end(), bytes.begin(), bytes.end());
+    }
+    auto append(std::string const& bytes) -> void { bytes_.insert(bytes_.end(), bytes.begin(), bytes.end()); }
+    auto align(std::size_t alignment) -> void { bytes_.resize((bytes_.size() + alignment - 1) / alignment * alignment); }
+
+    [[nodiscard]] auto size() const noexcept -> std::uint64_t { return bytes_.size(); }
+    [[nodiscard]] auto release() -> std::vector<std::uint8_t> { return std::move(bytes_); }
+
+private:
+    auto put(std::uint64_t value, unsigned size) -> void
+    {
+        for (auto i = 0U; i < size; ++i) { bytes_.push_back(static_cast<std::uint8_t>(value >> (8U * i))); }
+    }
+
+    std::vector<std::uint8_t> bytes_ {};
+};
+
+/**
+ * @brief Null terminated names, the empty name is at offset 0.
+ */
+class StringTable
+{
+public:
+    auto add(std::string const& name) -> std::uint32_t
+    {
+        if (name.empty()) { return 0; }
+        auto const offset = static_cast<std::uint32_t>(data_.size());
+        data_.append(name);
+        data_.push_back('\0');
+        return offset;
+    }
+
+    [[nodiscard]] auto data() const noexcept -> std::string const& { return data_; }
+
+private:
+    std::string data_ {std::string(1, '\0')};
+};
+
+struct Section
+{
+    std::uint32_t name {0};
+    std::uint32_t type {0};
+    std::uint64_t flags {0};
+    std::uint64_t offset {0};
+    std::uint64_t size {0};
+    std::uint32_t link {0};
+    std::uint32_t info {0};
+    std::uint64_t alignment {1};
+    std::uint64_t entrySize {0};
+};
+
+auto writeHeader(Image& image, FileType type, std::uint64_t entry, std::uint16_t programHeaders,
+                 std::uint64_t sectionOffset, std::uint16_t sections) -> void
+{
+    for (auto const byte : {0x7F, int {'E'}, int {'L'}, int {'F'}, 2, 1, 1, 0}) { image.u8(static_cast<std::uint8_t>(byte)); }
+    image.u64(0);  // padding
+    image.u16(type);
+    image.u16(62);  // x86-64
+    image.u32(1);
+    image.u64(entry);
+    image.u64(programHeaders > 0 ? HeaderSize : 0);
+    image.u64(sectionOffset);
+    image.u32(0);
+    image.u16(HeaderSize);
+    image.u16(programHeaders > 0 ? ProgramHeaderSize : 0);
+    image.u16(programHeaders);
+    image.u16(sections > 0 ? SectionHeaderSize : 0);
+    image.u16(sections);
+    image.u16(sections > 0 ? sections - 1 : 0);  // section names are last
+}
+
+auto writeSection(Image& image, Section const& section) -> void
+{
+    image.u32(section.name);
+    image.u32(section.type);
+    image.u64(section.flags);
+    image.u64(0);  // address
+    image.u64(section.offset);
+    image.u64(section.size);
+    image.u32(section.link);
+    image.u32(section.info);
+    image.u64(section.alignment);
+    image.u64(section.entrySize);
+}
+
+auto writeSymbol(Image& image, std::uint32_t name, std::uint8_t info, std::uint16_t section, std::uint64_t value,
+                 std::uint64_t size) -> void
+{
+    image.u32(name);
+    image.u8(info);
+    image.u8(0);
+    image.u16(section);
+    image.u64(value);
+    image.u64(size);
+}
+}  // namespace
+
+auto ElfWriter::object(NativeProgram const& code) -> std::vector<std::uint8_t>
+{
+    enum Index : std::uint16_t
+    {
+        Null,
+        Text,
+        RelaText,
+        Symbols,
+        Strings,
+        GnuStack,
+        SectionNames,
+        NumSections,
+    };
+
+    auto names   = StringTable {};
+    auto strings = StringTable {};
+
+    // locals have to come first
+    auto symbols = Image {};
+    writeSymbol(symbols, 0, 0, 0, 0, 0);
+    for (auto const& symbol : code.symbols)
+    {
+        if (symbol.name == "tcc_main") { continue; }
+        writeSymbol(symbols, strings.add(symbol.name), LocalFunction, Text, symbol.offset, symbol.size);
+    }
+    auto const firstGlobal = static_cast<std::uint32_t>(symbols.size() / SymbolSize);
+    auto const main = std::find_if(code.symbols.begin(), code.symbols.end(),
+                                   [](auto const& symbol) { return symbol.name == "tcc_main"; });
+    TCC_ASSERT(main != code.symbols.end(), "Native code without entry point");
+    writeSymbol(symbols, strings.add(main->name), GlobalFunction, Text, main->offset, main->size);
+
+    auto externals = std::map<std::string, std::uint32_t> {};
+    auto relocations = Image {};
+    for (auto const& relocation : code.relocations)
+    {
+        auto [external, inserted] = externals.try_emplace(relocation.symbol, 0);
+        if (inserted)
+        {
+            external->second = static_cast<std::uint32_t>(symbols.size() / SymbolSize);
+            writeSymbol(symbols, strings.add(relocation.symbol), GlobalNoType, 0, 0, 0);
+        }
+
+        // the displacement is relative to the end of the call
+        relocations.u64(relocation.offset);
+        relocations.u64((std::uint64_t {external->second} << 32U) | RelocationPlt32);
+        relocations.u64(static_cast<std::uint64_t>(-4));
+    }
+
+    auto sections = std::vector<Section>(NumSections);
+    sections[Text]         = {names.add(".text"), ProgBits, Alloc | ExecInstr, 0, code.text.size(), 0, 0, 16, 0};
+    sections[RelaText]     = {names.add(".rela.text"), Rela, InfoLink, 0, relocations.size(), Symbols, Text, 8,
+                          RelocationSize};
+    sections[Symbols]      = {names.add(".symtab"), SymTab, 0, 0, symbols.size(), Strings, firstGlobal, 8, SymbolSize};
+    sections[Strings]      = {names.add(".strtab"), StrTab, 0, 0, strings.data().size(), 0, 0, 1, 0};
+    sections[GnuStack]     = {names.add(".note.GNU-stack"), ProgBits, 0, 0, 0, 0, 0, 1, 0};
+    sections[SectionNames] = {names.add(".shstrtab"), StrTab, 0, 0, names.data().size(), 0, 0, 1, 0};
+
+    // the header is written last, once the section headers are placed
+    auto image = Image {};
+    image.append(std::vector<std::uint8_t>(HeaderSize));
+
+    auto const place = [&](Index index, auto const& bytes) {
+        image.align(sections[index].alignment);
+        sections[index].offset = image.size();
+        image.append(bytes);
+    };
+    place(Text, code.text);
+    place(RelaText, relocations.release());
+    place(Symbols, symbols.release());
+    place(Strings, strings.data());
+    sections[GnuStack].offset = image.size();
+    place(SectionNames, names.data());
+
+    image.align(8);
+    auto const sectionOffset = image.size();
+    for (auto const& section : sections) { writeSection(image, section); }
+
+    auto result = image.release();
+    auto header = Image {};
+    writeHeader(header, Relocatable, 0, 0, sectionOffset, NumSections);
+    auto const bytes = header.release();
+    std::copy(bytes.begin(), bytes.end(), result.begin());
+    return result;
+}
+
+auto ElfWriter::executable(NativeProgram const& code) -> std::vector<std::uint8_t>
+{
+    TCC_ASSERT(code.relocations.empty(), "Executables can't call extern functions");
+
+    // one read & execute segment for everything, plus a non executable stack
+    auto const textOffset = std::uint64_t {HeaderSize + 2 * ProgramHeaderSize};
+    auto const fileSize   = textOffset + code.text.size();
+
+    auto image = Image {};
+    writeHeader(image, Executable, BaseAddress + textOffset + code.start, 2, 0, 0);
+
+    image.u32(1);        // load
+    image.u32(0x4 | 0x1);  // read & execute
+    image.u64(0);
+    image.u64(BaseAddress);
+    image.u64(BaseAddress);
+    image.u64(fileSize);
+    image.u64(fileSize);
+    image.u64(0x1000);
+
+    image.u32(0x6474E551);  // gnu stack
+    image.u32(0x4 | 0x2);   // read & write
+    for (auto i = 0; i < 5; ++i) { image.u64(0); }
+    image.u64(16);
+
+    image.append(code.text);
+    return image.release();
+}
+
+auto ElfWriter::writeToFile(std::string const& path, std::vector<std::uint8_t> const& image, bool executable)
+    -> bool
+{
+    auto file = std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        fmt::print("Could not open file: {}\n", path);
+        return false;
+    }
+
+    file.write(reinterpret_cast<char const*>(image.data()), static_cast<std::streamsize>(image.size()));
+    file.close();
+    if (!file.good()) { return false; }
+
+    if (executable)
+    {
+        namespace fs   = std::filesystem;
+        auto const all = fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec;
+        auto error     = std::error_code {};
+        fs::permissions(path, all, fs::perm_options::add, error);
+        return !error;
+    }
+
+    return true;
+}
+
+}  // namespace tcc
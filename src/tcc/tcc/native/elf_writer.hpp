@@ -0,0 +1,35 @@
+#pragma once
+
+#include "tcc/native/native_generator.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tcc
+{
+/**
+ * @brief Packs NativeProgram into ELF64 files for x86-64 linux.
+ */
+class ElfWriter
+{
+public:
+    /**
+     * @brief Relocatable object. Functions are local symbols, tcc_main is
+     * global & every extern function becomes an undefined symbol.
+     */
+    static auto object(NativeProgram const& code) -> std::vector<std::uint8_t>;
+
+    /**
+     * @brief Static executable starting at _start. Only for code without
+     * relocations, there is no linker to resolve them.
+     */
+    static auto executable(NativeProgram const& code) -> std::vector<std::uint8_t>;
+
+    /**
+     * @brief Executables are marked as such for everyone allowed to read them.
+     */
+    static auto writeToFile(std::string const& path, std::vector<std::uint8_t> const& image, bool executable)
+        -> bool;
+};
+}  // namespace tcc
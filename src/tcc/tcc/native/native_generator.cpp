@@ -0,0 +1,444 @@
+#include "tcc/native/native_generator.hpp"
+
+#include "tcsl/tcsl.hpp"
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <variant>
+
+namespace tcc
+{
+namespace
+{
+constexpr auto RAX = X86Register::RAX;
+constexpr auto RCX = X86Register::RCX;
+constexpr auto RDX = X86Register::RDX;
+constexpr auto RBX = X86Register::RBX;
+constexpr auto RSP = X86Register::RSP;
+constexpr auto RBP = X86Register::RBP;
+constexpr auto RSI = X86Register::RSI;
+constexpr auto RDI = X86Register::RDI;
+constexpr auto R8  = X86Register::R8;
+constexpr auto R9  = X86Register::R9;
+
+// linux system calls
+constexpr auto SysWrite     = 1;
+constexpr auto SysExitGroup = 231;
+
+auto slot(X86Register base, int64_t offset) -> X86Memory
+{
+    return X86Memory {base, {}, 1, static_cast<int32_t>(offset)};
+}
+
+auto numArguments(IRStatement const& statement) -> int64_t
+{
+    TCC_ASSERT(statement.second.has_value(), "Function call should have an arg list");
+    return static_cast<int64_t>(std::get<IRArgumentList>(statement.second.value()).size());
+}
+
+/**
+ * @brief Every function has a frame pointer in rbp, the arguments are pushed
+ * by the caller from first to last:
+ *
+ *  [rbp + 16 + 8 * (n - 1 - i)]  argument i of n
+ *  [rbp + 8]                     return address
+ *  [rbp]                         callers rbp
+ *  [rbp - 8 * (i + 1)]           local i
+ *  below                         temporaries
+ *
+ * Arguments & locals are ordered like in the AssemblyGenerator. The result is
+ * returned in rax, the caller resets rsp from its frame pointer, so a tail
+ * call may leave a different number of arguments behind.
+ */
+class Lowering
+{
+public:
+    Lowering(IRPackage const& package, NativeProgram& code) : package_ {package}, code_ {code} { }
+
+    auto run() -> void
+    {
+        for (auto const& function : package_.functions) { functions_.try_emplace(function.name, assembler_.newLabel()); }
+        auto const main = functions_.find("main");
+        if (main == functions_.end())
+        {
+            code_.error = "Function not found: main";
+            return;
+        }
+
+        print_ = assembler_.newLabel();
+        exit_  = assembler_.newLabel();
+
+        for (auto const& function : package_.functions)
+        {
+            auto const begin = assembler_.code().size();
+            if (!lower(function)) { return; }
+            code_.symbols.push_back(NativeSymbol {function.name, begin, assembler_.code().size() - begin});
+        }
+
+        runtime(main->second);
+        if (!assembler_.finalize())
+        {
+            code_.error = "Unresolved jump";
+            return;
+        }
+        code_.text = assembler_.code();
+    }
+
+private:
+    auto fail(std::string message) -> bool
+    {
+        code_.error = std::move(message);
+        return false;
+    }
+
+    auto lower(IRFunction const& function) -> bool
+    {
+        function_ = &function;
+        depth_    = 0;
+
+        assembler_.bind(functions_.at(function.name));
+        assembler_.push(RBP);
+        assembler_.mov(RBP, RSP);
+        assembler_.xor32(RAX, RAX);
+        for (auto i = 0UL; i < function.variables.size(); ++i) { assembler_.push(RAX); }
+        body_ = assembler_.newLabel();
+        assembler_.bind(body_);
+
+        for (auto const& block : function.blocks)
+        {
+            for (auto const& statement : block.statements)
+            {
+                if (!lower(statement)) { return false; }
+            }
+        }
+
+        // falling off the end returns 0
+        assembler_.xor32(RAX, RAX);
+        leave();
+        return true;
+    }
+
+    auto lower(IRStatement const& statement) -> bool
+    {
+        switch (statement.type)
+        {
+            // arguments are already in place
+            case IRByteCode::ArgStore: return true;
+
+            case IRByteCode::Load:
+            {
+                auto const variable = find(std::get<std::string>(statement.first));
+                if (!variable.has_value()) { return fail("Unknown variable: " + std::get<std::string>(statement.first)); }
+                assembler_.mov(RAX, *variable);
+                push(RAX);
+                return true;
+            }
+
+            case IRByteCode::Store:
+            {
+                operand(RAX, statement.first);
+
+                // a constant the optimizer folded, still passed as an argument
+                if (statement.isTemporary)
+                {
+                    push(RAX);
+                    return true;
+                }
+
+                auto const variable = find(statement.destination);
+                if (!variable.has_value()) { return fail("Unknown variable: " + statement.destination); }
+                assembler_.mov(*variable, RAX);
+                return true;
+            }
+
+            case IRByteCode::Addition:
+            case IRByteCode::Subtraction:
+            case IRByteCode::Multiplication:
+            {
+                TCC_ASSERT(statement.second.has_value(), "Binary operation should have two operands");
+                operand(RCX, statement.second.value());
+                operand(RAX, statement.first);
+                if (statement.type == IRByteCode::Addition) { assembler_.add(RAX, RCX); }
+                if (statement.type == IRByteCode::Subtraction) { assembler_.sub(RAX, RCX); }
+                if (statement.type == IRByteCode::Multiplication) { assembler_.imul(RAX, RCX); }
+                push(RAX);
+                return true;
+            }
+
+            // tasks run to completion right away, the handle is the result
+            case IRByteCode::Call:
+            case IRByteCode::Spawn:
+            {
+                auto const name   = std::get<std::string>(statement.first);
+                auto const target = functions_.find(name);
+                if (target == functions_.end()) { return fail("Function not found: " + name); }
+
+                assembler_.call(target->second);
+                depth_ -= numArguments(statement);
+                assembler_.lea(RSP, slot(RBP, -8 * frameSize()));
+                push(RAX);
+                return true;
+            }
+
+            case IRByteCode::Join:
+            {
+                if (std::holds_alternative<IRConstant>(statement.first))
+                {
+                    operand(RAX, statement.first);
+                    push(RAX);
+                }
+                return true;
+            }
+
+            case IRByteCode::TailCall: return tailCall(statement);
+            case IRByteCode::CallNative: return callNative(statement);
+
+            case IRByteCode::Return:
+            {
+                operand(RAX, statement.first);
+                leave();
+                return true;
+            }
+
+            default:
+            {
+                auto type = std::stringstream {};
+                type << statement.type;
+                return fail(fmt::format("Unsupported instruction in {}: {}", function_->name, type.str()));
+            }
+        }
+    }
+
+    auto tailCall(IRStatement const& statement) -> bool
+    {
+        auto const name   = std::get<std::string>(statement.first);
+        auto const target = functions_.find(name);
+        if (target == functions_.end()) { return fail("Function not found: " + name); }
+
+        auto const n = static_cast<int64_t>(function_->args.size());
+        auto const m = numArguments(statement);
+
+        // self recursion becomes a loop, the new args overwrite the current ones
+        if (name == function_->name)
+        {
+            TCC_ASSERT(m == n, "Recursive call with wrong number of args");
+            for (auto i = int64_t {0}; i < m; ++i)
+            {
+                assembler_.pop(RAX);
+                assembler_.mov(slot(RBP, 16 + 8 * i), RAX);
+            }
+            depth_ = 0;
+            assembler_.lea(RSP, slot(RBP, -8 * frameSize()));
+            assembler_.jmp(body_);
+            return true;
+        }
+
+        // the new args replace ours, aligned to the top so our callers
+        // temporaries stay intact. copied from the top down, as they may overlap
+        assembler_.mov(RCX, slot(RBP, 8));
+        assembler_.mov(RDX, slot(RBP, 0));
+        for (auto k = int64_t {0}; k < m; ++k)
+        {
+            assembler_.mov(RAX, slot(RSP, 8 * (m - 1 - k)));
+            assembler_.mov(slot(RBP, 16 + 8 * (n - 1 - k)), RAX);
+        }
+        assembler_.lea(RSP, slot(RBP, 8 + 8 * (n - m)));
+        assembler_.mov(slot(RSP, 0), RCX);
+        assembler_.mov(RBP, RDX);
+        assembler_.jmp(target->second);
+        depth_ -= m;
+        return true;
+    }
+
+    auto callNative(IRStatement const& statement) -> bool
+    {
+        auto const name      = std::get<std::string>(statement.first);
+        auto const n         = numArguments(statement);
+        auto const isRuntime = isRuntimeFunction(name);
+        if (isRuntime && n != 1) { return fail(fmt::format("Runtime function {} takes 1 argument", name)); }
+
+        // the args are passed as an array, first to last, on an aligned stack
+        assembler_.mov(RBX, RSP);
+        if (n > 0) { assembler_.subImm(RSP, static_cast<int32_t>(8 * n)); }
+        assembler_.andImm(RSP, -16);
+        for (auto k = int64_t {0}; k < n; ++k)
+        {
+            assembler_.mov(RAX, slot(RBX, 8 * (n - 1 - k)));
+            assembler_.mov(slot(RSP, 8 * k), RAX);
+        }
+        assembler_.mov(RDI, RSP);
+
+        if (isRuntime) { assembler_.call(name == "print" ? print_ : exit_); }
+        else
+        {
+            code_.relocations.push_back(NativeRelocation {assembler_.callExternal(), name});
+        }
+
+        assembler_.lea(RSP, slot(RBX, 8 * n));
+        depth_ -= n;
+        push(RAX);
+        return true;
+    }
+
+    /**
+     * @brief print, exit & the two entry points.
+     */
+    auto runtime(X86Label const main) -> void
+    {
+        // int64_t print(int64_t const* args), writes args[0] as a decimal line
+        auto begin = assembler_.code().size();
+        auto digit = assembler_.newLabel();
+        auto next  = assembler_.newLabel();
+        auto write = assembler_.newLabel();
+        assembler_.bind(print_);
+        assembler_.mov(RAX, slot(RDI, 0));
+        assembler_.mov(R8, RAX);
+        assembler_.subImm(RSP, 32);
+        assembler_.lea(RSI, slot(RSP, 31));
+        assembler_.movImm(RCX, '\n');
+        assembler_.mov8(slot(RSI, 0), RCX);
+        assembler_.movImm(R9, 10);
+        assembler_.bind(next);
+        assembler_.cqo();
+        assembler_.idiv(R9);
+        assembler_.mov(RCX, RDX);
+        assembler_.test(RCX, RCX);
+        assembler_.jcc(X86Condition::GreaterOrEqual, digit);
+        assembler_.neg(RCX);
+        assembler_.bind(digit);
+        assembler_.addImm(RCX, '0');
+        assembler_.dec(RSI);
+        assembler_.mov8(slot(RSI, 0), RCX);
+        assembler_.test(RAX, RAX);
+        assembler_.jcc(X86Condition::NotEqual, next);
+        assembler_.test(R8, R8);
+        assembler_.jcc(X86Condition::GreaterOrEqual, write);
+        assembler_.movImm(RCX, '-');
+        assembler_.dec(RSI);
+        assembler_.mov8(slot(RSI, 0), RCX);
+        assembler_.bind(write);
+        assembler_.lea(RDX, slot(RSP, 32));
+        assembler_.sub(RDX, RSI);
+        assembler_.movImm(RDI, 1);
+        assembler_.movImm(RAX, SysWrite);
+        assembler_.syscall();
+        assembler_.mov(RAX, R8);
+        assembler_.addImm(RSP, 32);
+        assembler_.ret();
+        code_.symbols.push_back(NativeSymbol {"print", begin, assembler_.code().size() - begin});
+
+        // int64_t exit(int64_t const* args), ends the process with args[0]
+        begin = assembler_.code().size();
+        assembler_.bind(exit_);
+        assembler_.mov(RDI, slot(RDI, 0));
+        assembler_.movImm(RAX, SysExitGroup);
+        assembler_.syscall();
+        code_.symbols.push_back(NativeSymbol {"exit", begin, assembler_.code().size() - begin});
+
+        // int64_t tcc_main(), rbx is the only callee saved register we use
+        code_.entry = assembler_.code().size();
+        assembler_.push(RBP);
+        assembler_.mov(RBP, RSP);
+        assembler_.push(RBX);
+        assembler_.call(main);
+        assembler_.lea(RSP, slot(RBP, -8));
+        assembler_.pop(RBX);
+        assembler_.pop(RBP);
+        assembler_.ret();
+        code_.symbols.push_back(NativeSymbol {"tcc_main", code_.entry, assembler_.code().size() - code_.entry});
+
+        // _start, the exit code is the result of main
+        code_.start = assembler_.code().size();
+        assembler_.call(main);
+        assembler_.mov(RDI, RAX);
+        assembler_.movImm(RAX, SysExitGroup);
+        assembler_.syscall();
+        code_.symbols.push_back(NativeSymbol {"_start", code_.start, assembler_.code().size() - code_.start});
+    }
+
+    /**
+     * @brief Moves a constant into reg or pops a temporary.
+     */
+    auto operand(X86Register const reg, IRStatement::Argument const& argument) -> void
+    {
+        if (auto const* value = std::get_if<IRConstant>(&argument); value != nullptr)
+        {
+            assembler_.movImm(reg, static_cast<int64_t>(*value));
+            return;
+        }
+        assembler_.pop(reg);
+        --depth_;
+    }
+
+    auto push(X86Register const reg) -> void
+    {
+        assembler_.push(reg);
+        ++depth_;
+    }
+
+    auto leave() -> void
+    {
+        assembler_.mov(RSP, RBP);
+        assembler_.pop(RBP);
+        assembler_.ret();
+    }
+
+    /**
+     * @brief Slot of a local or argument, by the name without its version.
+     */
+    [[nodiscard]] auto find(std::string const& versioned) const -> std::optional<X86Memory>
+    {
+        auto const name = versioned.substr(0, versioned.rfind('.'));
+
+        auto const& locals = function_->variables;
+        if (auto const local = locals.find(name); local != locals.end())
+        {
+            auto const index = std::distance(locals.begin(), local);
+            return slot(RBP, -8 * (index + 1));
+        }
+
+        auto const& args = function_->args;
+        if (auto const arg = args.find(name); arg != args.end())
+        {
+            auto const index = std::distance(args.begin(), arg);
+            return slot(RBP, 16 + 8 * (static_cast<int64_t>(args.size()) - 1 - index));
+        }
+
+        return std::nullopt;
+    }
+
+    // locals & temporaries below the frame pointer
+    [[nodiscard]] auto frameSize() const -> int64_t
+    {
+        return static_cast<int64_t>(function_->variables.size()) + depth_;
+    }
+
+    IRPackage const& package_;
+    NativeProgram& code_;
+    X86Assembler assembler_ {};
+    std::map<std::string, X86Label> functions_ {};
+    X86Label print_ {};
+    X86Label exit_ {};
+
+    IRFunction const* function_ {nullptr};
+    X86Label body_ {};
+    int64_t depth_ {0};  // temporaries on the stack
+};
+}  // namespace
+
+auto NativeGenerator::build(tcc::IRPackage const& package) -> NativeProgram
+{
+    auto code = NativeProgram {};
+    Lowering {package, code}.run();
+    if (!code.ok())
+    {
+        code.text.clear();
+        code.symbols.clear();
+        code.relocations.clear();
+    }
+    return code;
+}
+
+}  // namespace tcc
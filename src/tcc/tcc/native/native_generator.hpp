@@ -0,0 +1,61 @@
+#pragma once
+
+#include "tcc/ir/statement.hpp"
+#include "tcsl/tcsl.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tcc
+{
+/**
+ * @brief A function or runtime routine in NativeProgram::text.
+ */
+struct NativeSymbol
+{
+    std::string name;
+    std::size_t offset {0};
+    std::size_t size {0};
+};
+
+/**
+ * @brief Call of an extern function. The 32 bit displacement at offset has to
+ * be filled in by a linker, relative to the end of the call.
+ */
+struct NativeRelocation
+{
+    std::size_t offset {0};
+    std::string symbol;
+};
+
+/**
+ * @brief x86-64 machine code for a whole package. Only valid if error is empty.
+ */
+struct NativeProgram
+{
+    std::vector<std::uint8_t> text {};
+    std::vector<NativeSymbol> symbols {};          // functions & runtime routines
+    std::vector<NativeRelocation> relocations {};  // calls to extern functions
+    std::size_t entry {0};                         // int64_t tcc_main(), callable from C
+    std::size_t start {0};                         // _start, calls main & exits with its result
+    std::string error {};
+
+    [[nodiscard]] auto ok() const noexcept -> bool { return error.empty(); }
+};
+
+/**
+ * @brief Lowers an IRPackage to x86-64 machine code, without going through
+ * the VM. Covers the same instructions as the AssemblyGenerator, spawn runs
+ * the call right away & join returns its result.
+ *
+ * Extern functions are called like tcvm natives: int64_t f(int64_t const*
+ * args). print & exit are provided by a small runtime using Linux system
+ * calls, all others are left to the linker.
+ */
+class NativeGenerator
+{
+public:
+    static auto build(tcc::IRPackage const& package) -> NativeProgram;
+};
+}  // namespace tcc
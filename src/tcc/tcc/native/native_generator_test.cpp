@@ -0,0 +1,167 @@
+/**
+ * @file native_generator_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcc/native/native_generator.hpp"
+
+#include "tcc/compiler/compiler.hpp"
+#include "tcc/native/elf_writer.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__linux__)
+#include <sys/wait.h>
+#endif
+
+using namespace Catch::Matchers;
+
+namespace
+{
+auto compile(std::string const& source, tcc::OutputFormat format, std::ostream& out, std::string const& output = "")
+    -> tcc::Compiler
+{
+    auto options       = tcc::CompilerOptions {};
+    options.out        = &out;
+    options.source     = source;
+    options.outputName = output;
+    options.optLevel   = 1;
+    options.format     = format;
+    return tcc::Compiler {options};
+}
+
+auto hasSymbol(tcc::NativeProgram const& code, std::string const& name) -> bool
+{
+    return std::any_of(code.symbols.begin(), code.symbols.end(),
+                       [&](auto const& symbol) { return symbol.name == name; });
+}
+
+template<typename T>
+auto read(std::vector<std::uint8_t> const& image, std::size_t offset) -> T
+{
+    auto value = T {};
+    for (auto i = 0U; i < sizeof(T); ++i) { value |= static_cast<T>(T {image.at(offset + i)} << (8U * i)); }
+    return value;
+}
+}  // namespace
+
+TEST_CASE("tcc/native: NativeGenerator", "[native]")
+{
+    SECTION("functions, runtime & extern calls")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile(R"(
+            extern int min(a, b);
+            extern int print(x);
+            int main() { int x = 3; int y = 4; int z = print(x); return min(z, y); }
+        )",
+                                tcc::OutputFormat::Object, stream);
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        auto const& code = compiler.getNativeProgram();
+        REQUIRE(code.ok());
+        REQUIRE_FALSE(code.text.empty());
+        for (auto const* name : {"main", "print", "exit", "tcc_main", "_start"}) { CHECK(hasSymbol(code, name)); }
+
+        // print is part of the runtime
+        REQUIRE(code.relocations.size() == 1);
+        CHECK(code.relocations[0].symbol == "min");
+        CHECK(code.text.at(code.relocations[0].offset - 1) == 0xE8);
+    }
+
+    SECTION("unsupported instruction")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("int main() { int x = 2; return 8 / x; }", tcc::OutputFormat::Object, stream);
+        REQUIRE(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Error while generating native code: Unsupported instruction in main: div"));
+        CHECK(compiler.getNativeProgram().text.empty());
+    }
+
+    SECTION("runtime functions take one argument")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("extern int print(a, b); int main() { int x = 2; return print(x, x); }",
+                                tcc::OutputFormat::Object, stream);
+        REQUIRE(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Runtime function print takes 1 argument"));
+    }
+
+    SECTION("executables can't call extern functions")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("extern int hash(a); int main() { int x = 2; return hash(x); }",
+                                tcc::OutputFormat::Executable, stream);
+        REQUIRE(compiler.run() == EXIT_FAILURE);
+        CHECK_THAT(stream.str(), Contains("Unresolved extern function: hash"));
+    }
+
+    SECTION("bytecode only")
+    {
+        auto stream   = std::ostringstream {};
+        auto compiler = compile("int main() { return 1; }", tcc::OutputFormat::Bytecode, stream);
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+        CHECK(compiler.getNativeProgram().text.empty());
+    }
+}
+
+TEST_CASE("tcc/native: ElfWriter", "[native]")
+{
+    auto stream   = std::ostringstream {};
+    auto compiler = compile("extern int abs(x); int main() { int x = 7; return abs(x); }", tcc::OutputFormat::Object,
+                            stream);
+    REQUIRE(compiler.run() == EXIT_SUCCESS);
+    auto const& code = compiler.getNativeProgram();
+
+    auto const object = tcc::ElfWriter::object(code);
+    REQUIRE(object.size() > 64);
+    CHECK(object[0] == 0x7F);
+    CHECK(std::string(object.begin() + 1, object.begin() + 4) == "ELF");
+    CHECK(read<std::uint16_t>(object, 16) == 1);   // relocatable
+    CHECK(read<std::uint16_t>(object, 18) == 62);  // x86-64
+    CHECK(read<std::uint16_t>(object, 60) == 7);   // sections
+
+    // the code is copied as is, the call to abs is left to the linker
+    auto const text = read<std::uint64_t>(object, read<std::uint64_t>(object, 40) + 64 + 24);
+    CHECK(std::equal(code.text.begin(), code.text.end(), object.begin() + static_cast<std::ptrdiff_t>(text)));
+
+    auto withoutExterns = code;
+    withoutExterns.relocations.clear();
+    auto const executable = tcc::ElfWriter::executable(withoutExterns);
+    CHECK(read<std::uint16_t>(executable, 16) == 2);  // executable
+    CHECK(read<std::uint64_t>(executable, 24) == 0x400000 + 64 + 2 * 56 + code.start);
+    CHECK(executable.size() == 64 + 2 * 56 + code.text.size());
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+TEST_CASE("tcc/native: RunExecutable", "[native]")
+{
+    auto const directory = std::filesystem::temp_directory_path();
+    auto const binary    = (directory / "tcc_native_test").string();
+    auto const output    = (directory / "tcc_native_test.txt").string();
+
+    auto stream   = std::ostringstream {};
+    auto compiler = compile(R"(
+        extern int print(x);
+        int twice(a) { return a * 2; }
+        int main() { int x = 21; int y = print(twice(x)); return y - 40; }
+    )",
+                            tcc::OutputFormat::Executable, stream, binary);
+    REQUIRE(compiler.run() == EXIT_SUCCESS);
+    REQUIRE(stream.str().empty());
+
+    auto const status = std::system((binary + " > " + output).c_str());
+    REQUIRE(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 2);
+
+    auto file  = std::ifstream {output};
+    auto lines = std::string {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+    CHECK(lines == "42\n");
+
+    std::filesystem::remove(binary);
+    std::filesystem::remove(output);
+}
+#endif
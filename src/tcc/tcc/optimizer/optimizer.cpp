@@ -19,7 +19,11 @@ auto Optimizer::optimize() -> void
                           [&](auto& statement) { replaceVariableIfConstant(statement, block.statements); });
         }
     }
-    for (auto& block : function_.blocks) { deleteUnusedStatements(block.statements); }
+    for (auto& block : function_.blocks)
+    {
+        replaceTailCalls(block.statements);
+        deleteUnusedStatements(block.statements);
+    }
 }
 
 auto Optimizer::deleteUnusedStatements(IRStatementList& statementList) -> bool
@@ -179,4 +183,26 @@ auto Optimizer::isBinaryOperation(IRByteCode op) noexcept -> bool
     if (op == IRByteCode::Division) { return true; }
     return false;
 }
+
+// replace call followed by a return of its result with a tail call.
+auto Optimizer::replaceTailCalls(IRStatementList& statementList) -> bool
+{
+    auto replaced = false;
+    for (auto iter = std::begin(statementList); iter != std::end(statementList); ++iter)
+    {
+        auto const next = std::next(iter);
+        if (iter->type != IRByteCode::Call || next == std::end(statementList)) { continue; }
+        if (next->type != IRByteCode::Return) { continue; }
+
+        auto const* result = std::get_if<std::string>(&next->first);
+        if (result == nullptr || *result != iter->destination) { continue; }
+
+        // the callee returns straight to our caller
+        iter->type = IRByteCode::TailCall;
+        statementList.erase(next);
+        replaced = true;
+    }
+
+    return replaced;
+}
 }  // namespace tcc
\ No newline at end of file
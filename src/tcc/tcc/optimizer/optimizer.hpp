@@ -27,6 +27,9 @@ public:
     static auto isConstantBinaryExpression(IRStatement const& statement) -> bool;
     static auto isBinaryOperation(IRByteCode op) noexcept -> bool;
 
+    // replace call followed by a return of its result with a tail call.
+    static auto replaceTailCalls(IRStatementList& statementList) -> bool;
+
 private:
     IRFunction& function_;
 };
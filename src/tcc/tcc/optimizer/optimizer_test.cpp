@@ -207,4 +207,57 @@ TEST_CASE("tcc/optimizer: ReplaceVariableIfConstant", "[tcc][optimizer]")
     REQUIRE(std::get<std::uint32_t>(testData[1].first) == 143);
     REQUIRE(std::get<std::uint32_t>(testData[2].first) == 143);
     REQUIRE(std::get<std::uint32_t>(testData[3].second.value()) == 143);
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcc/optimizer: ReplaceTailCalls", "[tcc][optimizer]")
+{
+    auto args = tcc::IRArgumentList {};
+    args.pushBack("t.0"s);
+
+    auto testData = tcc::IRStatementList {
+        IRStatement {
+            .type        = IRByteCode::Call,
+            .isTemporary = false,
+            .destination = "t.1"s,
+            .first       = "foo"s,
+            .second      = args,
+        },
+        IRStatement {
+            .type        = IRByteCode::Store,
+            .destination = "x.0"s,
+            .first       = "t.1"s,
+            .second      = std::nullopt,
+        },
+        IRStatement {
+            .type        = IRByteCode::Call,
+            .isTemporary = false,
+            .destination = "t.2"s,
+            .first       = "foo"s,
+            .second      = args,
+        },
+        IRStatement {
+            .type        = IRByteCode::Return,
+            .isTemporary = false,
+            .destination = ""s,
+            .first       = "t.2"s,
+            .second      = std::nullopt,
+        },
+    };
+
+    REQUIRE(Optimizer::replaceTailCalls(testData) == true);
+    REQUIRE(testData.size() == std::size_t {3});
+    REQUIRE(testData[0].type == IRByteCode::Call);
+    REQUIRE(testData[2].type == IRByteCode::TailCall);
+
+    // a call whose result is not returned stays
+    testData.back().type = IRByteCode::Call;
+    testData.push_back(IRStatement {
+        .type        = IRByteCode::Return,
+        .isTemporary = false,
+        .destination = ""s,
+        .first       = "x.0"s,
+        .second      = std::nullopt,
+    });
+    REQUIRE(Optimizer::replaceTailCalls(testData) == false);
+    REQUIRE(testData.size() == std::size_t {4});
+}
@@ -198,6 +198,7 @@ struct Function
     Identifier funcName;
     std::vector<Identifier> args;
     StatementList body;
+    bool external {false};  // extern declaration of a host function, has no body
 };
 
 /**
@@ -295,6 +296,7 @@ BOOST_FUSION_ADAPT_STRUCT(                     //
     (tcc::ast::Identifier, funcName)           //
     (std::vector<tcc::ast::Identifier>, args)  //
     (tcc::ast::StatementList, body)            //
+    (bool, external)                           //
 )
 
 #endif
@@ -82,6 +82,7 @@ Expression<Iterator>::Expression(ErrorHandler<Iterator>& errorHandler) : Express
         ("int")
         ("void")
         ("return")
+        ("extern")
         ;
 
     // Main expression grammar
@@ -18,6 +18,9 @@ struct Function : qi::grammar<Iterator, ast::Function(), Skipper<Iterator>>
     qi::rule<Iterator, std::string(), Skipper<Iterator>> name;
     qi::rule<Iterator, ast::Identifier(), Skipper<Iterator>> identifier;
     qi::rule<Iterator, std::vector<ast::Identifier>(), Skipper<Iterator>> argumentList;
+    qi::rule<Iterator, std::string(), Skipper<Iterator>> returnType;
+    qi::rule<Iterator, ast::Function(), Skipper<Iterator>> definition;
+    qi::rule<Iterator, ast::Function(), Skipper<Iterator>> declaration;
     qi::rule<Iterator, ast::Function(), Skipper<Iterator>> start;
 };
 }  // namespace parser
@@ -23,6 +23,8 @@ Function<Iterator>::Function(ErrorHandler<Iterator>& errorHandler) : Function::b
     qi::alpha_type alpha;
     qi::alnum_type alnum;
     qi::string_type string;
+    qi::lit_type lit;
+    qi::attr_type attr;
 
     using boost::phoenix::function;
     using qi::fail;
@@ -37,11 +39,18 @@ Function<Iterator>::Function(ErrorHandler<Iterator>& errorHandler) : Function::b
     identifier   = name;
     argumentList = -(identifier % ',');
 
-    start = lexeme[(string("void") | string("int")) >> !(alnum | '_')]  // make sure we have whole words
-            > identifier > '(' > argumentList > ')' > '{' > body > '}';
+    returnType = lexeme[(string("void") | string("int")) >> !(alnum | '_')];  // make sure we have whole words
+
+    definition = returnType > identifier > '(' > argumentList > ')' > '{' > body > '}' > attr(false);
+
+    // extern int name(args); calls the host function registered as name
+    declaration = lexeme[lit("extern") >> !(alnum | '_')] > returnType > identifier > '(' > argumentList > ')'
+                  > attr(ast::StatementList {}) > ';' > attr(true);
+
+    start = declaration | definition;
 
     // Debugging and error handling and reporting support.
-    BOOST_SPIRIT_DEBUG_NODES((identifier)(argumentList)(start));
+    BOOST_SPIRIT_DEBUG_NODES((identifier)(argumentList)(returnType)(definition)(declaration)(start));
 
     // Error handling: on error in start, call error handler.
     on_error<fail>(start, ErrorHandlerFunction(errorHandler)("Error! Expecting ", _4, _3));
@@ -16,7 +16,8 @@ using namespace tcc::parser::testing;
 
 TEST_CASE("tcc/parser: FunctionValid", "[tcc][parser][qi]")
 {
-    auto testCase = GENERATE(as<std::string> {}, "void foo(){ int foo = 5; }", "int foo(){return 1;}");
+    auto testCase = GENERATE(as<std::string> {}, "void foo(){ int foo = 5; }", "int foo(){return 1;}",
+                             "extern int hash(x);");
 
     using IteratorType = std::string::const_iterator;
     IteratorType iter  = testCase.begin();
@@ -35,7 +36,8 @@ TEST_CASE("tcc/parser: FunctionValid", "[tcc][parser][qi]")
 
 TEST_CASE("tcc/parser: FunctionInvalid", "[tcc][parser][qi]")
 {
-    auto testCase = GENERATE(as<std::string> {}, "int int(){}", "void void(){}");
+    auto testCase = GENERATE(as<std::string> {}, "int int(){}", "void void(){}", "extern int f(x) {}",
+                             "extern f(x);");
 
     using IteratorType = std::string::const_iterator;
     IteratorType iter  = testCase.begin();
@@ -50,4 +52,29 @@ TEST_CASE("tcc/parser: FunctionInvalid", "[tcc][parser][qi]")
     auto ast      = tcc::ast::FunctionList {};
 
     REQUIRE(phrase_parse(iter, end, function, skipper, ast) == false);
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcc/parser: FunctionExtern", "[tcc][parser][qi]")
+{
+    auto const testCase = std::string {"extern int min(a, b); int main() { return min(1, 2); }"};
+
+    using IteratorType = std::string::const_iterator;
+    IteratorType iter  = testCase.begin();
+    IteratorType end   = testCase.end();
+
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    auto errorHandler = tcc::ErrorHandler<IteratorType>(iter, end, nullStream);
+
+    auto function = tcc::parser::Function<IteratorType>(errorHandler);
+    auto skipper  = tcc::parser::Skipper<IteratorType> {};
+    auto ast      = tcc::ast::FunctionList {};
+
+    REQUIRE(phrase_parse(iter, end, +function, skipper, ast) == true);
+    REQUIRE(ast.size() == 2);
+    REQUIRE(ast[0].external);
+    REQUIRE(ast[0].funcName.name == "min");
+    REQUIRE(ast[0].args.size() == 2);
+    REQUIRE(ast[0].body.empty());
+    REQUIRE_FALSE(ast[1].external);
+}
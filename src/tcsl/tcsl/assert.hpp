@@ -1,6 +1,11 @@
 #pragma once
 
+// Enabled by default in debug builds, define TCC_ENABLE_ASSERTIONS to keep them
+// in release builds.
+#if !defined(TCC_ENABLE_ASSERTIONS) && !defined(NDEBUG)
 #define TCC_ENABLE_ASSERTIONS 1
+#endif
+
 #ifdef TCC_ENABLE_ASSERTIONS
 #define TCC_ASSERT(x, ...)                                                                                             \
     {                                                                                                                  \
@@ -8,4 +13,4 @@
     }
 #else
 #define TCC_ASSERT(x, ...)
-#endif
\ No newline at end of file
+#endif
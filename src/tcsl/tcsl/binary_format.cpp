@@ -9,6 +9,12 @@
 
 namespace tcc
 {
+auto symbolAt(SymbolTable const& symbols, int64_t const address) -> std::string_view
+{
+    auto const next = symbols.upper_bound(address);
+    if (next == symbols.begin()) { return {}; }
+    return std::prev(next)->second;
+}
 
 auto BinaryFormat::writeToFile(std::string const& path, BinaryProgram const& program) -> bool
 {
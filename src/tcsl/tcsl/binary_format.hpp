@@ -9,28 +9,49 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tcc
 {
+/**
+ * @brief Start address -> name of every function in a program.
+ */
+using SymbolTable = std::map<int64_t, std::string>;
+
+/**
+ * @brief Name of the function that contains address, empty if the address is
+ * before the first symbol.
+ */
+auto symbolAt(SymbolTable const& symbols, int64_t address) -> std::string_view;
+
 struct BinaryProgram
 {
     int64_t version {0};
     std::string name;
     int64_t entryPoint = {0};
     std::vector<int64_t> data;
+    SymbolTable symbols {};               // written by the compiler, empty for hand written programs
+    std::vector<std::string> natives {};  // host functions called by CALLNATIVE, by index
 
     template<class Archive>
-    void serialize(Archive& ar, const unsigned int /* file_version */)
+    void serialize(Archive& ar, const unsigned int fileVersion)
     {
         ar& version;
         ar& name;
         ar& entryPoint;
         ar& data;
+        if (fileVersion > 0) { ar& symbols; }
+        if (fileVersion > 1) { ar& natives; }
     }
 };
 
@@ -58,3 +79,6 @@ struct BinaryFormat
 };
 
 }  // namespace tcc
+
+// version 1 added the symbol table, version 2 the natives
+BOOST_CLASS_VERSION(tcc::BinaryProgram, 2)
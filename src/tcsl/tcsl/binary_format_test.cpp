@@ -46,4 +46,33 @@ TEST_CASE("tcsl: BinaryFormatWriteReadFile", "[tcsl]")
         REQUIRE(program.entryPoint == 0);
         REQUIRE(program.data == std::vector<int64_t> {1, 2, 3});
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcsl: BinaryFormatSymbols", "[tcsl]")
+{
+    auto stream    = std::stringstream {};
+    auto output    = tcc::BinaryProgram {1, "test", 9, {}};
+    output.symbols = tcc::SymbolTable {{2, "square"}, {9, "main"}};
+    tcc::BinaryFormat::writeToStream(stream, output);
+
+    auto input = tcc::BinaryProgram {};
+    tcc::BinaryFormat::readFromStream(stream, input);
+    REQUIRE(input.symbols == output.symbols);
+
+    REQUIRE(tcc::symbolAt(input.symbols, 0).empty());
+    REQUIRE(tcc::symbolAt(input.symbols, 2) == "square");
+    REQUIRE(tcc::symbolAt(input.symbols, 8) == "square");
+    REQUIRE(tcc::symbolAt(input.symbols, 42) == "main");
+}
+
+TEST_CASE("tcsl: BinaryFormatNatives", "[tcsl]")
+{
+    auto stream    = std::stringstream {};
+    auto output    = tcc::BinaryProgram {1, "test", 0, {}};
+    output.natives = std::vector<std::string> {"hash", "min"};
+    tcc::BinaryFormat::writeToStream(stream, output);
+
+    auto input = tcc::BinaryProgram {};
+    tcc::BinaryFormat::readFromStream(stream, input);
+    REQUIRE(input.natives == output.natives);
+}
@@ -7,35 +7,20 @@
 
 #include "fmt/format.h"
 
+#include <cctype>
+
 namespace tcc
 {
 
 auto operator<<(std::ostream& out, ByteCode::Type byteCode) -> std::ostream&
 {
-    switch (byteCode)
+    if (byteCode >= 0 && byteCode < ByteCode::NUM_OPCODES)
     {
-        case ByteCode::NOOP: return out << "NOOP";
-        case ByteCode::IADD: return out << "IADD";
-        case ByteCode::ISUB: return out << "ISUB";
-        case ByteCode::IMUL: return out << "IMUL";
-        case ByteCode::ILT: return out << "ILT";
-        case ByteCode::IEQ: return out << "IEQ";
-        case ByteCode::BR: return out << "BR";
-        case ByteCode::BRT: return out << "BRT";
-        case ByteCode::BRF: return out << "BRF";
-        case ByteCode::ICONST: return out << "ICONST";
-        case ByteCode::LOAD: return out << "LOAD";
-        case ByteCode::GLOAD: return out << "GLOAD";
-        case ByteCode::STORE: return out << "STORE";
-        case ByteCode::GSTORE: return out << "GSTORE";
-        case ByteCode::PRINT: return out << "PRINT";
-        case ByteCode::POP: return out << "POP";
-        case ByteCode::CALL: return out << "CALL";
-        case ByteCode::RET: return out << "RET";
-        case ByteCode::EXIT: return out << "EXIT";
-        case ByteCode::HALT: return out << "HALT";
-        case ByteCode::NUM_OPCODES: return out << fmt::format("{}", static_cast<int64_t>(byteCode));
+        auto const name = Instructions[static_cast<std::size_t>(byteCode)].name;
+        for (auto const c : name) { out << static_cast<char>(std::toupper(c)); }
+        return out;
     }
-    return out;
+
+    return out << fmt::format("{}", static_cast<int64_t>(byteCode));
 }
-}  // namespace tcc
\ No newline at end of file
+}  // namespace tcc
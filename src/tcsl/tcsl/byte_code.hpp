@@ -36,41 +36,181 @@ struct ByteCode
         RET,
         EXIT,
         HALT,
+
+        // tasks, a VirtualMachine runs SPAWN as CALL & JOIN as no-op, see Scheduler
+        SPAWN,
+        JOIN,
+
+        // CALL that replaces the frame of the caller, the callee returns to the caller's caller
+        TAILCALL,
+
+        // calls host function idx of the program's natives with nargs arguments on the stack, see NativeRegistry
+        CALLNATIVE,
+
+        // superinstructions, see Instruction::fuses
+        LOAD_ICONST_IADD,
+        LOAD_ICONST_ISUB,
+        LOAD_ICONST_ILT,
+        LOAD_LOAD_IADD,
+        ILT_BRF,
         NUM_OPCODES,
     };
 };
 
 auto operator<<(std::ostream& out, ByteCode::Type byteCode) -> std::ostream&;
 
+/**
+ * @brief Name & operand count of an opcode. Superinstructions additionally list
+ * the sequence they replace, their operands are the operands of that sequence
+ * in order.
+ */
 struct Instruction
 {
+    static constexpr auto MaxFusedLength = std::size_t {3};
+
     constexpr explicit Instruction(std::string_view n) : name(n), numberOfOperands(0) { }
     constexpr explicit Instruction(std::string_view n, int8_t numOperands) : name(n), numberOfOperands(numOperands) { }
+    constexpr explicit Instruction(std::string_view n, int8_t numOperands,
+                                   std::array<ByteCode::Type, MaxFusedLength> sequence)
+        : name(n), numberOfOperands(numOperands), fuses(sequence)
+    {
+    }
+
+    [[nodiscard]] constexpr auto isFused() const noexcept -> bool { return fuses[0] != ByteCode::NOOP; }
+    [[nodiscard]] constexpr auto fusedLength() const noexcept -> std::size_t
+    {
+        auto length = std::size_t {0};
+        while (length < MaxFusedLength && fuses[length] != ByteCode::NOOP) { ++length; }
+        return length;
+    }
+
     std::string_view name = {};
     int8_t numberOfOperands;
+    std::array<ByteCode::Type, MaxFusedLength> fuses = {};  // NOOP terminated
 };
 
 constexpr auto Instructions = std::array {
-    Instruction {"noop"},       //
-    Instruction {"iadd"},       //
-    Instruction {"isub"},       //
-    Instruction {"imul"},       //
-    Instruction {"ilt"},        //
-    Instruction {"ieq"},        //
-    Instruction {"br", 1},      //
-    Instruction {"brt", 1},     //
-    Instruction {"brf", 1},     //
-    Instruction {"iconst", 1},  //
-    Instruction {"load", 1},    //
-    Instruction {"gload", 1},   //
-    Instruction {"store", 1},   //
-    Instruction {"gstore", 1},  //
-    Instruction {"print"},      //
-    Instruction {"pop"},        //
-    Instruction {"call", 2},    //
-    Instruction {"ret"},        //
-    Instruction {"exit"},       //
-    Instruction {"halt"},       //
+    Instruction {"noop"},           //
+    Instruction {"iadd"},           //
+    Instruction {"isub"},           //
+    Instruction {"imul"},           //
+    Instruction {"ilt"},            //
+    Instruction {"ieq"},            //
+    Instruction {"br", 1},          //
+    Instruction {"brt", 1},         //
+    Instruction {"brf", 1},         //
+    Instruction {"iconst", 1},      //
+    Instruction {"load", 1},        //
+    Instruction {"gload", 1},       //
+    Instruction {"store", 1},       //
+    Instruction {"gstore", 1},      //
+    Instruction {"print"},          //
+    Instruction {"pop"},            //
+    Instruction {"call", 2},        //
+    Instruction {"ret"},            //
+    Instruction {"exit"},           //
+    Instruction {"halt"},           //
+    Instruction {"spawn", 2},       //
+    Instruction {"join"},           //
+    Instruction {"tailcall", 2},    //
+    Instruction {"callnative", 2},  //
+
+    Instruction {"load_iconst_iadd", 2, {ByteCode::LOAD, ByteCode::ICONST, ByteCode::IADD}},  //
+    Instruction {"load_iconst_isub", 2, {ByteCode::LOAD, ByteCode::ICONST, ByteCode::ISUB}},  //
+    Instruction {"load_iconst_ilt", 2, {ByteCode::LOAD, ByteCode::ICONST, ByteCode::ILT}},    //
+    Instruction {"load_load_iadd", 2, {ByteCode::LOAD, ByteCode::LOAD, ByteCode::IADD}},      //
+    Instruction {"ilt_brf", 1, {ByteCode::ILT, ByteCode::BRF}},                               //
 };
 
+static_assert(Instructions.size() == ByteCode::NUM_OPCODES);
+
+/**
+ * @brief Returns true if the opcode transfers control or stops the program.
+ */
+constexpr auto isControlFlow(int64_t const opcode) noexcept -> bool
+{
+    switch (opcode)
+    {
+        case ByteCode::BR:
+        case ByteCode::BRT:
+        case ByteCode::BRF:
+        case ByteCode::CALL:
+        case ByteCode::SPAWN:
+        case ByteCode::TAILCALL:
+        case ByteCode::RET:
+        case ByteCode::EXIT:
+        case ByteCode::HALT: return true;
+        default: return false;
+    }
+}
+
+/**
+ * @brief Returns the index of the operand holding a branch or call target, or
+ * -1 if the instruction has none. Works for superinstructions as well.
+ */
+constexpr auto targetOperandIndex(int64_t const opcode) noexcept -> int
+{
+    if (opcode <= ByteCode::NOOP || opcode >= ByteCode::NUM_OPCODES) { return -1; }
+
+    auto const& instruction = Instructions[static_cast<std::size_t>(opcode)];
+    auto const length       = instruction.isFused() ? instruction.fusedLength() : 1;
+    auto operand            = 0;
+    for (auto i = std::size_t {0}; i < length; ++i)
+    {
+        auto const op = instruction.isFused() ? int64_t {instruction.fuses[i]} : opcode;
+        switch (op)
+        {
+            case ByteCode::BR:
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            case ByteCode::TAILCALL: return operand;
+            default: operand += Instructions[static_cast<std::size_t>(op)].numberOfOperands; break;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns true if the instruction ends a basic block, i.e. the opcode
+ * or the last instruction of its sequence is control flow.
+ */
+constexpr auto endsBasicBlock(int64_t const opcode) noexcept -> bool
+{
+    if (opcode <= ByteCode::NOOP || opcode >= ByteCode::NUM_OPCODES) { return false; }
+
+    auto const& instruction = Instructions[static_cast<std::size_t>(opcode)];
+    if (!instruction.isFused()) { return isControlFlow(opcode); }
+    return isControlFlow(instruction.fuses[instruction.fusedLength() - 1]);
+}
+
+/**
+ * @brief A superinstruction takes the operands of its sequence, may only end in
+ * control flow and has to fit the two operand slots of the decoded formats.
+ */
+constexpr auto isValidFusion(Instruction const& instruction) noexcept -> bool
+{
+    if (!instruction.isFused()) { return true; }
+
+    auto const length = instruction.fusedLength();
+    auto operands     = 0;
+    for (auto i = std::size_t {0}; i < length; ++i)
+    {
+        auto const op = instruction.fuses[i];
+        if (op >= ByteCode::HALT) { return false; }
+        if (isControlFlow(op) && i + 1 != length) { return false; }
+        operands += Instructions[static_cast<std::size_t>(op)].numberOfOperands;
+    }
+    return length >= 2 && operands == instruction.numberOfOperands && operands <= 2;
+}
+
+static_assert([] {
+    for (auto const& instruction : Instructions)
+    {
+        if (!isValidFusion(instruction)) { return false; }
+    }
+    return true;
+}());
+
 }  // namespace tcc
\ No newline at end of file
@@ -39,4 +39,26 @@ TEST_CASE("tcsl: ByteCode ostream", "[tcsl]")
     REQUIRE(str
             == "ICONSTIADDISUBIMULILTIEQPRINTSTORELOADGSTOREGLOADBRBRTBR"
                "FPOPCALLRETEXITHALT");
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcsl: ByteCode superinstructions", "[tcsl]")
+{
+    using tcc::ByteCode;
+    using tcc::Instructions;
+
+    auto stream = std::stringstream {};
+    stream << ByteCode::LOAD_ICONST_ISUB << ByteCode::ILT_BRF;
+    REQUIRE(stream.str() == "LOAD_ICONST_ISUBILT_BRF");
+
+    auto const& fused = Instructions[ByteCode::LOAD_ICONST_ISUB];
+    REQUIRE(fused.isFused());
+    REQUIRE(fused.fusedLength() == 3);
+    REQUIRE(fused.numberOfOperands == 2);
+    REQUIRE_FALSE(Instructions[ByteCode::LOAD].isFused());
+
+    REQUIRE(tcc::targetOperandIndex(ByteCode::BR) == 0);
+    REQUIRE(tcc::targetOperandIndex(ByteCode::CALL) == 0);
+    REQUIRE(tcc::targetOperandIndex(ByteCode::ILT_BRF) == 0);
+    REQUIRE(tcc::targetOperandIndex(ByteCode::LOAD_LOAD_IADD) == -1);
+    REQUIRE(tcc::targetOperandIndex(ByteCode::NUM_OPCODES) == -1);
+}
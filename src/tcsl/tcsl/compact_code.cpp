@@ -0,0 +1,194 @@
+/**
+ * @file compact_code.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcsl/compact_code.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace tcc
+{
+namespace
+{
+auto widthOf(int64_t const value) noexcept -> CompactCode::Width
+{
+    auto const fits = [value](auto limits) { return value >= limits.min() && value <= limits.max(); };
+    if (fits(std::numeric_limits<int8_t> {})) { return CompactCode::Int8; }
+    if (fits(std::numeric_limits<int16_t> {})) { return CompactCode::Int16; }
+    if (fits(std::numeric_limits<int32_t> {})) { return CompactCode::Int32; }
+    return CompactCode::Int64;
+}
+
+auto append(std::vector<uint8_t>& out, uint64_t const value, std::size_t const size) -> void
+{
+    for (auto i = std::size_t {0}; i < size; ++i) { out.push_back(static_cast<uint8_t>(value >> (8 * i))); }
+}
+
+auto numberOfOperands(int64_t const opcode) -> int
+{
+    return Instructions[static_cast<std::size_t>(opcode)].numberOfOperands;
+}
+}  // namespace
+
+auto CompactProgram::fromImage(std::vector<uint8_t> image) -> std::optional<CompactProgram>
+{
+    if (image.size() < HeaderSize || !std::equal(Magic.begin(), Magic.end(), image.begin())) { return std::nullopt; }
+
+    auto program           = CompactProgram {std::move(image)};
+    auto const tableSize   = uint64_t {program.numTargets()} * sizeof(uint32_t);
+    auto const expectedEnd = HeaderSize + tableSize + program.codeSize();
+    if (program.image_.size() != expectedEnd || program.entry() >= program.codeSize()) { return std::nullopt; }
+
+    for (auto i = std::size_t {0}; i < program.numTargets(); ++i)
+    {
+        if (program.target(i) > program.codeSize()) { return std::nullopt; }
+    }
+    return program;
+}
+
+auto CompactLayout::offsetAt(int64_t const address) const -> std::optional<uint32_t>
+{
+    auto const it = std::lower_bound(addresses.begin(), addresses.end(), address);
+    if (it == addresses.end() || *it != address) { return std::nullopt; }
+    return offsets[static_cast<std::size_t>(std::distance(addresses.begin(), it))];
+}
+
+auto CompactLayout::addressAt(int64_t const offset) const -> std::optional<int64_t>
+{
+    auto const it = std::lower_bound(offsets.begin(), offsets.end(), offset,
+                                     [](uint32_t lhs, int64_t rhs) { return int64_t {lhs} < rhs; });
+    if (it == offsets.end() || int64_t {*it} != offset) { return std::nullopt; }
+    return addresses[static_cast<std::size_t>(std::distance(offsets.begin(), it))];
+}
+
+auto layoutOf(CompactProgram const& program) -> std::optional<CompactLayout>
+{
+    if (program.image().empty()) { return std::nullopt; }
+
+    auto layout      = CompactLayout {};
+    auto const* code = program.code();
+    auto const size  = std::size_t {program.codeSize()};
+
+    auto address = int64_t {0};
+    auto offset  = std::size_t {0};
+    while (offset < size)
+    {
+        auto const opcode = code[offset] & CompactCode::OpcodeMask;
+        if (opcode >= ByteCode::NUM_OPCODES) { return std::nullopt; }
+
+        layout.addresses.push_back(address);
+        layout.offsets.push_back(static_cast<uint32_t>(offset));
+        address += 1 + numberOfOperands(opcode);
+        offset += CompactCode::instructionSize(code[offset], numberOfOperands(opcode));
+    }
+    if (offset != size) { return std::nullopt; }
+
+    layout.addresses.push_back(address);
+    layout.offsets.push_back(static_cast<uint32_t>(offset));
+    return layout;
+}
+
+auto toCompactCode(std::vector<int64_t> const& code, int64_t const entryPoint) -> std::optional<CompactProgram>
+{
+    auto const size = static_cast<int64_t>(code.size());
+
+    // instruction boundaries & jump targets, the table is sorted by address
+    auto starts  = std::vector<bool>(code.size() + 1, false);
+    auto targets = std::map<int64_t, uint32_t> {};
+    for (auto address = int64_t {0}; address < size;)
+    {
+        auto const opcode = code[static_cast<std::size_t>(address)];
+        if (opcode < 0 || opcode >= ByteCode::NUM_OPCODES) { return std::nullopt; }
+        if (address + numberOfOperands(opcode) >= size) { return std::nullopt; }
+
+        starts[static_cast<std::size_t>(address)] = true;
+        if (auto const index = targetOperandIndex(opcode); index >= 0)
+        { targets.emplace(code[static_cast<std::size_t>(address + 1 + index)], 0); }
+        address += 1 + numberOfOperands(opcode);
+    }
+    starts.back() = true;
+
+    if (entryPoint < 0 || entryPoint >= size || !starts[static_cast<std::size_t>(entryPoint)]) { return std::nullopt; }
+    auto next = uint32_t {0};
+    for (auto& [address, index] : targets)
+    {
+        if (address < 0 || address > size || !starts[static_cast<std::size_t>(address)]) { return std::nullopt; }
+        index = next++;
+    }
+
+    auto bytes   = std::vector<uint8_t> {};
+    auto offsets = std::vector<uint32_t>(code.size() + 1, 0);
+    bytes.reserve(code.size() * 2);
+    for (auto address = std::size_t {0}; address < code.size();)
+    {
+        auto const opcode      = code[address];
+        auto const numOperands = numberOfOperands(opcode);
+        auto const target      = targetOperandIndex(opcode);
+
+        auto operands = std::array<int64_t, 2> {};
+        auto width    = CompactCode::Int8;
+        for (auto i = 0; i < numOperands; ++i)
+        {
+            auto const value = code[address + 1 + static_cast<std::size_t>(i)];
+            operands[static_cast<std::size_t>(i)] = i == target ? int64_t {targets.at(value)} : value;
+            width = std::max(width, widthOf(operands[static_cast<std::size_t>(i)]));
+        }
+
+        offsets[address] = static_cast<uint32_t>(bytes.size());
+        bytes.push_back(static_cast<uint8_t>(opcode | width));
+        auto const operandSize = std::size_t {1} << CompactCode::widthLog2(width);
+        for (auto i = 0; i < numOperands; ++i)
+        { append(bytes, static_cast<uint64_t>(operands[static_cast<std::size_t>(i)]), operandSize); }
+
+        if (bytes.size() > std::numeric_limits<uint32_t>::max()) { return std::nullopt; }
+        address += 1 + static_cast<std::size_t>(numOperands);
+    }
+    offsets.back() = static_cast<uint32_t>(bytes.size());
+
+    auto image = std::vector<uint8_t>(CompactProgram::Magic.begin(), CompactProgram::Magic.end());
+    append(image, targets.size(), sizeof(uint32_t));
+    append(image, bytes.size(), sizeof(uint32_t));
+    append(image, offsets[static_cast<std::size_t>(entryPoint)], sizeof(uint32_t));
+    for (auto const& [address, index] : targets)
+    { append(image, offsets[static_cast<std::size_t>(address)], sizeof(uint32_t)); }
+    image.insert(image.end(), bytes.begin(), bytes.end());
+    return CompactProgram {std::move(image)};
+}
+
+auto fromCompactCode(CompactProgram const& program) -> std::optional<BinaryProgram>
+{
+    auto const layout = layoutOf(program);
+    if (!layout.has_value()) { return std::nullopt; }
+
+    auto result = BinaryProgram {};
+    result.data.reserve(static_cast<std::size_t>(layout->addresses.back()));
+    auto const entryPoint = layout->addressAt(program.entry());
+    if (!entryPoint.has_value()) { return std::nullopt; }
+    result.entryPoint = entryPoint.value();
+
+    for (auto i = std::size_t {0}; i + 1 < layout->offsets.size(); ++i)
+    {
+        auto const* pc    = program.code() + layout->offsets[i];
+        auto const opcode = int64_t {*pc & CompactCode::OpcodeMask};
+        auto const target = targetOperandIndex(opcode);
+
+        result.data.push_back(opcode);
+        for (auto operand = 0; operand < numberOfOperands(opcode); ++operand)
+        {
+            auto value = CompactCode::operand(pc, operand);
+            if (operand == target)
+            {
+                if (value < 0 || value >= program.numTargets()) { return std::nullopt; }
+                auto const address = layout->addressAt(program.target(static_cast<std::size_t>(value)));
+                if (!address.has_value()) { return std::nullopt; }
+                value = address.value();
+            }
+            result.data.push_back(value);
+        }
+    }
+    return result;
+}
+}  // namespace tcc
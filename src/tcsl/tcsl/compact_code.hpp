@@ -0,0 +1,190 @@
+/**
+ * @file compact_code.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tcsl/binary_format.hpp"
+#include "tcsl/byte_code.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Byte encoding of ByteCode. Every instruction is a 1 byte opcode
+ * followed by its operands, all of the same width. The two high bits of the
+ * opcode byte select the width, the smallest one that fits every operand.
+ * Operands are signed & little endian.
+ */
+struct CompactCode
+{
+    enum Width : uint8_t
+    {
+        Int8  = 0x00,
+        Int16 = 0x40,
+        Int32 = 0x80,
+        Int64 = 0xC0,
+    };
+
+    static constexpr auto OpcodeMask = uint8_t {0x3F};
+    static constexpr auto WidthShift = 6;
+
+    /**
+     * @brief log2 of the operand size in bytes.
+     */
+    [[nodiscard]] static constexpr auto widthLog2(uint8_t const opcodeByte) noexcept -> int
+    {
+        return opcodeByte >> WidthShift;
+    }
+
+    /**
+     * @brief Bytes of an instruction with numOperands operands.
+     */
+    [[nodiscard]] static constexpr auto instructionSize(uint8_t const opcodeByte, int const numOperands) noexcept
+        -> std::size_t
+    {
+        return 1 + (static_cast<std::size_t>(numOperands) << widthLog2(opcodeByte));
+    }
+
+    /**
+     * @brief Operand index of the instruction starting at pc, for handlers
+     * that know the width from the opcode byte.
+     */
+    template <typename Operand>
+    [[nodiscard]] static auto operand(uint8_t const* pc, int const index) noexcept -> int64_t
+    {
+        auto const* src = pc + 1 + static_cast<std::size_t>(index) * sizeof(Operand);
+        auto value      = std::make_unsigned_t<Operand> {0};
+        if constexpr (std::endian::native == std::endian::little) { std::memcpy(&value, src, sizeof(value)); }
+        else
+        {
+            for (auto i = 0U; i < sizeof(value); ++i)
+            { value = static_cast<decltype(value)>(value | static_cast<decltype(value)>(src[i]) << (8 * i)); }
+        }
+        return static_cast<Operand>(value);
+    }
+
+    [[nodiscard]] static auto operand(uint8_t const* pc, int const index) noexcept -> int64_t
+    {
+        switch (widthLog2(*pc))
+        {
+            case 0: return operand<int8_t>(pc, index);
+            case 1: return operand<int16_t>(pc, index);
+            case 2: return operand<int32_t>(pc, index);
+            default: return operand<int64_t>(pc, index);
+        }
+    }
+};
+
+static_assert(ByteCode::NUM_OPCODES <= CompactCode::OpcodeMask + 1);
+
+/**
+ * @brief A program in the compact encoding. The image can be written to disk
+ * as is:
+ *
+ *   header   magic "tcvc", number of jump targets, code size, entry offset
+ *   targets  uint32 byte offset into the code per jump target, 4 byte aligned
+ *   code     the instructions
+ *
+ * Branch & call operands are indices into the target table, so they stay
+ * small in large programs & their width doesn't depend on the layout.
+ */
+class CompactProgram
+{
+public:
+    static constexpr auto Magic      = std::array<uint8_t, 4> {'t', 'c', 'v', 'c'};
+    static constexpr auto HeaderSize = std::size_t {16};
+
+    CompactProgram() = default;
+
+    /**
+     * @brief Checks the header & that every target is inside the code.
+     * Instructions are checked by fromCompactCode().
+     */
+    [[nodiscard]] static auto fromImage(std::vector<uint8_t> image) -> std::optional<CompactProgram>;
+
+    [[nodiscard]] auto image() const noexcept -> std::vector<uint8_t> const& { return image_; }
+    [[nodiscard]] auto numTargets() const noexcept -> uint32_t { return field(1); }
+    [[nodiscard]] auto codeSize() const noexcept -> uint32_t { return field(2); }
+    [[nodiscard]] auto entry() const noexcept -> uint32_t { return field(3); }  // byte offset into code()
+    [[nodiscard]] auto targets() const noexcept -> uint8_t const* { return image_.data() + HeaderSize; }
+    [[nodiscard]] auto code() const noexcept -> uint8_t const*
+    {
+        return image_.data() + HeaderSize + numTargets() * sizeof(uint32_t);
+    }
+
+    [[nodiscard]] auto target(std::size_t const index) const noexcept -> uint32_t
+    {
+        auto offset = uint32_t {0};
+        std::memcpy(&offset, targets() + index * sizeof(uint32_t), sizeof(offset));
+        return offset;
+    }
+
+private:
+    friend auto toCompactCode(std::vector<int64_t> const& code, int64_t entryPoint) -> std::optional<CompactProgram>;
+
+    explicit CompactProgram(std::vector<uint8_t> image) : image_ {std::move(image)} { }
+
+    [[nodiscard]] auto field(std::size_t const index) const noexcept -> uint32_t
+    {
+        if (image_.size() < HeaderSize) { return 0; }
+        auto value = uint32_t {0};
+        std::memcpy(&value, image_.data() + index * sizeof(uint32_t), sizeof(value));
+        return value;
+    }
+
+    std::vector<uint8_t> image_ {};
+};
+
+/**
+ * @brief ByteCode address & byte offset of every instruction in code order.
+ * The end of the code is included, calls in the last instruction return
+ * there.
+ */
+struct CompactLayout
+{
+    std::vector<int64_t> addresses {};
+    std::vector<uint32_t> offsets {};
+
+    /**
+     * @brief Byte offset of the instruction at a ByteCode address, std::nullopt
+     * if no instruction starts there.
+     */
+    [[nodiscard]] auto offsetAt(int64_t address) const -> std::optional<uint32_t>;
+
+    /**
+     * @brief ByteCode address of the instruction at a byte offset, std::nullopt
+     * if no instruction starts there.
+     */
+    [[nodiscard]] auto addressAt(int64_t offset) const -> std::optional<int64_t>;
+};
+
+/**
+ * @brief Walks the code of a program, std::nullopt if it contains an unknown
+ * opcode or the last instruction is cut off.
+ */
+auto layoutOf(CompactProgram const& program) -> std::optional<CompactLayout>;
+
+/**
+ * @brief Encodes ByteCode. Returns std::nullopt if an opcode is unknown, an
+ * instruction is cut off or a branch, call or the entry point doesn't hit the
+ * start of an instruction. Branches to the end of the code are allowed.
+ */
+auto toCompactCode(std::vector<int64_t> const& code, int64_t entryPoint) -> std::optional<CompactProgram>;
+
+/**
+ * @brief Decodes to ByteCode, only data & entryPoint are set. The exact
+ * inverse of toCompactCode().
+ */
+auto fromCompactCode(CompactProgram const& program) -> std::optional<BinaryProgram>;
+
+}  // namespace tcc
@@ -0,0 +1,101 @@
+/**
+ * @file compact_code_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcsl/compact_code.hpp"
+
+#include "catch2/catch.hpp"
+
+using tcc::ByteCode;
+using tcc::CompactCode;
+using tcc::CompactProgram;
+
+TEST_CASE("tcsl: CompactCode operand", "[tcsl]")
+{
+    auto const check = [](uint8_t width, std::vector<uint8_t> bytes, int64_t expected) {
+        bytes.insert(bytes.begin(), static_cast<uint8_t>(ByteCode::ICONST | width));
+        bytes.push_back(0xFF);  // next opcode
+        REQUIRE(CompactCode::operand(bytes.data(), 0) == expected);
+    };
+
+    check(CompactCode::Int8, {0x7F}, 127);
+    check(CompactCode::Int8, {0x80}, -128);
+    check(CompactCode::Int16, {0x34, 0x12}, 0x1234);
+    check(CompactCode::Int16, {0xFE, 0xFF}, -2);
+    check(CompactCode::Int32, {0x00, 0x00, 0x00, 0x80}, std::numeric_limits<int32_t>::min());
+    check(CompactCode::Int64, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F}, std::numeric_limits<int64_t>::max());
+
+    REQUIRE(CompactCode::instructionSize(ByteCode::IADD, 0) == 1);
+    REQUIRE(CompactCode::instructionSize(static_cast<uint8_t>(ByteCode::CALL) | CompactCode::Int16, 2) == 5);
+    REQUIRE(CompactCode::instructionSize(static_cast<uint8_t>(ByteCode::ICONST) | CompactCode::Int64, 1) == 9);
+}
+
+TEST_CASE("tcsl: CompactCode round trip", "[tcsl]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::LOAD, -3,             // 0
+        ByteCode::ICONST, 2,            // 2
+        ByteCode::ILT_BRF, 8,           // 4
+        ByteCode::LOAD, -3,             // 6
+        ByteCode::LOAD, -3,             // 8
+        ByteCode::ICONST, 1'000,        // 10
+        ByteCode::ISUB,                 // 12
+        ByteCode::CALL, 0, 1,           // 13
+        ByteCode::ICONST, 1LL << 40,    // 16
+        ByteCode::GSTORE, 70'000,       // 18
+        ByteCode::RET,                  // 20
+        ByteCode::ICONST, 12,           // 21 <-- main
+        ByteCode::CALL, 0, 1,           // 23
+        ByteCode::BR, 29,               // 26
+        ByteCode::EXIT,                 // 28
+    };
+
+    auto const program = tcc::toCompactCode(code, 21);
+    REQUIRE(program.has_value());
+
+    // 15 opcodes, 1 byte operands except for 1'000, 70'000 & 1 << 40
+    CHECK(program->numTargets() == 3);
+    CHECK(program->codeSize() == 15 + 11 + 2 + 4 + 8);
+    CHECK(program->image().size() == CompactProgram::HeaderSize + 3 * 4 + program->codeSize());
+    CHECK(program->target(0) == 0);
+    CHECK(program->target(2) == program->codeSize());
+
+    auto const layout = tcc::layoutOf(program.value());
+    REQUIRE(layout.has_value());
+    CHECK(layout->addresses.size() == 16);
+    CHECK(layout->offsetAt(21) == program->entry());
+    CHECK(layout->addressAt(program->entry()) == 21);
+    CHECK_FALSE(layout->offsetAt(1).has_value());
+    CHECK(layout->addressAt(program->codeSize()) == 29);
+
+    auto const decoded = tcc::fromCompactCode(program.value());
+    REQUIRE(decoded.has_value());
+    CHECK(decoded->entryPoint == 21);
+    CHECK(decoded->data == code);
+
+    SECTION("image")
+    {
+        auto const copy = CompactProgram::fromImage(program->image());
+        REQUIRE(copy.has_value());
+        CHECK(tcc::fromCompactCode(copy.value())->data == code);
+
+        auto truncated = program->image();
+        truncated.pop_back();
+        CHECK_FALSE(CompactProgram::fromImage(truncated).has_value());
+
+        auto badMagic = program->image();
+        badMagic[0]   = 'x';
+        CHECK_FALSE(CompactProgram::fromImage(badMagic).has_value());
+    }
+}
+
+TEST_CASE("tcsl: CompactCode invalid", "[tcsl]")
+{
+    // unknown opcode, missing operand, branch into an operand & entry point
+    CHECK_FALSE(tcc::toCompactCode({ByteCode::NUM_OPCODES}, 0).has_value());
+    CHECK_FALSE(tcc::toCompactCode({ByteCode::ICONST}, 0).has_value());
+    CHECK_FALSE(tcc::toCompactCode({ByteCode::BR, 1, ByteCode::HALT}, 0).has_value());
+    CHECK_FALSE(tcc::toCompactCode({ByteCode::ICONST, 1, ByteCode::EXIT}, 1).has_value());
+    CHECK_FALSE(tcc::toCompactCode({}, 0).has_value());
+    CHECK_FALSE(tcc::fromCompactCode(CompactProgram {}).has_value());
+}
@@ -0,0 +1,26 @@
+/**
+ * @file register_code.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcsl/register_code.hpp"
+
+#include "fmt/format.h"
+
+#include <cctype>
+
+namespace tcc
+{
+
+auto operator<<(std::ostream& out, RegisterCode::Type code) -> std::ostream&
+{
+    if (code >= 0 && code < RegisterCode::NUM_OPCODES)
+    {
+        auto const name = RegisterInstructions[static_cast<std::size_t>(code)].name;
+        for (auto const c : name) { out << static_cast<char>(std::toupper(c)); }
+        return out;
+    }
+
+    return out << fmt::format("{}", static_cast<int64_t>(code));
+}
+}  // namespace tcc
@@ -0,0 +1,84 @@
+/**
+ * @file register_code.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+#include "tcsl/byte_code.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Three-address instruction set of the register engine.
+ *
+ * Registers are slots of the VM stack relative to the frame pointer, the same
+ * slots LOAD & STORE address in ByteCode. Operands ending in K are constants.
+ */
+struct RegisterCode
+{
+    enum Type : int64_t
+    {
+        NOOP = 0,
+        MOV,     // r[a] = r[b]
+        MOVK,    // r[a] = b
+        IADD,    // r[a] = r[b] + r[c]
+        IADDK,   // r[a] = r[b] + c
+        ISUB,    // r[a] = r[b] - r[c]
+        ISUBK,   // r[a] = r[b] - c
+        IMUL,    // r[a] = r[b] * r[c]
+        IMULK,   // r[a] = r[b] * c
+        ILT,     // r[a] = r[b] < r[c]
+        ILTK,    // r[a] = r[b] < c
+        IEQ,     // r[a] = r[b] == r[c]
+        IEQK,    // r[a] = r[b] == c
+        BR,      // goto a
+        BRT,     // if r[a] != 0 goto b
+        BRF,     // if r[a] == 0 goto b
+        GLOAD,   // r[a] = globals[b]
+        GSTORE,  // globals[a] = r[b]
+        PRINT,   // print r[a]
+        CALL,    // call a with b args starting at r[c], result in r[c]
+        RET,     // return r[a]
+        EXIT,    // exit with r[a]
+        HALT,    //
+        NUM_OPCODES,
+    };
+};
+
+auto operator<<(std::ostream& out, RegisterCode::Type code) -> std::ostream&;
+
+constexpr auto RegisterInstructions = std::array {
+    Instruction {"noop"},       //
+    Instruction {"mov", 2},     //
+    Instruction {"movk", 2},    //
+    Instruction {"iadd", 3},    //
+    Instruction {"iaddk", 3},   //
+    Instruction {"isub", 3},    //
+    Instruction {"isubk", 3},   //
+    Instruction {"imul", 3},    //
+    Instruction {"imulk", 3},   //
+    Instruction {"ilt", 3},     //
+    Instruction {"iltk", 3},    //
+    Instruction {"ieq", 3},     //
+    Instruction {"ieqk", 3},    //
+    Instruction {"br", 1},      //
+    Instruction {"brt", 2},     //
+    Instruction {"brf", 2},     //
+    Instruction {"gload", 2},   //
+    Instruction {"gstore", 2},  //
+    Instruction {"print", 1},   //
+    Instruction {"call", 3},    //
+    Instruction {"ret", 1},     //
+    Instruction {"exit", 1},    //
+    Instruction {"halt"},       //
+};
+
+static_assert(RegisterInstructions.size() == RegisterCode::NUM_OPCODES);
+
+}  // namespace tcc
@@ -0,0 +1,26 @@
+/**
+ * @file register_code_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcsl/register_code.hpp"
+
+#include <sstream>
+
+#include "catch2/catch.hpp"
+
+TEST_CASE("tcsl: RegisterCode ostream", "[tcsl]")
+{
+    auto const input = {
+        tcc::RegisterCode::MOV,    //
+        tcc::RegisterCode::IADDK,  //
+        tcc::RegisterCode::BRF,    //
+        tcc::RegisterCode::CALL,   //
+        tcc::RegisterCode::HALT,   //
+    };
+
+    auto stream = std::stringstream {};
+    for (auto const& x : input) { stream << x; }
+    stream << static_cast<tcc::RegisterCode::Type>(tcc::RegisterCode::NUM_OPCODES);
+
+    REQUIRE(stream.str() == "MOVIADDKBRFCALLHALT23");
+}
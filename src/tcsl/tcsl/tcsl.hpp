@@ -9,10 +9,13 @@
 #include "tcsl/assert.hpp"
 #include "tcsl/binary_format.hpp"
 #include "tcsl/byte_code.hpp"
+#include "tcsl/compact_code.hpp"
 #include "tcsl/file.hpp"
+#include "tcsl/register_code.hpp"
 #include "tcsl/testing.hpp"
 #include "tcsl/variant.hpp"
 #include "tcsl/warning.hpp"
+#include "tcsl/x86_assembler.hpp"
 
 // fmt
 #include "fmt/format.h"
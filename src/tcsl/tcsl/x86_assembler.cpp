@@ -0,0 +1,266 @@
+/**
+ * @file x86_assembler.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcsl/x86_assembler.hpp"
+
+#include <limits>
+
+namespace tcc
+{
+namespace
+{
+constexpr auto regCode(X86Register reg) noexcept -> uint8_t { return static_cast<uint8_t>(reg); }
+constexpr auto low(uint8_t reg) noexcept -> uint8_t { return reg & 0x7U; }
+constexpr auto high(uint8_t reg) noexcept -> uint8_t { return (reg >> 3U) & 0x1U; }
+
+constexpr auto fitsInt8(int64_t value) noexcept -> bool
+{
+    return value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max();
+}
+
+constexpr auto fitsInt32(int64_t value) noexcept -> bool
+{
+    return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+}
+
+constexpr auto scaleBits(uint8_t scale) noexcept -> uint8_t
+{
+    switch (scale)
+    {
+        case 2: return 1;
+        case 4: return 2;
+        case 8: return 3;
+        default: return 0;
+    }
+}
+}  // namespace
+
+auto X86Assembler::newLabel() -> X86Label
+{
+    labels_.emplace_back();
+    return X86Label {labels_.size() - 1};
+}
+
+auto X86Assembler::bind(X86Label const label) -> void { labels_.at(label.id) = code_.size(); }
+
+auto X86Assembler::offsetOf(X86Label const label) const -> std::optional<std::size_t> { return labels_.at(label.id); }
+
+auto X86Assembler::finalize() -> bool
+{
+    for (auto const& [offset, id] : fixups_)
+    {
+        auto const target = labels_.at(id);
+        if (!target.has_value()) { return false; }
+
+        auto const relative = static_cast<int64_t>(*target) - static_cast<int64_t>(offset + 4);
+        if (!fitsInt32(relative)) { return false; }
+
+        auto const value = static_cast<uint32_t>(static_cast<int32_t>(relative));
+        for (auto i = 0U; i < 4U; ++i) { code_[offset + i] = static_cast<uint8_t>(value >> (8U * i)); }
+    }
+    fixups_.clear();
+    return true;
+}
+
+auto X86Assembler::mov(X86Register dest, X86Register src) -> void { emitRegister(0x89, regCode(src), dest); }
+auto X86Assembler::mov(X86Register dest, X86Memory const& src) -> void { emitMemory(0x8B, regCode(dest), src); }
+auto X86Assembler::mov(X86Memory const& dest, X86Register src) -> void { emitMemory(0x89, regCode(src), dest); }
+
+auto X86Assembler::movImm(X86Register dest, int64_t const value) -> void
+{
+    if (fitsInt32(value))
+    {
+        emitRegister(0xC7, 0, dest);
+        emit32(static_cast<int32_t>(value));
+        return;
+    }
+
+    emitRex(true, 0, 0, regCode(dest));
+    emitByte(static_cast<uint8_t>(0xB8 + low(regCode(dest))));
+    emit64(value);
+}
+
+auto X86Assembler::movImm(X86Memory const& dest, int32_t const value) -> void
+{
+    emitMemory(0xC7, 0, dest);
+    emit32(value);
+}
+
+auto X86Assembler::mov8(X86Memory const& dest, X86Register src) -> void
+{
+    // rex is required to address sil & dil instead of dh & bh
+    emitMemory(0x88, regCode(src), dest, false, regCode(src) >= 4);
+}
+
+auto X86Assembler::lea(X86Register dest, X86Memory const& src) -> void { emitMemory(0x8D, regCode(dest), src); }
+
+auto X86Assembler::add(X86Register dest, X86Register src) -> void { emitRegister(0x01, regCode(src), dest); }
+auto X86Assembler::add(X86Register dest, X86Memory const& src) -> void { emitMemory(0x03, regCode(dest), src); }
+auto X86Assembler::add(X86Memory const& dest, X86Register src) -> void { emitMemory(0x01, regCode(src), dest); }
+auto X86Assembler::addImm(X86Register dest, int32_t const value) -> void { emitImmediate(0, dest, value); }
+auto X86Assembler::sub(X86Register dest, X86Register src) -> void { emitRegister(0x29, regCode(src), dest); }
+auto X86Assembler::sub(X86Memory const& dest, X86Register src) -> void { emitMemory(0x29, regCode(src), dest); }
+auto X86Assembler::subImm(X86Register dest, int32_t const value) -> void { emitImmediate(5, dest, value); }
+auto X86Assembler::andImm(X86Register dest, int32_t const value) -> void { emitImmediate(4, dest, value); }
+auto X86Assembler::cmp(X86Register lhs, X86Register rhs) -> void { emitRegister(0x39, regCode(rhs), lhs); }
+auto X86Assembler::cmp(X86Register lhs, X86Memory const& rhs) -> void { emitMemory(0x3B, regCode(lhs), rhs); }
+auto X86Assembler::cmpImm(X86Register lhs, int32_t const value) -> void { emitImmediate(7, lhs, value); }
+auto X86Assembler::test(X86Register lhs, X86Register rhs) -> void { emitRegister(0x85, regCode(rhs), lhs); }
+auto X86Assembler::xor32(X86Register dest, X86Register src) -> void { emitRegister(0x31, regCode(src), dest, false); }
+auto X86Assembler::inc(X86Register reg) -> void { emitRegister(0xFF, 0, reg); }
+auto X86Assembler::dec(X86Register reg) -> void { emitRegister(0xFF, 1, reg); }
+
+auto X86Assembler::imul(X86Register dest, X86Register src) -> void
+{
+    emitRex(true, regCode(dest), 0, regCode(src));
+    emitByte(0x0F);
+    emitByte(0xAF);
+    emitByte(static_cast<uint8_t>(0xC0U | (low(regCode(dest)) << 3U) | low(regCode(src))));
+}
+
+auto X86Assembler::idiv(X86Register divisor) -> void { emitRegister(0xF7, 7, divisor); }
+auto X86Assembler::neg(X86Register reg) -> void { emitRegister(0xF7, 3, reg); }
+
+auto X86Assembler::cqo() -> void
+{
+    emitByte(0x48);
+    emitByte(0x99);
+}
+
+auto X86Assembler::setcc(X86Condition condition, X86Register dest) -> void
+{
+    // rex is required to address sil & dil instead of dh & bh
+    emitRex(false, 0, 0, regCode(dest), regCode(dest) >= 4);
+    emitByte(0x0F);
+    emitByte(static_cast<uint8_t>(0x90U | static_cast<uint8_t>(condition)));
+    emitByte(static_cast<uint8_t>(0xC0U | low(regCode(dest))));
+}
+
+auto X86Assembler::push(X86Register reg) -> void
+{
+    emitRex(false, 0, 0, regCode(reg));
+    emitByte(static_cast<uint8_t>(0x50 + low(regCode(reg))));
+}
+
+auto X86Assembler::pop(X86Register reg) -> void
+{
+    emitRex(false, 0, 0, regCode(reg));
+    emitByte(static_cast<uint8_t>(0x58 + low(regCode(reg))));
+}
+
+auto X86Assembler::jmp(X86Label const target) -> void
+{
+    emitByte(0xE9);
+    emitRelative(target);
+}
+
+auto X86Assembler::jmp(X86Memory const& target) -> void { emitMemory(0xFF, 4, target, false); }
+
+auto X86Assembler::jcc(X86Condition condition, X86Label const target) -> void
+{
+    emitByte(0x0F);
+    emitByte(static_cast<uint8_t>(0x80U | static_cast<uint8_t>(condition)));
+    emitRelative(target);
+}
+
+auto X86Assembler::call(X86Label const target) -> void
+{
+    emitByte(0xE8);
+    emitRelative(target);
+}
+
+auto X86Assembler::call(X86Register target) -> void { emitRegister(0xFF, 2, target, false); }
+auto X86Assembler::call(X86Memory const& target) -> void { emitMemory(0xFF, 2, target, false); }
+auto X86Assembler::ret() -> void { emitByte(0xC3); }
+
+auto X86Assembler::syscall() -> void
+{
+    emitByte(0x0F);
+    emitByte(0x05);
+}
+
+auto X86Assembler::callExternal() -> std::size_t
+{
+    emitByte(0xE8);
+    auto const offset = code_.size();
+    emit32(0);
+    return offset;
+}
+
+auto X86Assembler::emitByte(uint8_t const byte) -> void { code_.push_back(byte); }
+
+auto X86Assembler::emit32(int32_t const value) -> void
+{
+    auto const bits = static_cast<uint32_t>(value);
+    for (auto i = 0U; i < 4U; ++i) { emitByte(static_cast<uint8_t>(bits >> (8U * i))); }
+}
+
+auto X86Assembler::emit64(int64_t const value) -> void
+{
+    auto const bits = static_cast<uint64_t>(value);
+    for (auto i = 0U; i < 8U; ++i) { emitByte(static_cast<uint8_t>(bits >> (8U * i))); }
+}
+
+auto X86Assembler::emitRex(bool const wide, uint8_t const reg, uint8_t const index, uint8_t const base,
+                           bool const force) -> void
+{
+    auto const rex = static_cast<uint8_t>(0x40U | (wide ? 0x8U : 0x0U) | (high(reg) << 2U) | (high(index) << 1U)
+                                          | high(base));
+    if (rex != 0x40 || force) { emitByte(rex); }
+}
+
+auto X86Assembler::emitRegister(uint8_t const opcode, uint8_t const reg, X86Register const rm, bool const wide)
+    -> void
+{
+    emitRex(wide, reg, 0, regCode(rm));
+    emitByte(opcode);
+    emitByte(static_cast<uint8_t>(0xC0U | (low(reg) << 3U) | low(regCode(rm))));
+}
+
+auto X86Assembler::emitMemory(uint8_t const opcode, uint8_t const reg, X86Memory const& rm, bool const wide,
+                              bool const force) -> void
+{
+    auto const base  = regCode(rm.base);
+    auto const index = rm.index.has_value() ? regCode(*rm.index) : uint8_t {0};
+    emitRex(wide, reg, index, base, force);
+    emitByte(opcode);
+
+    // rbp & r13 as base always need a displacement
+    auto const disp = rm.displacement;
+    auto const mod  = disp == 0 && low(base) != 5 ? 0U : fitsInt8(disp) ? 1U : 2U;
+
+    // rsp & r12 as base always need a sib byte
+    auto const needsSib = rm.index.has_value() || low(base) == 4;
+    emitByte(static_cast<uint8_t>((mod << 6U) | (low(reg) << 3U) | (needsSib ? 4U : low(base))));
+    if (needsSib)
+    {
+        auto const indexBits = rm.index.has_value() ? low(index) : uint8_t {4};
+        emitByte(static_cast<uint8_t>((scaleBits(rm.scale) << 6U) | (indexBits << 3U) | low(base)));
+    }
+
+    if (mod == 1U) { emitByte(static_cast<uint8_t>(static_cast<int8_t>(disp))); }
+    if (mod == 2U) { emit32(disp); }
+}
+
+auto X86Assembler::emitImmediate(uint8_t const extension, X86Register const dest, int32_t const value) -> void
+{
+    if (fitsInt8(value))
+    {
+        emitRegister(0x83, extension, dest);
+        emitByte(static_cast<uint8_t>(static_cast<int8_t>(value)));
+        return;
+    }
+
+    emitRegister(0x81, extension, dest);
+    emit32(value);
+}
+
+auto X86Assembler::emitRelative(X86Label const target) -> void
+{
+    fixups_.emplace_back(code_.size(), target.id);
+    emit32(0);
+}
+
+}  // namespace tcc
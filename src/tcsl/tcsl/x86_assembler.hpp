@@ -0,0 +1,147 @@
+/**
+ * @file x86_assembler.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace tcc
+{
+enum class X86Register : uint8_t
+{
+    RAX = 0,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+};
+
+/**
+ * @brief Condition codes, the values are the low nibble of Jcc & SETcc.
+ */
+enum class X86Condition : uint8_t
+{
+    Equal          = 0x4,
+    NotEqual       = 0x5,
+    Below          = 0x2,
+    AboveOrEqual   = 0x3,
+    Less           = 0xC,
+    GreaterOrEqual = 0xD,
+    Greater        = 0xF,
+};
+
+/**
+ * @brief Memory operand [base + index * scale + displacement].
+ */
+struct X86Memory
+{
+    X86Register base {X86Register::RAX};
+    std::optional<X86Register> index {};
+    uint8_t scale {1};  // 1, 2, 4 or 8
+    int32_t displacement {0};
+};
+
+/**
+ * @brief Handle for a position in the code, may be used before it is bound.
+ */
+struct X86Label
+{
+    std::size_t id {0};
+};
+
+/**
+ * @brief Minimal x86-64 encoder. All arithmetic is 64 bit, jumps & calls to
+ * labels always use a 32 bit displacement.
+ */
+class X86Assembler
+{
+public:
+    auto newLabel() -> X86Label;
+    auto bind(X86Label label) -> void;
+    [[nodiscard]] auto offsetOf(X86Label label) const -> std::optional<std::size_t>;
+
+    /**
+     * @brief Patches all jumps & calls. Returns false if a used label was never
+     * bound.
+     */
+    auto finalize() -> bool;
+    [[nodiscard]] auto code() const noexcept -> std::vector<uint8_t> const& { return code_; }
+
+    auto mov(X86Register dest, X86Register src) -> void;
+    auto mov(X86Register dest, X86Memory const& src) -> void;
+    auto mov(X86Memory const& dest, X86Register src) -> void;
+    auto movImm(X86Register dest, int64_t value) -> void;
+    auto movImm(X86Memory const& dest, int32_t value) -> void;
+    auto mov8(X86Memory const& dest, X86Register src) -> void;  // stores the low byte of src
+    auto lea(X86Register dest, X86Memory const& src) -> void;
+
+    auto add(X86Register dest, X86Register src) -> void;
+    auto add(X86Register dest, X86Memory const& src) -> void;
+    auto add(X86Memory const& dest, X86Register src) -> void;
+    auto addImm(X86Register dest, int32_t value) -> void;
+    auto sub(X86Register dest, X86Register src) -> void;
+    auto sub(X86Memory const& dest, X86Register src) -> void;
+    auto subImm(X86Register dest, int32_t value) -> void;
+    auto andImm(X86Register dest, int32_t value) -> void;
+    auto imul(X86Register dest, X86Register src) -> void;
+    auto idiv(X86Register divisor) -> void;  // rdx:rax / divisor, quotient in rax, remainder in rdx
+    auto cqo() -> void;                      // sign extends rax into rdx
+    auto neg(X86Register reg) -> void;
+    auto cmp(X86Register lhs, X86Register rhs) -> void;
+    auto cmp(X86Register lhs, X86Memory const& rhs) -> void;
+    auto cmpImm(X86Register lhs, int32_t value) -> void;
+    auto test(X86Register lhs, X86Register rhs) -> void;
+    auto xor32(X86Register dest, X86Register src) -> void;
+    auto inc(X86Register reg) -> void;
+    auto dec(X86Register reg) -> void;
+    auto setcc(X86Condition condition, X86Register dest) -> void;
+
+    auto push(X86Register reg) -> void;
+    auto pop(X86Register reg) -> void;
+
+    auto jmp(X86Label target) -> void;
+    auto jmp(X86Memory const& target) -> void;
+    auto jcc(X86Condition condition, X86Label target) -> void;
+    auto call(X86Label target) -> void;
+    auto call(X86Register target) -> void;
+    auto call(X86Memory const& target) -> void;
+    auto ret() -> void;
+    auto syscall() -> void;
+
+    /**
+     * @brief Call to a symbol outside of this code. Returns the offset of the
+     * zero displacement, which a linker has to fill in.
+     */
+    auto callExternal() -> std::size_t;
+
+private:
+    auto emitByte(uint8_t byte) -> void;
+    auto emit32(int32_t value) -> void;
+    auto emit64(int64_t value) -> void;
+    auto emitRex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool force = false) -> void;
+    auto emitRegister(uint8_t opcode, uint8_t reg, X86Register rm, bool wide = true) -> void;
+    auto emitMemory(uint8_t opcode, uint8_t reg, X86Memory const& rm, bool wide = true, bool force = false) -> void;
+    auto emitImmediate(uint8_t extension, X86Register dest, int32_t value) -> void;
+    auto emitRelative(X86Label target) -> void;
+
+    std::vector<uint8_t> code_ {};
+    std::vector<std::optional<std::size_t>> labels_ {};
+    std::vector<std::pair<std::size_t, std::size_t>> fixups_ {};  // code offset, label id
+};
+
+}  // namespace tcc
@@ -0,0 +1,90 @@
+/**
+ * @file x86_assembler_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcsl/x86_assembler.hpp"
+
+#include "catch2/catch.hpp"
+
+using tcc::X86Assembler;
+using tcc::X86Condition;
+using tcc::X86Memory;
+using tcc::X86Register;
+
+TEST_CASE("tcsl: X86AssemblerEncoding", "[tcsl]")
+{
+    auto assembler = X86Assembler {};
+
+    SECTION("register to register")
+    {
+        assembler.mov(X86Register::R13, X86Register::R12);
+        assembler.add(X86Register::RAX, X86Register::RCX);
+        assembler.imul(X86Register::RCX, X86Register::RAX);
+        REQUIRE(assembler.code() == std::vector<uint8_t> {0x4D, 0x89, 0xE5, 0x48, 0x01, 0xC8, 0x48, 0x0F, 0xAF, 0xC8});
+    }
+
+    SECTION("memory operands")
+    {
+        assembler.mov(X86Register::RAX, X86Memory {X86Register::RBX, X86Register::R12, 8, 0});
+        assembler.mov(X86Memory {X86Register::R13, {}, 1, 0}, X86Register::RAX);
+        assembler.mov(X86Register::RCX, X86Memory {X86Register::RSP, {}, 1, 8});
+        assembler.jmp(X86Memory {X86Register::RAX, X86Register::RCX, 8, 0});
+        REQUIRE(assembler.code() == std::vector<uint8_t> {
+                                        0x4A, 0x8B, 0x04, 0xE3,        // mov rax, [rbx + r12 * 8]
+                                        0x49, 0x89, 0x45, 0x00,        // mov [r13], rax
+                                        0x48, 0x8B, 0x4C, 0x24, 0x08,  // mov rcx, [rsp + 8]
+                                        0xFF, 0x24, 0xC8,              // jmp [rax + rcx * 8]
+                                    });
+    }
+
+    SECTION("immediates")
+    {
+        assembler.addImm(X86Register::R12, 3);
+        assembler.movImm(X86Register::RAX, -1);
+        assembler.movImm(X86Register::RDX, int64_t {1} << 40);
+        REQUIRE(assembler.code() == std::vector<uint8_t> {
+                                        0x49, 0x83, 0xC4, 0x03,                          // add r12, 3
+                                        0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF,        // mov rax, -1
+                                        0x48, 0xBA, 0, 0, 0, 0, 0, 0x01, 0x00, 0x00,     // mov rdx, 1 << 40
+                                    });
+    }
+
+    SECTION("labels")
+    {
+        auto const label = assembler.newLabel();
+        assembler.jcc(X86Condition::Less, label);
+        assembler.ret();
+        assembler.bind(label);
+        assembler.setcc(X86Condition::Equal, X86Register::RSI);
+        REQUIRE(assembler.finalize());
+        REQUIRE(assembler.offsetOf(label) == 7);
+        REQUIRE(assembler.code() == std::vector<uint8_t> {0x0F, 0x8C, 0x01, 0, 0, 0, 0xC3, 0x40, 0x0F, 0x94, 0xC6});
+    }
+
+    SECTION("division, bytes & system calls")
+    {
+        REQUIRE(assembler.callExternal() == 1);
+        assembler.cqo();
+        assembler.idiv(X86Register::R9);
+        assembler.neg(X86Register::RCX);
+        assembler.mov8(X86Memory {X86Register::RSI, {}, 1, 0}, X86Register::RCX);
+        assembler.mov8(X86Memory {X86Register::RSP, {}, 1, 8}, X86Register::RSI);
+        assembler.syscall();
+        REQUIRE(assembler.finalize());
+        REQUIRE(assembler.code() == std::vector<uint8_t> {
+                                        0xE8, 0, 0, 0, 0,              // call <external>
+                                        0x48, 0x99,                    // cqo
+                                        0x49, 0xF7, 0xF9,              // idiv r9
+                                        0x48, 0xF7, 0xD9,              // neg rcx
+                                        0x88, 0x0E,                    // mov [rsi], cl
+                                        0x40, 0x88, 0x74, 0x24, 0x08,  // mov [rsp + 8], sil
+                                        0x0F, 0x05,                    // syscall
+                                    });
+    }
+
+    SECTION("unbound label")
+    {
+        assembler.call(assembler.newLabel());
+        REQUIRE_FALSE(assembler.finalize());
+    }
+}
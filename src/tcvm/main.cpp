@@ -6,6 +6,33 @@
 #include "tcsl/tcsl.hpp"
 #include "tcvm/examples.hpp"
 #include "tcvm/program_options.hpp"
+#include "tcvm/vm/natives.hpp"
+#include "tcvm/vm/output_sink.hpp"
+#include "tcvm/vm/perf_counters.hpp"
+#include "tcvm/vm/profiler.hpp"
+#include "tcvm/vm/scheduler.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/verifier.hpp"
+
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string_view>
+
+namespace
+{
+auto parseEngine(std::string_view const name) -> std::optional<tcc::VirtualMachine::Engine>
+{
+    using Engine = tcc::VirtualMachine::Engine;
+    if (name == "switch") { return Engine::Switch; }
+    if (name == "threaded") { return Engine::Threaded; }
+    if (name == "register") { return Engine::Register; }
+    if (name == "jit") { return Engine::Jit; }
+    if (name == "tracing-jit") { return Engine::TracingJit; }
+    if (name == "compact") { return Engine::Compact; }
+    return std::nullopt;
+}
+}  // namespace
 
 auto main(int argc, char** argv) -> int
 {
@@ -20,6 +47,20 @@ auto main(int argc, char** argv) -> int
         fmt::print("{}\n", arg);
     }
 
+    if (cliArguments.count("corpus") != 0U)
+    {
+        auto corpus = std::vector<tcc::BinaryProgram> {};
+        for (auto const& file : cliArguments["corpus"].as<std::vector<std::string>>())
+        {
+            auto& program = corpus.emplace_back();
+            tcc::BinaryFormat::readFromFile(file, program);
+        }
+
+        auto const maxEntries = 8;
+        tcc::printSuperinstructionTable(std::cout, tcc::countOpcodeSequences(corpus), maxEntries);
+        return EXIT_SUCCESS;
+    }
+
     auto path = std::string {};
     if (cliArguments.count("file") != 0U) { path = cliArguments["file"].as<std::string>(); }
 
@@ -32,14 +73,160 @@ auto main(int argc, char** argv) -> int
     // binary
     auto program = tcc::BinaryProgram {};
     tcc::BinaryFormat::readFromFile(path, program);
-    auto const stackSize = 200;
-    auto vm              = tcc::VirtualMachine(program.data, program.entryPoint, 0, stackSize, true);
+    if (cliArguments.count("fuse") != 0U) { program = tcc::fuseSuperinstructions(program); }
+
+    // verified programs run unchecked with an exact stack, others only with --check
+    auto const shouldCheck = cliArguments.count("check") != 0U;
+    auto const verified    = tcc::verify(program);
+    if (!verified.ok() && !shouldCheck)
+    {
+        fmt::print("error: {} at: {}\n", verified.error, verified.address);
+        return EXIT_FAILURE;
+    }
+
+    auto registry = tcc::NativeRegistry {};
+    tcc::addBuiltinNatives(registry);
+    auto const natives = tcc::resolveNatives(program, registry);
+    if (!natives.ok())
+    {
+        fmt::print("error: {} at: {}\n", natives.error, natives.address);
+        return EXIT_FAILURE;
+    }
+
+    auto const defaultStackSize = 200;
+    auto const stackSize        = static_cast<uint64_t>(verified.stackSize.value_or(defaultStackSize));
+    auto const dataSize         = static_cast<uint64_t>(verified.globals);
+
+    if (cliArguments.count("threads") != 0U)
+    {
+        // the scheduler runs its tasks unchecked, unmetered & prints to stdout
+        for (auto const* option :
+             {"check", "gas", "output", "trace", "stats", "histogram", "perf", "profile", "engine"})
+        {
+            if (cliArguments.count(option) != 0U && !cliArguments[option].defaulted())
+            {
+                fmt::print("error: --{} can not be combined with --threads\n", option);
+                return EXIT_FAILURE;
+            }
+        }
+
+        auto options         = tcc::SchedulerOptions {};
+        options.threads      = cliArguments["threads"].as<std::size_t>();
+        options.stackSize    = stackSize;
+        options.callHeadroom = static_cast<uint64_t>(verified.callHeadroom);
+        options.dataSize     = dataSize;
+        auto scheduler       = tcc::Scheduler {options};
+        scheduler.setNatives(natives.functions);
+        auto const exitCode = scheduler.run(program);
+        if (scheduler.status() == tcc::Scheduler::RunStatus::InvalidInstruction)
+        {
+            fmt::print("error: invalid instruction\n");
+            return EXIT_FAILURE;
+        }
+        fmt::print("exit code: {}\n", exitCode);
+        return EXIT_SUCCESS;
+    }
+
+    auto const& engineName = cliArguments["engine"].as<std::string>();
+    auto const engine      = parseEngine(engineName);
+    if (!engine.has_value())
+    {
+        fmt::print("error: unknown engine: {}\n", engineName);
+        return EXIT_FAILURE;
+    }
+
+    auto const shouldTrace = cliArguments.count("trace") != 0U;
+    auto vm                = tcc::VirtualMachine(program.data, program.entryPoint, dataSize, stackSize, shouldTrace,
+                                                 std::cout, engine.value());
+    vm.setNatives(natives.functions);
+    vm.setCallHeadroom(static_cast<uint64_t>(verified.callHeadroom));
+    vm.enableBoundsChecking(shouldCheck);
+    vm.enableStatistics(cliArguments.count("stats") != 0U || cliArguments.count("histogram") != 0U);
+    if (cliArguments.count("gas") != 0U) { vm.enableMetering(cliArguments["gas"].as<std::int64_t>()); }
+
+    auto output = std::unique_ptr<tcc::MappedFileSink> {};
+    if (cliArguments.count("output") != 0U)
+    {
+        auto const& outputPath = cliArguments["output"].as<std::string>();
+        output                 = tcc::MappedFileSink::open(outputPath);
+        if (output == nullptr)
+        {
+            fmt::print("error: can not map output file: {}\n", outputPath);
+            return EXIT_FAILURE;
+        }
+        vm.setOutput(output.get());
+    }
 
     // factorial
     // auto const factorial = tcvm::CreateFactorialProgram(arg);
     // auto vm = tcc::VirtualMachine(factorial.data, factorial.entryPoint, 0,
     // 1000, true);
 
-    vm.cpu();
+    auto exitCode = int64_t {-1};
+    auto traced   = false;  // only the plain run keeps the trace
+    if (cliArguments.count("profile") != 0U)
+    {
+        vm.enableTracing(false);
+        auto profiler = tcc::Profiler {program.symbols};
+        exitCode      = profiler.run(vm).exitCode;
+
+        auto file = std::ofstream {cliArguments["profile"].as<std::string>()};
+        profiler.writeFolded(file);
+    }
+    else if (cliArguments.count("perf") != 0U)
+    {
+        // the measured run counts the bytecode instructions as the gas of the
+        // basic blocks it entered, so it is always metered
+        auto const gas = cliArguments.count("gas") != 0U ? cliArguments["gas"].as<std::int64_t>()
+                                                         : std::numeric_limits<std::int64_t>::max();
+        vm.enableMetering(gas);
+
+        auto counters = tcc::PerfCounters {};
+        if (!counters.available()) { fmt::print("warning: hardware performance counters are not available\n"); }
+
+        vm.enableTracing(false);
+        exitCode = tcc::measure(counters, [&vm] { return vm.cpu(); });
+        fmt::print("{}", tcc::formatPerfCounts(counters.read(), gas - vm.gas()));
+    }
+    else
+    {
+        exitCode = vm.cpu();
+        traced   = shouldTrace;
+    }
+
+    // also written if the program was stopped
+#if defined(TCC_VM_HISTOGRAM)
+    if (cliArguments.count("histogram") != 0U)
+    {
+        auto file = std::ofstream {cliArguments["histogram"].as<std::string>()};
+        vm.histogram().writeJson(file);
+    }
+#endif
+    if (vm.status() == tcc::VirtualMachine::RunStatus::OutOfGas)
+    {
+        fmt::print("error: out of gas\n");
+        return EXIT_FAILURE;
+    }
+    if (vm.status() == tcc::VirtualMachine::RunStatus::StackOverflow)
+    {
+        fmt::print("error: stack overflow\n");
+        return EXIT_FAILURE;
+    }
+    // the machine already printed the error
+    if (vm.status() == tcc::VirtualMachine::RunStatus::BoundsCheckFailed) { return EXIT_FAILURE; }
+    if (vm.status() == tcc::VirtualMachine::RunStatus::InvalidInstruction)
+    {
+        fmt::print("error: invalid instruction at: {}\n", vm.callStack().front());
+        return EXIT_FAILURE;
+    }
+
+    // a trace already ends with the exit code
+    if (!traced) { fmt::print("exit code: {}\n", exitCode); }
+    if (cliArguments.count("stats") != 0U)
+    {
+        auto const& stats = vm.stats();
+        fmt::print("instructions: {}\ncalls: {}\nmax stack depth: {}\n", stats.instructions, stats.calls,
+                   stats.maxStackDepth);
+    }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 #include "tcvm/examples.hpp"
 
+#include <algorithm>
+
 using tcc::ByteCode;
 
 namespace tcvm
@@ -141,6 +143,80 @@ auto createFibonacciProgram(int64_t const argument) -> tcc::BinaryProgram
     };
 }
 
+auto createInputFibonacciProgram() -> tcc::BinaryProgram
+{
+    return tcc::BinaryProgram {
+        1,                  // version
+        "input fibonacci",  // name
+        28,                 // entryPoint
+        std::vector<int64_t> {
+            // .def fib: args=1, locals=0
+            ByteCode::LOAD, -3,    // 0
+            ByteCode::ICONST, 2,   // 2
+            ByteCode::ILT,         // 4
+            ByteCode::BRF, 10,     // 5
+            ByteCode::LOAD, -3,    // 7
+            ByteCode::RET,         // 9
+            ByteCode::LOAD, -3,    // 10
+            ByteCode::ICONST, 1,   // 12
+            ByteCode::ISUB,        // 14
+            ByteCode::CALL, 0, 1,  // 15
+            ByteCode::LOAD, -3,    // 18
+            ByteCode::ICONST, 2,   // 20
+            ByteCode::ISUB,        // 22
+            ByteCode::CALL, 0, 1,  // 23
+            ByteCode::IADD,        // 26
+            ByteCode::RET,         // 27
+
+            // .def main: args=0, locals=0
+            // return fib(g0);
+            ByteCode::GLOAD, 0,    // 28 <-- MAIN
+            ByteCode::CALL, 0, 1,  // 30
+            ByteCode::EXIT,        // 33
+        }                          //
+    };
+}
+
+auto createWarmStartProgram(int64_t const arg) -> tcc::BinaryProgram
+{
+    return tcc::BinaryProgram {
+        1,             // version
+        "warm start",  // name
+        28,            // entryPoint
+        std::vector<int64_t> {
+            // .def fib: args=1, locals=0
+            ByteCode::LOAD, -3,    // 0
+            ByteCode::ICONST, 2,   // 2
+            ByteCode::ILT,         // 4
+            ByteCode::BRF, 10,     // 5
+            ByteCode::LOAD, -3,    // 7
+            ByteCode::RET,         // 9
+            ByteCode::LOAD, -3,    // 10
+            ByteCode::ICONST, 1,   // 12
+            ByteCode::ISUB,        // 14
+            ByteCode::CALL, 0, 1,  // 15
+            ByteCode::LOAD, -3,    // 18
+            ByteCode::ICONST, 2,   // 20
+            ByteCode::ISUB,        // 22
+            ByteCode::CALL, 0, 1,  // 23
+            ByteCode::IADD,        // 26
+            ByteCode::RET,         // 27
+
+            // initialization: g0 = fib(arg);
+            ByteCode::ICONST, arg,  // 28 <-- MAIN
+            ByteCode::CALL, 0, 1,   // 30
+            ByteCode::GSTORE, 0,    // 33
+            ByteCode::HALT,         // 35
+
+            // request: return g0 + g1;
+            ByteCode::GLOAD, 0,  // 36
+            ByteCode::GLOAD, 1,  // 38
+            ByteCode::IADD,      // 40
+            ByteCode::EXIT,      // 41
+        }                        //
+    };
+}
+
 auto createMultipleArgumentsProgram(int64_t const firstArg, int64_t const secondArg) -> tcc::BinaryProgram
 {
     return tcc::BinaryProgram {
@@ -201,4 +277,117 @@ auto createMultipleFunctionsProgram(int64_t const argument) -> tcc::BinaryProgra
         }                                //
     };
 }
-}  // namespace tcvm
\ No newline at end of file
+
+auto createParallelFibonacciProgram(int64_t const argument, int64_t const cutoff) -> tcc::BinaryProgram
+{
+    auto const threshold = std::max(cutoff, int64_t {2});  // pfib(x - 2) has to stay positive
+    return tcc::BinaryProgram {
+        1,                     // version
+        "parallel fibonacci",  // name
+        62,                    // entryPoint
+        std::vector<int64_t> {
+            // .def fib: args=1, locals=0
+            // if (x < 2) return x;
+            ByteCode::LOAD, -3,   // 0
+            ByteCode::ICONST, 2,  // 2
+            ByteCode::ILT,        // 4
+            ByteCode::BRF, 10,    // 5
+            ByteCode::LOAD, -3,   // 7
+            ByteCode::RET,        // 9
+
+            // return fib(x - 1) + fib(x - 2)
+            ByteCode::LOAD, -3,    // 10
+            ByteCode::ICONST, 1,   // 12
+            ByteCode::ISUB,        // 14
+            ByteCode::CALL, 0, 1,  // 15 <-- fib(x-1)
+            ByteCode::LOAD, -3,    // 18
+            ByteCode::ICONST, 2,   // 20
+            ByteCode::ISUB,        // 22
+            ByteCode::CALL, 0, 1,  // 23 <-- fib(x-2)
+            ByteCode::IADD,        // 26
+            ByteCode::RET,         // 27
+
+            // .def pfib: args=1, locals=0
+            // if (x < cutoff) return fib(x);
+            ByteCode::LOAD, -3,           // 28
+            ByteCode::ICONST, threshold,  // 30
+            ByteCode::ILT,                // 32
+            ByteCode::BRF, 41,            // 33
+            ByteCode::LOAD, -3,           // 35
+            ByteCode::CALL, 0, 1,         // 37 <-- fib(x)
+            ByteCode::RET,                // 40
+
+            // h = spawn(pfib(x - 1));
+            // return pfib(x - 2) + join(h);
+            ByteCode::LOAD, -3,      // 41
+            ByteCode::ICONST, 1,     // 43
+            ByteCode::ISUB,          // 45
+            ByteCode::SPAWN, 28, 1,  // 46 <-- h
+            ByteCode::LOAD, -3,      // 49
+            ByteCode::ICONST, 2,     // 51
+            ByteCode::ISUB,          // 53
+            ByteCode::CALL, 28, 1,   // 54 <-- pfib(x-2)
+            ByteCode::LOAD, 1,       // 57 <-- h
+            ByteCode::JOIN,          // 59
+            ByteCode::IADD,          // 60
+            ByteCode::RET,           // 61
+
+            // .def main: args=0, locals=0
+            // return pfib(argument);
+            ByteCode::ICONST, argument,  // 62 <-- MAIN
+            ByteCode::CALL, 28, 1,       // 64 <-- pfib(argument)
+            ByteCode::EXIT,              // 67
+        }                                //
+    };
+}
+
+auto createEvenOddProgram(int64_t const arg, bool const tailCalls) -> tcc::BinaryProgram
+{
+    auto const call = tailCalls ? ByteCode::TAILCALL : ByteCode::CALL;
+    return tcc::BinaryProgram {
+        1,           // version
+        "even odd",  // name
+        38,          // entryPoint
+        std::vector<int64_t> {
+            // .def even: args=1, locals=0
+            // if (x < 1) return 1;
+            ByteCode::LOAD, -3,   // 0
+            ByteCode::ICONST, 1,  // 2
+            ByteCode::ILT,        // 4
+            ByteCode::BRF, 10,    // 5
+            ByteCode::ICONST, 1,  // 7
+            ByteCode::RET,        // 9
+
+            // return odd(x - 1);
+            ByteCode::LOAD, -3,   // 10
+            ByteCode::ICONST, 1,  // 12
+            ByteCode::ISUB,       // 14
+            call, 19, 1,          // 15 <-- odd(x-1)
+            ByteCode::RET,        // 18
+
+            // .def odd: args=1, locals=0
+            // if (x < 1) return 0;
+            ByteCode::LOAD, -3,   // 19
+            ByteCode::ICONST, 1,  // 21
+            ByteCode::ILT,        // 23
+            ByteCode::BRF, 29,    // 24
+            ByteCode::ICONST, 0,  // 26
+            ByteCode::RET,        // 28
+
+            // return even(x - 1);
+            ByteCode::LOAD, -3,   // 29
+            ByteCode::ICONST, 1,  // 31
+            ByteCode::ISUB,       // 33
+            call, 0, 1,           // 34 <-- even(x-1)
+            ByteCode::RET,        // 37
+
+            // .def main: args=0, locals=0
+            // return even(arg);
+            ByteCode::ICONST, arg,  // 38 <-- MAIN
+            ByteCode::CALL, 0, 1,   // 40 <-- even(arg)
+            ByteCode::EXIT,         // 43
+        },                          //
+        tcc::SymbolTable {{0, "even"}, {19, "odd"}, {38, "main"}},
+    };
+}
+}  // namespace tcvm
@@ -15,7 +15,30 @@ auto createCompiledProgram() -> tcc::BinaryProgram;
 auto createAdditionProgram(int64_t arg) -> tcc::BinaryProgram;
 auto createFactorialProgram(int64_t argument) -> tcc::BinaryProgram;
 auto createFibonacciProgram(int64_t arg) -> tcc::BinaryProgram;
+
+/**
+ * @brief Fibonacci of g0, e.g. the input of a VmJob or a BatchMachine lane.
+ */
+auto createInputFibonacciProgram() -> tcc::BinaryProgram;
 auto createMultipleArgumentsProgram(int64_t firstArg, int64_t secondArg) -> tcc::BinaryProgram;
 auto createMultipleFunctionsProgram(int64_t arg) -> tcc::BinaryProgram;
 
+/**
+ * @brief Fibonacci that spawns fib(x - 1) as a task down to cutoff & recurses
+ * with plain calls below.
+ */
+auto createParallelFibonacciProgram(int64_t arg, int64_t cutoff) -> tcc::BinaryProgram;
+
+/**
+ * @brief Mutually recursive even & odd, returns 1 if arg is even. With
+ * tailCalls the recursion uses TAILCALL and runs in a single frame.
+ */
+auto createEvenOddProgram(int64_t arg, bool tailCalls) -> tcc::BinaryProgram;
+
+/**
+ * @brief Stores fib(arg) in g0 & halts, running it again returns g0 + g1. Used
+ * to fork request handlers from a snapshot taken after the halt.
+ */
+auto createWarmStartProgram(int64_t arg) -> tcc::BinaryProgram;
+
 }  // namespace tcvm
\ No newline at end of file
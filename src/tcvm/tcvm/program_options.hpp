@@ -28,6 +28,23 @@ struct ProgramOptions
             options("help,h", "produce this help message");
             options("input,i", po::value<std::int64_t>(), "input argument");
             options("file,f", po::value<std::string>(), "binary file path");
+            options("fuse", "rewrite the program with superinstructions before running it");
+            options("check", "validate every instruction before executing it");
+            options("engine,e", po::value<std::string>()->default_value("switch"),
+                    "switch, threaded, register, jit, tracing-jit or compact");
+            options("trace", "print every instruction with the stack & globals while running");
+            options("threads,t", po::value<std::size_t>(), "run SPAWN & JOIN as tasks on this many worker threads");
+            options("gas", po::value<std::int64_t>(), "stop the program after this many instructions");
+            options("output,o", po::value<std::string>(), "write the values of PRINT to this file instead of stdout");
+            options("stats", "print the number of executed instructions, calls & the maximum stack depth");
+#if defined(TCC_VM_HISTOGRAM)
+            options("histogram", po::value<std::string>(),
+                    "count opcodes, opcode pairs, call sites & branches, write them as json to this file");
+#endif
+            options("perf", "count cycles, instructions, branch & cache misses per bytecode instruction, runs metered");
+            options("profile", po::value<std::string>(), "sample the call stack, write folded stacks to this file");
+            options("corpus,c", po::value<std::vector<std::string>>()->multitoken(),
+                    "binary files to count opcode sequences over, prints superinstruction candidates");
             options("version,v", "print version string");
 
             po::store(po::parse_command_line(argc, argv, desc), outputVariableMap);
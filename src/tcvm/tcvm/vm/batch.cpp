@@ -0,0 +1,595 @@
+/**
+ * @file batch.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/batch.hpp"
+#include "tcvm/vm/verifier.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TCC_VM_HAS_AVX2 1
+#define TCC_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+namespace tcc
+{
+namespace
+{
+// wraps around like the cpu, inactive lanes may hold any value
+constexpr auto add(int64_t a, int64_t b) noexcept -> int64_t
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+constexpr auto sub(int64_t a, int64_t b) noexcept -> int64_t
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+constexpr auto mul(int64_t a, int64_t b) noexcept -> int64_t
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+}
+
+template <typename Op>
+auto binaryPortable(int64_t const* a, int64_t const* b, int64_t* result, int64_t const* mask, std::size_t size,
+                    Op op) noexcept -> void
+{
+    for (auto i = std::size_t {0}; i < size; ++i)
+    { result[i] = (op(a[i], b[i]) & mask[i]) | (result[i] & ~mask[i]); }
+}
+
+#if defined(TCC_VM_HAS_AVX2)
+
+struct AddAvx2
+{
+    TCC_AVX2_TARGET static auto apply(__m256i a, __m256i b) noexcept -> __m256i { return _mm256_add_epi64(a, b); }
+};
+
+struct SubAvx2
+{
+    TCC_AVX2_TARGET static auto apply(__m256i a, __m256i b) noexcept -> __m256i { return _mm256_sub_epi64(a, b); }
+};
+
+// AVX2 has no 64 bit multiply, the low half is lo*lo + (lo*hi + hi*lo) << 32
+struct MulAvx2
+{
+    TCC_AVX2_TARGET static auto apply(__m256i a, __m256i b) noexcept -> __m256i
+    {
+        auto const low   = _mm256_mul_epu32(a, b);
+        auto const cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                            _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+        return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+    }
+};
+
+struct LessAvx2
+{
+    TCC_AVX2_TARGET static auto apply(__m256i a, __m256i b) noexcept -> __m256i
+    {
+        return _mm256_and_si256(_mm256_cmpgt_epi64(b, a), _mm256_set1_epi64x(1));
+    }
+};
+
+struct EqualAvx2
+{
+    TCC_AVX2_TARGET static auto apply(__m256i a, __m256i b) noexcept -> __m256i
+    {
+        return _mm256_and_si256(_mm256_cmpeq_epi64(a, b), _mm256_set1_epi64x(1));
+    }
+};
+
+// size is a multiple of BatchMachine::VectorLanes
+template <typename Op>
+TCC_AVX2_TARGET auto binaryAvx2(int64_t const* a, int64_t const* b, int64_t* result, int64_t const* mask,
+                                std::size_t size) noexcept -> void
+{
+    for (auto i = std::size_t {0}; i < size; i += BatchMachine::VectorLanes)
+    {
+        auto const va  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+        auto const vb  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+        auto const vm  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(mask + i));
+        auto const old = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(result + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), _mm256_blendv_epi8(old, Op::apply(va, vb), vm));
+    }
+}
+
+TCC_AVX2_TARGET auto selectAvx2(int64_t* destination, int64_t const* source, int64_t const* mask,
+                                std::size_t size) noexcept -> void
+{
+    for (auto i = std::size_t {0}; i < size; i += BatchMachine::VectorLanes)
+    {
+        auto const vs  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(source + i));
+        auto const vm  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(mask + i));
+        auto const old = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(destination + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_blendv_epi8(old, vs, vm));
+    }
+}
+
+auto const hasAvx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+#else
+
+constexpr auto hasAvx2 = false;
+
+#endif
+}  // namespace
+
+BatchMachine::BatchMachine(BinaryProgram const& program, BatchOptions options, std::ostream& out)
+    : code_ {program.data}
+    , entryPoint_ {program.entryPoint}
+    , width_ {(std::max(options.width, std::size_t {1}) + VectorLanes - 1) / VectorLanes * VectorLanes}
+    , stackSize_ {static_cast<int64_t>(options.stackSize)}
+    , streamSink_ {out}
+{
+    // verified once, so the lanes run unchecked & can't fall off the end
+    auto const verified = verify(program);
+    auto const globals  = verified.ok() ? static_cast<std::size_t>(verified.globals) : std::size_t {0};
+    error_              = verified.error;
+    nativesUsed_        = verified.natives;
+    dataSize_           = std::max({static_cast<std::size_t>(options.dataSize), globals, std::size_t {1}});
+    code_.push_back(ByteCode::HALT);
+
+    // groups are formed again at the start of every block, so lanes can join
+    leaders_.assign(code_.size() + 1, 0);
+    if (entryPoint_ >= 0 && static_cast<std::size_t>(entryPoint_) < leaders_.size())
+    { leaders_[static_cast<std::size_t>(entryPoint_)] = 1; }
+
+    auto address = std::size_t {0};
+    while (address < code_.size())
+    {
+        auto const opcode = code_[address];
+        if (opcode < 0 || opcode >= ByteCode::NUM_OPCODES) { break; }
+
+        auto const& instruction = Instructions[static_cast<std::size_t>(opcode)];
+        auto const length       = std::size_t {1} + static_cast<std::size_t>(instruction.numberOfOperands);
+        if (auto const target = targetOperandIndex(opcode); target >= 0 && address + length <= code_.size())
+        {
+            auto const destination = code_[address + 1 + static_cast<std::size_t>(target)];
+            if (destination >= 0 && static_cast<std::size_t>(destination) < leaders_.size())
+            { leaders_[static_cast<std::size_t>(destination)] = 1; }
+        }
+
+        address += length;
+        if (endsBasicBlock(opcode) && address < leaders_.size()) { leaders_[address] = 1; }
+    }
+
+    instructionPointers_.resize(width_);
+    stackPointers_.resize(width_);
+    framePointers_.resize(width_);
+    finished_.resize(width_);
+    exitCodes_.resize(width_);
+
+    stack_.resize(static_cast<std::size_t>(stackSize_) * width_);
+    data_.resize(dataSize_ * width_);
+    mask_.resize(width_);
+    constant_.resize(width_);
+}
+
+auto BatchMachine::usesAvx2() noexcept -> bool { return hasAvx2; }
+
+auto BatchMachine::setOutput(OutputSink* const sink) -> void
+{
+    output_->flush();
+    output_ = sink != nullptr ? sink : &streamSink_;
+}
+
+auto BatchMachine::run(std::span<int64_t const> const inputs) -> std::vector<int64_t>
+{
+    auto exitCodes = std::vector<int64_t>(inputs.size(), -1);
+    if (!error_.empty() || static_cast<std::size_t>(nativesUsed_) > natives_.size()) { return exitCodes; }
+
+    for (auto first = std::size_t {0}; first < inputs.size(); first += width_)
+    {
+        auto const count = std::min(width_, inputs.size() - first);
+        runBatch(inputs.subspan(first, count), std::span {exitCodes}.subspan(first, count));
+    }
+    output_->flush();
+    return exitCodes;
+}
+
+auto BatchMachine::runBatch(std::span<int64_t const> const inputs, std::span<int64_t> const exitCodes) -> void
+{
+    std::fill(data_.begin(), data_.end(), 0);
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        instructionPointers_[lane] = entryPoint_;
+        stackPointers_[lane]       = -1;
+        framePointers_[lane]       = 0;
+        finished_[lane]            = lane < inputs.size() ? 0 : 1;
+        exitCodes_[lane]           = 0;
+        if (lane < inputs.size()) { global(0)[lane] = inputs[lane]; }
+    }
+    live_ = static_cast<int64_t>(inputs.size());
+
+    while (selectGroup()) { executeGroup(); }
+    std::copy_n(exitCodes_.begin(), exitCodes.size(), exitCodes.begin());
+}
+
+/**
+ * @brief The lane with the deepest frame & the lowest address leads, every
+ * lane at the same address with the same frame & stack joins it.
+ */
+auto BatchMachine::selectGroup() -> bool
+{
+    auto leader = width_;
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        if (finished_[lane] != 0) { continue; }
+        if (leader == width_ || framePointers_[lane] > framePointers_[leader]
+            || (framePointers_[lane] == framePointers_[leader]
+                && instructionPointers_[lane] < instructionPointers_[leader]))
+        { leader = lane; }
+    }
+    if (leader == width_) { return false; }
+
+    group_  = Group {instructionPointers_[leader], stackPointers_[leader], framePointers_[leader]};
+    active_ = 0;
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        auto const joins = finished_[lane] == 0 && instructionPointers_[lane] == group_.instructionPointer
+                           && framePointers_[lane] == group_.framePointer
+                           && stackPointers_[lane] == group_.stackPointer;
+        mask_[lane] = joins ? -1 : 0;
+        active_ += joins ? 1 : 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs the group until control flow or the start of the next block.
+ */
+auto BatchMachine::executeGroup() -> void
+{
+    auto& group = group_;
+    while (true)
+    {
+        // a CALL pushes three values, the largest push of any instruction
+        if (group.stackPointer + 3 >= stackSize_)
+        {
+            finishGroup(true);
+            return;
+        }
+
+        auto const address = group.instructionPointer;
+        auto const opcode  = code_[static_cast<std::size_t>(address)];
+        auto const operand = [this, address](int64_t const index) {
+            return code_[static_cast<std::size_t>(address + 1 + index)];
+        };
+
+        ++stats_.instructions;
+        stats_.laneInstructions += active_;
+        if (opcode < 0 || opcode >= ByteCode::NUM_OPCODES)
+        {
+            finishGroup(false);
+            return;
+        }
+        group.instructionPointer += 1 + Instructions[static_cast<std::size_t>(opcode)].numberOfOperands;
+
+        switch (opcode)
+        {
+            case ByteCode::IADD:
+            case ByteCode::ISUB:
+            case ByteCode::IMUL:
+            case ByteCode::ILT:
+            case ByteCode::IEQ:
+            {
+                binary(opcode, row(group.stackPointer - 1), row(group.stackPointer), row(group.stackPointer - 1));
+                --group.stackPointer;
+                break;
+            }
+
+            case ByteCode::ICONST: push(broadcast(operand(0))); break;
+            case ByteCode::LOAD: push(row(group.framePointer + operand(0))); break;
+            case ByteCode::GLOAD: push(global(operand(0))); break;
+
+            case ByteCode::STORE:
+            {
+                select(row(group.framePointer + operand(0)), row(group.stackPointer));
+                --group.stackPointer;
+                break;
+            }
+
+            case ByteCode::GSTORE:
+            {
+                select(global(operand(0)), row(group.stackPointer));
+                --group.stackPointer;
+                break;
+            }
+
+            case ByteCode::PRINT:
+            {
+                auto const* values = row(group.stackPointer);
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] != 0) { output_->print(values[lane]); }
+                }
+                --group.stackPointer;
+                break;
+            }
+
+            case ByteCode::POP: --group.stackPointer; break;
+            case ByteCode::NOOP:
+            case ByteCode::JOIN: break;
+            case ByteCode::BR: group.instructionPointer = operand(0); break;
+
+            // without a scheduler a task runs to completion right away like in
+            // the VirtualMachine, numArgs, fp & the return address are the same
+            // for every lane of the group
+            case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            {
+                push(broadcast(operand(1)));
+                push(broadcast(group.framePointer));
+                push(broadcast(group.instructionPointer));
+                group.framePointer       = group.stackPointer;
+                group.instructionPointer = operand(0);
+                break;
+            }
+
+            // host functions take contiguous arguments, they are gathered per lane
+            case ByteCode::CALLNATIVE:
+            {
+                auto const function = natives_[static_cast<std::size_t>(operand(0))];
+                auto const numArgs  = operand(1);
+                auto const first    = group.stackPointer - numArgs + 1;
+                arguments_.resize(static_cast<std::size_t>(numArgs));
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] == 0) { continue; }
+                    for (auto i = int64_t {0}; i < numArgs; ++i)
+                    { arguments_[static_cast<std::size_t>(i)] = row(first + i)[lane]; }
+                    row(first)[lane] = function(arguments_.data());
+                }
+                group.stackPointer = first;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_IADD:
+            case ByteCode::LOAD_ICONST_ISUB:
+            case ByteCode::LOAD_ICONST_ILT:
+            {
+                auto const op = opcode == ByteCode::LOAD_ICONST_IADD   ? ByteCode::IADD
+                                : opcode == ByteCode::LOAD_ICONST_ISUB ? ByteCode::ISUB
+                                                                       : ByteCode::ILT;
+                binary(op, row(group.framePointer + operand(0)), broadcast(operand(1)), row(group.stackPointer + 1));
+                ++group.stackPointer;
+                break;
+            }
+
+            case ByteCode::LOAD_LOAD_IADD:
+            {
+                binary(ByteCode::IADD, row(group.framePointer + operand(0)), row(group.framePointer + operand(1)),
+                       row(group.stackPointer + 1));
+                ++group.stackPointer;
+                break;
+            }
+
+            // the lanes diverge unless all of them take the same way
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            case ByteCode::ILT_BRF:
+            {
+                auto const fused        = opcode == ByteCode::ILT_BRF;
+                auto const* top         = row(group.stackPointer);
+                auto const* second      = row(group.stackPointer - 1);
+                auto const stackPointer = group.stackPointer - (fused ? 2 : 1);
+                auto const target       = operand(0);
+                auto const taken        = [=](std::size_t lane) {
+                    return fused ? !(second[lane] < top[lane]) : (top[lane] != 0) == (opcode == ByteCode::BRT);
+                };
+
+                auto jumps = int64_t {0};
+                for (auto lane = std::size_t {0}; lane < width_; ++lane) { jumps += mask_[lane] != 0 && taken(lane); }
+
+                group.stackPointer = stackPointer;
+                if (jumps == active_ || jumps == 0)
+                {
+                    group.instructionPointer = jumps != 0 ? target : group.instructionPointer;
+                    break;
+                }
+
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] == 0) { continue; }
+                    instructionPointers_[lane] = taken(lane) ? target : group.instructionPointer;
+                    stackPointers_[lane]       = stackPointer;
+                    framePointers_[lane]       = group.framePointer;
+                }
+                return;
+            }
+
+            case ByteCode::RET:
+            {
+                auto const framePointer = group.framePointer;
+                auto const* values      = row(group.stackPointer);
+                auto const* addresses   = row(framePointer);
+                auto const* savedFps    = row(framePointer - 1);
+                auto const* numArgs     = row(framePointer - 2);
+                if (auto const uniform = uniformRet(addresses, savedFps, numArgs); uniform >= 0)
+                {
+                    auto const lane          = static_cast<std::size_t>(uniform);
+                    group.instructionPointer = addresses[lane];
+                    group.stackPointer       = framePointer - 2 - numArgs[lane];
+                    group.framePointer       = savedFps[lane];
+                    select(row(group.stackPointer), values);
+                    break;
+                }
+
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] == 0) { continue; }
+                    auto const returnValue     = values[lane];
+                    auto const stackPointer    = framePointer - 2 - numArgs[lane];
+                    instructionPointers_[lane] = addresses[lane];
+                    framePointers_[lane]       = savedFps[lane];
+                    stackPointers_[lane]       = stackPointer;
+                    row(stackPointer)[lane]    = returnValue;
+                }
+                return;
+            }
+
+            case ByteCode::TAILCALL:
+            {
+                auto const framePointer = group.framePointer;
+                auto const numArgs      = operand(1);
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] == 0) { continue; }
+                    auto const returnAddress = row(framePointer)[lane];
+                    auto const savedFp       = row(framePointer - 1)[lane];
+                    auto const first         = framePointer - 2 - row(framePointer - 2)[lane];
+                    for (auto i = int64_t {0}; i < numArgs; ++i)
+                    { row(first + i)[lane] = row(group.stackPointer - numArgs + 1 + i)[lane]; }
+                    row(first + numArgs)[lane]     = numArgs;
+                    row(first + numArgs + 1)[lane] = savedFp;
+                    row(first + numArgs + 2)[lane] = returnAddress;
+                    instructionPointers_[lane]     = operand(0);
+                    stackPointers_[lane]           = first + numArgs + 2;
+                    framePointers_[lane]           = first + numArgs + 2;
+                }
+                return;
+            }
+
+            case ByteCode::EXIT:
+            {
+                auto const* values = row(group.stackPointer);
+                for (auto lane = std::size_t {0}; lane < width_; ++lane)
+                {
+                    if (mask_[lane] == 0) { continue; }
+                    finished_[lane]  = 1;
+                    exitCodes_[lane] = values[lane];
+                }
+                live_ -= active_;
+                return;
+            }
+
+            default: finishGroup(false); return;  // HALT
+        }
+
+        // no other lane can join if the group holds all of them
+        if (active_ != live_ && leaders_[static_cast<std::size_t>(group.instructionPointer)] != 0)
+        {
+            commitGroup();
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Returns a lane of the group if all of them return to the same
+ * address & frame, -1 otherwise.
+ */
+auto BatchMachine::uniformRet(int64_t const* addresses, int64_t const* savedFps, int64_t const* numArgs) const
+    -> int64_t
+{
+    auto first = int64_t {-1};
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        if (mask_[lane] == 0) { continue; }
+        if (first == -1)
+        {
+            first = static_cast<int64_t>(lane);
+            continue;
+        }
+
+        auto const f = static_cast<std::size_t>(first);
+        if (addresses[lane] != addresses[f] || savedFps[lane] != savedFps[f] || numArgs[lane] != numArgs[f])
+        { return -1; }
+    }
+    return first;
+}
+
+auto BatchMachine::commitGroup() -> void
+{
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        if (mask_[lane] == 0) { continue; }
+        instructionPointers_[lane] = group_.instructionPointer;
+        stackPointers_[lane]       = group_.stackPointer;
+        framePointers_[lane]       = group_.framePointer;
+    }
+}
+
+auto BatchMachine::finishGroup(bool const overflow) -> void
+{
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    {
+        if (mask_[lane] == 0) { continue; }
+        finished_[lane]  = 1;
+        exitCodes_[lane] = -1;
+    }
+    live_ -= active_;
+    if (overflow) { stats_.stackOverflows += active_; }
+}
+
+auto BatchMachine::binary(int64_t const opcode, int64_t const* a, int64_t const* b, int64_t* result) -> void
+{
+    auto const* mask = mask_.data();
+
+#if defined(TCC_VM_HAS_AVX2)
+    if (hasAvx2)
+    {
+        switch (opcode)
+        {
+            case ByteCode::IADD: binaryAvx2<AddAvx2>(a, b, result, mask, width_); return;
+            case ByteCode::ISUB: binaryAvx2<SubAvx2>(a, b, result, mask, width_); return;
+            case ByteCode::IMUL: binaryAvx2<MulAvx2>(a, b, result, mask, width_); return;
+            case ByteCode::ILT: binaryAvx2<LessAvx2>(a, b, result, mask, width_); return;
+            default: binaryAvx2<EqualAvx2>(a, b, result, mask, width_); return;
+        }
+    }
+#endif
+
+    switch (opcode)
+    {
+        case ByteCode::IADD: binaryPortable(a, b, result, mask, width_, add); return;
+        case ByteCode::ISUB: binaryPortable(a, b, result, mask, width_, sub); return;
+        case ByteCode::IMUL: binaryPortable(a, b, result, mask, width_, mul); return;
+        case ByteCode::ILT:
+            binaryPortable(a, b, result, mask, width_, [](int64_t x, int64_t y) { return int64_t {x < y}; });
+            return;
+        default:
+            binaryPortable(a, b, result, mask, width_, [](int64_t x, int64_t y) { return int64_t {x == y}; });
+            return;
+    }
+}
+
+auto BatchMachine::select(int64_t* destination, int64_t const* source) -> void
+{
+    if (destination == source) { return; }
+
+#if defined(TCC_VM_HAS_AVX2)
+    if (hasAvx2)
+    {
+        selectAvx2(destination, source, mask_.data(), width_);
+        return;
+    }
+#endif
+
+    for (auto lane = std::size_t {0}; lane < width_; ++lane)
+    { destination[lane] = (source[lane] & mask_[lane]) | (destination[lane] & ~mask_[lane]); }
+}
+
+auto BatchMachine::push(int64_t const* values) -> void
+{
+    select(row(group_.stackPointer + 1), values);
+    ++group_.stackPointer;
+}
+
+auto BatchMachine::broadcast(int64_t const value) -> int64_t const*
+{
+    // consecutive constants are often equal, e.g. the 1 of a loop counter
+    if (value != constantValue_)
+    {
+        std::fill(constant_.begin(), constant_.end(), value);
+        constantValue_ = value;
+    }
+    return constant_.data();
+}
+
+}  // namespace tcc
@@ -0,0 +1,165 @@
+/**
+ * @file batch.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/natives.hpp"
+#include "tcvm/vm/output_sink.hpp"
+
+namespace tcc
+{
+struct BatchOptions
+{
+    std::size_t width {64};  // lanes run in lockstep, rounded up to a multiple of BatchMachine::VectorLanes
+    uint64_t stackSize {200};
+    uint64_t dataSize {1};  // globals per lane, grows to the input & the globals the program uses
+};
+
+struct BatchStats
+{
+    int64_t instructions {0};      // executed for a group of lanes, one per step
+    int64_t laneInstructions {0};  // executed per lane, the sum over all groups
+    int64_t stackOverflows {0};    // lanes stopped because their stack was full
+};
+
+/**
+ * @brief Runs one program over many inputs, width instances at a time, as the
+ * lanes of a vector.
+ *
+ * Stacks & globals are stored as structure of arrays, slot i of every lane is
+ * one contiguous row, so an instruction executed by many lanes is a single
+ * pass over a row. IADD, ISUB, IMUL, ILT & IEQ use AVX2 kernels if the cpu
+ * supports them, a portable loop otherwise.
+ *
+ * Lanes that execute the same instruction in the same frame form a group,
+ * an execution mask keeps the other lanes untouched. Branches, returns &
+ * exits are resolved per lane, as long as all lanes of the group go the same
+ * way it keeps running. Otherwise the lanes diverge and the deepest frame
+ * runs first, then the lowest address, so lanes that took different branches
+ * meet again at the start of the block where their paths join and continue
+ * as one group.
+ *
+ * The constructor verifies the program, after that nothing is checked except
+ * the stack size, a lane whose stack is full stops with exit code -1. If the
+ * program was rejected or calls natives that were not set, every lane exits
+ * with -1 right away. PRINT writes the values of all lanes of the group in
+ * lane order.
+ */
+class BatchMachine
+{
+public:
+    static constexpr auto VectorLanes = std::size_t {4};  // int64_t per 256 bit register
+
+    explicit BatchMachine(BinaryProgram const& program, BatchOptions options = {}, std::ostream& out = std::cout);
+
+    /**
+     * @brief Runs the program once per input, the input is stored in global
+     * 0 of its lane. Returns the exit codes in the order of the inputs.
+     */
+    auto run(std::span<int64_t const> inputs) -> std::vector<int64_t>;
+
+    [[nodiscard]] auto width() const noexcept -> std::size_t { return width_; }
+
+    /**
+     * @brief The verifier error, empty if the program runs.
+     */
+    [[nodiscard]] auto error() const noexcept -> std::string_view { return error_; }
+
+    /**
+     * @brief PRINT writes to sink instead of the stream passed to the
+     * constructor, nullptr switches back to the stream. The sink is flushed
+     * whenever run() returns & must outlive the machine or the next
+     * setOutput().
+     */
+    auto setOutput(OutputSink* sink) -> void;
+
+    /**
+     * @brief Host functions CALLNATIVE indexes into, see resolveNatives().
+     * They are called once per lane of the group, in lane order.
+     */
+    auto setNatives(std::vector<NativeFunction> natives) -> void { natives_ = std::move(natives); }
+
+    /**
+     * @brief Counters of all runs since construction.
+     */
+    [[nodiscard]] auto stats() const noexcept -> BatchStats const& { return stats_; }
+
+    /**
+     * @brief True if the kernels run on AVX2.
+     */
+    [[nodiscard]] static auto usesAvx2() noexcept -> bool;
+
+private:
+    struct Group
+    {
+        int64_t instructionPointer {0};
+        int64_t stackPointer {-1};
+        int64_t framePointer {0};
+    };
+
+    auto runBatch(std::span<int64_t const> inputs, std::span<int64_t> exitCodes) -> void;
+    auto selectGroup() -> bool;
+    auto executeGroup() -> void;
+    auto commitGroup() -> void;
+    auto finishGroup(bool overflow) -> void;
+    [[nodiscard]] auto uniformRet(int64_t const* addresses, int64_t const* savedFps, int64_t const* numArgs) const
+        -> int64_t;
+    auto binary(int64_t opcode, int64_t const* a, int64_t const* b, int64_t* result) -> void;
+    auto select(int64_t* destination, int64_t const* source) -> void;
+    auto push(int64_t const* values) -> void;
+    auto broadcast(int64_t value) -> int64_t const*;
+
+    [[nodiscard]] auto row(int64_t const slot) noexcept -> int64_t*
+    {
+        return stack_.data() + static_cast<std::size_t>(slot) * width_;
+    }
+
+    [[nodiscard]] auto global(int64_t const address) noexcept -> int64_t*
+    {
+        return data_.data() + static_cast<std::size_t>(address) * width_;
+    }
+
+    std::vector<int64_t> code_;
+    int64_t entryPoint_ {0};
+    std::size_t width_ {0};
+    int64_t stackSize_ {0};
+    std::size_t dataSize_ {0};
+    std::string_view error_ {};  // of verify()
+    int64_t nativesUsed_ {0};
+    StreamSink streamSink_;  // PRINT to the stream without a sink
+    OutputSink* output_ {&streamSink_};
+    std::vector<NativeFunction> natives_ {};
+    std::vector<int64_t> arguments_ {};  // of CALLNATIVE in one lane
+    std::vector<char> leaders_ {};  // per address, first instruction of a basic block
+
+    // per lane
+    std::vector<int64_t> instructionPointers_ {};
+    std::vector<int64_t> stackPointers_ {};
+    std::vector<int64_t> framePointers_ {};
+    std::vector<char> finished_ {};
+    std::vector<int64_t> exitCodes_ {};
+
+    // rows of width_ values
+    std::vector<int64_t> stack_ {};
+    std::vector<int64_t> data_ {};
+    std::vector<int64_t> mask_ {};      // -1 for lanes of the current group, 0 otherwise
+    std::vector<int64_t> constant_ {};  // operand of ICONST & fused instructions in every lane
+    int64_t constantValue_ {0};
+
+    Group group_ {};
+    int64_t active_ {0};  // lanes in the group
+    int64_t live_ {0};    // lanes not finished yet
+    BatchStats stats_ {};
+};
+
+}  // namespace tcc
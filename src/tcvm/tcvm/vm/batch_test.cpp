@@ -0,0 +1,215 @@
+/**
+ * @file batch_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/batch.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/verifier.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <numeric>
+#include <sstream>
+
+using tcc::ByteCode;
+
+namespace
+{
+// exit codes & the number of executed instructions of one scalar run per input
+auto runScalar(tcc::BinaryProgram const& program, std::vector<int64_t> const& inputs, uint64_t dataSize = 1)
+    -> std::pair<std::vector<int64_t>, int64_t>
+{
+    auto exitCodes    = std::vector<int64_t> {};
+    auto instructions = int64_t {0};
+    for (auto const input : inputs)
+    {
+        auto vm = tcc::VirtualMachine(program.data, program.entryPoint, dataSize, 200, false);
+        vm.enableStatistics(true);
+        vm.globals()[0] = input;
+        exitCodes.push_back(vm.cpu());
+        instructions += vm.stats().instructions;
+    }
+    return {exitCodes, instructions};
+}
+
+// sum of i * i while i * i < g0, minus one for every other i < g0
+auto const squares = tcc::BinaryProgram {
+    1, "squares", 0,
+    std::vector<int64_t> {
+        // .def main: args=0, locals=2
+        ByteCode::ICONST, 0,  // 0 i
+        ByteCode::ICONST, 0,  // 2 sum
+
+        // while (i < g0)
+        ByteCode::LOAD, 0,   // 4 <-- loop header
+        ByteCode::GLOAD, 0,  // 6
+        ByteCode::ILT,       // 8
+        ByteCode::BRF, 50,   // 9
+
+        // g1 = i * i
+        ByteCode::LOAD, 0,    // 11
+        ByteCode::LOAD, 0,    // 13
+        ByteCode::IMUL,       // 15
+        ByteCode::GSTORE, 1,  // 16
+
+        // if (g1 < g0) sum += g1; else sum -= 1;
+        ByteCode::GLOAD, 1,   // 18
+        ByteCode::GLOAD, 0,   // 20
+        ByteCode::ILT,        // 22
+        ByteCode::BRF, 34,    // 23
+        ByteCode::LOAD, 1,    // 25
+        ByteCode::GLOAD, 1,   // 27
+        ByteCode::IADD,       // 29
+        ByteCode::STORE, 1,   // 30
+        ByteCode::BR, 41,     // 32
+        ByteCode::LOAD, 1,    // 34
+        ByteCode::ICONST, 1,  // 36
+        ByteCode::ISUB,       // 38
+        ByteCode::STORE, 1,   // 39
+
+        // ++i
+        ByteCode::LOAD, 0,    // 41 <-- both paths join
+        ByteCode::ICONST, 1,  // 43
+        ByteCode::IADD,       // 45
+        ByteCode::STORE, 0,   // 46
+        ByteCode::BR, 4,      // 48
+
+        // return sum
+        ByteCode::LOAD, 1,  // 50
+        ByteCode::EXIT,     // 52
+    },
+};
+}  // namespace
+
+TEST_CASE("tcvm: BatchMachineFibonacci", "[tcvm]")
+{
+    auto const program = tcvm::createInputFibonacciProgram();
+    auto inputs        = std::vector<int64_t>(21);
+    std::iota(inputs.begin(), inputs.end(), 0);
+
+    auto const [expected, instructions] = runScalar(program, inputs);
+
+    auto batch = tcc::BatchMachine {program, tcc::BatchOptions {8, 200, 1}};
+    REQUIRE(batch.width() == 8);
+    REQUIRE(batch.run(inputs) == expected);
+
+    // every lane executes the instructions of its scalar run, fewer steps
+    REQUIRE(batch.stats().laneInstructions == instructions);
+    REQUIRE(batch.stats().instructions < instructions);
+    REQUIRE(batch.stats().stackOverflows == 0);
+}
+
+TEST_CASE("tcvm: BatchMachineUniformInputsStayConverged", "[tcvm]")
+{
+    auto const program = tcvm::createInputFibonacciProgram();
+    auto const inputs  = std::vector<int64_t>(16, 12);
+
+    auto batch = tcc::BatchMachine {program, tcc::BatchOptions {16, 200, 1}};
+    REQUIRE(batch.run(inputs) == std::vector<int64_t>(16, 144));
+    REQUIRE(batch.stats().laneInstructions == 16 * batch.stats().instructions);
+}
+
+TEST_CASE("tcvm: BatchMachineDivergentLoop", "[tcvm]")
+{
+    auto const inputs                   = std::vector<int64_t> {0, 1, 2, 3, 7, 10, 4, 100, 5};
+    auto const [expected, instructions] = runScalar(squares, inputs, 2);
+
+    // width is rounded up to whole vectors, the last batch is partial
+    auto batch = tcc::BatchMachine {squares, tcc::BatchOptions {5, 16, 2}};
+    REQUIRE(batch.width() == 8);
+    REQUIRE(batch.run(inputs) == expected);
+    REQUIRE(batch.stats().laneInstructions == instructions);
+}
+
+TEST_CASE("tcvm: BatchMachineSuperinstructions", "[tcvm]")
+{
+    auto const program = tcc::fuseSuperinstructions(tcvm::createInputFibonacciProgram());
+    auto const inputs  = std::vector<int64_t> {15, 3, 9, 1, 0, 12, 7, 2};
+
+    auto const [expected, instructions] = runScalar(program, inputs);
+    auto batch                          = tcc::BatchMachine {program};
+    REQUIRE(batch.run(inputs) == expected);
+    REQUIRE(batch.stats().laneInstructions == instructions);
+}
+
+TEST_CASE("tcvm: BatchMachineStackOverflow", "[tcvm]")
+{
+    // fib(n) needs 4 slots per frame & n frames
+    auto const program = tcvm::createInputFibonacciProgram();
+    auto batch         = tcc::BatchMachine {program, tcc::BatchOptions {4, 32, 1}};
+    REQUIRE(batch.run(std::vector<int64_t> {5, 20, 6, 30}) == std::vector<int64_t> {5, -1, 8, -1});
+    REQUIRE(batch.stats().stackOverflows == 2);
+}
+
+TEST_CASE("tcvm: BatchMachinePrint", "[tcvm]")
+{
+    auto const program = tcc::BinaryProgram {
+        1, "print", 0,
+        std::vector<int64_t> {
+            ByteCode::GLOAD, 0,    //
+            ByteCode::ICONST, 3,   //
+            ByteCode::IMUL,        //
+            ByteCode::PRINT,       //
+            ByteCode::GLOAD, 0,    //
+            ByteCode::ICONST, -2,  //
+            ByteCode::ISUB,        //
+            ByteCode::EXIT,        //
+        },
+    };
+
+    auto out   = std::stringstream {};
+    auto batch = tcc::BatchMachine {program, {}, out};
+    REQUIRE(batch.run(std::vector<int64_t> {1, -4, 5}) == std::vector<int64_t> {3, -2, 7});
+    REQUIRE(out.str() == "3\n-12\n15\n");
+}
+
+TEST_CASE("tcvm: BatchMachineVerifiesPrograms", "[tcvm]")
+{
+    auto const inputs = std::vector<int64_t> {1, 2};
+    auto const failed = std::vector<int64_t> {-1, -1};
+    auto const batch  = [](std::vector<int64_t> code) {
+        return tcc::BatchMachine {tcc::BinaryProgram {1, "verify", 0, std::move(code)}, tcc::BatchOptions {4, 16, 1}};
+    };
+
+    auto global = batch({ByteCode::GLOAD, tcc::MaxGlobals, ByteCode::EXIT});
+    CHECK(global.error() == "global address out of range");
+    CHECK(global.run(inputs) == failed);
+
+    auto branch = batch({ByteCode::BR, 100});
+    CHECK(branch.error() == "branch target out of range");
+    CHECK(branch.run(inputs) == failed);
+
+    // falls off the end into the appended HALT
+    auto end = batch({ByteCode::GLOAD, 0, ByteCode::POP});
+    CHECK(end.error().empty());
+    CHECK(end.run(inputs) == failed);
+
+    // the globals grow to the highest address the program uses
+    auto globals = batch({ByteCode::GLOAD, 0, ByteCode::GSTORE, 40, ByteCode::GLOAD, 40, ByteCode::EXIT});
+    CHECK(globals.run(inputs) == inputs);
+
+    // natives have to be set before the program runs
+    auto native = batch({ByteCode::GLOAD, 0, ByteCode::CALLNATIVE, 0, 1, ByteCode::EXIT});
+    CHECK(native.error().empty());
+    CHECK(native.run(inputs) == failed);
+}
+
+TEST_CASE("tcvm: BatchMachineOutputSink", "[tcvm]")
+{
+    auto const program = tcc::BinaryProgram {
+        1, "print", 0, std::vector<int64_t> {ByteCode::GLOAD, 0, ByteCode::PRINT, ByteCode::GLOAD, 0, ByteCode::EXIT}};
+
+    auto out   = std::stringstream {};
+    auto sink  = tcc::BufferSink {};
+    auto batch = tcc::BatchMachine {program, {}, out};
+    batch.setOutput(&sink);
+    REQUIRE(batch.run(std::vector<int64_t> {4, -2}) == std::vector<int64_t> {4, -2});
+    REQUIRE(sink.view() == "4\n-2\n");
+
+    batch.setOutput(nullptr);
+    REQUIRE(batch.run(std::vector<int64_t> {9}) == std::vector<int64_t> {9});
+    REQUIRE(out.str() == "9\n");
+}
@@ -0,0 +1,83 @@
+/**
+ * @file decoder.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/decoder.hpp"
+
+namespace tcc
+{
+namespace
+{
+auto weight(int64_t const opcode) noexcept -> int64_t
+{
+    if (opcode == ByteCode::NOOP) { return 1; }
+    auto const& instruction = gsl::at(Instructions, opcode);
+    return instruction.isFused() ? static_cast<int64_t>(instruction.fusedLength()) : 1;
+}
+}  // namespace
+
+auto decode(std::vector<int64_t> const& code, int64_t const entryPoint) -> DecodedProgram
+{
+    auto program = DecodedProgram {};
+    program.indexOf.assign(code.size(), -1);
+
+    // first pass: split into instructions
+    for (auto address = std::size_t {0}; address < code.size();)
+    {
+        auto const opcode = code[address];
+        auto const known  = opcode > ByteCode::NOOP && opcode < ByteCode::NUM_OPCODES;
+
+        auto instruction    = DecodedInstruction {};
+        instruction.opcode  = known ? opcode : int64_t {ByteCode::NOOP};
+        instruction.address = static_cast<int64_t>(address);
+
+        auto const numOperands = known ? gsl::at(Instructions, opcode).numberOfOperands : 0;
+        if (address + numOperands >= code.size()) { instruction.opcode = ByteCode::NOOP; }
+        if (instruction.opcode != ByteCode::NOOP)
+        {
+            if (numOperands >= 1) { instruction.operand = code[address + 1]; }
+            if (numOperands >= 2) { instruction.argument = code[address + 2]; }
+        }
+
+        program.indexOf[address] = static_cast<int64_t>(program.instructions.size());
+        program.instructions.push_back(instruction);
+        address += instruction.opcode == ByteCode::NOOP ? 1 : 1 + numOperands;
+    }
+
+    // trailing halt, target for everything that runs off the code
+    auto halt    = DecodedInstruction {};
+    halt.opcode  = ByteCode::HALT;
+    halt.address = static_cast<int64_t>(code.size());
+    program.instructions.push_back(halt);
+
+    // trailing noop, target for everything else that is not an instruction
+    auto invalid    = DecodedInstruction {};
+    invalid.address = -1;
+    program.instructions.push_back(invalid);
+
+    // second pass: resolve targets
+    for (auto& instruction : program.instructions)
+    {
+        auto const target = targetOperandIndex(instruction.opcode);
+        if (target == 0) { instruction.operand = program.indexAt(instruction.operand); }
+        if (target == 1) { instruction.argument = program.indexAt(instruction.argument); }
+    }
+
+    // third pass: block costs, the trailing halt & noop always end a block
+    auto& insts = program.instructions;
+    for (auto i = insts.size(); i-- > 0;)
+    {
+        auto& inst = insts[i];
+        inst.cost  = weight(inst.opcode);
+        // unknown instructions stop every engine
+        if (inst.opcode != ByteCode::NOOP && !endsBasicBlock(inst.opcode)) { inst.cost += insts[i + 1].cost; }
+    }
+
+    program.entryPoint = program.indexAt(entryPoint);
+    return program;
+}
+
+auto decode(BinaryProgram const& program) -> DecodedProgram { return decode(program.data, program.entryPoint); }
+
+}  // namespace tcc
@@ -0,0 +1,80 @@
+/**
+ * @file decoder.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief One instruction of the pre-decoded stream. Operands are copied out of
+ * the raw code and branch/call targets are resolved to instruction indices.
+ */
+struct DecodedInstruction
+{
+    void const* handler {nullptr};  // filled in by the executing engine
+    int64_t opcode {ByteCode::NOOP};
+    int64_t operand {0};   // first operand, target index for BR/BRT/BRF/CALL/ILT_BRF
+    int64_t argument {0};  // second operand, number of arguments for CALL
+    int64_t address {0};   // address in the raw code, -1 for the trailing NOOP
+    int64_t cost {1};      // gas from here to the end of the basic block, see decode()
+};
+
+/**
+ * @brief Pre-decoded form of a program.
+ *
+ * The instructions end with a HALT, for code that runs off the end, followed
+ * by a NOOP without an address. Every target that does not point at the start
+ * of an instruction is resolved to the NOOP, so engines stop there with
+ * RunStatus::InvalidInstruction.
+ */
+struct DecodedProgram
+{
+    std::vector<DecodedInstruction> instructions {};
+    std::vector<int64_t> indexOf {};  // raw address -> instruction index, -1 for operand words
+    int64_t entryPoint {0};
+
+    /**
+     * @brief Returns the instruction index for a raw address. The end of the
+     * code is the trailing HALT, any other address that is not the start of an
+     * instruction the trailing NOOP.
+     */
+    [[nodiscard]] auto indexAt(int64_t address) const noexcept -> int64_t
+    {
+        if (static_cast<uint64_t>(address) == indexOf.size()) { return haltIndex(); }
+        if (static_cast<uint64_t>(address) > indexOf.size()) { return invalidIndex(); }
+        auto const index = indexOf[static_cast<std::size_t>(address)];
+        return index < 0 ? invalidIndex() : index;
+    }
+
+    [[nodiscard]] auto haltIndex() const noexcept -> int64_t { return invalidIndex() - 1; }
+
+    [[nodiscard]] auto invalidIndex() const noexcept -> int64_t
+    {
+        return static_cast<int64_t>(instructions.size()) - 1;
+    }
+};
+
+/**
+ * @brief Decodes raw byte code into a DecodedProgram. Unknown opcodes are kept
+ * as NOOP, which no engine executes.
+ *
+ * The cost of an instruction is the number of instructions executed when
+ * control enters at it & runs to the next control flow instruction, which is
+ * included. Superinstructions count as the sequence they replace, so fusing a
+ * program does not change its gas usage.
+ */
+auto decode(std::vector<int64_t> const& code, int64_t entryPoint) -> DecodedProgram;
+
+/**
+ * @brief Decodes the code of a BinaryProgram.
+ */
+auto decode(BinaryProgram const& program) -> DecodedProgram;
+
+}  // namespace tcc
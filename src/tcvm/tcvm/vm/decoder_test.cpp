@@ -0,0 +1,110 @@
+/**
+ * @file decoder_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/decoder.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+
+using tcc::ByteCode;
+
+TEST_CASE("tcvm: DecodeOperands", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::ICONST, 2,   // 0
+        ByteCode::LOAD,   -3,  // 2
+        ByteCode::IADD,        // 4
+        ByteCode::CALL, 0, 1,  // 5
+        ByteCode::EXIT,        // 8
+    };
+
+    auto const program = tcc::decode(code, 0);
+    auto const& insts  = program.instructions;
+
+    REQUIRE(insts.size() == 7);
+    CHECK(insts[0].opcode == ByteCode::ICONST);
+    CHECK(insts[0].operand == 2);
+    CHECK(insts[1].opcode == ByteCode::LOAD);
+    CHECK(insts[1].operand == -3);
+    CHECK(insts[2].opcode == ByteCode::IADD);
+    CHECK(insts[2].address == 4);
+    CHECK(insts[3].opcode == ByteCode::CALL);
+    CHECK(insts[3].operand == 0);
+    CHECK(insts[3].argument == 1);
+    CHECK(insts[4].opcode == ByteCode::EXIT);
+    CHECK(insts[5].opcode == ByteCode::HALT);
+    CHECK(insts[5].address == 9);
+    CHECK(insts[6].opcode == ByteCode::NOOP);
+    CHECK(insts[6].address == -1);
+}
+
+TEST_CASE("tcvm: DecodeResolveTargets", "[tcvm]")
+{
+    auto const program = tcc::decode(tcvm::createFibonacciProgram(3));
+    auto const& insts  = program.instructions;
+
+    REQUIRE(program.entryPoint == program.indexOf[28]);
+
+    // BRF 10
+    auto const& brf = insts[static_cast<std::size_t>(program.indexOf[5])];
+    REQUIRE(brf.opcode == ByteCode::BRF);
+    CHECK(insts[static_cast<std::size_t>(brf.operand)].address == 10);
+
+    // CALL 0, 1
+    auto const& call = insts[static_cast<std::size_t>(program.indexOf[15])];
+    REQUIRE(call.opcode == ByteCode::CALL);
+    CHECK(call.operand == 0);
+    CHECK(call.argument == 1);
+}
+
+TEST_CASE("tcvm: DecodeInvalidTargets", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::BR, 100,  // 0 out of range
+        ByteCode::BR, 1,    // 2 operand word
+        42,                 // 4 unknown opcode
+    };
+
+    auto const program = tcc::decode(code, 0);
+    auto const& insts  = program.instructions;
+
+    REQUIRE(insts.size() == 5);
+    CHECK(insts[0].operand == program.invalidIndex());
+    CHECK(insts[1].operand == program.invalidIndex());
+    CHECK(insts[2].opcode == ByteCode::NOOP);
+    CHECK(insts[3].opcode == ByteCode::HALT);
+    CHECK(insts[4].opcode == ByteCode::NOOP);
+    CHECK(program.indexAt(-1) == program.invalidIndex());
+    CHECK(program.indexAt(3) == program.invalidIndex());
+    CHECK(program.indexAt(5) == program.haltIndex());
+}
+
+TEST_CASE("tcvm: DecodeBlockCosts", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::ICONST,           1,      // 0
+        ByteCode::LOAD,             -3,     // 2
+        ByteCode::ILT_BRF,          9,      // 4
+        ByteCode::ICONST,           2,      // 6
+        ByteCode::RET,                      // 8
+        ByteCode::LOAD_ICONST_IADD, -3, 1,  // 9
+        ByteCode::EXIT,                     // 12
+    };
+
+    auto const program = tcc::decode(code, 0);
+    auto const& insts  = program.instructions;
+
+    // superinstructions cost as much as the sequence they replace
+    REQUIRE(insts.size() == 9);
+    CHECK(insts[0].cost == 4);
+    CHECK(insts[1].cost == 3);
+    CHECK(insts[2].cost == 2);
+    CHECK(insts[3].cost == 2);
+    CHECK(insts[4].cost == 1);
+    CHECK(insts[5].cost == 4);
+    CHECK(insts[6].cost == 1);
+    CHECK(insts[7].cost == 1);
+    CHECK(insts[8].cost == 1);
+}
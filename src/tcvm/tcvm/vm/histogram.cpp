@@ -0,0 +1,105 @@
+/**
+ * @file histogram.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/histogram.hpp"
+
+#include <string>
+#include <string_view>
+
+namespace tcc
+{
+namespace
+{
+auto isOpcode(int64_t const opcode) noexcept -> bool { return opcode >= 0 && opcode < ByteCode::NUM_OPCODES; }
+
+auto nameOf(int64_t const opcode) -> std::string_view
+{
+    return isOpcode(opcode) ? Instructions[static_cast<std::size_t>(opcode)].name : std::string_view {"unknown"};
+}
+}  // namespace
+
+void OpcodeHistogram::record(int64_t const opcode) noexcept
+{
+    if (!isOpcode(opcode)) { return; }
+
+    ++instructions_;
+    ++opcodes_[static_cast<std::size_t>(opcode)];
+    if (previous_ != -1)
+    { ++pairs_[static_cast<std::size_t>(previous_) * NumOpcodes + static_cast<std::size_t>(opcode)]; }
+    previous_ = opcode;
+}
+
+void OpcodeHistogram::recordCall(int64_t const address, int64_t const target)
+{
+    auto& site  = callSites_[address];
+    site.target = target;
+    ++site.count;
+}
+
+void OpcodeHistogram::recordBranch(int64_t const address, int64_t const opcode, bool const taken)
+{
+    auto& branch  = branches_[address];
+    branch.opcode = opcode;
+    ++(taken ? branch.taken : branch.notTaken);
+}
+
+void OpcodeHistogram::clear() { *this = OpcodeHistogram {}; }
+
+auto OpcodeHistogram::count(int64_t const opcode) const noexcept -> int64_t
+{
+    return isOpcode(opcode) ? opcodes_[static_cast<std::size_t>(opcode)] : 0;
+}
+
+auto OpcodeHistogram::pairCount(int64_t const first, int64_t const second) const noexcept -> int64_t
+{
+    if (!isOpcode(first) || !isOpcode(second)) { return 0; }
+    return pairs_[static_cast<std::size_t>(first) * NumOpcodes + static_cast<std::size_t>(second)];
+}
+
+auto OpcodeHistogram::writeJson(std::ostream& out) const -> void
+{
+    auto json = fmt::format("{{\n  \"instructions\": {},\n  \"opcodes\": {{", instructions_);
+    auto separator = "";
+    for (auto opcode = std::size_t {0}; opcode < NumOpcodes; ++opcode)
+    {
+        if (opcodes_[opcode] == 0) { continue; }
+        json += fmt::format("{}\n    \"{}\": {}", separator, nameOf(static_cast<int64_t>(opcode)), opcodes_[opcode]);
+        separator = ",";
+    }
+
+    json += "\n  },\n  \"pairs\": {";
+    separator = "";
+    for (auto i = std::size_t {0}; i < pairs_.size(); ++i)
+    {
+        if (pairs_[i] == 0) { continue; }
+        auto const first  = static_cast<int64_t>(i / NumOpcodes);
+        auto const second = static_cast<int64_t>(i % NumOpcodes);
+        json += fmt::format("{}\n    \"{} {}\": {}", separator, nameOf(first), nameOf(second), pairs_[i]);
+        separator = ",";
+    }
+
+    json += "\n  },\n  \"callSites\": [";
+    separator = "";
+    for (auto const& [address, site] : callSites_)
+    {
+        json += fmt::format("{}\n    {{\"address\": {}, \"target\": {}, \"count\": {}}}", separator, address,
+                            site.target, site.count);
+        separator = ",";
+    }
+
+    json += "\n  ],\n  \"branches\": [";
+    separator = "";
+    for (auto const& [address, branch] : branches_)
+    {
+        json += fmt::format("{}\n    {{\"address\": {}, \"opcode\": \"{}\", \"taken\": {}, \"notTaken\": {}}}",
+                            separator, address, nameOf(branch.opcode), branch.taken, branch.notTaken);
+        separator = ",";
+    }
+    json += "\n  ]\n}\n";
+
+    out << json;
+}
+
+}  // namespace tcc
@@ -0,0 +1,82 @@
+/**
+ * @file histogram.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <map>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Dynamic instruction counts of one or more runs: executions per
+ * opcode & per pair of consecutive opcodes, calls per call site and the
+ * outcome of every conditional branch.
+ *
+ * A VirtualMachine only records into it if the library is built with
+ * TCC_BUILD_VM_HISTOGRAM, which defines TCC_VM_HISTOGRAM, and statistics are
+ * enabled. Other builds do not contain the instrumentation at all.
+ */
+class OpcodeHistogram
+{
+public:
+    static constexpr auto NumOpcodes = static_cast<std::size_t>(ByteCode::NUM_OPCODES);
+
+    struct CallSite
+    {
+        int64_t target {0};
+        int64_t count {0};
+    };
+
+    struct Branch
+    {
+        int64_t opcode {0};
+        int64_t taken {0};
+        int64_t notTaken {0};
+    };
+
+    /**
+     * @brief Counts an executed opcode, it forms a pair with the previous one.
+     */
+    void record(int64_t opcode) noexcept;
+
+    /**
+     * @brief Counts a call from address, CALL, SPAWN & TAILCALL.
+     */
+    void recordCall(int64_t address, int64_t target);
+
+    /**
+     * @brief Counts the outcome of the conditional branch at address.
+     */
+    void recordBranch(int64_t address, int64_t opcode, bool taken);
+
+    void clear();
+
+    [[nodiscard]] auto count(int64_t opcode) const noexcept -> int64_t;
+    [[nodiscard]] auto pairCount(int64_t first, int64_t second) const noexcept -> int64_t;
+    [[nodiscard]] auto instructions() const noexcept -> int64_t { return instructions_; }
+    [[nodiscard]] auto callSites() const noexcept -> std::map<int64_t, CallSite> const& { return callSites_; }
+    [[nodiscard]] auto branches() const noexcept -> std::map<int64_t, Branch> const& { return branches_; }
+
+    /**
+     * @brief Writes all non-zero counts as a JSON object, opcodes by name,
+     * call sites & branches by address.
+     */
+    auto writeJson(std::ostream& out) const -> void;
+
+private:
+    int64_t instructions_ {0};
+    int64_t previous_ {-1};
+    std::array<int64_t, NumOpcodes> opcodes_ {};
+    std::array<int64_t, NumOpcodes * NumOpcodes> pairs_ {};  // first * NumOpcodes + second
+    std::map<int64_t, CallSite> callSites_ {};
+    std::map<int64_t, Branch> branches_ {};
+};
+
+}  // namespace tcc
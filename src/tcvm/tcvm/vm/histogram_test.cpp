@@ -0,0 +1,81 @@
+/**
+ * @file histogram_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/histogram.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <sstream>
+
+using tcc::ByteCode;
+
+TEST_CASE("tcvm: OpcodeHistogramCounts", "[tcvm]")
+{
+    auto histogram = tcc::OpcodeHistogram {};
+    histogram.record(ByteCode::LOAD);
+    histogram.record(ByteCode::ICONST);
+    histogram.record(ByteCode::ILT);
+    histogram.record(ByteCode::BRF);
+    histogram.record(ByteCode::LOAD);
+    histogram.record(ByteCode::ICONST);
+    histogram.recordBranch(5, ByteCode::BRF, true);
+    histogram.recordBranch(5, ByteCode::BRF, false);
+    histogram.recordBranch(5, ByteCode::BRF, true);
+    histogram.recordCall(15, 0);
+    histogram.recordCall(15, 0);
+
+    REQUIRE(histogram.instructions() == 6);
+    REQUIRE(histogram.count(ByteCode::LOAD) == 2);
+    REQUIRE(histogram.count(ByteCode::IADD) == 0);
+    REQUIRE(histogram.pairCount(ByteCode::LOAD, ByteCode::ICONST) == 2);
+    REQUIRE(histogram.pairCount(ByteCode::BRF, ByteCode::LOAD) == 1);
+    REQUIRE(histogram.pairCount(ByteCode::ICONST, ByteCode::LOAD) == 0);
+    REQUIRE(histogram.branches().at(5).taken == 2);
+    REQUIRE(histogram.branches().at(5).notTaken == 1);
+    REQUIRE(histogram.callSites().at(15).count == 2);
+
+    auto out = std::stringstream {};
+    histogram.writeJson(out);
+    auto const json = out.str();
+    REQUIRE_THAT(json, Catch::Contains("\"instructions\": 6"));
+    REQUIRE_THAT(json, Catch::Contains("\"load\": 2"));
+    REQUIRE_THAT(json, Catch::Contains("\"load iconst\": 2"));
+    REQUIRE_THAT(json, Catch::Contains("{\"address\": 15, \"target\": 0, \"count\": 2}"));
+    REQUIRE_THAT(json, Catch::Contains("{\"address\": 5, \"opcode\": \"brf\", \"taken\": 2, \"notTaken\": 1}"));
+    REQUIRE_THAT(json, !Catch::Contains("iadd"));
+
+    histogram.clear();
+    REQUIRE(histogram.instructions() == 0);
+    REQUIRE(histogram.pairCount(ByteCode::LOAD, ByteCode::ICONST) == 0);
+    REQUIRE(histogram.branches().empty());
+}
+
+#if defined(TCC_VM_HISTOGRAM)
+TEST_CASE("tcvm: OpcodeHistogramRecordsRun", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(10);
+    auto vm            = tcc::VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    vm.enableStatistics(true);
+    REQUIRE(vm.cpu() == 55);
+
+    auto const& histogram = vm.histogram();
+    REQUIRE(histogram.instructions() == vm.stats().instructions);
+
+    // fib(10) is called 177 times, from main once & twice from every call with x >= 2
+    auto calls = int64_t {0};
+    for (auto const& [address, site] : histogram.callSites()) { calls += site.count; }
+    REQUIRE(calls == vm.stats().calls);
+    REQUIRE(histogram.count(ByteCode::CALL) == 177);
+
+    auto const& branch = histogram.branches().at(5);
+    REQUIRE(branch.opcode == ByteCode::BRF);
+    REQUIRE(branch.taken + branch.notTaken == 177);
+    REQUIRE(branch.taken == 88);
+
+    vm.reset(program.entryPoint);
+    REQUIRE(vm.histogram().instructions() == 0);
+}
+#endif
@@ -0,0 +1,709 @@
+/**
+ * @file jit.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/jit.hpp"
+
+#include "tcvm/vm/decoder.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if defined(TCC_VM_HAS_JIT)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_JIT)
+namespace
+{
+// register assignment, all callee saved so helper calls keep them
+constexpr auto Stack    = X86Register::RBX;  // base of the vm stack
+constexpr auto SP       = X86Register::R12;  // stack pointer as index
+constexpr auto FP       = X86Register::R13;  // frame pointer as index
+constexpr auto Data     = X86Register::R14;  // base of the globals
+constexpr auto Context  = X86Register::R15;  // JitContext*
+constexpr auto SavedRsp = X86Register::RBP;  // native stack pointer on entry
+
+// scratch
+constexpr auto RAX = X86Register::RAX;
+constexpr auto RCX = X86Register::RCX;
+constexpr auto RDX = X86Register::RDX;
+
+constexpr auto fitsInt32(int64_t value) noexcept -> bool
+{
+    return value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max();
+}
+
+auto field(std::size_t const offset) -> X86Memory { return X86Memory {Context, {}, 1, static_cast<int32_t>(offset)}; }
+
+auto saveRegisters(X86Assembler& assembler) -> void
+{
+    for (auto reg : {SavedRsp, Stack, SP, FP, Data, Context}) { assembler.push(reg); }
+    assembler.mov(Context, X86Register::RDI);
+    assembler.mov(SavedRsp, X86Register::RSP);
+    assembler.mov(Stack, field(offsetof(JitContext, stack)));
+    assembler.mov(Data, field(offsetof(JitContext, data)));
+    assembler.mov(FP, field(offsetof(JitContext, framePointer)));
+}
+
+auto restoreRegisters(X86Assembler& assembler) -> void
+{
+    assembler.mov(X86Register::RSP, SavedRsp);
+    for (auto reg : {Context, Data, FP, SP, Stack, SavedRsp}) { assembler.pop(reg); }
+    assembler.ret();
+}
+
+/**
+ * @brief Calls target, the arguments are already in rdi & rsi. Clobbers rax.
+ */
+auto callAligned(X86Assembler& assembler, X86Memory const& target) -> void
+{
+    // the native stack is not aligned inside vm functions & traces
+    assembler.mov(RAX, X86Register::RSP);
+    assembler.andImm(X86Register::RSP, -16);
+    assembler.push(RAX);
+    assembler.push(RAX);
+    assembler.call(target);
+    assembler.mov(X86Register::RSP, X86Memory {X86Register::RSP, {}, 1, 0});
+}
+
+/**
+ * @brief Calls JitContext::print with the value in rsi.
+ */
+auto callPrint(X86Assembler& assembler) -> void
+{
+    assembler.mov(X86Register::RDI, Context);
+    callAligned(assembler, field(offsetof(JitContext, print)));
+}
+
+/**
+ * @brief Translates the decoded program one instruction at a time. Every
+ * instruction gets a label, so branches & calls jump directly.
+ */
+class NativeEmitter
+{
+public:
+    explicit NativeEmitter(std::vector<int64_t> const& code) : decoded_ {decode(code, 0)} { }
+
+    auto run() -> bool
+    {
+        auto const& insts = decoded_.instructions;
+        for (auto i = std::size_t {0}; i < insts.size(); ++i) { labels_.push_back(asm_.newLabel()); }
+        dispatch_ = asm_.newLabel();
+        leave_    = asm_.newLabel();
+
+        emitPrologue();
+        for (auto i = std::size_t {0}; i < insts.size(); ++i)
+        {
+            asm_.bind(labels_[i]);
+            emitInstruction(insts[i]);
+        }
+        emitLeave();
+
+        return ok_ && asm_.finalize();
+    }
+
+    [[nodiscard]] auto code() const -> std::vector<uint8_t> const& { return asm_.code(); }
+    [[nodiscard]] auto decoded() const -> DecodedProgram const& { return decoded_; }
+    [[nodiscard]] auto offsetOf(int64_t index) const -> std::size_t
+    {
+        return asm_.offsetOf(labels_[static_cast<std::size_t>(index)]).value_or(0);
+    }
+
+private:
+    auto emitPrologue() -> void
+    {
+        saveRegisters(asm_);
+        asm_.mov(SP, field(offsetof(JitContext, stackPointer)));
+        asm_.mov(RCX, field(offsetof(JitContext, instructionPointer)));
+
+        // enter through the address table, also the landing pad for returns
+        // whose address does not match their call site
+        asm_.bind(dispatch_);
+        asm_.cmp(RCX, field(offsetof(JitContext, codeSize)));
+        asm_.jcc(X86Condition::AboveOrEqual, labels_.back());
+        asm_.mov(RAX, field(offsetof(JitContext, addressTable)));
+        asm_.call(X86Memory {RAX, RCX, 8, 0});
+        asm_.jmp(dispatch_);
+    }
+
+    auto emitLeave() -> void
+    {
+        // out of line, a CALL that does not fit stops before the call
+        for (auto const& [label, address] : overflows_)
+        {
+            asm_.bind(label);
+            asm_.movImm(field(offsetof(JitContext, stackOverflow)), 1);
+            asm_.movImm(RAX, -1);
+            leave(address);
+        }
+
+        asm_.bind(leave_);
+        asm_.mov(field(offsetof(JitContext, stackPointer)), SP);
+        asm_.mov(field(offsetof(JitContext, framePointer)), FP);
+        restoreRegisters(asm_);
+    }
+
+    auto emitInstruction(DecodedInstruction const& inst) -> void
+    {
+        switch (inst.opcode)
+        {
+            case ByteCode::IADD: binary([this] { asm_.add(top(0), RAX); }); break;
+            case ByteCode::ISUB: binary([this] { asm_.sub(top(0), RAX); }); break;
+            case ByteCode::IMUL:
+            {
+                binary([this] {
+                    asm_.mov(RCX, top(0));
+                    asm_.imul(RCX, RAX);
+                    asm_.mov(top(0), RCX);
+                });
+                break;
+            }
+            case ByteCode::ILT: binary([this] { compare(X86Condition::Less); }); break;
+            case ByteCode::IEQ: binary([this] { compare(X86Condition::Equal); }); break;
+
+            case ByteCode::BR: asm_.jmp(target(inst.operand)); break;
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            {
+                asm_.mov(RAX, top(0));
+                asm_.dec(SP);
+                asm_.test(RAX, RAX);
+                auto const condition = inst.opcode == ByteCode::BRT ? X86Condition::NotEqual : X86Condition::Equal;
+                asm_.jcc(condition, target(inst.operand));
+                break;
+            }
+
+            case ByteCode::ICONST:
+            {
+                if (fitsInt32(inst.operand)) { asm_.movImm(top(1), static_cast<int32_t>(inst.operand)); }
+                else
+                {
+                    asm_.movImm(RAX, inst.operand);
+                    asm_.mov(top(1), RAX);
+                }
+                asm_.inc(SP);
+                break;
+            }
+
+            case ByteCode::LOAD: push(local(inst.operand)); break;
+            case ByteCode::GLOAD: push(global(inst.operand)); break;
+            case ByteCode::STORE: pop(local(inst.operand)); break;
+            case ByteCode::GSTORE: pop(global(inst.operand)); break;
+            case ByteCode::POP: asm_.dec(SP); break;
+
+            case ByteCode::PRINT:
+            {
+                asm_.mov(X86Register::RSI, top(0));
+                asm_.dec(SP);
+                callPrint(asm_);
+                break;
+            }
+
+            case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            {
+                auto const returnAddress = inst.address + 3;
+                if (!fitsInt32(inst.argument) || !fitsInt32(returnAddress)) { ok_ = false; }
+
+                overflows_.push_back({asm_.newLabel(), inst.address});
+                asm_.cmp(SP, field(offsetof(JitContext, stackLimit)));
+                asm_.jcc(X86Condition::Greater, overflows_.back().first);
+
+                asm_.movImm(top(1), static_cast<int32_t>(inst.argument));  // save num args
+                asm_.mov(top(2), FP);                                      // save frame pointer
+                asm_.movImm(top(3), static_cast<int32_t>(returnAddress));  // save raw return address
+                asm_.addImm(SP, 3);
+                asm_.mov(FP, SP);
+                asm_.call(target(inst.operand));
+
+                // RET leaves the raw return address in rcx
+                asm_.cmpImm(RCX, static_cast<int32_t>(returnAddress));
+                asm_.jcc(X86Condition::NotEqual, dispatch_);
+                break;
+            }
+
+            // no native call, the RET of the callee returns to the call site of
+            // the current function, which finds its raw return address unchanged
+            case ByteCode::TAILCALL:
+            {
+                auto const numArgs = inst.argument;
+                if (numArgs < 0 || !fitsInt32(numArgs + 2)) { ok_ = false; }
+
+                asm_.mov(RCX, local(0));   // raw return address
+                asm_.mov(RDX, local(-1));  // frame pointer of the caller
+                asm_.mov(RAX, local(-2));  // current num args
+                asm_.sub(FP, RAX);
+                asm_.subImm(FP, 2);  // fp indexes the first current argument
+                for (auto i = int64_t {0}; i < numArgs && ok_; ++i)
+                {
+                    asm_.mov(RAX, top(static_cast<int32_t>(i - numArgs + 1)));
+                    asm_.mov(local(i), RAX);
+                }
+                asm_.movImm(local(numArgs), static_cast<int32_t>(numArgs));
+                asm_.mov(local(numArgs + 1), RDX);
+                asm_.mov(local(numArgs + 2), RCX);
+                asm_.mov(SP, FP);
+                asm_.addImm(SP, static_cast<int32_t>(numArgs + 2));
+                asm_.mov(FP, SP);
+                asm_.jmp(target(inst.operand));
+                break;
+            }
+
+            case ByteCode::JOIN: break;
+
+            // the host function reads its arguments in place, the result replaces them
+            case ByteCode::CALLNATIVE:
+            {
+                auto const numArgs = inst.argument;
+                if (numArgs < 0 || !fitsInt32(numArgs)) { ok_ = false; }
+                auto const first = static_cast<int32_t>(ok_ ? 1 - numArgs : 0);
+
+                asm_.lea(X86Register::RDI, X86Memory {Stack, SP, 8, scaled(first)});
+                asm_.mov(X86Register::R11, field(offsetof(JitContext, natives)));
+                callAligned(asm_, X86Memory {X86Register::R11, {}, 1, scaled(inst.operand)});
+                asm_.subImm(SP, static_cast<int32_t>(-first));
+                asm_.mov(top(0), RAX);
+                break;
+            }
+
+            case ByteCode::RET:
+            {
+                asm_.mov(RAX, top(0));   // return value
+                asm_.mov(SP, FP);        // jump over locals
+                asm_.mov(RCX, top(0));   // return address
+                asm_.mov(FP, top(-1));   // restore frame pointer
+                asm_.mov(RDX, top(-2));  // num args
+                asm_.sub(SP, RDX);
+                asm_.subImm(SP, 2);
+                asm_.mov(top(0), RAX);
+                asm_.ret();
+                break;
+            }
+
+            case ByteCode::EXIT:
+            {
+                asm_.mov(RAX, top(0));
+                leave(inst.address + 1);
+                break;
+            }
+
+            case ByteCode::HALT:
+            {
+                asm_.movImm(RAX, -1);
+                leave(inst.address + 1);
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_IADD:
+            case ByteCode::LOAD_ICONST_ISUB:
+            {
+                asm_.mov(RAX, local(inst.operand));
+                asm_.movImm(RDX, inst.argument);
+                if (inst.opcode == ByteCode::LOAD_ICONST_IADD) { asm_.add(RAX, RDX); }
+                else
+                {
+                    asm_.sub(RAX, RDX);
+                }
+                asm_.mov(top(1), RAX);
+                asm_.inc(SP);
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_ILT:
+            {
+                asm_.mov(RAX, local(inst.operand));
+                asm_.movImm(RDX, inst.argument);
+                asm_.xor32(RCX, RCX);
+                asm_.cmp(RAX, RDX);
+                asm_.setcc(X86Condition::Less, RCX);
+                asm_.mov(top(1), RCX);
+                asm_.inc(SP);
+                break;
+            }
+
+            case ByteCode::LOAD_LOAD_IADD:
+            {
+                asm_.mov(RAX, local(inst.operand));
+                asm_.add(RAX, local(inst.argument));
+                asm_.mov(top(1), RAX);
+                asm_.inc(SP);
+                break;
+            }
+
+            case ByteCode::ILT_BRF:
+            {
+                asm_.mov(RAX, top(0));
+                asm_.mov(RCX, top(-1));
+                asm_.subImm(SP, 2);
+                asm_.cmp(RCX, RAX);
+                asm_.jcc(X86Condition::GreaterOrEqual, target(inst.operand));
+                break;
+            }
+
+            default:
+            {
+                // unknown opcode, reported by the vm
+                asm_.movImm(field(offsetof(JitContext, invalidInstruction)), 1);
+                asm_.movImm(RAX, -1);
+                leave(inst.address);
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Pops the 2nd operand into rax, the 1st operand stays on top.
+     */
+    template<typename Operation>
+    auto binary(Operation operation) -> void
+    {
+        asm_.mov(RAX, top(0));
+        asm_.dec(SP);
+        operation();
+    }
+
+    auto compare(X86Condition condition) -> void
+    {
+        asm_.mov(RCX, top(0));
+        asm_.xor32(RDX, RDX);
+        asm_.cmp(RCX, RAX);
+        asm_.setcc(condition, RDX);
+        asm_.mov(top(0), RDX);
+    }
+
+    auto push(X86Memory const& source) -> void
+    {
+        asm_.mov(RAX, source);
+        asm_.mov(top(1), RAX);
+        asm_.inc(SP);
+    }
+
+    auto pop(X86Memory const& dest) -> void
+    {
+        asm_.mov(RAX, top(0));
+        asm_.dec(SP);
+        asm_.mov(dest, RAX);
+    }
+
+    auto leave(int64_t const instructionPointer) -> void
+    {
+        if (!fitsInt32(instructionPointer)) { ok_ = false; }
+        asm_.movImm(field(offsetof(JitContext, instructionPointer)), static_cast<int32_t>(instructionPointer));
+        asm_.jmp(leave_);
+    }
+
+    [[nodiscard]] auto target(int64_t const index) const -> X86Label
+    {
+        return labels_[static_cast<std::size_t>(index)];
+    }
+
+    static auto top(int32_t const slot) -> X86Memory { return X86Memory {Stack, SP, 8, slot * 8}; }
+
+    auto local(int64_t const offset) -> X86Memory { return X86Memory {Stack, FP, 8, scaled(offset)}; }
+    auto global(int64_t const address) -> X86Memory { return X86Memory {Data, {}, 1, scaled(address)}; }
+
+    auto scaled(int64_t const index) -> int32_t
+    {
+        if (!fitsInt32(index * 8) || !fitsInt32(index)) { ok_ = false; }
+        return ok_ ? static_cast<int32_t>(index * 8) : 0;
+    }
+
+    DecodedProgram decoded_;
+    X86Assembler asm_ {};
+    std::vector<X86Label> labels_ {};
+    std::vector<std::pair<X86Label, int64_t>> overflows_ {};  // stub & address of every CALL
+    X86Label dispatch_ {};
+    X86Label leave_ {};
+    bool ok_ {true};
+};
+
+/**
+ * @brief Translates a trace. Registers are addressed relative to the frame
+ * pointer, which stays the same while the trace runs.
+ */
+class TraceEmitter
+{
+public:
+    explicit TraceEmitter(Trace const& trace) : trace_ {trace} { }
+
+    auto run() -> bool
+    {
+        for (auto i = std::size_t {0}; i < trace_.instructions.size(); ++i) { labels_.push_back(asm_.newLabel()); }
+        for (auto i = std::size_t {0}; i < trace_.exits.size(); ++i) { exits_.push_back(asm_.newLabel()); }
+        leave_ = asm_.newLabel();
+
+        saveRegisters(asm_);
+        for (auto i = std::size_t {0}; i < trace_.instructions.size(); ++i)
+        {
+            asm_.bind(labels_[i]);
+            emitInstruction(trace_.instructions[i]);
+        }
+
+        for (auto i = std::size_t {0}; i < trace_.exits.size(); ++i)
+        {
+            auto const& exit = trace_.exits[i];
+            asm_.bind(exits_[i]);
+            for (auto const& inst : exit.restore) { emitInstruction(inst); }
+
+            if (!fitsInt32(exit.stackPointer) || !fitsInt32(exit.address)) { ok_ = false; }
+            asm_.lea(RAX, X86Memory {FP, {}, 1, static_cast<int32_t>(exit.stackPointer)});
+            asm_.mov(field(offsetof(JitContext, stackPointer)), RAX);
+            asm_.movImm(field(offsetof(JitContext, instructionPointer)), static_cast<int32_t>(exit.address));
+            asm_.movImm(RAX, static_cast<int64_t>(i));
+            asm_.jmp(leave_);
+        }
+
+        asm_.bind(leave_);
+        asm_.mov(field(offsetof(JitContext, framePointer)), FP);
+        restoreRegisters(asm_);
+
+        return ok_ && asm_.finalize();
+    }
+
+    [[nodiscard]] auto code() const -> std::vector<uint8_t> const& { return asm_.code(); }
+
+private:
+    auto emitInstruction(RegisterInstruction const& inst) -> void
+    {
+        switch (inst.opcode)
+        {
+            case RegisterCode::MOV:
+            {
+                asm_.mov(RAX, reg(inst.b));
+                asm_.mov(reg(inst.a), RAX);
+                break;
+            }
+
+            case RegisterCode::MOVK:
+            {
+                if (fitsInt32(inst.b)) { asm_.movImm(reg(inst.a), static_cast<int32_t>(inst.b)); }
+                else
+                {
+                    asm_.movImm(RAX, inst.b);
+                    asm_.mov(reg(inst.a), RAX);
+                }
+                break;
+            }
+
+            case RegisterCode::IADD:
+            case RegisterCode::IADDK:
+            {
+                binary(inst, [this] { asm_.add(RAX, RCX); });
+                break;
+            }
+
+            case RegisterCode::ISUB:
+            case RegisterCode::ISUBK:
+            {
+                binary(inst, [this] { asm_.sub(RAX, RCX); });
+                break;
+            }
+
+            case RegisterCode::IMUL:
+            case RegisterCode::IMULK:
+            {
+                binary(inst, [this] { asm_.imul(RAX, RCX); });
+                break;
+            }
+
+            case RegisterCode::ILT:
+            case RegisterCode::ILTK: compare(inst, X86Condition::Less); break;
+            case RegisterCode::IEQ:
+            case RegisterCode::IEQK: compare(inst, X86Condition::Equal); break;
+
+            case RegisterCode::GLOAD:
+            {
+                asm_.mov(RAX, X86Memory {Data, {}, 1, scaled(inst.b)});
+                asm_.mov(reg(inst.a), RAX);
+                break;
+            }
+
+            case RegisterCode::GSTORE:
+            {
+                asm_.mov(RAX, reg(inst.b));
+                asm_.mov(X86Memory {Data, {}, 1, scaled(inst.a)}, RAX);
+                break;
+            }
+
+            case RegisterCode::PRINT:
+            {
+                asm_.mov(X86Register::RSI, reg(inst.a));
+                callPrint(asm_);
+                break;
+            }
+
+            case RegisterCode::BR: asm_.jmp(labels_.at(static_cast<std::size_t>(inst.a))); break;
+            case RegisterCode::BRT:
+            case RegisterCode::BRF:
+            {
+                asm_.mov(RAX, reg(inst.a));
+                asm_.test(RAX, RAX);
+                auto const condition = inst.opcode == RegisterCode::BRT ? X86Condition::NotEqual : X86Condition::Equal;
+                asm_.jcc(condition, exits_.at(static_cast<std::size_t>(inst.b)));
+                break;
+            }
+
+            default: ok_ = false; break;
+        }
+    }
+
+    /**
+     * @brief Loads the operands into rax & rcx, the result is taken from rax.
+     * The K forms are the register forms plus one.
+     */
+    template<typename Operation>
+    auto binary(RegisterInstruction const& inst, Operation operation) -> void
+    {
+        loadOperands(inst);
+        operation();
+        asm_.mov(reg(inst.a), RAX);
+    }
+
+    auto compare(RegisterInstruction const& inst, X86Condition condition) -> void
+    {
+        loadOperands(inst);
+        asm_.xor32(RDX, RDX);
+        asm_.cmp(RAX, RCX);
+        asm_.setcc(condition, RDX);
+        asm_.mov(reg(inst.a), RDX);
+    }
+
+    auto loadOperands(RegisterInstruction const& inst) -> void
+    {
+        auto const isK = (inst.opcode - RegisterCode::IADD) % 2 == 1;
+        asm_.mov(RAX, reg(inst.b));
+        if (isK) { asm_.movImm(RCX, inst.c); }
+        else
+        {
+            asm_.mov(RCX, reg(inst.c));
+        }
+    }
+
+    auto reg(int64_t const index) -> X86Memory { return X86Memory {Stack, FP, 8, scaled(index)}; }
+
+    auto scaled(int64_t const index) -> int32_t
+    {
+        if (!fitsInt32(index * 8) || !fitsInt32(index)) { ok_ = false; }
+        return ok_ ? static_cast<int32_t>(index * 8) : 0;
+    }
+
+    Trace const& trace_;
+    X86Assembler asm_ {};
+    std::vector<X86Label> labels_ {};
+    std::vector<X86Label> exits_ {};
+    X86Label leave_ {};
+    bool ok_ {true};
+};
+}  // namespace
+
+ExecutableMemory::~ExecutableMemory()
+{
+    if (memory_ != nullptr) { ::munmap(memory_, size_); }
+}
+
+auto ExecutableMemory::create(std::vector<uint8_t> const& code) -> std::optional<ExecutableMemory>
+{
+    auto const pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto const size     = (code.size() + pageSize - 1) / pageSize * pageSize;
+
+    auto* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) { return std::nullopt; }
+
+    auto executable    = ExecutableMemory {};
+    executable.memory_ = memory;
+    executable.size_   = size;
+
+    std::memcpy(memory, code.data(), code.size());
+    if (::mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) { return std::nullopt; }
+    return executable;
+}
+
+auto ExecutableMemory::call(JitContext& context, std::size_t const offset) const -> int64_t
+{
+    using Entry = int64_t (*)(JitContext*);
+
+    auto const* address = static_cast<uint8_t const*>(memory_) + offset;
+    auto entry          = Entry {};
+    std::memcpy(&entry, &address, sizeof(entry));
+    return entry(&context);
+}
+
+auto NativeCode::run(JitContext& context) const -> int64_t
+{
+    context.addressTable = addressTable_.data();
+    context.codeSize     = static_cast<int64_t>(addressTable_.size());
+    return memory_.call(context);
+}
+
+auto compileToNative(std::vector<int64_t> const& code) -> std::optional<NativeCode>
+{
+    auto emitter = NativeEmitter {code};
+    if (!emitter.run()) { return std::nullopt; }
+
+    auto memory = ExecutableMemory::create(emitter.code());
+    if (!memory.has_value()) { return std::nullopt; }
+
+    auto native    = NativeCode {};
+    native.memory_ = std::move(memory.value());
+
+    auto const* base = static_cast<uint8_t const*>(native.memory_.data());
+    native.addressTable_.reserve(code.size());
+    for (auto address = int64_t {0}; address < static_cast<int64_t>(code.size()); ++address)
+    { native.addressTable_.push_back(base + emitter.offsetOf(emitter.decoded().indexAt(address))); }
+
+    return native;
+}
+
+auto compileTrace(Trace const& trace) -> std::optional<NativeTrace>
+{
+    auto emitter = TraceEmitter {trace};
+    if (!emitter.run()) { return std::nullopt; }
+
+    auto memory = ExecutableMemory::create(emitter.code());
+    if (!memory.has_value()) { return std::nullopt; }
+
+    auto native    = NativeTrace {};
+    native.memory_ = std::move(memory.value());
+    return native;
+}
+
+#else
+
+ExecutableMemory::~ExecutableMemory() = default;
+
+auto ExecutableMemory::create(std::vector<uint8_t> const& /*code*/) -> std::optional<ExecutableMemory>
+{
+    return std::nullopt;
+}
+
+auto ExecutableMemory::call(JitContext& /*context*/, std::size_t /*offset*/) const -> int64_t { return -1; }
+
+auto NativeCode::run(JitContext& /*context*/) const -> int64_t { return -1; }
+
+auto compileToNative(std::vector<int64_t> const& /*code*/) -> std::optional<NativeCode> { return std::nullopt; }
+
+auto compileTrace(Trace const& /*trace*/) -> std::optional<NativeTrace> { return std::nullopt; }
+
+#endif
+
+ExecutableMemory::ExecutableMemory(ExecutableMemory&& other) noexcept
+    : memory_ {std::exchange(other.memory_, nullptr)}, size_ {std::exchange(other.size_, 0)}
+{
+}
+
+auto ExecutableMemory::operator=(ExecutableMemory&& other) noexcept -> ExecutableMemory&
+{
+    auto tmp = ExecutableMemory {std::move(other)};
+    std::swap(memory_, tmp.memory_);
+    std::swap(size_, tmp.size_);
+    return *this;
+}
+
+}  // namespace tcc
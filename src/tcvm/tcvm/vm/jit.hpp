@@ -0,0 +1,142 @@
+/**
+ * @file jit.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/natives.hpp"
+#include "tcvm/vm/output_sink.hpp"
+#include "tcvm/vm/trace.hpp"
+
+#if defined(__linux__) && defined(__x86_64__)
+#define TCC_VM_HAS_JIT 1
+#endif
+
+namespace tcc
+{
+/**
+ * @brief VM state handed to native code. Registers are read on entry and
+ * written back on exit, the stack & globals are used in place.
+ */
+struct JitContext
+{
+    int64_t* stack {nullptr};
+    int64_t* data {nullptr};
+    int64_t stackPointer {-1};
+    int64_t framePointer {0};
+    int64_t instructionPointer {0};
+    void const* const* addressTable {nullptr};  // raw address -> native code
+    int64_t codeSize {0};                       // entries in addressTable
+    void (*print)(JitContext* context, int64_t value) {nullptr};
+    OutputSink* output {nullptr};
+    NativeFunction const* natives {nullptr};  // called by CALLNATIVE
+    int64_t invalidInstruction {0};  // set if an unknown opcode was reached
+    int64_t stackLimit {std::numeric_limits<int64_t>::max()};  // highest stack pointer at a CALL
+    int64_t stackOverflow {0};  // set if a CALL stopped at stackLimit, the instruction pointer is the CALL
+};
+
+/**
+ * @brief Owns an executable mapping. The code is copied in while the pages are
+ * writable, afterwards they are only readable & executable.
+ */
+class ExecutableMemory
+{
+public:
+    ExecutableMemory() = default;
+    ~ExecutableMemory();
+
+    ExecutableMemory(ExecutableMemory const&) = delete;
+    auto operator=(ExecutableMemory const&) -> ExecutableMemory& = delete;
+
+    ExecutableMemory(ExecutableMemory&& other) noexcept;
+    auto operator=(ExecutableMemory&& other) noexcept -> ExecutableMemory&;
+
+    /**
+     * @brief Returns std::nullopt if the platform is not supported or the
+     * mapping could not be created.
+     */
+    static auto create(std::vector<uint8_t> const& code) -> std::optional<ExecutableMemory>;
+
+    [[nodiscard]] auto data() const noexcept -> void const* { return memory_; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }
+
+    /**
+     * @brief Calls the code at offset as `int64_t(JitContext*)`.
+     */
+    auto call(JitContext& context, std::size_t offset = 0) const -> int64_t;
+
+private:
+    void* memory_ {nullptr};
+    std::size_t size_ {0};
+};
+
+/**
+ * @brief Native code for a whole program in an executable mapping.
+ *
+ * The code uses the same stack layout as the interpreters: CALL pushes the
+ * number of arguments, the frame pointer and the raw return address, so frames
+ * can be inspected the same way. Returns additionally use the hardware call
+ * stack, a return address that does not match the call site is looked up in
+ * the address table instead.
+ */
+class NativeCode
+{
+public:
+    /**
+     * @brief Runs from context.instructionPointer until EXIT or HALT and
+     * returns the exit code.
+     */
+    auto run(JitContext& context) const -> int64_t;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return memory_.size(); }
+
+private:
+    friend auto compileToNative(std::vector<int64_t> const& code) -> std::optional<NativeCode>;
+
+    ExecutableMemory memory_ {};
+    std::vector<void const*> addressTable_ {};
+};
+
+/**
+ * @brief Native code for one loop trace.
+ */
+class NativeTrace
+{
+public:
+    /**
+     * @brief Runs the loop until a guard fails. The stack, frame and
+     * instruction pointer in context are set to the exit state, the index of
+     * the exit is returned. Expects the frame of context to match the trace.
+     */
+    auto run(JitContext& context) const -> int64_t { return memory_.call(context); }
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return memory_.size(); }
+
+private:
+    friend auto compileTrace(Trace const& trace) -> std::optional<NativeTrace>;
+
+    ExecutableMemory memory_ {};
+};
+
+/**
+ * @brief Compiles byte code to native code. Returns std::nullopt if the
+ * platform is not supported, an operand does not fit the encoding or the
+ * executable mapping could not be created.
+ */
+auto compileToNative(std::vector<int64_t> const& code) -> std::optional<NativeCode>;
+
+/**
+ * @brief Compiles a loop trace to native code. Returns std::nullopt in the
+ * same cases as compileToNative().
+ */
+auto compileTrace(Trace const& trace) -> std::optional<NativeTrace>;
+
+}  // namespace tcc
@@ -0,0 +1,95 @@
+/**
+ * @file jit_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/jit.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+
+using tcc::ByteCode;
+
+#if defined(TCC_VM_HAS_JIT)
+
+TEST_CASE("tcvm: JitCompileAndRun", "[tcvm]")
+{
+    auto const program = tcvm::createFactorialProgram(5);
+    auto native        = tcc::compileToNative(program.data);
+    REQUIRE(native.has_value());
+    REQUIRE(native->size() > 0);
+
+    auto stack                 = std::vector<int64_t>(64);
+    auto context               = tcc::JitContext {};
+    context.stack              = stack.data();
+    context.instructionPointer = program.entryPoint;
+
+    REQUIRE(native->run(context) == 120);
+    REQUIRE(context.stackPointer == 0);
+    REQUIRE(context.framePointer == 0);
+    REQUIRE(context.instructionPointer == 28);
+
+    SECTION("moved code keeps working")
+    {
+        auto moved                 = std::move(native.value());
+        context.stackPointer       = -1;
+        context.instructionPointer = program.entryPoint;
+        REQUIRE(moved.run(context) == 120);
+    }
+}
+
+TEST_CASE("tcvm: JitTailCalls", "[tcvm]")
+{
+    auto const program = tcvm::createEvenOddProgram(1001, true);
+    auto native        = tcc::compileToNative(program.data);
+    REQUIRE(native.has_value());
+
+    auto stack                 = std::vector<int64_t>(8);
+    auto context               = tcc::JitContext {};
+    context.stack              = stack.data();
+    context.instructionPointer = program.entryPoint;
+
+    REQUIRE(native->run(context) == 0);
+    REQUIRE(context.stackPointer == 0);
+    REQUIRE(context.framePointer == 0);
+}
+
+TEST_CASE("tcvm: JitInvalidTargets", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::ICONST, 7,  // 0
+        ByteCode::BR,     3,  // 2 into an operand, same as halt
+        ByteCode::EXIT,       // 4
+    };
+
+    auto const native = tcc::compileToNative(code);
+    REQUIRE(native.has_value());
+
+    auto stack    = std::vector<int64_t>(8);
+    auto context  = tcc::JitContext {};
+    context.stack = stack.data();
+    REQUIRE(native->run(context) == -1);
+
+    context.stackPointer       = -1;
+    context.instructionPointer = 100;
+    REQUIRE(native->run(context) == -1);
+}
+
+TEST_CASE("tcvm: JitOperandOutOfRange", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::LOAD, int64_t {1} << 40,  // displacement does not fit
+        ByteCode::EXIT,
+    };
+
+    REQUIRE_FALSE(tcc::compileToNative(code).has_value());
+}
+
+#else
+
+TEST_CASE("tcvm: JitUnsupportedPlatform", "[tcvm]")
+{
+    REQUIRE_FALSE(tcc::compileToNative(tcvm::createFactorialProgram(5).data).has_value());
+}
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * @file memoization.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/memoization.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <optional>
+
+namespace tcc
+{
+namespace
+{
+/**
+ * @brief What a function does on its own, without looking into its callees.
+ */
+struct FunctionBody
+{
+    bool impure {false};
+    int64_t arguments {0};                                // highest argument read or written
+    std::vector<std::pair<int64_t, int64_t>> calls {};  // callee index & number of arguments
+};
+
+// LOAD & STORE offsets: arguments are at -3 & below, locals at 1 & above
+auto argumentOf(int64_t const offset) noexcept -> std::optional<int64_t>
+{
+    if (offset >= 1) { return int64_t {0}; }
+    if (offset <= -3) { return -offset - 2; }
+    return std::nullopt;  // saved numArgs, frame pointer or return address
+}
+
+auto analyzeBody(DecodedProgram const& program, int64_t const entry) -> FunctionBody
+{
+    auto const& insts = program.instructions;
+    auto body         = FunctionBody {};
+    auto visited      = std::vector<bool>(insts.size(), false);
+    auto work         = std::vector<int64_t> {entry};
+
+    auto const access = [&body](int64_t const offset) {
+        auto const argument = argumentOf(offset);
+        if (!argument.has_value()) { body.impure = true; }
+        else
+        {
+            body.arguments = std::max(body.arguments, argument.value());
+        }
+    };
+
+    while (!work.empty() && !body.impure)
+    {
+        auto const index = work.back();
+        work.pop_back();
+        if (visited[static_cast<std::size_t>(index)]) { continue; }
+        visited[static_cast<std::size_t>(index)] = true;
+
+        auto const& inst = insts[static_cast<std::size_t>(index)];
+        auto const next  = index + 1;
+        switch (inst.opcode)
+        {
+            case ByteCode::LOAD:
+            case ByteCode::STORE:
+            case ByteCode::LOAD_ICONST_IADD:
+            case ByteCode::LOAD_ICONST_ISUB:
+            case ByteCode::LOAD_ICONST_ILT:
+                access(inst.operand);
+                work.push_back(next);
+                break;
+            case ByteCode::LOAD_LOAD_IADD:
+                access(inst.operand);
+                access(inst.argument);
+                work.push_back(next);
+                break;
+            case ByteCode::BR: work.push_back(inst.operand); break;
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            case ByteCode::ILT_BRF:
+                work.push_back(inst.operand);
+                work.push_back(next);
+                break;
+            case ByteCode::CALL:
+                body.calls.emplace_back(inst.operand, inst.argument);
+                work.push_back(next);
+                break;
+            case ByteCode::RET: break;
+            case ByteCode::NOOP:
+            case ByteCode::GLOAD:
+            case ByteCode::GSTORE:
+            case ByteCode::PRINT:
+            case ByteCode::SPAWN:
+            case ByteCode::JOIN:
+            case ByteCode::TAILCALL:
+            case ByteCode::CALLNATIVE:
+            case ByteCode::EXIT:
+            case ByteCode::HALT: body.impure = true; break;
+            default: work.push_back(next); break;
+        }
+    }
+
+    return body;
+}
+
+auto mix(uint64_t hash, int64_t const value) noexcept -> uint64_t
+{
+    hash ^= static_cast<uint64_t>(value) + 0x9E3779B97F4A7C15ULL + (hash << 6U) + (hash >> 2U);
+    return hash;
+}
+}  // namespace
+
+auto analyzePurity(DecodedProgram const& program) -> std::vector<int64_t>
+{
+    auto const& insts = program.instructions;
+    auto result       = std::vector<int64_t>(insts.size(), -1);
+
+    auto bodies   = std::vector<std::pair<int64_t, FunctionBody>> {};
+    auto analyzed = std::vector<bool>(insts.size(), false);
+    for (auto const& inst : insts)
+    {
+        if (inst.opcode != ByteCode::CALL || analyzed[static_cast<std::size_t>(inst.operand)]) { continue; }
+        analyzed[static_cast<std::size_t>(inst.operand)] = true;
+
+        auto body = analyzeBody(program, inst.operand);
+        if (body.impure || body.arguments > static_cast<int64_t>(MemoTable::MaxArguments)) { continue; }
+        result[static_cast<std::size_t>(inst.operand)] = body.arguments;
+        bodies.emplace_back(inst.operand, std::move(body));
+    }
+
+    // drop functions calling something impure until nothing changes, which
+    // keeps recursive functions that only call pure functions
+    for (auto changed = true; changed;)
+    {
+        changed = false;
+        for (auto const& [function, body] : bodies)
+        {
+            if (result[static_cast<std::size_t>(function)] == -1) { continue; }
+            auto const impureCall = std::any_of(begin(body.calls), end(body.calls), [&](auto const& call) {
+                auto const reads = result[static_cast<std::size_t>(call.first)];
+                return reads == -1 || call.second < reads;
+            });
+            if (impureCall)
+            {
+                result[static_cast<std::size_t>(function)] = -1;
+                changed                                    = true;
+            }
+        }
+    }
+
+    return result;
+}
+
+MemoTable::MemoTable(std::size_t const capacity)
+    : entries_(std::bit_ceil(std::max(capacity, std::size_t {1}))), mask_(entries_.size() - 1)
+{
+}
+
+auto MemoTable::makeKey(int64_t const function, std::span<int64_t const> arguments) noexcept -> Key
+{
+    auto key     = Key {};
+    key.function = function;
+    std::copy(arguments.begin(), arguments.end(), key.arguments.begin());
+    return key;
+}
+
+auto MemoTable::slot(Key const& key) noexcept -> Entry&
+{
+    auto hash = mix(0, key.function);
+    for (auto const argument : key.arguments) { hash = mix(hash, argument); }
+    return entries_[hash & mask_];
+}
+
+auto MemoTable::clear() -> void { std::fill(entries_.begin(), entries_.end(), Entry {}); }
+
+}  // namespace tcc
@@ -0,0 +1,90 @@
+/**
+ * @file memoization.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tcvm/vm/decoder.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Finds the functions whose result only depends on their arguments.
+ *
+ * Returns a value for every decoded instruction: for the target of a CALL the
+ * number of arguments the function reads if it is pure, -1 for everything
+ * else. A function is pure if no path from its first instruction reaches
+ * GLOAD, GSTORE, PRINT, SPAWN, JOIN, TAILCALL, CALLNATIVE, EXIT, HALT or an
+ * unknown instruction, every LOAD & STORE stays in its own arguments or
+ * locals, every callee is pure & gets all the arguments it reads. Functions
+ * reading more than MemoTable::MaxArguments arguments are not memoized. Host
+ * functions may have side effects, so calling one makes a function impure.
+ */
+auto analyzePurity(DecodedProgram const& program) -> std::vector<int64_t>;
+
+struct MemoStats
+{
+    int64_t hits {0};    // calls answered from the table
+    int64_t misses {0};  // calls of pure functions that ran
+};
+
+/**
+ * @brief Bounded cache of call results, keyed by function & arguments.
+ *
+ * Direct mapped, a new result replaces whatever was stored in its slot, so
+ * the table never grows & a lookup is a single compare of the key.
+ */
+class MemoTable
+{
+public:
+    static constexpr auto MaxArguments = std::size_t {4};
+
+    struct Key
+    {
+        int64_t function {-1};  // decoded index of the first instruction
+        std::array<int64_t, MaxArguments> arguments {};
+
+        auto operator==(Key const& other) const noexcept -> bool = default;
+    };
+
+    struct Entry
+    {
+        Key key {};
+        int64_t value {0};
+    };
+
+    MemoTable() = default;  // no slots, slot() must not be called
+
+    /**
+     * @brief Capacity is rounded up to a power of two, at least one slot.
+     */
+    explicit MemoTable(std::size_t capacity);
+
+    /**
+     * @brief Key of a call, arguments are the at most MaxArguments values the
+     * function reads, from the top of the stack.
+     */
+    [[nodiscard]] static auto makeKey(int64_t function, std::span<int64_t const> arguments) noexcept -> Key;
+
+    /**
+     * @brief The only slot that can hold the key. It is a hit if the stored key
+     * is equal, otherwise the slot is where the result goes once it is known.
+     * Slots stay valid until the table is replaced.
+     */
+    [[nodiscard]] auto slot(Key const& key) noexcept -> Entry&;
+
+    [[nodiscard]] auto capacity() const noexcept -> std::size_t { return entries_.size(); }
+    auto clear() -> void;
+
+private:
+    std::vector<Entry> entries_ {};
+    std::size_t mask_ {0};
+};
+
+}  // namespace tcc
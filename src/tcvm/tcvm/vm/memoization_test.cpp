@@ -0,0 +1,187 @@
+/**
+ * @file memoization_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/memoization.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <sstream>
+
+using tcc::ByteCode;
+using tcc::VirtualMachine;
+
+namespace
+{
+auto purityAt(std::vector<int64_t> const& code, int64_t const address) -> int64_t
+{
+    auto const program = tcc::decode(code, 0);
+    return tcc::analyzePurity(program)[static_cast<std::size_t>(program.indexAt(address))];
+}
+
+auto fibonacci(int64_t n) -> int64_t { return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2); }
+}  // namespace
+
+TEST_CASE("tcvm: PurityAnalysis", "[tcvm]")
+{
+    SECTION("recursive function")
+    {
+        auto const program = tcvm::createFibonacciProgram(5);
+        REQUIRE(purityAt(program.data, 0) == 1);
+        REQUIRE(purityAt(program.data, 28) == -1);  // not called
+
+        auto const fused = tcc::fuseSuperinstructions(program);
+        REQUIRE(purityAt(fused.data, 0) == 1);
+    }
+
+    SECTION("arguments & locals")
+    {
+        // second(a, b) { c = a; return c; }
+        auto const code = std::vector<int64_t> {
+            ByteCode::ICONST, 1,    // 0
+            ByteCode::ICONST, 2,    // 2
+            ByteCode::CALL, 9, 2,   // 4
+            ByteCode::EXIT,         // 7
+            ByteCode::HALT,         // 8
+            ByteCode::LOAD,   -4,   // 9
+            ByteCode::STORE,  1,    // 11
+            ByteCode::LOAD,   1,    // 13
+            ByteCode::RET,          // 15
+        };
+        REQUIRE(purityAt(code, 9) == 2);
+    }
+
+    SECTION("side effects")
+    {
+        // f() { return g(1); } g(x) { ... } with one of the effects below
+        for (auto const& effect : std::vector<std::vector<int64_t>> {
+                 {ByteCode::GLOAD, 0},
+                 {ByteCode::LOAD, -3, ByteCode::GSTORE, 0, ByteCode::ICONST, 0},
+                 {ByteCode::LOAD, -3, ByteCode::PRINT, ByteCode::ICONST, 0},
+                 {ByteCode::LOAD, -1},  // saved frame pointer
+                 {ByteCode::ICONST, 0, ByteCode::EXIT},
+                 {ByteCode::LOAD, -3, ByteCode::CALLNATIVE, 0, 1},
+             })
+        {
+            auto code = std::vector<int64_t> {
+                ByteCode::CALL,   4,  0,  // 0
+                ByteCode::EXIT,           // 3
+                ByteCode::ICONST, 1,      // 4 <-- f
+                ByteCode::CALL,   10, 1,  // 6
+                ByteCode::RET,            // 9
+            };
+            code.insert(code.end(), effect.begin(), effect.end());  // 10 <-- g
+            code.push_back(ByteCode::RET);
+
+            REQUIRE(purityAt(code, 10) == -1);
+            REQUIRE(purityAt(code, 4) == -1);
+        }
+    }
+
+    SECTION("too few arguments")
+    {
+        // f() { return g(); } g(x) { return x; }
+        auto const code = std::vector<int64_t> {
+            ByteCode::CALL, 4, 0,  // 0
+            ByteCode::EXIT,        // 3
+            ByteCode::CALL, 8, 0,  // 4 <-- f
+            ByteCode::RET,         // 7
+            ByteCode::LOAD, -3,    // 8 <-- g
+            ByteCode::RET,         // 10
+        };
+        REQUIRE(purityAt(code, 8) == 1);
+        REQUIRE(purityAt(code, 4) == -1);
+    }
+}
+
+TEST_CASE("tcvm: MemoTable", "[tcvm]")
+{
+    auto table = tcc::MemoTable {5};
+    REQUIRE(table.capacity() == 8);
+
+    auto const arguments = std::vector<int64_t> {3, 4};
+    auto const key       = tcc::MemoTable::makeKey(7, arguments);
+    REQUIRE_FALSE(table.slot(key).key == key);
+
+    table.slot(key) = tcc::MemoTable::Entry {key, 42};
+    REQUIRE(table.slot(key).key == key);
+    REQUIRE(table.slot(key).value == 42);
+
+    table.clear();
+    REQUIRE_FALSE(table.slot(key).key == key);
+}
+
+TEST_CASE("tcvm: MemoizedFibonacci", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(25);
+
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    auto vm = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout, engine);
+    vm.enableMemoization();
+    REQUIRE(vm.cpu() == fibonacci(25));
+
+    // every argument is computed once, fib(n - 2) is found for n > 2
+    REQUIRE(vm.memoStats().misses == 26);
+    REQUIRE(vm.memoStats().hits == 23);
+
+    // the table outlives reset
+    vm.reset(program.entryPoint);
+    REQUIRE(vm.cpu() == fibonacci(25));
+    REQUIRE(vm.memoStats().misses == 0);
+    REQUIRE(vm.memoStats().hits == 1);
+
+    SECTION("single slot")
+    {
+        vm.enableMemoization(1);
+        vm.reset(program.entryPoint);
+        REQUIRE(vm.cpu() == fibonacci(25));
+    }
+
+    SECTION("metered")
+    {
+        vm.enableMemoization();
+        vm.enableMetering(1'000);
+        vm.reset(program.entryPoint);
+        REQUIRE(vm.cpu() == fibonacci(25));
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::Finished);
+    }
+
+    SECTION("statistics run every call")
+    {
+        vm.enableStatistics(true);
+        vm.reset(program.entryPoint);
+        REQUIRE(vm.cpu() == fibonacci(25));
+        REQUIRE(vm.stats().calls == 242785);
+    }
+}
+
+TEST_CASE("tcvm: MemoizationKeepsSideEffects", "[tcvm]")
+{
+    // show(x) { print(x); return x; } main() { show(1); show(1); return show(1); }
+    auto const code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,    // 0
+        ByteCode::PRINT,         // 2
+        ByteCode::LOAD,   -3,    // 3
+        ByteCode::RET,           // 5
+        ByteCode::ICONST, 1,     // 6 <-- main
+        ByteCode::CALL,   0, 1,  // 8
+        ByteCode::ICONST, 1,     // 11
+        ByteCode::CALL,   0, 1,  // 13
+        ByteCode::IADD,          // 16
+        ByteCode::EXIT,          // 17
+    };
+
+    auto out = std::stringstream {};
+    auto vm  = VirtualMachine(code, 6, 0, 200, false, out, VirtualMachine::Engine::Threaded);
+    vm.enableMemoization();
+    REQUIRE(vm.cpu() == 2);
+    REQUIRE(out.str() == "1\n1\n");
+    REQUIRE(vm.memoStats().misses == 0);
+}
@@ -0,0 +1,144 @@
+/**
+ * @file natives.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/natives.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace tcc
+{
+namespace
+{
+// negated in two's complement, the lowest int64_t has no positive counterpart & stays as is
+auto nativeAbs(int64_t const* args) noexcept -> int64_t
+{
+    auto const x = static_cast<uint64_t>(args[0]);
+    return static_cast<int64_t>(args[0] < 0 ? ~x + 1 : x);
+}
+auto nativeMin(int64_t const* args) noexcept -> int64_t { return std::min(args[0], args[1]); }
+auto nativeMax(int64_t const* args) noexcept -> int64_t { return std::max(args[0], args[1]); }
+
+auto nativeIsqrt(int64_t const* args) noexcept -> int64_t
+{
+    if (args[0] <= 0) { return 0; }
+
+    // the double estimate is off by at most one
+    auto root = static_cast<int64_t>(std::sqrt(static_cast<double>(args[0])));
+    while (root > 0 && root > args[0] / root) { --root; }
+    while (root + 1 <= args[0] / (root + 1)) { ++root; }
+    return root;
+}
+
+// splitmix64 finalizer
+auto nativeHash(int64_t const* args) noexcept -> int64_t
+{
+    auto x = static_cast<uint64_t>(args[0]);
+    x      = (x ^ (x >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    x      = (x ^ (x >> 27U)) * 0x94d049bb133111ebULL;
+    return static_cast<int64_t>(x ^ (x >> 31U));
+}
+}  // namespace
+
+auto NativeRegistry::add(std::string name, int64_t const numArgs, NativeFunction const function) -> bool
+{
+    return functions_.try_emplace(std::move(name), NativeSignature {function, numArgs}).second;
+}
+
+auto NativeRegistry::find(std::string_view const name) const -> NativeSignature const*
+{
+    auto const it = functions_.find(name);
+    return it != functions_.end() ? &it->second : nullptr;
+}
+
+auto addBuiltinNatives(NativeRegistry& registry) -> void
+{
+    registry.add("abs", 1, nativeAbs);
+    registry.add("min", 2, nativeMin);
+    registry.add("max", 2, nativeMax);
+    registry.add("isqrt", 1, nativeIsqrt);
+    registry.add("hash", 1, nativeHash);
+}
+
+auto resolveNatives(BinaryProgram const& program, NativeRegistry const& registry) -> NativeTable
+{
+    auto table      = NativeTable {};
+    auto signatures = std::vector<NativeSignature const*> {};
+    for (auto const& name : program.natives)
+    {
+        auto const* signature = registry.find(name);
+        if (signature == nullptr)
+        {
+            table.error = fmt::format("unknown native function '{}'", name);
+            return table;
+        }
+        signatures.push_back(signature);
+        table.functions.push_back(signature->function);
+    }
+
+    auto const& code = program.data;
+    for (auto address = std::size_t {0}; address < code.size();)
+    {
+        auto const opcode = code[address];
+        if (opcode <= ByteCode::NOOP || opcode >= ByteCode::NUM_OPCODES)
+        {
+            ++address;
+            continue;
+        }
+
+        auto const numOperands = gsl::at(Instructions, opcode).numberOfOperands;
+        if (opcode == ByteCode::CALLNATIVE && address + 2 < code.size())
+        {
+            auto const index   = code[address + 1];
+            auto const numArgs = code[address + 2];
+            auto const error   = [&](std::string message) {
+                table.functions.clear();
+                table.error   = std::move(message);
+                table.address = static_cast<int64_t>(address);
+                return table;
+            };
+
+            if (index < 0 || index >= static_cast<int64_t>(signatures.size()))
+            { return error(fmt::format("native function {} out of range", index)); }
+            auto const& signature = *signatures[static_cast<std::size_t>(index)];
+            if (numArgs != signature.numArgs)
+            {
+                return error(fmt::format("native function '{}' takes {} arguments, called with {}",
+                                         program.natives[static_cast<std::size_t>(index)], signature.numArgs,
+                                         numArgs));
+            }
+        }
+        address += 1 + static_cast<std::size_t>(numOperands);
+    }
+
+    return table;
+}
+
+auto nativesUsed(std::vector<int64_t> const& code) -> std::size_t
+{
+    auto used = std::size_t {0};
+    for (auto address = std::size_t {0}; address < code.size();)
+    {
+        auto const opcode = code[address];
+        if (opcode <= ByteCode::NOOP || opcode >= ByteCode::NUM_OPCODES)
+        {
+            ++address;
+            continue;
+        }
+
+        if (opcode == ByteCode::CALLNATIVE && address + 1 < code.size())
+        {
+            auto const index = code[address + 1];
+            if (index < 0) { return std::numeric_limits<std::size_t>::max(); }
+            used = std::max(used, static_cast<std::size_t>(index) + 1);
+        }
+        address += 1 + static_cast<std::size_t>(gsl::at(Instructions, opcode).numberOfOperands);
+    }
+    return used;
+}
+
+}  // namespace tcc
@@ -0,0 +1,84 @@
+/**
+ * @file natives.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Host function called by CALLNATIVE. args points at the first of the
+ * arguments on the VM stack, the last argument is on top. The result replaces
+ * the arguments. Must not throw, the JIT calls it directly.
+ */
+using NativeFunction = int64_t (*)(int64_t const* args) noexcept;
+
+struct NativeSignature
+{
+    NativeFunction function {nullptr};
+    int64_t numArgs {0};
+};
+
+/**
+ * @brief Host functions by name. Programs list the names they call in
+ * BinaryProgram::natives, resolveNatives() turns them into the table a
+ * VirtualMachine indexes with the first operand of CALLNATIVE.
+ */
+class NativeRegistry
+{
+public:
+    /**
+     * @brief Returns false if a function with the same name exists already.
+     */
+    auto add(std::string name, int64_t numArgs, NativeFunction function) -> bool;
+
+    [[nodiscard]] auto find(std::string_view name) const -> NativeSignature const*;
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return functions_.size(); }
+
+private:
+    std::map<std::string, NativeSignature, std::less<>> functions_ {};
+};
+
+/**
+ * @brief Adds the functions every tcvm provides:
+ *  abs(x), wrapping for the lowest int64_t, min(a, b), max(a, b), isqrt(x)
+ *  for x >= 0 & hash(x), a 64 bit mix.
+ */
+auto addBuiltinNatives(NativeRegistry& registry) -> void;
+
+/**
+ * @brief Outcome of resolveNatives(). Only valid if error is empty.
+ */
+struct NativeTable
+{
+    std::vector<NativeFunction> functions {};  // by index in BinaryProgram::natives
+    std::string error {};                      // empty if all functions were found
+    int64_t address {0};                       // address of the offending CALLNATIVE
+
+    [[nodiscard]] auto ok() const noexcept -> bool { return error.empty(); }
+};
+
+/**
+ * @brief Looks up every name of program.natives. Each CALLNATIVE in the code
+ * has to index the table & pass the number of arguments the host function
+ * was registered with, so no engine checks the arity at run time.
+ */
+auto resolveNatives(BinaryProgram const& program, NativeRegistry const& registry) -> NativeTable;
+
+/**
+ * @brief Size of the table the CALLNATIVE instructions of code index into,
+ * the highest index + 1. A negative index needs more than any table holds.
+ */
+auto nativesUsed(std::vector<int64_t> const& code) -> std::size_t;
+
+}  // namespace tcc
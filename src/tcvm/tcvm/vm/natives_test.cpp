@@ -0,0 +1,234 @@
+/**
+ * @file natives_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/natives.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/batch.hpp"
+#include "tcvm/vm/scheduler.hpp"
+#include "tcvm/vm/verifier.hpp"
+#include "tcvm/vm/vm.hpp"
+#include "tcvm/vm/vm_pool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+using tcc::ByteCode;
+
+namespace
+{
+auto call(tcc::NativeRegistry const& registry, std::string_view name, std::vector<int64_t> const& args) -> int64_t
+{
+    auto const* signature = registry.find(name);
+    REQUIRE(signature != nullptr);
+    REQUIRE(signature->numArgs == static_cast<int64_t>(args.size()));
+    return signature->function(args.data());
+}
+
+auto answer(int64_t const* /*args*/) noexcept -> int64_t { return 42; }
+
+auto makeRegistry() -> tcc::NativeRegistry
+{
+    auto registry = tcc::NativeRegistry {};
+    tcc::addBuiltinNatives(registry);
+    registry.add("answer", 0, answer);
+    return registry;
+}
+
+// for (i = 0; i < 100; ++i) { sum += min(i * 3, 100); } return sum + answer();
+auto const loop = tcc::BinaryProgram {
+    1, "loop", 0,
+    std::vector<int64_t> {
+        ByteCode::ICONST,     0,       // 0 i
+        ByteCode::ICONST,     0,       // 2 sum
+        ByteCode::LOAD,       0,       // 4 <-- loop header
+        ByteCode::ICONST,     100,     // 6
+        ByteCode::ILT,                 // 8
+        ByteCode::BRF,        35,      // 9
+        ByteCode::LOAD,       1,       // 11
+        ByteCode::LOAD,       0,       // 13
+        ByteCode::ICONST,     3,       // 15
+        ByteCode::IMUL,                // 17
+        ByteCode::ICONST,     100,     // 18
+        ByteCode::CALLNATIVE, 0,   2,  // 20 min
+        ByteCode::IADD,                // 23
+        ByteCode::STORE,      1,       // 24
+        ByteCode::LOAD,       0,       // 26
+        ByteCode::ICONST,     1,       // 28
+        ByteCode::IADD,                // 30
+        ByteCode::STORE,      0,       // 31
+        ByteCode::BR,         4,       // 33
+        ByteCode::LOAD,       1,       // 35
+        ByteCode::CALLNATIVE, 1,   0,  // 37 answer
+        ByteCode::IADD,                // 40
+        ByteCode::EXIT,                // 41
+    },
+    {},
+    {"min", "answer"},
+};
+
+auto expectedLoop() -> int64_t
+{
+    auto sum = int64_t {0};
+    for (auto i = int64_t {0}; i < 100; ++i) { sum += std::min(i * 3, int64_t {100}); }
+    return sum + 42;
+}
+}  // namespace
+
+TEST_CASE("tcvm: NativeRegistry", "[tcvm]")
+{
+    auto registry = makeRegistry();
+    REQUIRE(registry.size() == 6);
+    REQUIRE(registry.find("missing") == nullptr);
+    REQUIRE_FALSE(registry.add("min", 1, answer));
+    REQUIRE(registry.find("min")->numArgs == 2);
+
+    constexpr auto min = std::numeric_limits<int64_t>::min();
+    constexpr auto max = std::numeric_limits<int64_t>::max();
+
+    REQUIRE(call(registry, "abs", {-7}) == 7);
+    REQUIRE(call(registry, "abs", {7}) == 7);
+    REQUIRE(call(registry, "abs", {max}) == max);
+    REQUIRE(call(registry, "abs", {min}) == min);
+    REQUIRE(call(registry, "min", {3, -4}) == -4);
+    REQUIRE(call(registry, "max", {3, -4}) == 3);
+    REQUIRE(call(registry, "answer", {}) == 42);
+
+    REQUIRE(call(registry, "isqrt", {-1}) == 0);
+    REQUIRE(call(registry, "isqrt", {0}) == 0);
+    REQUIRE(call(registry, "isqrt", {15}) == 3);
+    REQUIRE(call(registry, "isqrt", {16}) == 4);
+    REQUIRE(call(registry, "isqrt", {max}) == 3037000499);
+
+    REQUIRE(call(registry, "hash", {0}) == 0);
+    REQUIRE(call(registry, "hash", {1}) == call(registry, "hash", {1}));
+    REQUIRE(call(registry, "hash", {1}) != call(registry, "hash", {2}));
+    REQUIRE(call(registry, "hash", {min}) != min);
+}
+
+TEST_CASE("tcvm: ResolveNatives", "[tcvm]")
+{
+    auto const registry = makeRegistry();
+
+    auto const table = tcc::resolveNatives(loop, registry);
+    REQUIRE(table.ok());
+    REQUIRE(table.functions == std::vector<tcc::NativeFunction> {registry.find("min")->function, answer});
+
+    auto unknown    = loop;
+    unknown.natives = {"min", "question"};
+    REQUIRE(tcc::resolveNatives(unknown, registry).error == "unknown native function 'question'");
+
+    auto arity           = loop;
+    arity.data[22]       = 1;
+    auto const wrongArgs = tcc::resolveNatives(arity, registry);
+    REQUIRE(wrongArgs.error == "native function 'min' takes 2 arguments, called with 1");
+    REQUIRE(wrongArgs.address == 20);
+    REQUIRE(wrongArgs.functions.empty());
+
+    auto range     = loop;
+    range.data[38] = 2;
+    REQUIRE(tcc::resolveNatives(range, registry).error == "native function 2 out of range");
+}
+
+TEST_CASE("tcvm: NativeEngines", "[tcvm]")
+{
+    auto const table = tcc::resolveNatives(loop, makeRegistry());
+    REQUIRE(table.ok());
+
+    auto const verified = tcc::verify(loop);
+    REQUIRE(verified.ok());
+    REQUIRE(verified.natives == 2);
+
+    using Engine = tcc::VirtualMachine::Engine;
+    for (auto const engine :
+         {Engine::Switch, Engine::Threaded, Engine::Register, Engine::Jit, Engine::TracingJit, Engine::Compact})
+    {
+        auto vm = tcc::VirtualMachine(loop.data, loop.entryPoint, 0, 50, false, std::cout, engine);
+        vm.setNatives(table.functions);
+        REQUIRE(vm.cpu() == expectedLoop());
+
+        vm.enableBoundsChecking(true);
+        vm.reset(loop.entryPoint);
+        REQUIRE(vm.cpu() == expectedLoop());
+    }
+
+    auto scheduler = tcc::Scheduler {tcc::SchedulerOptions {2, 50, 0}};
+    scheduler.setNatives(table.functions);
+    REQUIRE(scheduler.run(loop) == expectedLoop());
+}
+
+TEST_CASE("tcvm: NativesMissing", "[tcvm]")
+{
+    auto const table = tcc::resolveNatives(loop, makeRegistry());
+    REQUIRE(table.ok());
+    REQUIRE(tcc::nativesUsed(loop.data) == 2);
+
+    // the program does not start with a table that is too short
+    auto out = std::stringstream {};
+    auto vm  = tcc::VirtualMachine(loop.data, loop.entryPoint, 0, 50, false, out);
+    vm.setNatives({table.functions.front()});
+    REQUIRE(vm.cpu() == -1);
+    REQUIRE(vm.status() == tcc::VirtualMachine::RunStatus::MissingNatives);
+    REQUIRE(vm.run(1000).status == tcc::VirtualMachine::RunStatus::MissingNatives);
+
+    vm.enableBoundsChecking(true);
+    REQUIRE(vm.cpu() == -1);
+    REQUIRE(vm.status() == tcc::VirtualMachine::RunStatus::MissingNatives);
+    REQUIRE(out.str().empty());
+
+    vm.setNatives(table.functions);
+    REQUIRE(vm.cpu() == expectedLoop());
+
+    auto scheduler = tcc::Scheduler {tcc::SchedulerOptions {2, 50, 0}};
+    REQUIRE(scheduler.run(loop) == -1);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::MissingNatives);
+
+    // a negative index never fits
+    auto negative   = loop.data;
+    negative.at(21) = -1;
+    REQUIRE(tcc::nativesUsed(negative) > table.functions.size());
+}
+
+TEST_CASE("tcvm: VmPoolNatives", "[tcvm]")
+{
+    auto const table   = tcc::resolveNatives(loop, makeRegistry());
+    auto const program = std::make_shared<tcc::BinaryProgram const>(loop);
+
+    auto options    = tcc::VmPoolOptions {};
+    options.threads = 2;
+    options.natives = table.functions;
+    auto pool       = tcc::VmPool {options};
+    for (auto i = 0; i < 4; ++i) { REQUIRE(pool.submit(tcc::VmJob {program, {}}).get().exitCode == expectedLoop()); }
+
+    auto without = tcc::VmPool {tcc::VmPoolOptions {1}};
+    REQUIRE(without.submit(tcc::VmJob {program, {}}).get().exitCode == -1);
+}
+
+TEST_CASE("tcvm: BatchMachineNatives", "[tcvm]")
+{
+    // abs(g0) + max(g0, 3)
+    auto const program = tcc::BinaryProgram {
+        1, "natives", 0,
+        std::vector<int64_t> {
+            ByteCode::GLOAD,      0,      //
+            ByteCode::CALLNATIVE, 0,  1,  //
+            ByteCode::GLOAD,      0,      //
+            ByteCode::ICONST,     3,      //
+            ByteCode::CALLNATIVE, 1,  2,  //
+            ByteCode::IADD,               //
+            ByteCode::EXIT,               //
+        },
+        {},
+        {"abs", "max"},
+    };
+
+    auto const table = tcc::resolveNatives(program, makeRegistry());
+    REQUIRE(table.ok());
+
+    auto batch = tcc::BatchMachine {program, tcc::BatchOptions {4, 16, 1}};
+    batch.setNatives(table.functions);
+    REQUIRE(batch.run(std::vector<int64_t> {-5, 0, 2, 7, -1}) == std::vector<int64_t> {8, 3, 5, 14, 4});
+}
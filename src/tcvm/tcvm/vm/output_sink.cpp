@@ -0,0 +1,191 @@
+/**
+ * @file output_sink.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/output_sink.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TCC_VM_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace tcc
+{
+auto OutputSink::formatLine(char* out, int64_t const value) noexcept -> char*
+{
+    auto const result = std::to_chars(out, out + MaxLineLength - 1, value);
+    *result.ptr       = '\n';
+    return result.ptr + 1;
+}
+
+StreamSink::StreamSink(std::ostream& out, std::size_t const capacity, std::mutex* const mutex)
+    : out_ {out}, buffer_(std::max(capacity, MaxLineLength)), mutex_ {mutex}
+{
+}
+
+StreamSink::~StreamSink() { flush(); }
+
+auto StreamSink::print(int64_t const value) -> void
+{
+    if (buffer_.size() - size_ < MaxLineLength) { flush(); }
+    size_ = static_cast<std::size_t>(formatLine(buffer_.data() + size_, value) - buffer_.data());
+}
+
+auto StreamSink::flush() -> void
+{
+    if (size_ == 0) { return; }
+    auto const lock = mutex_ != nullptr ? std::unique_lock {*mutex_} : std::unique_lock<std::mutex> {};
+    out_.write(buffer_.data(), static_cast<std::streamsize>(size_));
+    size_ = 0;
+}
+
+BufferSink::BufferSink(std::size_t const capacity) : buffer_(capacity) {}
+
+auto BufferSink::print(int64_t const value) -> void
+{
+    if (buffer_.size() - size_ < MaxLineLength)
+    {
+        // the line may still fit, formatting it aside keeps this path rare
+        char line[MaxLineLength];
+        auto const length = static_cast<std::size_t>(formatLine(line, value) - line);
+        if (buffer_.size() - size_ < length)
+        {
+            truncated_ = true;
+            return;
+        }
+        std::copy_n(line, length, buffer_.data() + size_);
+        size_ += length;
+        return;
+    }
+    size_ = static_cast<std::size_t>(formatLine(buffer_.data() + size_, value) - buffer_.data());
+}
+
+auto BufferSink::clear() noexcept -> void
+{
+    size_      = 0;
+    truncated_ = false;
+}
+
+BinarySink::BinarySink(std::ostream& out, std::size_t const capacity)
+    : out_ {out}, buffer_(std::max(capacity, std::size_t {1}))
+{
+}
+
+BinarySink::~BinarySink() { flush(); }
+
+auto BinarySink::print(int64_t const value) -> void
+{
+    buffer_[size_++] = value;
+    if (size_ == buffer_.size()) { flush(); }
+}
+
+auto BinarySink::flush() -> void
+{
+    if (size_ == 0) { return; }
+    out_.write(reinterpret_cast<char const*>(buffer_.data()), static_cast<std::streamsize>(size_ * sizeof(int64_t)));
+    size_ = 0;
+}
+
+CallbackSink::CallbackSink(Callback callback, std::size_t const capacity)
+    : callback_ {std::move(callback)}, buffer_(std::max(capacity, std::size_t {1}))
+{
+}
+
+CallbackSink::~CallbackSink() { flush(); }
+
+auto CallbackSink::print(int64_t const value) -> void
+{
+    buffer_[size_++] = value;
+    if (size_ == buffer_.size()) { flush(); }
+}
+
+auto CallbackSink::flush() -> void
+{
+    if (size_ == 0) { return; }
+    callback_(std::span<int64_t const> {buffer_.data(), size_});
+    size_ = 0;
+}
+
+#if defined(TCC_VM_HAS_MMAP)
+
+auto MappedFileSink::open(std::filesystem::path const& path, std::size_t const capacity)
+    -> std::unique_ptr<MappedFileSink>
+{
+    auto const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) { return nullptr; }
+
+    auto sink = std::unique_ptr<MappedFileSink> {new MappedFileSink {fd}};
+    if (!sink->map(std::max(capacity, MaxLineLength))) { return nullptr; }
+    return sink;
+}
+
+MappedFileSink::MappedFileSink(int const fd) : fd_ {fd} {}
+
+MappedFileSink::~MappedFileSink() { close(); }
+
+auto MappedFileSink::map(std::size_t const capacity) -> bool
+{
+    if (mapping_ != nullptr) { ::munmap(mapping_, capacity_); }
+    mapping_  = nullptr;
+    capacity_ = 0;
+
+    if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0) { return false; }
+    auto* const mapping = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) { return false; }
+
+    mapping_  = static_cast<char*>(mapping);
+    capacity_ = capacity;
+    return true;
+}
+
+auto MappedFileSink::print(int64_t const value) -> void
+{
+    // a failed or closed mapping drops the value
+    if (mapping_ == nullptr) { return; }
+    if (capacity_ - size_ < MaxLineLength && !map(capacity_ * 2)) { return; }
+    size_ = static_cast<std::size_t>(formatLine(mapping_ + size_, value) - mapping_);
+}
+
+auto MappedFileSink::flush() -> void
+{
+    if (mapping_ != nullptr) { ::msync(mapping_, size_, MS_ASYNC); }
+}
+
+auto MappedFileSink::close() -> bool
+{
+    if (fd_ == -1) { return true; }
+    if (mapping_ != nullptr) { ::munmap(mapping_, capacity_); }
+    auto const truncated = ::ftruncate(fd_, static_cast<off_t>(size_)) == 0;
+    ::close(fd_);
+
+    fd_       = -1;
+    mapping_  = nullptr;
+    capacity_ = 0;
+    return truncated;
+}
+
+#else
+
+auto MappedFileSink::open(std::filesystem::path const& /*path*/, std::size_t /*capacity*/)
+    -> std::unique_ptr<MappedFileSink>
+{
+    return nullptr;
+}
+
+MappedFileSink::MappedFileSink(int const fd) : fd_ {fd} {}
+MappedFileSink::~MappedFileSink() = default;
+auto MappedFileSink::map(std::size_t /*capacity*/) -> bool { return false; }
+auto MappedFileSink::print(int64_t /*value*/) -> void {}
+auto MappedFileSink::flush() -> void {}
+auto MappedFileSink::close() -> bool { return true; }
+
+#endif
+
+}  // namespace tcc
@@ -0,0 +1,173 @@
+/**
+ * @file output_sink.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace tcc
+{
+/**
+ * @brief Receives the values of PRINT. Sinks collect values in a buffer that
+ * is allocated once & hand it on in large batches, flush() passes on the rest.
+ * A VirtualMachine flushes its sink whenever cpu() or run() returns.
+ */
+class OutputSink
+{
+public:
+    static constexpr auto DefaultCapacity = std::size_t {64} * 1024;  // bytes
+
+    OutputSink()          = default;
+    virtual ~OutputSink() = default;
+
+    OutputSink(OutputSink const&) = delete;
+    auto operator=(OutputSink const&) -> OutputSink& = delete;
+
+    virtual auto print(int64_t value) -> void = 0;
+    virtual auto flush() -> void              = 0;
+
+protected:
+    // longest decimal int64_t including sign & newline
+    static constexpr auto MaxLineLength = std::size_t {21};
+
+    /**
+     * @brief Writes value & a newline to out, which has room for
+     * MaxLineLength characters. Returns the end of the written text.
+     */
+    static auto formatLine(char* out, int64_t value) noexcept -> char*;
+};
+
+/**
+ * @brief Writes one decimal value per line to a stream, like the machine did
+ * without a sink. The stream only sees full buffers & flushes. Threads that
+ * share a stream own a sink each & pass the same mutex, which is held while a
+ * buffer is written.
+ */
+class StreamSink final : public OutputSink
+{
+public:
+    explicit StreamSink(std::ostream& out, std::size_t capacity = DefaultCapacity, std::mutex* mutex = nullptr);
+    ~StreamSink() override;
+
+    auto print(int64_t value) -> void override;
+    auto flush() -> void override;
+
+private:
+    std::ostream& out_;
+    std::vector<char> buffer_;
+    std::size_t size_ {0};
+    std::mutex* mutex_ {nullptr};
+};
+
+/**
+ * @brief Keeps the text in memory. Nothing is allocated after construction,
+ * values that do not fit anymore are dropped & truncated() is set.
+ */
+class BufferSink final : public OutputSink
+{
+public:
+    explicit BufferSink(std::size_t capacity = DefaultCapacity);
+
+    auto print(int64_t value) -> void override;
+    auto flush() -> void override {}
+
+    [[nodiscard]] auto view() const noexcept -> std::string_view { return {buffer_.data(), size_}; }
+    [[nodiscard]] auto truncated() const noexcept -> bool { return truncated_; }
+    auto clear() noexcept -> void;
+
+private:
+    std::vector<char> buffer_;
+    std::size_t size_ {0};
+    bool truncated_ {false};
+};
+
+/**
+ * @brief Writes every value as 8 raw bytes in host byte order, nothing is
+ * formatted.
+ */
+class BinarySink final : public OutputSink
+{
+public:
+    explicit BinarySink(std::ostream& out, std::size_t capacity = DefaultCapacity / sizeof(int64_t));
+    ~BinarySink() override;
+
+    auto print(int64_t value) -> void override;
+    auto flush() -> void override;
+
+private:
+    std::ostream& out_;
+    std::vector<int64_t> buffer_;
+    std::size_t size_ {0};
+};
+
+/**
+ * @brief Hands the values to a function, capacity values at a time.
+ */
+class CallbackSink final : public OutputSink
+{
+public:
+    using Callback = std::function<void(std::span<int64_t const>)>;
+
+    explicit CallbackSink(Callback callback, std::size_t capacity = DefaultCapacity / sizeof(int64_t));
+    ~CallbackSink() override;
+
+    auto print(int64_t value) -> void override;
+    auto flush() -> void override;
+
+private:
+    Callback callback_;
+    std::vector<int64_t> buffer_;
+    std::size_t size_ {0};
+};
+
+/**
+ * @brief Formats the text directly into a shared mapping of a file. The file
+ * grows by doubling its mapped size & is cut to the written size by close()
+ * or the destructor. flush() schedules the written pages for writeback.
+ */
+class MappedFileSink final : public OutputSink
+{
+public:
+    /**
+     * @brief Creates or truncates the file. Returns nullptr if it can not be
+     * opened or mapped, or the platform has no mmap.
+     */
+    [[nodiscard]] static auto open(std::filesystem::path const& path, std::size_t capacity = DefaultCapacity * 16)
+        -> std::unique_ptr<MappedFileSink>;
+
+    ~MappedFileSink() override;
+
+    auto print(int64_t value) -> void override;
+    auto flush() -> void override;
+
+    /**
+     * @brief Unmaps & truncates the file to the written size, following
+     * values are dropped. Returns false if the file could not be truncated.
+     */
+    auto close() -> bool;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }  // bytes written
+
+private:
+    explicit MappedFileSink(int fd);
+
+    auto map(std::size_t capacity) -> bool;
+
+    int fd_ {-1};
+    char* mapping_ {nullptr};
+    std::size_t capacity_ {0};
+    std::size_t size_ {0};
+};
+
+}  // namespace tcc
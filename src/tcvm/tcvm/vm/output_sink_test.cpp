@@ -0,0 +1,180 @@
+/**
+ * @file output_sink_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/output_sink.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+using tcc::ByteCode;
+
+namespace
+{
+constexpr auto min = std::numeric_limits<int64_t>::min();
+constexpr auto max = std::numeric_limits<int64_t>::max();
+
+auto readFile(std::filesystem::path const& path) -> std::string
+{
+    auto file = std::ifstream {path, std::ios::binary};
+    return std::string {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+}
+}  // namespace
+
+TEST_CASE("tcvm: StreamSink", "[tcvm]")
+{
+    auto out = std::stringstream {};
+    {
+        auto sink = tcc::StreamSink {out};
+        sink.print(0);
+        sink.print(-42);
+        sink.print(min);
+        sink.print(max);
+        REQUIRE(out.str().empty());
+
+        sink.flush();
+        REQUIRE(out.str() == "0\n-42\n-9223372036854775808\n9223372036854775807\n");
+        sink.print(7);
+    }
+    REQUIRE(out.str() == "0\n-42\n-9223372036854775808\n9223372036854775807\n7\n");
+
+    // the buffer is written once it has no room for the longest line, here
+    // after every second value
+    auto batched = std::stringstream {};
+    auto sink    = tcc::StreamSink {batched, 24};
+    for (auto i = 0; i < 10; ++i) { sink.print(i); }
+    REQUIRE(batched.str() == "0\n1\n2\n3\n4\n5\n6\n7\n");
+    sink.flush();
+    REQUIRE(batched.str() == "0\n1\n2\n3\n4\n5\n6\n7\n8\n9\n");
+}
+
+TEST_CASE("tcvm: BufferSink", "[tcvm]")
+{
+    auto sink = tcc::BufferSink {32};
+    sink.print(123);
+    sink.print(min);
+    REQUIRE(sink.view() == "123\n-9223372036854775808\n");
+    REQUIRE_FALSE(sink.truncated());
+
+    // 24 of 32 bytes are used
+    sink.print(123456);
+    sink.print(1);
+    REQUIRE(sink.view() == "123\n-9223372036854775808\n123456\n");
+    REQUIRE(sink.truncated());
+
+    sink.clear();
+    REQUIRE(sink.view().empty());
+    REQUIRE_FALSE(sink.truncated());
+}
+
+TEST_CASE("tcvm: BinarySink", "[tcvm]")
+{
+    auto out  = std::stringstream {};
+    auto sink = tcc::BinarySink {out, 2};
+    sink.print(1);
+    REQUIRE(out.str().empty());
+    sink.print(min);
+    sink.print(-1);
+    REQUIRE(out.str().size() == 2 * sizeof(int64_t));
+    sink.flush();
+
+    auto const bytes = out.str();
+    REQUIRE(bytes.size() == 3 * sizeof(int64_t));
+    int64_t values[3] {};
+    std::memcpy(values, bytes.data(), bytes.size());
+    REQUIRE(values[0] == 1);
+    REQUIRE(values[1] == min);
+    REQUIRE(values[2] == -1);
+}
+
+TEST_CASE("tcvm: CallbackSink", "[tcvm]")
+{
+    auto batches = std::vector<std::vector<int64_t>> {};
+    {
+        auto sink = tcc::CallbackSink {[&](std::span<int64_t const> values) {
+                                           batches.emplace_back(values.begin(), values.end());
+                                       },
+                                       3};
+        for (auto i = 0; i < 7; ++i) { sink.print(i); }
+        REQUIRE(batches.size() == 2);
+    }
+    REQUIRE(batches == std::vector<std::vector<int64_t>> {{0, 1, 2}, {3, 4, 5}, {6}});
+}
+
+TEST_CASE("tcvm: MappedFileSink", "[tcvm]")
+{
+    auto const path = std::filesystem::temp_directory_path() / "tcvm_mapped_file_sink_test.txt";
+    auto sink       = tcc::MappedFileSink::open(path, 32);
+    if (sink == nullptr) { return; }
+
+    // grows twice beyond the initial mapping
+    auto expected = std::string {};
+    for (auto i = 0; i < 40; ++i)
+    {
+        sink->print(i * 1000);
+        expected += std::to_string(i * 1000) + "\n";
+    }
+    sink->flush();
+    REQUIRE(sink->size() == expected.size());
+
+    REQUIRE(sink->close());
+    REQUIRE(readFile(path) == expected);
+
+    sink->print(1);
+    sink.reset();
+    REQUIRE(readFile(path) == expected);
+    std::filesystem::remove(path);
+
+    REQUIRE(tcc::MappedFileSink::open(path / "missing" / "file.txt") == nullptr);
+}
+
+TEST_CASE("tcvm: OutputSinkEngines", "[tcvm]")
+{
+    // for (i = 0; i < 100; ++i) { print(i * 3); } return i;
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 0,    // 0 i
+        ByteCode::LOAD,   0,    // 2 <-- header
+        ByteCode::ICONST, 100,  // 4
+        ByteCode::ILT,          // 6
+        ByteCode::BRF,    24,   // 7
+        ByteCode::LOAD,   0,    // 9
+        ByteCode::ICONST, 3,    // 11
+        ByteCode::IMUL,         // 13
+        ByteCode::PRINT,        // 14
+        ByteCode::LOAD,   0,    // 15
+        ByteCode::ICONST, 1,    // 17
+        ByteCode::IADD,         // 19
+        ByteCode::STORE,  0,    // 20
+        ByteCode::BR,     2,    // 22
+        ByteCode::LOAD,   0,    // 24
+        ByteCode::EXIT,         // 26
+    };
+
+    auto expected = std::string {};
+    for (auto i = 0; i < 100; ++i) { expected += std::to_string(i * 3) + "\n"; }
+
+    using Engine = tcc::VirtualMachine::Engine;
+    for (auto const engine :
+         {Engine::Switch, Engine::Threaded, Engine::Register, Engine::Jit, Engine::TracingJit, Engine::Compact})
+    {
+        auto stream = std::stringstream {};
+        auto sink   = tcc::BufferSink {};
+        auto vm     = tcc::VirtualMachine(assembly, 0, 0, 50, false, stream, engine);
+        vm.setOutput(&sink);
+        REQUIRE(vm.cpu() == 100);
+        REQUIRE(sink.view() == expected);
+        REQUIRE(stream.str().empty());
+
+        // back to the stream
+        vm.setOutput(nullptr);
+        vm.reset(0);
+        REQUIRE(vm.cpu() == 100);
+        REQUIRE(stream.str() == expected);
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * @file perf_counters.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/perf_counters.hpp"
+
+#include "fmt/format.h"
+
+#if defined(__linux__)
+#define TCC_VM_HAS_PERF_COUNTERS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_PERF_COUNTERS)
+
+namespace
+{
+constexpr auto Events = std::array<uint64_t, 4> {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+auto openEvent(uint64_t const event, int const groupLeader) -> int
+{
+    auto attributes           = perf_event_attr {};
+    attributes.type           = PERF_TYPE_HARDWARE;
+    attributes.size           = sizeof(perf_event_attr);
+    attributes.config         = event;
+    attributes.disabled       = groupLeader == -1 ? 1U : 0U;
+    attributes.exclude_kernel = 1U;
+    attributes.exclude_hv     = 1U;
+    attributes.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, groupLeader, 0));
+}
+}  // namespace
+
+PerfCounters::PerfCounters()
+{
+    for (auto i = std::size_t {0}; i < Events.size(); ++i)
+    {
+        descriptors_[i] = openEvent(Events[i], descriptors_[0]);
+        if (descriptors_[i] != -1) { continue; }
+
+        // all or nothing, a partial group would report zeros as measurements
+        for (auto& descriptor : descriptors_)
+        {
+            if (descriptor != -1) { ::close(descriptor); }
+            descriptor = -1;
+        }
+        return;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (auto const descriptor : descriptors_)
+    {
+        if (descriptor != -1) { ::close(descriptor); }
+    }
+}
+
+void PerfCounters::start()
+{
+    if (available()) { ::ioctl(descriptors_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP); }
+}
+
+void PerfCounters::stop()
+{
+    if (available()) { ::ioctl(descriptors_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP); }
+}
+
+void PerfCounters::reset()
+{
+    if (available()) { ::ioctl(descriptors_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP); }
+}
+
+auto PerfCounters::read() const -> PerfCounts
+{
+    if (!available()) { return {}; }
+
+    // nr, time enabled, time running, one value per event
+    auto buffer = std::array<uint64_t, 3 + Events.size()> {};
+    if (::read(descriptors_[0], buffer.data(), sizeof(buffer)) != static_cast<ssize_t>(sizeof(buffer))) { return {}; }
+
+    auto const enabled = buffer[1];
+    auto const running = buffer[2];
+    auto const scale   = [enabled, running](uint64_t const value) {
+        if (running == 0) { return int64_t {0}; }
+        if (running == enabled) { return static_cast<int64_t>(value); }
+        return static_cast<int64_t>(static_cast<double>(value) * static_cast<double>(enabled)
+                                    / static_cast<double>(running));
+    };
+
+    return PerfCounts {scale(buffer[3]), scale(buffer[4]), scale(buffer[5]), scale(buffer[6])};
+}
+
+#else
+
+PerfCounters::PerfCounters()  = default;
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() { }
+void PerfCounters::stop() { }
+void PerfCounters::reset() { }
+
+auto PerfCounters::read() const -> PerfCounts { return {}; }
+
+#endif
+
+auto formatPerfCounts(PerfCounts const& counts, int64_t const bytecodeInstructions) -> std::string
+{
+    auto const perInstruction = [bytecodeInstructions](int64_t const value) {
+        if (bytecodeInstructions <= 0) { return 0.0; }
+        return static_cast<double>(value) / static_cast<double>(bytecodeInstructions);
+    };
+
+    auto result = fmt::format("cycles: {} ({:.2f}/op)\n", counts.cycles, perInstruction(counts.cycles));
+    result += fmt::format("instructions: {} ({:.2f}/op)\n", counts.instructions, perInstruction(counts.instructions));
+    result += fmt::format("branch-misses: {} ({:.4f}/op)\n", counts.branchMisses, perInstruction(counts.branchMisses));
+    result += fmt::format("cache-misses: {} ({:.4f}/op)\n", counts.cacheMisses, perInstruction(counts.cacheMisses));
+    return result;
+}
+
+}  // namespace tcc
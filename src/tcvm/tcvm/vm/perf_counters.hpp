@@ -0,0 +1,81 @@
+/**
+ * @file perf_counters.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace tcc
+{
+/**
+ * @brief Hardware events counted by PerfCounters.
+ */
+struct PerfCounts
+{
+    int64_t cycles {0};
+    int64_t instructions {0};  // retired by the cpu, not bytecode
+    int64_t branchMisses {0};
+    int64_t cacheMisses {0};
+};
+
+/**
+ * @brief Hardware performance counters of the calling thread, opened with
+ * perf_event_open as one group, so all events cover the same instructions.
+ * Only user space is counted.
+ *
+ * Without Linux, or if the kernel refuses, e.g. because of
+ * perf_event_paranoid or missing hardware events in a virtual machine,
+ * available() is false and every count stays zero.
+ */
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(PerfCounters const&) = delete;
+    auto operator=(PerfCounters const&) -> PerfCounters& = delete;
+    PerfCounters(PerfCounters&&)                         = delete;
+    auto operator=(PerfCounters&&) -> PerfCounters& = delete;
+
+    [[nodiscard]] auto available() const noexcept -> bool { return descriptors_[0] != -1; }
+
+    /**
+     * @brief Counting accumulates between start() & stop() until reset().
+     */
+    void start();
+    void stop();
+    void reset();
+
+    /**
+     * @brief Events counted so far, scaled up if the kernel had to multiplex
+     * the group with other users of the counters.
+     */
+    [[nodiscard]] auto read() const -> PerfCounts;
+
+private:
+    std::array<int, 4> descriptors_ {-1, -1, -1, -1};  // the first one leads the group
+};
+
+/**
+ * @brief Runs f between start() & stop().
+ */
+template <typename Function>
+auto measure(PerfCounters& counters, Function&& f)
+{
+    counters.start();
+    auto result = f();
+    counters.stop();
+    return result;
+}
+
+/**
+ * @brief One line per event, total & per executed bytecode instruction.
+ */
+auto formatPerfCounts(PerfCounts const& counts, int64_t bytecodeInstructions) -> std::string;
+
+}  // namespace tcc
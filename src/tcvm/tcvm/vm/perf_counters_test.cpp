@@ -0,0 +1,50 @@
+/**
+ * @file perf_counters_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/perf_counters.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm.hpp"
+
+TEST_CASE("tcvm: PerfCountersMeasureRun", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(15);
+    auto vm = tcc::VirtualMachine(program.data, program.entryPoint, 0, 64, false, std::cout,
+                                  tcc::VirtualMachine::Engine::Threaded);
+
+    auto counters = tcc::PerfCounters {};
+    REQUIRE(tcc::measure(counters, [&vm] { return vm.cpu(); }) == 610);
+
+    auto const counts = counters.read();
+    if (!counters.available())
+    {
+        REQUIRE(counts.cycles == 0);
+        REQUIRE(counts.instructions == 0);
+        return;
+    }
+
+    REQUIRE(counts.cycles > 0);
+    REQUIRE(counts.instructions > 0);
+    REQUIRE(counts.branchMisses >= 0);
+    REQUIRE(counts.cacheMisses >= 0);
+
+    // stopped counters do not count
+    REQUIRE(counters.read().instructions == counts.instructions);
+
+    counters.reset();
+    REQUIRE(counters.read().instructions == 0);
+}
+
+TEST_CASE("tcvm: PerfCountersFormat", "[tcvm]")
+{
+    auto const counts = tcc::PerfCounts {200, 400, 2, 1};
+    auto const text   = tcc::formatPerfCounts(counts, 100);
+    REQUIRE_THAT(text, Catch::Contains("cycles: 200 (2.00/op)"));
+    REQUIRE_THAT(text, Catch::Contains("instructions: 400 (4.00/op)"));
+    REQUIRE_THAT(text, Catch::Contains("branch-misses: 2 (0.0200/op)"));
+    REQUIRE_THAT(text, Catch::Contains("cache-misses: 1 (0.0100/op)"));
+
+    REQUIRE_THAT(tcc::formatPerfCounts(counts, 0), Catch::Contains("cycles: 200 (0.00/op)"));
+}
@@ -0,0 +1,119 @@
+/**
+ * @file profiler.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/profiler.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace tcc
+{
+namespace
+{
+constexpr auto UnknownFunction = std::string_view {"[unknown]"};
+
+/**
+ * @brief Calls suspend() on the machine once per period until destroyed.
+ */
+class SampleTimer
+{
+public:
+    SampleTimer(VirtualMachine& vm, std::chrono::microseconds const period)
+        : thread_ {[this, &vm, period] {
+            auto lock = std::unique_lock {mutex_};
+            while (!wakeUp_.wait_for(lock, period, [this] { return stopped_; })) { vm.suspend(); }
+        }}
+    {
+    }
+
+    ~SampleTimer()
+    {
+        {
+            auto const lock = std::lock_guard {mutex_};
+            stopped_        = true;
+        }
+        wakeUp_.notify_one();
+        thread_.join();
+    }
+
+    SampleTimer(SampleTimer const&) = delete;
+    auto operator=(SampleTimer const&) -> SampleTimer& = delete;
+    SampleTimer(SampleTimer&&)                         = delete;
+    auto operator=(SampleTimer&&) -> SampleTimer& = delete;
+
+private:
+    std::mutex mutex_ {};
+    std::condition_variable wakeUp_ {};
+    bool stopped_ {false};
+    std::thread thread_;  // last, starts once the members above exist
+};
+}  // namespace
+
+Profiler::Profiler(SymbolTable symbols, ProfilerOptions options)
+    : symbols_ {std::move(symbols)}, options_ {options}
+{
+}
+
+auto Profiler::run(VirtualMachine& vm) -> VirtualMachine::RunResult
+{
+    auto const timed  = options_.period.count() > 0;
+    auto const budget = timed ? std::numeric_limits<int64_t>::max() : std::max(options_.interval, int64_t {1});
+
+    auto timer  = timed ? std::make_unique<SampleTimer>(vm, options_.period) : nullptr;
+    auto result = vm.run(budget);
+    while (result.status == VirtualMachine::RunStatus::OutOfBudget
+           || result.status == VirtualMachine::RunStatus::Suspended)
+    {
+        // the timer may suspend the machine again before it executed anything,
+        // the stack was already sampled then
+        if (result.instructions > 0) { sample(vm); }
+        result = vm.run(budget);
+    }
+    return result;
+}
+
+auto Profiler::sample(VirtualMachine const& vm) -> void
+{
+    auto const addresses = vm.callStack();
+
+    auto functions = std::vector<std::string_view> {};
+    functions.reserve(addresses.size());
+    for (auto address = addresses.rbegin(); address != addresses.rend(); ++address)
+    {
+        auto const name = symbolAt(symbols_, *address);
+        functions.push_back(name.empty() ? UnknownFunction : name);
+    }
+
+    ++stacks_[functions];
+    ++samples_;
+}
+
+auto Profiler::writeFolded(std::ostream& out) const -> void
+{
+    for (auto const& [functions, count] : stacks_)
+    {
+        auto line = std::string {};
+        for (auto const name : functions)
+        {
+            if (!line.empty()) { line += ';'; }
+            line += name;
+        }
+        out << fmt::format("{} {}\n", line, count);
+    }
+}
+
+auto Profiler::clear() -> void
+{
+    stacks_.clear();
+    samples_ = 0;
+}
+
+}  // namespace tcc
@@ -0,0 +1,71 @@
+/**
+ * @file profiler.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/vm.hpp"
+
+namespace tcc
+{
+struct ProfilerOptions
+{
+    int64_t interval {1000};               // instructions between two samples
+    std::chrono::microseconds period {0};  // if set, a timer requests the samples instead
+};
+
+/**
+ * @brief Samples the call stack of a running program & writes the samples as
+ * folded stacks, one line per distinct stack, e.g. `__init;main;fib 42`. The
+ * format is read by flamegraph.pl, inferno & speedscope.
+ *
+ * The program runs on the budgeted switch interpreter, which stops it at an
+ * instruction boundary every interval instructions or whenever the timer
+ * thread calls suspend(). Between two samples nothing is recorded. Frames are
+ * named after the function containing the instruction pointer or the return
+ * address, functions missing from the symbol table are [unknown].
+ */
+class Profiler
+{
+public:
+    explicit Profiler(SymbolTable symbols, ProfilerOptions options = {});
+
+    // stacks_ views the names in symbols_, short names move with the strings
+    Profiler(Profiler const&) = delete;
+    Profiler(Profiler&&)      = delete;
+    auto operator=(Profiler const&) -> Profiler& = delete;
+    auto operator=(Profiler&&) -> Profiler& = delete;
+
+    /**
+     * @brief Runs the program until it finishes or is stopped by anything but
+     * the profiler, e.g. metering.
+     */
+    auto run(VirtualMachine& vm) -> VirtualMachine::RunResult;
+
+    /**
+     * @brief Records the current call stack of a stopped machine.
+     */
+    auto sample(VirtualMachine const& vm) -> void;
+
+    [[nodiscard]] auto samples() const noexcept -> int64_t { return samples_; }
+    auto writeFolded(std::ostream& out) const -> void;
+    auto clear() -> void;
+
+private:
+    SymbolTable symbols_;
+    ProfilerOptions options_;
+    std::map<std::vector<std::string_view>, int64_t> stacks_ {};  // names in symbols_, outermost first
+    int64_t samples_ {0};
+};
+
+}  // namespace tcc
@@ -0,0 +1,142 @@
+/**
+ * @file profiler_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/profiler.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+using tcc::VirtualMachine;
+
+namespace
+{
+// sum of the counts & the deepest stack of folded output
+auto parseFolded(std::string const& folded) -> std::pair<int64_t, std::size_t>
+{
+    auto total    = int64_t {0};
+    auto maxDepth = std::size_t {0};
+    auto lines    = std::istringstream {folded};
+    for (auto line = std::string {}; std::getline(lines, line);)
+    {
+        auto const space = line.rfind(' ');
+        REQUIRE(space != std::string::npos);
+        total += std::stoll(line.substr(space + 1));
+        auto const depth = static_cast<std::size_t>(std::count(line.begin(), line.begin() + space, ';')) + 1;
+        maxDepth         = std::max(maxDepth, depth);
+    }
+    return {total, maxDepth};
+}
+}  // namespace
+
+TEST_CASE("tcvm: ProfilerCallStack", "[tcvm]")
+{
+    auto const program = tcvm::createEvenOddProgram(4, false);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    REQUIRE(vm.callStack() == std::vector<int64_t> {38});
+
+    // main, 4 calls of 8 instructions each & even(0) up to its RET
+    auto const beforeReturn = 2 + 4 * 8 + 5;
+    REQUIRE(vm.run(beforeReturn).status == VirtualMachine::RunStatus::OutOfBudget);
+    REQUIRE(vm.callStack() == std::vector<int64_t> {9, 37, 18, 37, 18, 43});
+}
+
+TEST_CASE("tcvm: ProfilerFoldedStacks", "[tcvm]")
+{
+    auto const tailCalls = GENERATE(false, true);
+    auto const program   = tcvm::createEvenOddProgram(4, tailCalls);
+
+    auto vm           = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    auto profiler     = tcc::Profiler {program.symbols, tcc::ProfilerOptions {1}};
+    auto const result = profiler.run(vm);
+    REQUIRE(result.status == VirtualMachine::RunStatus::Finished);
+    REQUIRE(result.exitCode == 1);
+
+    auto out = std::stringstream {};
+    profiler.writeFolded(out);
+    auto const folded            = out.str();
+    auto const [total, maxDepth] = parseFolded(folded);
+    REQUIRE(total == profiler.samples());
+    // one sample after each but the last instruction, tail calls skip 4 RETs
+    REQUIRE(total == (tailCalls ? 40 : 44));
+    REQUIRE_THAT(folded, Catch::StartsWith("main "));
+
+    if (tailCalls)
+    {
+        REQUIRE(maxDepth == 2);
+        REQUIRE_THAT(folded, Catch::Contains("\nmain;odd "));
+    }
+    else
+    {
+        REQUIRE(maxDepth == 6);
+        REQUIRE_THAT(folded, Catch::Contains("\nmain;even;odd;even;odd;even "));
+    }
+
+    profiler.clear();
+    REQUIRE(profiler.samples() == 0);
+}
+
+TEST_CASE("tcvm: ProfilerWithoutSymbols", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(10);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    auto profiler      = tcc::Profiler {{}, tcc::ProfilerOptions {100}};
+    REQUIRE(profiler.run(vm).exitCode == 55);
+
+    auto out = std::stringstream {};
+    profiler.writeFolded(out);
+    REQUIRE(profiler.samples() > 0);
+    REQUIRE_THAT(out.str(), Catch::StartsWith("[unknown]"));
+}
+
+TEST_CASE("tcvm: ProfilerTimer", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(25);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+
+    auto options   = tcc::ProfilerOptions {};
+    options.period = std::chrono::microseconds {200};
+    auto profiler  = tcc::Profiler {{}, options};
+    REQUIRE(profiler.run(vm).exitCode == 75025);
+    REQUIRE(profiler.samples() > 0);
+}
+
+TEST_CASE("tcvm: ProfilerSkipsStopsWithoutProgress", "[tcvm]")
+{
+    // requests a suspend after every other stop, like a timer firing while
+    // the profiler takes a sample
+    class SuspendingSink final : public tcc::OutputSink
+    {
+    public:
+        explicit SuspendingSink(VirtualMachine& vm) : vm_ {vm} { }
+        auto print(int64_t /*value*/) -> void override { }
+        auto flush() -> void override
+        {
+            if ((flushes_++ % 2) == 0) { vm_.suspend(); }
+        }
+
+    private:
+        VirtualMachine& vm_;
+        int64_t flushes_ {0};
+    };
+
+    auto const program = tcvm::createFibonacciProgram(15);
+    auto options       = tcc::ProfilerOptions {};
+    options.interval   = 100;
+
+    auto plain        = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    auto plainProfile = tcc::Profiler {{}, options};
+    REQUIRE(plainProfile.run(plain).exitCode == 610);
+
+    auto vm       = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    auto sink     = SuspendingSink {vm};
+    auto profiler = tcc::Profiler {{}, options};
+    vm.setOutput(&sink);
+    REQUIRE(profiler.run(vm).exitCode == 610);
+    REQUIRE(profiler.samples() == plainProfile.samples());
+}
@@ -0,0 +1,520 @@
+/**
+ * @file register_translator.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/register_translator.hpp"
+
+#include "tcvm/vm/decoder.hpp"
+
+#include <array>
+#include <map>
+#include <set>
+
+namespace tcc
+{
+namespace
+{
+/**
+ * @brief Symbolic content of one stack slot during translation.
+ *
+ * A Slot value lives in its own register. Register and Constant values have
+ * not been written yet, the consuming instruction reads them directly. A
+ * Register value only ever refers to a register below its own slot.
+ */
+struct Value
+{
+    enum class Kind
+    {
+        Slot,
+        Register,
+        Constant,
+    };
+
+    Kind kind {Kind::Slot};
+    int64_t value {0};
+};
+
+class Translator
+{
+public:
+    Translator(std::vector<int64_t> const& code, int64_t entryPoint)
+        : decoded_ {decode(code, entryPoint)}, entryPoint_ {entryPoint}
+    {
+        program_.indexOf.assign(code.size(), -1);
+    }
+
+    auto run() -> std::optional<RegisterProgram>
+    {
+        if (!findLeaders()) { return std::nullopt; }
+
+        auto const& instructions = decoded_.instructions;
+        for (auto i = std::size_t {0}; i < instructions.size() && !failed_; ++i)
+        {
+            current_ = instructions[i];
+            startInstruction(static_cast<int64_t>(i));
+            if (reachable_) { translate(current_); }
+        }
+
+        emit(RegisterCode::HALT);
+        if (failed_ || !resolveTargets()) { return std::nullopt; }
+
+        program_.entryPoint = program_.indexAt(entryPoint_);
+        return std::move(program_);
+    }
+
+private:
+    auto findLeaders() -> bool
+    {
+        functionStarts_[decoded_.entryPoint] = -1;
+        for (auto const& inst : decoded_.instructions)
+        {
+            if (inst.opcode == ByteCode::CALL || inst.opcode == ByteCode::SPAWN)
+            {
+                auto const [iter, inserted] = functionStarts_.insert({inst.operand, 0});
+                if (!inserted && iter->second != 0) { return false; }
+                continue;
+            }
+
+            auto const target = targetOperandIndex(inst.opcode);
+            if (target == 0) { branchTargets_.insert(inst.operand); }
+            if (target == 1) { branchTargets_.insert(inst.argument); }
+        }
+        return true;
+    }
+
+    auto startInstruction(int64_t const index) -> void
+    {
+        auto const function    = functionStarts_.find(index);
+        auto const isFunction  = function != functionStarts_.end();
+        auto const isBranchDst = branchTargets_.count(index) != 0;
+        if (!isFunction && !isBranchDst) { return; }
+
+        if (reachable_) { flushAll(); }
+        lastProducer_.reset();
+
+        if (isFunction)
+        {
+            if (reachable_ && depth() != function->second) { return fail(); }
+            base_ = function->second;
+            stack_.clear();
+            reachable_ = true;
+        }
+
+        if (isBranchDst)
+        {
+            if (reachable_) { recordDepth(index); }
+            else if (auto const known = depthAt_.find(index); known != depthAt_.end())
+            {
+                if (known->second < base_) { return fail(); }
+                stack_.assign(static_cast<std::size_t>(known->second - base_), Value {});
+                reachable_ = true;
+            }
+        }
+
+        if (!reachable_) { return; }
+
+        registerIndexOf_[index] = nextIndex();
+        if (static_cast<uint64_t>(current_.address) < program_.indexOf.size())
+        { program_.indexOf[static_cast<std::size_t>(current_.address)] = nextIndex(); }
+    }
+
+    auto translate(DecodedInstruction const& inst) -> void
+    {
+        switch (inst.opcode)
+        {
+            case ByteCode::IADD: binary(RegisterCode::IADD, [](auto a, auto b) { return a + b; }, true); break;
+            case ByteCode::ISUB: binary(RegisterCode::ISUB, [](auto a, auto b) { return a - b; }, false); break;
+            case ByteCode::IMUL: binary(RegisterCode::IMUL, [](auto a, auto b) { return a * b; }, true); break;
+            case ByteCode::ILT: binary(RegisterCode::ILT, [](auto a, auto b) { return a < b ? 1 : 0; }, false); break;
+            case ByteCode::IEQ: binary(RegisterCode::IEQ, [](auto a, auto b) { return a == b ? 1 : 0; }, true); break;
+
+            case ByteCode::ICONST: push({Value::Kind::Constant, inst.operand}); break;
+            case ByteCode::LOAD: load(inst.operand); break;
+            case ByteCode::STORE: store(inst.operand); break;
+
+            case ByteCode::GLOAD:
+            {
+                auto const dest = depth() + 1;
+                lastProducer_  = emit(RegisterCode::GLOAD, dest, inst.operand);
+                push({});
+                break;
+            }
+
+            case ByteCode::GSTORE:
+            {
+                auto const source = popToRegister();
+                emit(RegisterCode::GSTORE, inst.operand, source);
+                break;
+            }
+
+            case ByteCode::PRINT: emit(RegisterCode::PRINT, popToRegister()); break;
+            case ByteCode::POP: pop(); break;
+
+            case ByteCode::BR:
+            {
+                flushAll();
+                recordDepth(inst.operand);
+                addFixup(emit(RegisterCode::BR, 0), inst.operand);
+                reachable_ = false;
+                break;
+            }
+
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            {
+                auto const condition = pop();
+                flushAll();
+                recordDepth(inst.operand);
+                if (condition.kind == Value::Kind::Constant)
+                {
+                    auto const taken = (condition.value != 0) == (inst.opcode == ByteCode::BRT);
+                    if (taken)
+                    {
+                        addFixup(emit(RegisterCode::BR, 0), inst.operand);
+                        reachable_ = false;
+                    }
+                    break;
+                }
+
+                auto const op = inst.opcode == ByteCode::BRT ? RegisterCode::BRT : RegisterCode::BRF;
+                addFixup(emit(op, toRegister(condition, depth() + 1), 0), inst.operand);
+                break;
+            }
+
+            case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            {
+                auto const numArgs = inst.argument;
+                if (numArgs < 0 || static_cast<std::size_t>(numArgs) > stack_.size()) { return fail(); }
+
+                flushAll();
+                auto const first = depth() - numArgs + 1;
+                addFixup(emit(RegisterCode::CALL, 0, numArgs, first), inst.operand);
+                stack_.resize(stack_.size() - static_cast<std::size_t>(numArgs));
+                push({});
+                break;
+            }
+
+            case ByteCode::JOIN:
+            {
+                if (stack_.empty()) { return fail(); }
+                break;
+            }
+
+            // not translated, the VM falls back to the Switch engine
+            case ByteCode::TAILCALL:
+            case ByteCode::CALLNATIVE: return fail();
+
+            case ByteCode::RET:
+            {
+                emit(RegisterCode::RET, popToRegister());
+                reachable_ = false;
+                break;
+            }
+
+            case ByteCode::EXIT:
+            {
+                if (stack_.empty()) { return fail(); }
+                materialize(stack_.size() - 1);
+                emit(RegisterCode::EXIT, depth());
+                reachable_ = false;
+                break;
+            }
+
+            case ByteCode::HALT:
+            {
+                emit(RegisterCode::HALT);
+                reachable_ = false;
+                break;
+            }
+
+            // unknown opcode or a target inside an instruction, the engine stops there
+            case ByteCode::NOOP:
+            {
+                flushAll();
+                emit(RegisterCode::NOOP);
+                reachable_ = false;
+                break;
+            }
+
+            default:
+            {
+                if (gsl::at(Instructions, inst.opcode).isFused()) { return expand(inst); }
+                fail();
+            }
+        }
+    }
+
+    /**
+     * @brief Translates a superinstruction as the sequence it replaces.
+     */
+    auto expand(DecodedInstruction const& inst) -> void
+    {
+        auto const& fused   = gsl::at(Instructions, inst.opcode);
+        auto const operands = std::array {inst.operand, inst.argument};
+        auto next           = std::size_t {0};
+
+        for (auto k = std::size_t {0}; k < fused.fusedLength(); ++k)
+        {
+            auto part              = inst;
+            part.opcode            = fused.fuses[k];
+            auto const numOperands = gsl::at(Instructions, part.opcode).numberOfOperands;
+            if (numOperands >= 1) { part.operand = operands.at(next++); }
+            if (numOperands >= 2) { part.argument = operands.at(next++); }
+            translate(part);
+        }
+    }
+
+    template<typename Operation>
+    auto binary(RegisterCode::Type op, Operation operation, bool commutative) -> void
+    {
+        auto const rhs = pop();
+        auto const lhs = pop();
+
+        if (lhs.kind == Value::Kind::Constant && rhs.kind == Value::Kind::Constant)
+        {
+            push({Value::Kind::Constant, operation(lhs.value, rhs.value)});
+            return;
+        }
+
+        auto const dest = depth() + 1;
+        auto left       = int64_t {};
+        auto right      = int64_t {};
+        auto isK        = rhs.kind == Value::Kind::Constant;
+        if (commutative && lhs.kind == Value::Kind::Constant)
+        {
+            left  = toRegister(rhs, dest + 1);
+            right = lhs.value;
+            isK   = true;
+        }
+        else
+        {
+            left  = toRegister(lhs, dest);
+            right = isK ? rhs.value : toRegister(rhs, dest + 1);
+        }
+
+        lastProducer_ = emit(static_cast<RegisterCode::Type>(op + (isK ? 1 : 0)), dest, left, right);
+        push({});
+    }
+
+    auto load(int64_t const offset) -> void
+    {
+        if (offset > depth()) { return fail(); }
+        if (offset > base_)
+        {
+            auto const& value = stack_[slotIndex(offset)];
+            push(value.kind == Value::Kind::Slot ? Value {Value::Kind::Register, offset} : value);
+            return;
+        }
+
+        push({Value::Kind::Register, offset});
+    }
+
+    auto store(int64_t const offset) -> void
+    {
+        auto const value = pop();
+        prepareWrite(offset);
+
+        // a slot on the operand stack can take the value symbolically, stores
+        // above the stack write a dead register, same as the stack engines
+        auto const isSlot = offset > base_ && offset <= depth();
+        if (isSlot)
+        {
+            auto const lazy = value.kind == Value::Kind::Constant
+                              || (value.kind == Value::Kind::Register && (value.value <= base_ || value.value < offset));
+            if (lazy)
+            {
+                stack_[slotIndex(offset)] = value;
+                return;
+            }
+        }
+
+        writeRegister(offset, value, depth() + 1);
+        if (isSlot) { stack_[slotIndex(offset)] = Value {}; }
+    }
+
+    auto writeRegister(int64_t const dest, Value const& value, int64_t const position) -> void
+    {
+        switch (value.kind)
+        {
+            case Value::Kind::Constant: emit(RegisterCode::MOVK, dest, value.value); break;
+            case Value::Kind::Register:
+            {
+                if (value.value != dest) { emit(RegisterCode::MOV, dest, value.value); }
+                break;
+            }
+            case Value::Kind::Slot:
+            {
+                // retarget the instruction that produced the value
+                auto& instructions = program_.instructions;
+                if (lastProducer_.has_value() && *lastProducer_ + 1 == instructions.size()
+                    && instructions.back().a == position)
+                {
+                    instructions.back().a = dest;
+                    break;
+                }
+                if (position != dest) { emit(RegisterCode::MOV, dest, position); }
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Materializes every symbolic value that reads register, so it can
+     * be overwritten.
+     */
+    auto prepareWrite(int64_t const reg) -> void
+    {
+        for (auto i = std::size_t {0}; i < stack_.size(); ++i)
+        {
+            if (stack_[i].kind == Value::Kind::Register && stack_[i].value == reg) { materialize(i); }
+        }
+    }
+
+    auto materialize(std::size_t const index) -> void
+    {
+        auto& value = stack_[index];
+        if (value.kind == Value::Kind::Slot) { return; }
+        writeRegister(positionOf(index), value, positionOf(index));
+        value = Value {};
+    }
+
+    auto flushAll() -> void
+    {
+        for (auto i = std::size_t {0}; i < stack_.size(); ++i) { materialize(i); }
+        lastProducer_.reset();
+    }
+
+    /**
+     * @brief Returns a register holding value, which was popped from the given
+     * stack position. Constants get written to that position first.
+     */
+    auto toRegister(Value const& value, int64_t const position) -> int64_t
+    {
+        switch (value.kind)
+        {
+            case Value::Kind::Register: return value.value;
+            case Value::Kind::Constant: emit(RegisterCode::MOVK, position, value.value); return position;
+            case Value::Kind::Slot: return position;
+        }
+        return position;
+    }
+
+    auto popToRegister() -> int64_t
+    {
+        auto const value = pop();
+        return toRegister(value, depth() + 1);
+    }
+
+    auto recordDepth(int64_t const target) -> void
+    {
+        auto const [iter, inserted] = depthAt_.insert({target, depth()});
+        if (!inserted && iter->second != depth()) { fail(); }
+    }
+
+    auto addFixup(std::size_t const instruction, int64_t const target) -> void
+    {
+        fixups_.emplace_back(instruction, target);
+    }
+
+    auto resolveTargets() -> bool
+    {
+        for (auto const& [instruction, target] : fixups_)
+        {
+            auto const index = registerIndexOf_.find(target);
+            if (index == registerIndexOf_.end()) { return false; }
+
+            auto& inst = program_.instructions[instruction];
+            switch (inst.opcode)
+            {
+                case RegisterCode::BR:
+                case RegisterCode::CALL: inst.a = index->second; break;
+                default: inst.b = index->second; break;
+            }
+        }
+        return true;
+    }
+
+    auto emit(RegisterCode::Type op, int64_t a = 0, int64_t b = 0, int64_t c = 0) -> std::size_t
+    {
+        auto inst    = RegisterInstruction {};
+        inst.opcode  = op;
+        inst.a       = a;
+        inst.b       = b;
+        inst.c       = c;
+        inst.address = current_.address;
+        program_.instructions.push_back(inst);
+        return program_.instructions.size() - 1;
+    }
+
+    auto push(Value const& value) -> void { stack_.push_back(value); }
+
+    auto pop() -> Value
+    {
+        if (stack_.empty())
+        {
+            fail();
+            return {};
+        }
+        auto const value = stack_.back();
+        stack_.pop_back();
+        return value;
+    }
+
+    auto fail() -> void { failed_ = true; }
+
+    [[nodiscard]] auto depth() const -> int64_t { return base_ + static_cast<int64_t>(stack_.size()); }
+    [[nodiscard]] auto positionOf(std::size_t index) const -> int64_t
+    {
+        return base_ + 1 + static_cast<int64_t>(index);
+    }
+    [[nodiscard]] auto slotIndex(int64_t position) const -> std::size_t
+    {
+        return static_cast<std::size_t>(position - base_ - 1);
+    }
+    [[nodiscard]] auto nextIndex() const -> int64_t { return static_cast<int64_t>(program_.instructions.size()); }
+
+    DecodedProgram decoded_;
+    int64_t entryPoint_;
+    RegisterProgram program_ {};
+    DecodedInstruction current_ {};
+
+    std::map<int64_t, int64_t> functionStarts_ {};  // decoded index -> base depth
+    std::set<int64_t> branchTargets_ {};            // decoded indices
+    std::map<int64_t, int64_t> depthAt_ {};         // decoded index -> depth
+    std::map<int64_t, int64_t> registerIndexOf_ {};  // decoded index -> register index
+    std::vector<std::pair<std::size_t, int64_t>> fixups_ {};
+
+    std::vector<Value> stack_ {};
+    int64_t base_ {0};
+    bool reachable_ {false};
+    bool failed_ {false};
+    std::optional<std::size_t> lastProducer_ {};
+};
+}  // namespace
+
+auto operator<<(std::ostream& out, RegisterProgram const& program) -> std::ostream&
+{
+    for (auto i = std::size_t {0}; i < program.instructions.size(); ++i)
+    {
+        auto const& inst       = program.instructions[i];
+        auto const opcode      = static_cast<RegisterCode::Type>(inst.opcode);
+        auto const numOperands = gsl::at(RegisterInstructions, inst.opcode).numberOfOperands;
+
+        out << fmt::format("{:04}: {}", i, opcode);
+        if (numOperands >= 1) { out << fmt::format(" {}", inst.a); }
+        if (numOperands >= 2) { out << fmt::format(", {}", inst.b); }
+        if (numOperands >= 3) { out << fmt::format(", {}", inst.c); }
+        out << '\n';
+    }
+    return out;
+}
+
+auto translateToRegisterCode(std::vector<int64_t> const& code, int64_t const entryPoint)
+    -> std::optional<RegisterProgram>
+{
+    return Translator {code, entryPoint}.run();
+}
+
+}  // namespace tcc
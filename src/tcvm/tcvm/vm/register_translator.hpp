@@ -0,0 +1,98 @@
+/**
+ * @file register_translator.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief One three-address instruction of the register engine.
+ */
+struct RegisterInstruction
+{
+    void const* handler {nullptr};  // filled in by the executing engine
+    int64_t opcode {RegisterCode::NOOP};
+    int64_t a {0};
+    int64_t b {0};
+    int64_t c {0};
+    int64_t address {0};  // address of the originating instruction in the stack code
+};
+
+/**
+ * @brief Register code translated from stack byte code. The last instruction
+ * is always a HALT.
+ */
+struct RegisterProgram
+{
+    std::vector<RegisterInstruction> instructions {};
+    std::vector<int64_t> indexOf {};  // stack code address -> instruction index, -1 if not a jump target
+    int64_t entryPoint {0};
+
+    /**
+     * @brief Returns the instruction index for a stack code address, or the
+     * index of the trailing HALT if the address is not a jump target.
+     */
+    [[nodiscard]] auto indexAt(int64_t address) const noexcept -> int64_t
+    {
+        if (static_cast<uint64_t>(address) >= indexOf.size()) { return haltIndex(); }
+        auto const index = indexOf[static_cast<std::size_t>(address)];
+        return index < 0 ? haltIndex() : index;
+    }
+
+    [[nodiscard]] auto haltIndex() const noexcept -> int64_t
+    {
+        return static_cast<int64_t>(instructions.size()) - 1;
+    }
+
+    /**
+     * @brief Returns the stack code address behind the CALL that saved the
+     * return index, or std::nullopt if no CALL precedes the index.
+     */
+    [[nodiscard]] auto returnAddressAt(int64_t const index) const noexcept -> std::optional<int64_t>
+    {
+        if (index < 1 || index > haltIndex()) { return std::nullopt; }
+        auto const& call = instructions[static_cast<std::size_t>(index - 1)];
+        if (call.opcode != RegisterCode::CALL) { return std::nullopt; }
+        return call.address + 3;  // CALL & SPAWN have two operands
+    }
+
+    /**
+     * @brief Inverse of returnAddressAt(). Instructions are emitted in stack
+     * code order, so their addresses are sorted.
+     */
+    [[nodiscard]] auto returnIndexAt(int64_t const address) const noexcept -> std::optional<int64_t>
+    {
+        auto const callAddress = address - 3;
+        auto call              = std::lower_bound(instructions.begin(), instructions.end(), callAddress,
+                                     [](auto const& inst, int64_t const key) { return inst.address < key; });
+        for (; call != instructions.end() && call->address == callAddress; ++call)
+        {
+            if (call->opcode == RegisterCode::CALL) { return (call - instructions.begin()) + 1; }
+        }
+        return std::nullopt;
+    }
+};
+
+auto operator<<(std::ostream& out, RegisterProgram const& program) -> std::ostream&;
+
+/**
+ * @brief Translates stack byte code into register code.
+ *
+ * Every stack slot becomes the register at the same frame offset. Loads and
+ * constants are kept symbolic until an instruction consumes them, so
+ * `LOAD n; ICONST k; ISUB` becomes a single `ISUBK`. Stack depths have to be
+ * the same on every path into a jump target, otherwise std::nullopt is
+ * returned and the program has to run on a stack engine.
+ */
+auto translateToRegisterCode(std::vector<int64_t> const& code, int64_t entryPoint) -> std::optional<RegisterProgram>;
+
+}  // namespace tcc
@@ -0,0 +1,78 @@
+/**
+ * @file register_translator_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/register_translator.hpp"
+#include "tcvm/vm/decoder.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+
+#include <algorithm>
+
+using tcc::ByteCode;
+using tcc::RegisterCode;
+
+namespace
+{
+auto countOpcode(tcc::RegisterProgram const& program, RegisterCode::Type opcode) -> std::ptrdiff_t
+{
+    auto const& insts = program.instructions;
+    return std::count_if(begin(insts), end(insts), [opcode](auto const& inst) { return inst.opcode == opcode; });
+}
+}  // namespace
+
+TEST_CASE("tcvm: RegisterTranslateConstantOperands", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,  // 0
+        ByteCode::ICONST, 2,   // 2
+        ByteCode::ILT,         // 4
+        ByteCode::ICONST, 3,   // 5
+        ByteCode::ICONST, 4,   // 7
+        ByteCode::IMUL,        // 9 folded
+        ByteCode::IADD,        // 10
+        ByteCode::EXIT,        // 11
+    };
+
+    auto const program = tcc::translateToRegisterCode(code, 0);
+    REQUIRE(program.has_value());
+
+    auto const& insts = program->instructions;
+    REQUIRE(insts.size() == 4);
+    CHECK(insts[0].opcode == RegisterCode::ILTK);
+    CHECK(insts[0].b == -3);
+    CHECK(insts[0].c == 2);
+    CHECK(insts[1].opcode == RegisterCode::IADDK);
+    CHECK(insts[1].c == 12);
+    CHECK(insts[2].opcode == RegisterCode::EXIT);
+    CHECK(insts[3].opcode == RegisterCode::HALT);
+}
+
+TEST_CASE("tcvm: RegisterTranslateFibonacci", "[tcvm]")
+{
+    auto const binary  = tcvm::createFibonacciProgram(3);
+    auto const program = tcc::translateToRegisterCode(binary.data, binary.entryPoint);
+    REQUIRE(program.has_value());
+
+    // LOAD, ICONST & ISUB collapse into one ISUBK per call
+    CHECK(countOpcode(program.value(), RegisterCode::ISUBK) == 2);
+    CHECK(countOpcode(program.value(), RegisterCode::ILTK) == 1);
+    CHECK(countOpcode(program.value(), RegisterCode::CALL) == 3);
+    CHECK(program->instructions.size() < tcc::decode(binary).instructions.size());
+    CHECK(program->entryPoint == program->indexAt(binary.entryPoint));
+}
+
+TEST_CASE("tcvm: RegisterTranslateInconsistentDepth", "[tcvm]")
+{
+    auto const code = std::vector<int64_t> {
+        ByteCode::GLOAD,  0,  // 0
+        ByteCode::BRT,    6,  // 2
+        ByteCode::ICONST, 7,  // 4
+        ByteCode::ICONST, 9,  // 6
+        ByteCode::EXIT,       // 8
+    };
+
+    CHECK_FALSE(tcc::translateToRegisterCode(code, 0).has_value());
+}
@@ -0,0 +1,351 @@
+/**
+ * @file scheduler.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace tcc
+{
+namespace
+{
+// a task handle is the generation of the run, the index of the spawning
+// worker & the index of the task in its table, from high to low bits
+constexpr auto GenerationBits = 15U;
+constexpr auto WorkerBits     = 16U;
+constexpr auto IndexBits      = 32U;
+constexpr auto MaxWorkers     = std::size_t {1} << WorkerBits;
+}  // namespace
+
+Scheduler::Scheduler(SchedulerOptions options)
+    : options_ {options}, threads_ {std::clamp(options.threads, std::size_t {1}, MaxWorkers)}, data_(options.dataSize, 0)
+{
+}
+
+auto Scheduler::run(BinaryProgram const& program, std::ostream& out) -> int64_t
+{
+    return run(program.data, program.entryPoint, out);
+}
+
+auto Scheduler::run(std::vector<int64_t> const& code, int64_t const entryPoint, std::ostream& out) -> int64_t
+{
+    if (nativesUsed(code) > natives_.size())
+    {
+        status_ = RunStatus::MissingNatives;
+        return -1;
+    }
+
+    generation_ = generation_ % ((uint64_t {1} << GenerationBits) - 1) + 1;  // handles of earlier runs are invalid
+    exitCode_   = -1;
+    status_     = RunStatus::Finished;
+    finished_.store(false);
+    sleeping_.store(0);
+
+    workers_.clear();
+    for (auto i = std::size_t {0}; i < threads_; ++i)
+    {
+        auto& worker = *workers_.emplace_back(std::make_unique<Worker>(*this));
+        worker.index = i;
+        worker.output.emplace(out, OutputSink::DefaultCapacity, &outputMutex_);
+        worker.vm = std::make_unique<VirtualMachine>(code, static_cast<uint64_t>(entryPoint), 0, 0, false, out);
+        worker.vm->setNatives(natives_);
+        worker.vm->setCallHeadroom(options_.callHeadroom);
+        worker.vm->setOutput(&*worker.output);
+        worker.vm->setTaskHost(&worker);
+    }
+
+    auto* main                       = allocate(*workers_[0]);
+    main->context.instructionPointer = entryPoint;
+    workers_[0]->ready.push_back(main);
+
+    for (auto i = std::size_t {0}; i < threads_; ++i)
+    { workers_[i]->thread = std::thread([this, i] { work(i); }); }
+    for (auto& worker : workers_) { worker->thread.join(); }
+
+    stats_ = {};
+    for (auto const& worker : workers_)
+    {
+        stats_.tasks += worker->stats.tasks;
+        stats_.steals += worker->stats.steals;
+        stats_.suspensions += worker->stats.suspensions;
+    }
+
+    workers_.clear();
+    return exitCode_;
+}
+
+auto Scheduler::work(std::size_t const index) -> void
+{
+    auto& worker = *workers_[index];
+    while (!finished_.load(std::memory_order_acquire))
+    {
+        auto* fiber = tryPop(index);
+        if (fiber == nullptr) { fiber = sleep(index); }
+        if (fiber != nullptr) { execute(worker, fiber); }
+    }
+    worker.output->flush();
+}
+
+/**
+ * @brief Runs the fiber on the machine of the worker until the fiber & every
+ * task it switched to either finished or got parked.
+ */
+auto Scheduler::execute(Worker& worker, Fiber* fiber) -> void
+{
+    auto& vm = *worker.vm;
+    while (fiber != nullptr)
+    {
+        worker.spawned = nullptr;
+        worker.joining = nullptr;
+        vm.swapContext(fiber->context);
+        auto const exitCode = vm.cpu();
+        vm.swapContext(fiber->context);
+
+        switch (vm.status())
+        {
+            case VirtualMachine::RunStatus::Yielded: break;
+            case VirtualMachine::RunStatus::Cancelled: return;
+            case VirtualMachine::RunStatus::StackOverflow: finish(-1, RunStatus::StackOverflow); return;
+            case VirtualMachine::RunStatus::InvalidInstruction: finish(-1, RunStatus::InvalidInstruction); return;
+            default: finish(exitCode); return;
+        }
+
+        auto const& context = fiber->context;
+        if (worker.spawned != nullptr)
+        {
+            // the spawner continues with the handle once its queued
+            // continuation gets picked up
+            push(worker, fiber);
+            worker.stats.tasks++;
+            fiber = worker.spawned;
+        }
+        else if (context.instructionPointer == TaskHost::TaskReturn)
+        {
+            fiber = complete(worker, fiber, context.stack[context.stackPointer]);
+        }
+        else if (worker.joining == nullptr)
+        {
+            finish(-1, RunStatus::InvalidHandle);
+            return;
+        }
+        else
+        {
+            // parked on the JOIN itself, which runs again once the task completed
+            auto* const task = worker.joining;
+            auto const lock  = std::scoped_lock {task->mutex};
+            if (!task->done.load(std::memory_order_relaxed))
+            {
+                task->waiters.push_back(fiber);
+                worker.stats.suspensions++;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief The callee frame moves to the stack of a new fiber, which runs next.
+ */
+auto Scheduler::Worker::spawn(int64_t const address, std::span<int64_t const> arguments) -> std::optional<int64_t>
+{
+    auto const numArgs = static_cast<int64_t>(arguments.size());
+    auto* const child  = scheduler.allocate(*this);
+    auto& context      = child->context;
+    // the machine commits the rest of the frame once it enters the task
+    if (!context.stack.grow(arguments.size() + 3))
+    {
+        spare.push_back(child);
+        return std::nullopt;
+    }
+
+    auto const [task, slot] = tasks.append();
+    child->task             = task;
+
+    std::copy(arguments.begin(), arguments.end(), context.stack.data());
+    context.stack[numArgs]     = numArgs;
+    context.stack[numArgs + 1] = 0;
+    context.stack[numArgs + 2] = TaskReturn;
+    context.stackPointer       = numArgs + 2;
+    context.framePointer       = context.stackPointer;
+    context.instructionPointer = address;
+
+    spawned = child;
+    return scheduler.handleOf(*this, slot);
+}
+
+auto Scheduler::Worker::join(int64_t const handle) -> std::optional<int64_t>
+{
+    joining = scheduler.findTask(handle);
+    if (joining == nullptr || !joining->done.load(std::memory_order_acquire)) { return std::nullopt; }
+    return joining->result;
+}
+
+auto Scheduler::allocate(Worker& worker) -> Fiber*
+{
+    if (!worker.spare.empty())
+    {
+        auto* const fiber = worker.spare.back();
+        worker.spare.pop_back();
+        return fiber;
+    }
+
+    auto& fiber          = worker.fibers.emplace_back(std::make_unique<Fiber>());
+    fiber->context.stack = VmStack {options_.stackSize, options_.maxStackSize};
+    return fiber.get();
+}
+
+/**
+ * @brief Publishes the result of a task & recycles its fiber. Returns one of
+ * the parked joiners to continue with, the others get queued.
+ */
+auto Scheduler::complete(Worker& worker, Fiber* fiber, int64_t const result) -> Fiber*
+{
+    auto waiters = std::vector<Fiber*> {};
+    {
+        auto* const task = fiber->task;
+        auto const lock  = std::scoped_lock {task->mutex};
+        task->result     = result;
+        task->done.store(true, std::memory_order_release);
+        std::swap(waiters, task->waiters);
+    }
+
+    fiber->task = nullptr;
+    worker.spare.push_back(fiber);
+
+    if (waiters.empty()) { return nullptr; }
+    std::for_each(begin(waiters) + 1, end(waiters), [&](auto* waiter) { push(worker, waiter); });
+    return waiters.front();
+}
+
+auto Scheduler::handleOf(Worker const& worker, uint32_t const task) const noexcept -> int64_t
+{
+    auto const handle = (generation_ << (WorkerBits + IndexBits)) | (worker.index << IndexBits) | task;
+    return static_cast<int64_t>(handle);
+}
+
+/**
+ * @brief The task a handle refers to, nullptr unless it was spawned during
+ * the current run.
+ */
+auto Scheduler::findTask(int64_t const handle) const noexcept -> Task*
+{
+    auto const bits       = static_cast<uint64_t>(handle);
+    auto const generation = bits >> (WorkerBits + IndexBits);
+    auto const worker     = (bits >> IndexBits) & (MaxWorkers - 1);
+    auto const index      = bits & ((uint64_t {1} << IndexBits) - 1);
+    if (generation != generation_ || worker >= workers_.size()) { return nullptr; }
+    return workers_[worker]->tasks.find(index);
+}
+
+auto Scheduler::TaskTable::append() -> std::pair<Task*, uint32_t>
+{
+    auto const index  = size_.load(std::memory_order_relaxed);
+    auto const chunk  = std::bit_width(index / FirstChunk + 1) - 1;
+    auto const offset = index - FirstChunk * ((uint64_t {1} << chunk) - 1);
+    if (offset == 0) { chunks_.at(chunk) = std::make_unique<Task[]>(FirstChunk << chunk); }
+
+    // publishes the chunk to find() on other threads
+    size_.store(index + 1, std::memory_order_release);
+    return {&chunks_[chunk][offset], static_cast<uint32_t>(index)};
+}
+
+auto Scheduler::TaskTable::find(uint64_t const index) const noexcept -> Task*
+{
+    if (index >= size_.load(std::memory_order_acquire)) { return nullptr; }
+    auto const chunk  = std::bit_width(index / FirstChunk + 1) - 1;
+    auto const offset = index - FirstChunk * ((uint64_t {1} << chunk) - 1);
+    return &chunks_[chunk][offset];
+}
+
+auto Scheduler::finish(int64_t const exitCode, RunStatus const status) -> void
+{
+    if (finished_.exchange(true)) { return; }
+    exitCode_ = exitCode;
+    status_   = status;
+
+    {
+        auto const lock = std::scoped_lock {sleepMutex_};
+        ++epoch_;
+    }
+    wakeUp_.notify_all();
+}
+
+auto Scheduler::push(Worker& worker, Fiber* fiber) -> void
+{
+    // the fiber may be stolen, its lines have to come first
+    worker.output->flush();
+
+    {
+        auto const lock = std::scoped_lock {worker.mutex};
+        worker.ready.push_back(fiber);
+    }
+
+    // pairs with the fence in sleep(), either the sleeper sees the fiber or
+    // this sees the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) == 0) { return; }
+
+    {
+        auto const lock = std::scoped_lock {sleepMutex_};
+        ++epoch_;
+    }
+    wakeUp_.notify_one();
+}
+
+auto Scheduler::tryPop(std::size_t const index) -> Fiber*
+{
+    auto& own = *workers_[index];
+    {
+        auto const lock = std::scoped_lock {own.mutex};
+        if (!own.ready.empty())
+        {
+            auto* const fiber = own.ready.back();
+            own.ready.pop_back();
+            return fiber;
+        }
+    }
+
+    for (auto offset = std::size_t {1}; offset < workers_.size(); ++offset)
+    {
+        auto& victim    = *workers_[(index + offset) % workers_.size()];
+        auto const lock = std::scoped_lock {victim.mutex};
+        if (!victim.ready.empty())
+        {
+            auto* const fiber = victim.ready.front();
+            victim.ready.pop_front();
+            own.stats.steals++;
+            return fiber;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Announces the worker as sleeping, looks for work once more & waits
+ * for the next push or the end of the program otherwise.
+ */
+auto Scheduler::sleep(std::size_t const index) -> Fiber*
+{
+    auto lock        = std::unique_lock {sleepMutex_};
+    auto const epoch = epoch_;
+    sleeping_.fetch_add(1, std::memory_order_relaxed);
+    lock.unlock();
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto* fiber = tryPop(index);
+
+    lock.lock();
+    if (fiber == nullptr)
+    {
+        wakeUp_.wait(lock, [this, epoch] { return epoch_ != epoch || finished_.load(std::memory_order_relaxed); });
+    }
+    sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    return fiber;
+}
+
+}  // namespace tcc
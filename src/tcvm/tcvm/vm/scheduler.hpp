@@ -0,0 +1,210 @@
+/**
+ * @file scheduler.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/natives.hpp"
+#include "tcvm/vm/output_sink.hpp"
+#include "tcvm/vm/task_host.hpp"
+#include "tcvm/vm/vm.hpp"
+#include "tcvm/vm/vm_stack.hpp"
+
+namespace tcc
+{
+struct SchedulerOptions
+{
+    std::size_t threads {std::thread::hardware_concurrency()};  // at least one
+    uint64_t stackSize {200};                                    // initial slots per task
+    uint64_t maxStackSize {VmStack::DefaultReserve};             // slots a task may grow to
+    uint64_t callHeadroom {VmStack::CallHeadroom};               // see VirtualMachine::setCallHeadroom()
+    uint64_t dataSize {0};
+};
+
+struct SchedulerStats
+{
+    int64_t tasks {0};        // executed SPAWNs
+    int64_t steals {0};       // tasks taken from the queue of another worker
+    int64_t suspensions {0};  // JOINs that had to wait for their task
+};
+
+/**
+ * @brief Runs a program as green threads on a fixed number of worker threads.
+ *
+ * Every SPAWN creates a task with its own VmStack, which grows at calls up
+ * to maxStackSize slots like the stack of a VirtualMachine. A CALL or SPAWN
+ * that does not fit ends the program with RunStatus::StackOverflow. The
+ * spawning worker runs the task right away and queues the continuation of the
+ * spawner, idle workers steal continuations from the front of the other
+ * queues, so the oldest & usually largest piece of work moves between threads.
+ * A JOIN on a task that is still running parks the joining task until the
+ * result arrives, its worker picks up other work meanwhile. JOIN only accepts
+ * handles created by SPAWN during the same run, any other value ends the
+ * program with RunStatus::InvalidHandle. Programs are not verified, an unknown
+ * opcode ends the program with RunStatus::InvalidInstruction.
+ *
+ * Every worker owns a VirtualMachine which executes the instructions, the
+ * worker is its TaskHost & swaps the TaskContext of the next fiber in whenever
+ * the machine stops at a SPAWN, a blocking JOIN or the last RET of a task.
+ *
+ * Globals are shared by all tasks. Every worker buffers PRINT in its own
+ * sink, which is flushed before another worker may continue one of its
+ * fibers, so the lines of a task keep their order. The first EXIT
+ * or HALT ends the program, running tasks stop at their next backward branch.
+ */
+class Scheduler
+{
+public:
+    /**
+     * @brief Why the last run() returned.
+     */
+    enum class RunStatus
+    {
+        Finished,            // EXIT or HALT, the exit code is valid
+        StackOverflow,       // a CALL or SPAWN did not fit into the maximum stack size of a task
+        InvalidHandle,       // JOIN on a value that is not a task of the current run
+        InvalidInstruction,  // a task reached an opcode the scheduler can not execute
+        MissingNatives,      // CALLNATIVE indexes past the table passed to setNatives(), nothing ran
+    };
+
+    explicit Scheduler(SchedulerOptions options = {});
+
+    auto run(std::vector<int64_t> const& code, int64_t entryPoint, std::ostream& out = std::cout) -> int64_t;
+    auto run(BinaryProgram const& program, std::ostream& out = std::cout) -> int64_t;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return threads_; }
+
+    /**
+     * @brief Host functions CALLNATIVE indexes into, see resolveNatives().
+     * Workers call them concurrently, so they have to be thread safe. A
+     * program with a CALLNATIVE past the end of the table does not start.
+     */
+    auto setNatives(std::vector<NativeFunction> natives) -> void { natives_ = std::move(natives); }
+
+    /**
+     * @brief Shared by all runs, cleared only on construction.
+     */
+    [[nodiscard]] auto globals() noexcept -> std::span<int64_t> { return data_; }
+
+    [[nodiscard]] auto status() const noexcept -> RunStatus { return status_; }
+
+    /**
+     * @brief Counters of the last run.
+     */
+    [[nodiscard]] auto stats() const noexcept -> SchedulerStats const& { return stats_; }
+
+private:
+    struct Fiber;
+
+    struct Task
+    {
+        std::atomic<bool> done {false};
+        int64_t result {0};
+        std::mutex mutex {};
+        std::vector<Fiber*> waiters {};  // parked in JOIN, guarded by mutex
+    };
+
+    /**
+     * @brief Tasks spawned by one worker during a run. Only the owning thread
+     * appends, any thread may look them up by index. Tasks never move, the
+     * chunks double in size.
+     */
+    class TaskTable
+    {
+    public:
+        auto append() -> std::pair<Task*, uint32_t>;
+        [[nodiscard]] auto find(uint64_t index) const noexcept -> Task*;  // nullptr if not appended
+
+    private:
+        static constexpr auto FirstChunk = uint64_t {64};
+
+        std::array<std::unique_ptr<Task[]>, 27> chunks_ {};  // enough for every uint32_t index
+        std::atomic<uint64_t> size_ {0};
+    };
+
+    struct Fiber
+    {
+        TaskContext context {};
+        Task* task {nullptr};  // nullptr for the fiber running the entry point
+    };
+
+    struct Worker final : TaskHost
+    {
+        explicit Worker(Scheduler& owner) : scheduler {owner} { }
+
+        auto spawn(int64_t address, std::span<int64_t const> arguments) -> std::optional<int64_t> override;
+        auto join(int64_t handle) -> std::optional<int64_t> override;
+        auto globals() noexcept -> std::span<int64_t> override { return scheduler.data_; }
+        [[nodiscard]] auto finished() const noexcept -> std::atomic<bool> const& override
+        {
+            return scheduler.finished_;
+        }
+
+        Scheduler& scheduler;
+        std::unique_ptr<VirtualMachine> vm {};  // runs the fibers of this worker
+        Fiber* spawned {nullptr};               // by the last SPAWN of the running fiber
+        Task* joining {nullptr};                // by the last JOIN of the running fiber, nullptr if invalid
+
+        std::mutex mutex {};
+        std::deque<Fiber*> ready {};  // the owner works at the back, thieves at the front
+        std::thread thread {};
+
+        TaskTable tasks {};
+        uint64_t index {0};                    // into workers_, part of every task handle
+        std::optional<StreamSink> output {};  // PRINT, shares outputMutex_ with the other workers
+
+        // only touched by the owning thread, released after the run
+        std::vector<std::unique_ptr<Fiber>> fibers {};
+        std::vector<Fiber*> spare {};
+        SchedulerStats stats {};
+    };
+
+    auto work(std::size_t index) -> void;
+    auto execute(Worker& worker, Fiber* fiber) -> void;
+    auto allocate(Worker& worker) -> Fiber*;
+    auto complete(Worker& worker, Fiber* fiber, int64_t result) -> Fiber*;
+    [[nodiscard]] auto handleOf(Worker const& worker, uint32_t task) const noexcept -> int64_t;
+    [[nodiscard]] auto findTask(int64_t handle) const noexcept -> Task*;
+    auto finish(int64_t exitCode, RunStatus status = RunStatus::Finished) -> void;
+
+    auto push(Worker& worker, Fiber* fiber) -> void;
+    auto tryPop(std::size_t index) -> Fiber*;
+    auto sleep(std::size_t index) -> Fiber*;
+
+    SchedulerOptions options_;
+    std::size_t threads_ {1};
+    std::vector<int64_t> data_ {};
+    std::vector<NativeFunction> natives_ {};
+    SchedulerStats stats_ {};
+
+    uint64_t generation_ {0};  // of the current run, part of every task handle
+    std::mutex outputMutex_ {};
+    std::vector<std::unique_ptr<Worker>> workers_ {};
+
+    std::atomic<bool> finished_ {false};
+    int64_t exitCode_ {-1};                   // written by the worker that finished the program
+    RunStatus status_ {RunStatus::Finished};  // written by the worker that finished the program
+
+    std::mutex sleepMutex_ {};
+    std::condition_variable wakeUp_ {};
+    std::atomic<std::size_t> sleeping_ {0};
+    uint64_t epoch_ {0};  // bumped for every wake up, guarded by sleepMutex_
+};
+
+}  // namespace tcc
@@ -0,0 +1,277 @@
+/**
+ * @file scheduler_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/scheduler.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/verifier.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <sstream>
+
+using tcc::ByteCode;
+using tcc::VirtualMachine;
+
+namespace
+{
+// square(x) { print(x); return x * x; }
+// main() { a = spawn(square(2)); b = spawn(square(3)); g0 = join(a) + join(b) + join(a); return g0; }
+auto const squares = std::vector<int64_t> {
+    ByteCode::LOAD,   -3,    // 0
+    ByteCode::PRINT,         // 2
+    ByteCode::LOAD,   -3,    // 3
+    ByteCode::LOAD,   -3,    // 5
+    ByteCode::IMUL,          // 7
+    ByteCode::RET,           // 8
+    ByteCode::ICONST, 2,     // 9 <-- main
+    ByteCode::SPAWN,  0, 1,  // 11
+    ByteCode::ICONST, 3,     // 14
+    ByteCode::SPAWN,  0, 1,  // 16
+    ByteCode::LOAD,   0,     // 19
+    ByteCode::JOIN,          // 21
+    ByteCode::LOAD,   1,     // 22
+    ByteCode::JOIN,          // 24
+    ByteCode::IADD,          // 25
+    ByteCode::LOAD,   0,     // 26
+    ByteCode::JOIN,          // 28
+    ByteCode::IADD,          // 29
+    ByteCode::GSTORE, 0,     // 30
+    ByteCode::GLOAD,  0,     // 32
+    ByteCode::EXIT,          // 34
+};
+
+auto fibonacci(int64_t n) -> int64_t { return n < 2 ? n : fibonacci(n - 1) + fibonacci(n - 2); }
+
+auto spawns(int64_t n, int64_t cutoff) -> int64_t
+{
+    return n < cutoff ? 0 : 1 + spawns(n - 1, cutoff) + spawns(n - 2, cutoff);
+}
+}  // namespace
+
+TEST_CASE("tcvm: SchedulerFibonacci", "[tcvm]")
+{
+    auto const threads = GENERATE(std::size_t {1}, std::size_t {2}, std::size_t {4});
+    auto const cutoff  = GENERATE(int64_t {2}, int64_t {8});
+    auto const program = tcvm::createParallelFibonacciProgram(16, cutoff);
+
+    auto options      = tcc::SchedulerOptions {};
+    options.threads   = threads;
+    options.stackSize = 64;
+    auto scheduler    = tcc::Scheduler {options};
+    REQUIRE(scheduler.size() == threads);
+
+    for (auto run = 0; run < 3; ++run)
+    {
+        REQUIRE(scheduler.run(program) == fibonacci(16));
+        REQUIRE(scheduler.stats().tasks == spawns(16, cutoff));
+    }
+
+    // a single worker always finishes the task before the spawner continues
+    if (threads == 1)
+    {
+        REQUIRE(scheduler.stats().steals == 0);
+        REQUIRE(scheduler.stats().suspensions == 0);
+    }
+}
+
+TEST_CASE("tcvm: SchedulerMatchesVirtualMachine", "[tcvm]")
+{
+    auto const program = tcvm::createParallelFibonacciProgram(12, 4);
+    REQUIRE(tcc::verify(program).ok());
+
+    // without a scheduler SPAWN is a call & JOIN does nothing
+    for (auto const engine : {VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                              VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                              VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact})
+    {
+        auto vm = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout, engine);
+        REQUIRE(vm.cpu() == fibonacci(12));
+    }
+}
+
+TEST_CASE("tcvm: SchedulerJoinPrintAndGlobals", "[tcvm]")
+{
+    REQUIRE(tcc::verify(squares, 9).ok());
+
+    for (auto const threads : {std::size_t {1}, std::size_t {3}})
+    {
+        auto options     = tcc::SchedulerOptions {};
+        options.threads  = threads;
+        options.dataSize = 1;
+        auto scheduler   = tcc::Scheduler {options};
+
+        auto out = std::stringstream {};
+        REQUIRE(scheduler.run(squares, 9, out) == 17);
+        REQUIRE(scheduler.globals()[0] == 17);
+        REQUIRE(scheduler.stats().tasks == 2);
+
+        auto const output = out.str();
+        REQUIRE((output == "2\n3\n" || output == "3\n2\n"));
+    }
+
+    auto out = std::stringstream {};
+    auto vm  = VirtualMachine(squares, 9, 1, 200, false, out);
+    REQUIRE(vm.cpu() == 17);
+    REQUIRE(out.str() == "2\n3\n");
+}
+
+TEST_CASE("tcvm: SchedulerPrintKeepsTheOrderOfATask", "[tcvm]")
+{
+    // count(n) { print(n); return n; } main() { print(1); print(join(spawn(count(2))) + 1); return 0; }
+    auto const code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,    // 0
+        ByteCode::PRINT,         // 2
+        ByteCode::LOAD,   -3,    // 3
+        ByteCode::RET,           // 5
+        ByteCode::ICONST, 1,     // 6 <-- main
+        ByteCode::PRINT,         // 8
+        ByteCode::ICONST, 2,     // 9
+        ByteCode::SPAWN,  0, 1,  // 11
+        ByteCode::JOIN,          // 14
+        ByteCode::ICONST, 1,     // 15
+        ByteCode::IADD,          // 17
+        ByteCode::PRINT,         // 18
+        ByteCode::ICONST, 0,     // 19
+        ByteCode::EXIT,          // 21
+    };
+    REQUIRE(tcc::verify(code, 6).ok());
+
+    // the continuation may be stolen, the lines before it still come first
+    auto options    = tcc::SchedulerOptions {};
+    options.threads = 4;
+    auto scheduler  = tcc::Scheduler {options};
+    for (auto run = 0; run < 50; ++run)
+    {
+        auto out = std::stringstream {};
+        REQUIRE(scheduler.run(code, 6, out) == 0);
+        REQUIRE(out.str() == "1\n2\n3\n");
+    }
+}
+
+TEST_CASE("tcvm: SchedulerExitStopsRunningTasks", "[tcvm]")
+{
+    // spin() { while (true) { } } main() { spawn(spin()); return 7; }
+    auto const code = std::vector<int64_t> {
+        ByteCode::BR,     0,     // 0
+        ByteCode::SPAWN,  0, 0,  // 2 <-- main
+        ByteCode::ICONST, 7,     // 5
+        ByteCode::EXIT,          // 7
+    };
+
+    // the spinning task occupies one worker, the other one steals main
+    auto options    = tcc::SchedulerOptions {};
+    options.threads = 2;
+    auto scheduler  = tcc::Scheduler {options};
+    REQUIRE(scheduler.run(code, 2) == 7);
+    REQUIRE(scheduler.stats().steals >= 1);
+}
+
+TEST_CASE("tcvm: SchedulerStackGrowsAtCalls", "[tcvm]")
+{
+    // 4 slots per call, far beyond the initial size of a task
+    auto const program = tcvm::createEvenOddProgram(50'001, false);
+
+    auto options      = tcc::SchedulerOptions {};
+    options.threads   = 2;
+    options.stackSize = 8;
+    auto scheduler    = tcc::Scheduler {options};
+    REQUIRE(scheduler.run(program) == 0);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::Finished);
+
+    options.maxStackSize = 10'000;
+    auto small           = tcc::Scheduler {options};
+    REQUIRE(small.run(program) == -1);
+    REQUIRE(small.status() == tcc::Scheduler::RunStatus::StackOverflow);
+}
+
+TEST_CASE("tcvm: SchedulerDeepFrames", "[tcvm]")
+{
+    // countdown(n) { return n ? countdown(n - 1) : 0; } called from a task
+    // frame far deeper than VmStack::CallHeadroom
+    auto code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,    //
+        ByteCode::BRF,    13,    //
+        ByteCode::LOAD,   -3,    //
+        ByteCode::ICONST, 1,     //
+        ByteCode::ISUB,          //
+        ByteCode::CALL,   0, 1,  //
+        ByteCode::RET,           //
+        ByteCode::ICONST, 0,     //
+        ByteCode::RET,           //
+    };
+    auto const task = static_cast<int64_t>(code.size());
+    for (auto i = 0; i < 1'000; ++i) { code.insert(code.end(), {ByteCode::ICONST, 1}); }
+    code.insert(code.end(), 1'000, ByteCode::POP);
+    code.insert(code.end(), {ByteCode::ICONST, 3, ByteCode::CALL, 0, 1, ByteCode::RET});
+    auto const entryPoint = static_cast<int64_t>(code.size());
+    code.insert(code.end(), {ByteCode::SPAWN, task, 0, ByteCode::JOIN, ByteCode::EXIT});
+    auto const verified = tcc::verify(code, entryPoint);
+    REQUIRE(verified.ok());
+
+    auto options         = tcc::SchedulerOptions {};
+    options.threads      = 2;
+    options.stackSize    = 8;
+    options.callHeadroom = static_cast<uint64_t>(verified.callHeadroom);
+    auto scheduler       = tcc::Scheduler {options};
+    REQUIRE(scheduler.run(code, entryPoint) == 0);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::Finished);
+}
+
+TEST_CASE("tcvm: SchedulerJoinInvalidHandle", "[tcvm]")
+{
+    // g0 = spawn(task()); return join(g0 + offset);
+    auto const code = std::vector<int64_t> {
+        ByteCode::ICONST, 3,     // 0
+        ByteCode::RET,           // 2
+        ByteCode::SPAWN,  0, 0,  // 3 <-- main
+        ByteCode::GSTORE, 0,     // 6
+        ByteCode::GLOAD,  0,     // 8
+        ByteCode::GLOAD,  1,     // 10
+        ByteCode::IADD,          // 12
+        ByteCode::JOIN,          // 13
+        ByteCode::EXIT,          // 14
+    };
+
+    auto options     = tcc::SchedulerOptions {};
+    options.threads  = 2;
+    options.dataSize = 2;
+    auto scheduler   = tcc::Scheduler {options};
+    REQUIRE(scheduler.run(code, 3) == 3);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::Finished);
+
+    // the next task of the same worker was never spawned
+    scheduler.globals()[1] = 1;
+    REQUIRE(scheduler.run(code, 3) == -1);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::InvalidHandle);
+
+    // a plain number
+    auto const plain = std::vector<int64_t> {ByteCode::ICONST, 5, ByteCode::JOIN, ByteCode::EXIT};
+    REQUIRE(scheduler.run(plain, 0) == -1);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::InvalidHandle);
+
+    // a handle of an earlier run
+    auto const stale = std::vector<int64_t> {ByteCode::GLOAD, 0, ByteCode::JOIN, ByteCode::EXIT};
+    REQUIRE(scheduler.run(stale, 0) == -1);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::InvalidHandle);
+}
+
+TEST_CASE("tcvm: SchedulerInvalidInstruction", "[tcvm]")
+{
+    // the task reaches an opcode the verifier would reject
+    auto const code = std::vector<int64_t> {
+        ByteCode::NOOP,          // 0
+        ByteCode::SPAWN,  0, 0,  // 1 <-- main
+        ByteCode::JOIN,          // 4
+        ByteCode::EXIT,          // 5
+    };
+    REQUIRE_FALSE(tcc::verify(code, 1).ok());
+
+    auto options    = tcc::SchedulerOptions {};
+    options.threads = 2;
+    auto scheduler  = tcc::Scheduler {options};
+    REQUIRE(scheduler.run(code, 1) == -1);
+    REQUIRE(scheduler.status() == tcc::Scheduler::RunStatus::InvalidInstruction);
+}
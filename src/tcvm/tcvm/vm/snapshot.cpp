@@ -0,0 +1,152 @@
+/**
+ * @file snapshot.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/snapshot.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TCC_VM_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tcc
+{
+namespace
+{
+constexpr auto Magic   = int64_t {0x31504E5356544354};  // "TCTVSNP1"
+constexpr auto Version = int64_t {2};
+
+// file layout: header words, followed by code, globals & the live stack
+enum Header : std::size_t
+{
+    MagicWord,
+    VersionWord,
+    CodeSize,
+    DataSize,
+    LiveStackSize,
+    StackPointer,
+    FramePointer,
+    InstructionPointer,
+    StackSize,
+    CallHeadroom,
+    HeaderSize,
+};
+
+struct Storage
+{
+    std::vector<int64_t> code {};
+    std::vector<int64_t> data {};
+    std::vector<int64_t> stack {};
+};
+}  // namespace
+
+VmSnapshot::VmSnapshot(std::vector<int64_t> code, std::vector<int64_t> data, std::vector<int64_t> stack,
+                       Registers registers, std::shared_ptr<PreparedCode const> prepared)
+    : registers_(registers), prepared_(std::move(prepared))
+{
+    auto storage = std::make_shared<Storage>(Storage {std::move(code), std::move(data), std::move(stack)});
+    code_        = storage->code;
+    data_        = storage->data;
+    stack_       = storage->stack;
+    storage_     = std::move(storage);
+}
+
+auto VmSnapshot::save(std::string const& path) const -> bool
+{
+    auto file = std::ofstream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) { return false; }
+
+    auto header                = std::vector<int64_t>(HeaderSize);
+    header[MagicWord]          = Magic;
+    header[VersionWord]        = Version;
+    header[CodeSize]           = static_cast<int64_t>(code_.size());
+    header[DataSize]           = static_cast<int64_t>(data_.size());
+    header[LiveStackSize]      = static_cast<int64_t>(stack_.size());
+    header[StackPointer]       = registers_.stackPointer;
+    header[FramePointer]       = registers_.framePointer;
+    header[InstructionPointer] = registers_.instructionPointer;
+    header[StackSize]          = static_cast<int64_t>(registers_.stackSize);
+    header[CallHeadroom]       = static_cast<int64_t>(registers_.callHeadroom);
+
+    for (auto const words : {std::span<int64_t const> {header}, code_, data_, stack_})
+    {
+        file.write(reinterpret_cast<char const*>(words.data()), static_cast<std::streamsize>(words.size_bytes()));
+    }
+
+    file.close();
+    return file.good();
+}
+
+auto VmSnapshot::open(std::string const& path) -> std::optional<VmSnapshot>
+{
+#if defined(TCC_VM_HAS_MMAP)
+    auto const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return std::nullopt; }
+
+    struct stat info {};
+    auto const size = ::fstat(fd, &info) == 0 ? static_cast<std::size_t>(info.st_size) : std::size_t {0};
+    auto* address   = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (address == MAP_FAILED) { return std::nullopt; }
+
+    auto storage = std::shared_ptr<void const> {address, [size](void const* mapped) {
+                                                    ::munmap(const_cast<void*>(mapped), size);
+                                                }};
+    return fromWords(std::move(storage), {static_cast<int64_t const*>(address), size / sizeof(int64_t)});
+#else
+    auto file = std::ifstream(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file) { return std::nullopt; }
+
+    auto words = std::make_shared<std::vector<int64_t>>(static_cast<std::size_t>(file.tellg()) / sizeof(int64_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(words->data()), static_cast<std::streamsize>(words->size() * sizeof(int64_t)));
+    if (!file) { return std::nullopt; }
+
+    auto const span = std::span<int64_t const> {*words};
+    return fromWords(std::move(words), span);
+#endif
+}
+
+auto VmSnapshot::fromWords(std::shared_ptr<void const> storage, std::span<int64_t const> words)
+    -> std::optional<VmSnapshot>
+{
+    if (words.size() < HeaderSize) { return std::nullopt; }
+    if (words[MagicWord] != Magic || words[VersionWord] != Version) { return std::nullopt; }
+
+    auto const payload   = static_cast<int64_t>(words.size() - HeaderSize);
+    auto const codeSize  = words[CodeSize];
+    auto const dataSize  = words[DataSize];
+    auto const liveStack = words[LiveStackSize];
+    for (auto const size : {codeSize, dataSize, liveStack})
+    {
+        if (size < 0 || size > payload) { return std::nullopt; }
+    }
+    if (codeSize + dataSize + liveStack != payload) { return std::nullopt; }
+    if (liveStack != std::max(words[StackPointer] + 1, int64_t {0}) || words[StackSize] < liveStack)
+    { return std::nullopt; }
+    if (words[CallHeadroom] < 0) { return std::nullopt; }
+
+    auto snapshot       = VmSnapshot {};
+    snapshot.storage_   = std::move(storage);
+    snapshot.code_      = words.subspan(HeaderSize, static_cast<std::size_t>(codeSize));
+    snapshot.data_      = words.subspan(HeaderSize + snapshot.code_.size(), static_cast<std::size_t>(dataSize));
+    snapshot.stack_     = words.subspan(HeaderSize + snapshot.code_.size() + snapshot.data_.size());
+    snapshot.registers_ = Registers {
+        words[StackPointer],
+        words[FramePointer],
+        words[InstructionPointer],
+        static_cast<uint64_t>(words[StackSize]),
+        static_cast<uint64_t>(words[CallHeadroom]),
+    };
+    return snapshot;
+}
+
+}  // namespace tcc
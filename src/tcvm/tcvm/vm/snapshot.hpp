@@ -0,0 +1,81 @@
+/**
+ * @file snapshot.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tcc
+{
+struct PreparedCode;
+
+/**
+ * @brief Immutable state of a stopped VirtualMachine: code, globals, the live
+ * part of the stack & the registers. Execution options, statistics and gas
+ * are not part of it.
+ *
+ * Copies share the same memory. A snapshot written by save() is mapped
+ * read-only by open(), so every process forking from the same file shares its
+ * pages through the page cache. Forking copies the globals & the live stack
+ * into the new machine, the snapshot itself is never written. Snapshots taken
+ * by a machine also carry its code prepared for the engine, forks with the same
+ * engine take it over instead of preparing the code again.
+ */
+class VmSnapshot
+{
+public:
+    struct Registers
+    {
+        int64_t stackPointer {-1};
+        int64_t framePointer {0};
+        int64_t instructionPointer {0};
+        uint64_t stackSize {0};     // slots of the captured machine
+        uint64_t callHeadroom {0};  // see VirtualMachine::setCallHeadroom()
+    };
+
+    VmSnapshot() = default;
+    VmSnapshot(std::vector<int64_t> code, std::vector<int64_t> data, std::vector<int64_t> stack, Registers registers,
+               std::shared_ptr<PreparedCode const> prepared = {});
+
+    [[nodiscard]] auto code() const noexcept -> std::span<int64_t const> { return code_; }
+    [[nodiscard]] auto data() const noexcept -> std::span<int64_t const> { return data_; }
+    [[nodiscard]] auto stack() const noexcept -> std::span<int64_t const> { return stack_; }  // up to the stack pointer
+    [[nodiscard]] auto registers() const noexcept -> Registers const& { return registers_; }
+
+    /**
+     * @brief The code prepared by the captured machine, nullptr for snapshots
+     * read by open().
+     */
+    [[nodiscard]] auto prepared() const noexcept -> std::shared_ptr<PreparedCode const> const& { return prepared_; }
+
+    /**
+     * @brief Writes the snapshot as a flat file of 64-bit words.
+     */
+    [[nodiscard]] auto save(std::string const& path) const -> bool;
+
+    /**
+     * @brief Maps a file written by save(), the mapping lives as long as any
+     * copy of the snapshot. Returns nullopt for missing or malformed files.
+     */
+    [[nodiscard]] static auto open(std::string const& path) -> std::optional<VmSnapshot>;
+
+private:
+    [[nodiscard]] static auto fromWords(std::shared_ptr<void const> storage, std::span<int64_t const> words)
+        -> std::optional<VmSnapshot>;
+
+    std::shared_ptr<void const> storage_ {};  // owns what the spans point into
+    std::span<int64_t const> code_ {};
+    std::span<int64_t const> data_ {};
+    std::span<int64_t const> stack_ {};
+    Registers registers_ {};
+    std::shared_ptr<PreparedCode const> prepared_ {};
+};
+
+}  // namespace tcc
@@ -0,0 +1,164 @@
+/**
+ * @file snapshot_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/snapshot.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/vm.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+using tcc::ByteCode;
+using tcc::VirtualMachine;
+using tcc::VmSnapshot;
+
+namespace
+{
+auto warmUp(tcc::BinaryProgram const& program) -> VmSnapshot
+{
+    auto vm = VirtualMachine(program.data, program.entryPoint, 2, 200, false);
+    REQUIRE(vm.cpu() == -1);
+    return vm.snapshot();
+}
+
+auto temporaryPath(std::string const& name) -> std::string
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+}  // namespace
+
+TEST_CASE("tcvm: SnapshotForkAfterHalt", "[tcvm]")
+{
+    auto const snapshot = warmUp(tcvm::createWarmStartProgram(15));
+    REQUIRE(snapshot.data()[0] == 610);
+    REQUIRE(snapshot.registers().instructionPointer == 36);
+    REQUIRE(snapshot.stack().empty());
+
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    for (auto request = int64_t {0}; request < 4; ++request)
+    {
+        auto fork         = VirtualMachine(snapshot, false, std::cout, engine);
+        fork.globals()[1] = request;
+        REQUIRE(fork.cpu() == 610 + request);
+    }
+
+    // restoring into the same machine keeps the loaded program
+    auto vm = VirtualMachine(snapshot, false, std::cout, engine);
+    for (auto request = int64_t {0}; request < 4; ++request)
+    {
+        vm.restore(snapshot);
+        REQUIRE(vm.globals()[1] == 0);
+        vm.globals()[1] = request;
+        REQUIRE(vm.cpu() == 610 + request);
+    }
+}
+
+TEST_CASE("tcvm: SnapshotInsideCall", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(12);
+
+    auto vm = VirtualMachine(program.data, program.entryPoint, 0, 64, false);
+    REQUIRE(vm.run(500).status == VirtualMachine::RunStatus::OutOfBudget);
+
+    auto const snapshot = vm.snapshot();
+    REQUIRE(snapshot.registers().stackSize >= 64);  // committed pages
+    REQUIRE(snapshot.stack().size() == static_cast<std::size_t>(snapshot.registers().stackPointer + 1));
+
+    // the fork & the original continue independently, every engine takes over
+    // the return addresses of the frames on the stack
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+    auto fork = VirtualMachine(snapshot, false, std::cout, engine);
+    REQUIRE(fork.cpu() == 144);
+    REQUIRE(vm.cpu() == 144);
+
+    // a machine with a smaller stack grows on restore
+    auto small = VirtualMachine({}, 0, 0, 8, false);
+    small.restore(snapshot);
+    REQUIRE(small.cpu() == 144);
+}
+
+TEST_CASE("tcvm: SnapshotPreparedCode", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+    auto const program = tcvm::createFibonacciProgram(12);
+
+    auto vm = VirtualMachine(program.data, program.entryPoint, 0, 64, false, std::cout, engine);
+    vm.setCallHeadroom(1000);
+    REQUIRE(vm.run(500).status == VirtualMachine::RunStatus::OutOfBudget);
+
+    auto const snapshot = vm.snapshot();
+    REQUIRE(snapshot.registers().callHeadroom == 1000);
+    REQUIRE(snapshot.prepared() != nullptr);
+    REQUIRE(snapshot.prepared()->requested == engine);
+
+    // forks with the same engine take over the prepared code, native code is shared
+    auto const& native = snapshot.prepared()->native;
+    auto const users   = native.use_count();
+    auto fork          = VirtualMachine(snapshot, false, std::cout, engine);
+    if (native != nullptr) { REQUIRE(native.use_count() == users + 1); }
+    REQUIRE(fork.cpu() == 144);
+    REQUIRE(vm.cpu() == 144);
+
+    // other engines prepare the code themselves
+    auto other = VirtualMachine(snapshot, false, std::cout, VirtualMachine::Engine::Switch);
+    REQUIRE(other.cpu() == 144);
+}
+
+TEST_CASE("tcvm: SnapshotSaveAndOpen", "[tcvm]")
+{
+    auto const path     = temporaryPath("tcvm_snapshot_test.snap");
+    auto const snapshot = warmUp(tcvm::createWarmStartProgram(10));
+    REQUIRE(snapshot.save(path));
+
+    {
+        auto const mapped = VmSnapshot::open(path);
+        REQUIRE(mapped.has_value());
+        REQUIRE(std::equal(mapped->code().begin(), mapped->code().end(), snapshot.code().begin(),
+                           snapshot.code().end()));
+        REQUIRE(mapped->data()[0] == 55);
+        REQUIRE(mapped->registers().instructionPointer == snapshot.registers().instructionPointer);
+        REQUIRE(mapped->registers().callHeadroom == snapshot.registers().callHeadroom);
+        REQUIRE(mapped->prepared() == nullptr);
+
+        // copies keep the mapping alive
+        auto copy = std::optional<VmSnapshot> {};
+        {
+            auto const another = VmSnapshot::open(path);
+            REQUIRE(another.has_value());
+            copy = another;
+        }
+
+        auto fork         = VirtualMachine(*copy, false);
+        fork.globals()[1] = 3;
+        REQUIRE(fork.cpu() == 58);
+    }
+
+    SECTION("malformed files")
+    {
+        REQUIRE_FALSE(VmSnapshot::open(temporaryPath("tcvm_snapshot_test.missing")).has_value());
+
+        auto const size = std::filesystem::file_size(path);
+        std::filesystem::resize_file(path, size - sizeof(int64_t));
+        REQUIRE_FALSE(VmSnapshot::open(path).has_value());
+
+        {
+            auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+            file << "not a snapshot, but long enough to hold a header of ten 64-bit words, or eighty bytes";
+        }
+        REQUIRE_FALSE(VmSnapshot::open(path).has_value());
+    }
+
+    std::remove(path.c_str());
+}
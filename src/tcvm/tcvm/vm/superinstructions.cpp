@@ -0,0 +1,257 @@
+/**
+ * @file superinstructions.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/superinstructions.hpp"
+
+#include "tcvm/vm/decoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+#include <optional>
+
+namespace tcc
+{
+namespace
+{
+/**
+ * @brief Instruction boundaries of a program and the instructions that start a
+ * basic block, which can only be the first one of a superinstruction.
+ */
+struct Layout
+{
+    DecodedProgram decoded {};
+    std::vector<bool> isLeader {};
+};
+
+auto analyze(std::vector<int64_t> const& code, int64_t const entryPoint) -> Layout
+{
+    auto layout       = Layout {decode(code, entryPoint), {}};
+    auto const& insts = layout.decoded.instructions;
+    layout.isLeader.assign(insts.size(), false);
+    layout.isLeader[static_cast<std::size_t>(layout.decoded.entryPoint)] = true;
+
+    for (auto i = std::size_t {0}; i < insts.size(); ++i)
+    {
+        auto const& inst  = insts[i];
+        auto const target = targetOperandIndex(inst.opcode);
+        if (target == 0) { layout.isLeader[static_cast<std::size_t>(inst.operand)] = true; }
+        if (target == 1) { layout.isLeader[static_cast<std::size_t>(inst.argument)] = true; }
+
+        // return point
+        auto const isCall = inst.opcode == ByteCode::CALL || inst.opcode == ByteCode::SPAWN;
+        if (isCall && i + 1 < insts.size()) { layout.isLeader[i + 1] = true; }
+    }
+
+    return layout;
+}
+
+auto isFusible(Layout const& layout, std::size_t const first, std::size_t const length) -> bool
+{
+    auto const& insts = layout.decoded.instructions;
+    if (first + length >= insts.size()) { return false; }  // never includes the trailing halt
+
+    auto operands = 0;
+    for (auto k = std::size_t {0}; k < length; ++k)
+    {
+        auto const opcode = insts[first + k].opcode;
+        if (opcode == ByteCode::NOOP || opcode >= ByteCode::HALT) { return false; }
+        if (k > 0 && layout.isLeader[first + k]) { return false; }
+        if (isControlFlow(opcode) && k + 1 != length) { return false; }
+        operands += gsl::at(Instructions, opcode).numberOfOperands;
+    }
+
+    return operands <= 2;
+}
+
+auto matches(Layout const& layout, std::size_t const first, int64_t const fusedOpcode) -> bool
+{
+    auto const& fused = gsl::at(Instructions, fusedOpcode);
+    auto const length = fused.fusedLength();
+    if (!isFusible(layout, first, length)) { return false; }
+
+    auto const& insts = layout.decoded.instructions;
+    for (auto k = std::size_t {0}; k < length; ++k)
+    {
+        if (insts[first + k].opcode != fused.fuses[k]) { return false; }
+    }
+    return true;
+}
+
+auto nameOf(std::vector<ByteCode::Type> const& opcodes) -> std::string
+{
+    auto name = std::string {};
+    for (auto const opcode : opcodes)
+    {
+        if (!name.empty()) { name += '_'; }
+        name += gsl::at(Instructions, opcode).name;
+    }
+    return name;
+}
+
+auto hasSuperinstruction(std::vector<ByteCode::Type> const& opcodes) -> bool
+{
+    return std::any_of(begin(Instructions), end(Instructions), [&opcodes](auto const& instruction) {
+        return instruction.fusedLength() == opcodes.size()
+               && std::equal(begin(opcodes), end(opcodes), begin(instruction.fuses));
+    });
+}
+}  // namespace
+
+auto countOpcodeSequences(std::vector<BinaryProgram> const& corpus, std::size_t const maxLength)
+    -> std::vector<OpcodeSequence>
+{
+    auto counts = std::map<std::vector<ByteCode::Type>, std::size_t> {};
+    for (auto const& program : corpus)
+    {
+        auto const layout = analyze(program.data, program.entryPoint);
+        auto const& insts = layout.decoded.instructions;
+        for (auto first = std::size_t {0}; first < insts.size(); ++first)
+        {
+            for (auto length = std::size_t {2}; length <= maxLength && isFusible(layout, first, length); ++length)
+            {
+                auto opcodes = std::vector<ByteCode::Type> {};
+                for (auto k = std::size_t {0}; k < length; ++k)
+                { opcodes.push_back(static_cast<ByteCode::Type>(insts[first + k].opcode)); }
+                ++counts[opcodes];
+            }
+        }
+    }
+
+    auto sequences = std::vector<OpcodeSequence> {};
+    for (auto const& [opcodes, count] : counts) { sequences.push_back({opcodes, count}); }
+    std::stable_sort(begin(sequences), end(sequences), [](auto const& lhs, auto const& rhs) {
+        if (lhs.count != rhs.count) { return lhs.count > rhs.count; }
+        return lhs.opcodes.size() > rhs.opcodes.size();
+    });
+    return sequences;
+}
+
+auto printSuperinstructionTable(std::ostream& out, std::vector<OpcodeSequence> const& sequences,
+                                std::size_t const maxEntries) -> void
+{
+    auto selected = std::vector<OpcodeSequence> {};
+    for (auto const& sequence : sequences)
+    {
+        if (selected.size() == maxEntries) { break; }
+        if (!hasSuperinstruction(sequence.opcodes)) { selected.push_back(sequence); }
+    }
+
+    out << "// ByteCode::Type\n";
+    for (auto const& sequence : selected)
+    {
+        auto const name = nameOf(sequence.opcodes);
+        auto upper      = std::string {};
+        std::transform(begin(name), end(name), std::back_inserter(upper),
+                       [](auto c) { return static_cast<char>(std::toupper(c)); });
+        out << fmt::format("{},  // count: {}\n", upper, sequence.count);
+    }
+
+    out << "\n// Instructions\n";
+    for (auto const& sequence : selected)
+    {
+        auto operands = 0;
+        auto list     = std::string {};
+        for (auto const opcode : sequence.opcodes)
+        {
+            operands += gsl::at(Instructions, opcode).numberOfOperands;
+            list += fmt::format("{}ByteCode::{}", list.empty() ? "" : ", ", opcode);
+        }
+        out << fmt::format("Instruction {{\"{}\", {}, {{{}}}}},  //\n", nameOf(sequence.opcodes), operands, list);
+    }
+}
+
+auto fuseSuperinstructions(BinaryProgram const& program) -> BinaryProgram
+{
+    auto const& code  = program.data;
+    auto const layout = analyze(code, program.entryPoint);
+    auto const& insts = layout.decoded.instructions;
+
+    // longest sequences first, table order otherwise
+    auto candidates = std::vector<int64_t> {};
+    for (auto opcode = int64_t {0}; opcode < ByteCode::NUM_OPCODES; ++opcode)
+    {
+        if (gsl::at(Instructions, opcode).isFused()) { candidates.push_back(opcode); }
+    }
+    std::stable_sort(begin(candidates), end(candidates), [](auto lhs, auto rhs) {
+        return gsl::at(Instructions, lhs).fusedLength() > gsl::at(Instructions, rhs).fusedLength();
+    });
+
+    auto result = program;
+    result.data.clear();
+
+    auto newAddress = std::vector<int64_t>(insts.size(), -1);
+    auto fixups     = std::vector<std::pair<std::size_t, int64_t>> {};  // operand position, old target
+
+    auto const lastIndex = static_cast<std::size_t>(layout.decoded.haltIndex());  // trailing halt
+    for (auto i = std::size_t {0}; i < lastIndex;)
+    {
+        auto const& inst = insts[i];
+        newAddress[i]    = static_cast<int64_t>(result.data.size());
+
+        // unknown opcode or truncated instruction, copy the raw word
+        if (inst.opcode == ByteCode::NOOP)
+        {
+            result.data.push_back(code[static_cast<std::size_t>(inst.address)]);
+            ++i;
+            continue;
+        }
+
+        auto const match = std::find_if(begin(candidates), end(candidates),
+                                        [&](auto fused) { return matches(layout, i, fused); });
+        auto const opcode = match != end(candidates) ? *match : inst.opcode;
+        auto const length = match != end(candidates) ? gsl::at(Instructions, opcode).fusedLength() : 1;
+
+        auto const position = result.data.size();
+        result.data.push_back(opcode);
+        for (auto k = std::size_t {0}; k < length; ++k)
+        {
+            auto const& part       = insts[i + k];
+            auto const numOperands = gsl::at(Instructions, part.opcode).numberOfOperands;
+            for (auto n = 1; n <= numOperands; ++n)
+            { result.data.push_back(code[static_cast<std::size_t>(part.address + n)]); }
+        }
+
+        if (auto const target = targetOperandIndex(opcode); target >= 0)
+        {
+            auto const operand = position + 1 + static_cast<std::size_t>(target);
+            fixups.emplace_back(operand, result.data[operand]);
+        }
+
+        i += length;
+    }
+    newAddress[lastIndex] = static_cast<int64_t>(result.data.size());
+
+    auto const relocate = [&](int64_t const address) -> std::optional<int64_t> {
+        if (address < 0 || static_cast<uint64_t>(address) >= code.size()) { return newAddress[lastIndex]; }
+        auto const index = layout.decoded.indexOf[static_cast<std::size_t>(address)];
+        if (index < 0 || newAddress[static_cast<std::size_t>(index)] < 0) { return std::nullopt; }
+        return newAddress[static_cast<std::size_t>(index)];
+    };
+
+    for (auto const& [operand, target] : fixups)
+    {
+        auto const relocated = relocate(target);
+        if (!relocated.has_value()) { return program; }
+        result.data[operand] = relocated.value();
+    }
+
+    auto const entryPoint = relocate(program.entryPoint);
+    if (!entryPoint.has_value()) { return program; }
+    result.entryPoint = entryPoint.value();
+
+    // functions start at call targets, which are never fused into a sequence
+    result.symbols.clear();
+    for (auto const& [address, name] : program.symbols)
+    {
+        auto const relocated = relocate(address);
+        if (relocated.has_value()) { result.symbols[relocated.value()] = name; }
+    }
+
+    return result;
+}
+
+}  // namespace tcc
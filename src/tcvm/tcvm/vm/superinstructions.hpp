@@ -0,0 +1,51 @@
+/**
+ * @file superinstructions.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Opcode sequence found in a corpus and how often it occurs.
+ */
+struct OpcodeSequence
+{
+    std::vector<ByteCode::Type> opcodes {};
+    std::size_t count {0};
+};
+
+/**
+ * @brief Counts every opcode sequence of length 2 up to maxLength that could
+ * be fused into a superinstruction, sorted by count.
+ *
+ * Sequences never span a jump target or return point, only end in control
+ * flow and have at most two operands in total.
+ */
+auto countOpcodeSequences(std::vector<BinaryProgram> const& corpus,
+                          std::size_t maxLength = Instruction::MaxFusedLength) -> std::vector<OpcodeSequence>;
+
+/**
+ * @brief Prints enum & Instructions table entries for the most frequent
+ * sequences, ready to be pasted into byte_code.hpp. Sequences that already
+ * have a superinstruction are skipped.
+ */
+auto printSuperinstructionTable(std::ostream& out, std::vector<OpcodeSequence> const& sequences,
+                                std::size_t maxEntries) -> void;
+
+/**
+ * @brief Replaces every sequence listed in the Instructions table with its
+ * superinstruction. Longer sequences win, branch & call targets and the entry
+ * point are relocated. Returns the program unchanged if a target points into
+ * the operands of an instruction.
+ */
+auto fuseSuperinstructions(BinaryProgram const& program) -> BinaryProgram;
+
+}  // namespace tcc
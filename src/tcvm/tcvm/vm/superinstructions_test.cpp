@@ -0,0 +1,102 @@
+/**
+ * @file superinstructions_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/superinstructions.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+
+#include <sstream>
+
+using tcc::ByteCode;
+
+TEST_CASE("tcvm: SuperinstructionsCountSequences", "[tcvm]")
+{
+    auto const corpus = std::vector<tcc::BinaryProgram> {
+        tcvm::createFibonacciProgram(3),
+        tcvm::createFactorialProgram(3),
+    };
+
+    auto const sequences = tcc::countOpcodeSequences(corpus);
+    REQUIRE_FALSE(sequences.empty());
+
+    auto const find = [&sequences](std::vector<ByteCode::Type> const& opcodes) -> std::size_t {
+        for (auto const& sequence : sequences)
+        {
+            if (sequence.opcodes == opcodes) { return sequence.count; }
+        }
+        return 0;
+    };
+
+    CHECK(find({ByteCode::LOAD, ByteCode::ICONST, ByteCode::ISUB}) == 3);
+    CHECK(find({ByteCode::ILT, ByteCode::BRF}) == 2);
+
+    // never across a return point or out of a control flow instruction
+    CHECK(find({ByteCode::CALL, ByteCode::IADD}) == 0);
+    CHECK(find({ByteCode::CALL, ByteCode::LOAD}) == 0);
+    CHECK(find({ByteCode::BRF, ByteCode::ICONST}) == 0);
+
+    auto stream = std::stringstream {};
+    tcc::printSuperinstructionTable(stream, sequences, 2);
+    CHECK(stream.str().find("// Instructions") != std::string::npos);
+    CHECK(stream.str().find("LOAD_ICONST_ISUB") == std::string::npos);  // already in the table
+}
+
+TEST_CASE("tcvm: SuperinstructionsFuse", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(3);
+    auto const fused   = tcc::fuseSuperinstructions(program);
+
+    REQUIRE(fused.data.size() < program.data.size());
+    REQUIRE(fused.data == std::vector<int64_t> {
+                              ByteCode::LOAD_ICONST_ILT, -3, 2,   // 0
+                              ByteCode::BRF, 8,                   // 3
+                              ByteCode::LOAD, -3,                 // 5
+                              ByteCode::RET,                      // 7
+                              ByteCode::LOAD_ICONST_ISUB, -3, 1,  // 8
+                              ByteCode::CALL, 0, 1,               // 11
+                              ByteCode::LOAD_ICONST_ISUB, -3, 2,  // 14
+                              ByteCode::CALL, 0, 1,               // 17
+                              ByteCode::IADD,                     // 20
+                              ByteCode::RET,                      // 21
+                              ByteCode::ICONST, 3,                // 22
+                              ByteCode::CALL, 0, 1,               // 24
+                              ByteCode::EXIT,                     // 27
+                          });
+    REQUIRE(fused.entryPoint == 22);
+}
+
+TEST_CASE("tcvm: SuperinstructionsKeepJumpTargets", "[tcvm]")
+{
+    auto const program = tcc::BinaryProgram {
+        1,        // version
+        "fused",  // name
+        0,        // entryPoint
+        std::vector<int64_t> {
+            ByteCode::LOAD,   0,   // 0
+            ByteCode::LOAD,   1,   // 2 jump target, not fused
+            ByteCode::IADD,        // 4
+            ByteCode::ILT,         // 5
+            ByteCode::BRF,    2,   // 6
+            ByteCode::BR,     100  // 8 out of range
+        },
+    };
+
+    auto const fused = tcc::fuseSuperinstructions(program);
+    REQUIRE(fused.data == std::vector<int64_t> {
+                              ByteCode::LOAD, 0,     // 0
+                              ByteCode::LOAD, 1,     // 2
+                              ByteCode::IADD,        // 4
+                              ByteCode::ILT_BRF, 2,  // 5
+                              ByteCode::BR, 9,       // 7
+                          });
+
+    SECTION("targets into operands are left alone")
+    {
+        auto broken = program;
+        broken.data[7] = 3;
+        REQUIRE(tcc::fuseSuperinstructions(broken).data == broken.data);
+    }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file task_host.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "tcvm/vm/vm_stack.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Stack & registers of a green thread between two instructions. A
+ * VirtualMachine runs one of them at a time, see VirtualMachine::swapContext().
+ */
+struct TaskContext
+{
+    VmStack stack {};
+    int64_t stackPointer {-1};
+    int64_t framePointer {0};
+    int64_t instructionPointer {0};
+};
+
+/**
+ * @brief Runs SPAWN & JOIN of a VirtualMachine as green threads, see
+ * VirtualMachine::setTaskHost() & Scheduler. Called on the thread that runs
+ * the machine.
+ */
+class TaskHost
+{
+public:
+    /**
+     * @brief Saved as the return address of the outermost frame of a task,
+     * the machine stops once that frame returns.
+     */
+    static constexpr auto TaskReturn = int64_t {-1};
+
+    TaskHost()          = default;
+    virtual ~TaskHost() = default;
+
+    TaskHost(TaskHost const&) = delete;
+    auto operator=(TaskHost const&) -> TaskHost& = delete;
+
+    /**
+     * @brief Creates a task calling the function at address with a copy of
+     * arguments. Returns its handle, std::nullopt if its stack does not fit.
+     */
+    virtual auto spawn(int64_t address, std::span<int64_t const> arguments) -> std::optional<int64_t> = 0;
+
+    /**
+     * @brief The result of the task, std::nullopt if it is still running or
+     * handle is not a task.
+     */
+    virtual auto join(int64_t handle) -> std::optional<int64_t> = 0;
+
+    /**
+     * @brief Globals shared by all tasks, GLOAD & GSTORE access them atomically.
+     */
+    virtual auto globals() noexcept -> std::span<int64_t> = 0;
+
+    /**
+     * @brief Set once any task ended the program, running tasks stop at their
+     * next backward jump.
+     */
+    [[nodiscard]] virtual auto finished() const noexcept -> std::atomic<bool> const& = 0;
+};
+
+}  // namespace tcc
@@ -0,0 +1,450 @@
+/**
+ * @file trace.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/trace.hpp"
+
+#include <array>
+#include <map>
+
+namespace tcc
+{
+namespace
+{
+/**
+ * @brief Symbolic content of one stack slot, same model as in the register
+ * translator. Slot values live in their own register, Register & Constant
+ * values are pending until they are consumed or written back.
+ */
+struct Value
+{
+    enum class Kind
+    {
+        Slot,
+        Register,
+        Constant,
+    };
+
+    Kind kind {Kind::Slot};
+    int64_t value {0};
+};
+
+class TraceOptimizer
+{
+public:
+    TraceOptimizer(DecodedProgram const& program, TraceRecorder const& recorder)
+        : program_ {program}, recorder_ {recorder}, base_ {recorder.frameOffset()}
+    {
+    }
+
+    auto run() -> std::optional<Trace>
+    {
+        auto const& steps = recorder_.steps();
+        if (recorder_.state() != TraceRecorder::State::Complete || steps.empty()) { return std::nullopt; }
+
+        trace_.header      = recorder_.header();
+        trace_.address     = addressOf(recorder_.header());
+        trace_.frameOffset = base_;
+
+        for (auto const& step : steps)
+        {
+            current_ = step;
+            translate(step.instruction);
+            if (failed_) { return std::nullopt; }
+        }
+
+        // the next iteration expects the same stack as the header
+        if (!stack_.empty()) { return std::nullopt; }
+        emit(RegisterCode::BR, 0);
+        return std::move(trace_);
+    }
+
+private:
+    auto translate(DecodedInstruction const& inst) -> void
+    {
+        switch (inst.opcode)
+        {
+            case ByteCode::IADD: binary(RegisterCode::IADD, [](auto a, auto b) { return a + b; }, true); break;
+            case ByteCode::ISUB: binary(RegisterCode::ISUB, [](auto a, auto b) { return a - b; }, false); break;
+            case ByteCode::IMUL: binary(RegisterCode::IMUL, [](auto a, auto b) { return a * b; }, true); break;
+            case ByteCode::ILT: binary(RegisterCode::ILT, [](auto a, auto b) { return a < b ? 1 : 0; }, false); break;
+            case ByteCode::IEQ: binary(RegisterCode::IEQ, [](auto a, auto b) { return a == b ? 1 : 0; }, true); break;
+
+            case ByteCode::ICONST: push({Value::Kind::Constant, inst.operand}); break;
+            case ByteCode::LOAD: load(inst.operand); break;
+            case ByteCode::STORE: store(inst.operand); break;
+
+            case ByteCode::GLOAD:
+            {
+                auto const dest = depth() + 1;
+                lastProducer_  = emitWrite(RegisterCode::GLOAD, dest, inst.operand);
+                push({});
+                break;
+            }
+
+            case ByteCode::GSTORE:
+            {
+                auto const source = popToRegister();
+                emit(RegisterCode::GSTORE, inst.operand, source);
+                break;
+            }
+
+            case ByteCode::PRINT: emit(RegisterCode::PRINT, popToRegister()); break;
+            case ByteCode::POP: pop(); break;
+
+            // the trace is linear, only conditional branches need a guard
+            case ByteCode::BR: break;
+            case ByteCode::BRT:
+            case ByteCode::BRF: guard(inst); break;
+
+            default:
+            {
+                if (gsl::at(Instructions, inst.opcode).isFused()) { return expand(inst); }
+                fail();
+            }
+        }
+    }
+
+    /**
+     * @brief Translates a superinstruction as the sequence it replaces.
+     */
+    auto expand(DecodedInstruction const& inst) -> void
+    {
+        auto const& fused   = gsl::at(Instructions, inst.opcode);
+        auto const operands = std::array {inst.operand, inst.argument};
+        auto next           = std::size_t {0};
+
+        for (auto k = std::size_t {0}; k < fused.fusedLength(); ++k)
+        {
+            auto part              = inst;
+            part.opcode            = fused.fuses[k];
+            auto const numOperands = gsl::at(Instructions, part.opcode).numberOfOperands;
+            if (numOperands >= 1) { part.operand = operands.at(next++); }
+            if (numOperands >= 2) { part.argument = operands.at(next++); }
+            translate(part);
+        }
+    }
+
+    /**
+     * @brief Emits a guard that leaves the trace if the branch goes the other
+     * way than recorded.
+     */
+    auto guard(DecodedInstruction const& inst) -> void
+    {
+        auto const condition = pop();
+        if (condition.kind == Value::Kind::Constant) { return; }
+
+        auto const isBrt    = inst.opcode == ByteCode::BRT;
+        auto const taken    = current_.next == inst.operand;
+        auto const exitTo   = taken ? current_.index + 1 : inst.operand;
+        auto const reg      = toRegister(condition, depth() + 1);
+        auto const op       = isBrt == taken ? RegisterCode::BRF : RegisterCode::BRT;
+        auto const exitSlot = static_cast<int64_t>(trace_.exits.size());
+
+        auto exit         = TraceExit {};
+        exit.address      = addressOf(exitTo);
+        exit.stackPointer = depth();
+        for (auto i = std::size_t {0}; i < stack_.size(); ++i)
+        {
+            auto const& value = stack_[i];
+            if (value.kind == Value::Kind::Slot) { continue; }
+            auto const restore = value.kind == Value::Kind::Constant ? RegisterCode::MOVK : RegisterCode::MOV;
+            exit.restore.push_back(make(restore, positionOf(i), value.value));
+        }
+        trace_.exits.push_back(std::move(exit));
+
+        emit(op, reg, exitSlot);
+    }
+
+    template<typename Operation>
+    auto binary(RegisterCode::Type op, Operation operation, bool commutative) -> void
+    {
+        auto const rhs = pop();
+        auto const lhs = pop();
+
+        if (lhs.kind == Value::Kind::Constant && rhs.kind == Value::Kind::Constant)
+        {
+            push({Value::Kind::Constant, operation(lhs.value, rhs.value)});
+            return;
+        }
+
+        auto const dest = depth() + 1;
+        auto left       = int64_t {};
+        auto right      = int64_t {};
+        auto isK        = rhs.kind == Value::Kind::Constant;
+        if (commutative && lhs.kind == Value::Kind::Constant)
+        {
+            left  = toRegister(rhs, dest + 1);
+            right = lhs.value;
+            isK   = true;
+        }
+        else
+        {
+            left  = toRegister(lhs, dest);
+            right = isK ? rhs.value : toRegister(rhs, dest + 1);
+        }
+
+        lastProducer_ = emitWrite(static_cast<RegisterCode::Type>(op + (isK ? 1 : 0)), dest, left, right);
+        push({});
+    }
+
+    auto load(int64_t const offset) -> void
+    {
+        if (offset > depth()) { return fail(); }
+
+        auto value = Value {Value::Kind::Register, offset};
+        if (offset > base_)
+        {
+            auto const& slot = stack_[slotIndex(offset)];
+            if (slot.kind != Value::Kind::Slot) { value = slot; }
+        }
+
+        if (value.kind == Value::Kind::Register)
+        {
+            if (auto const known = constants_.find(value.value); known != constants_.end())
+            { value = Value {Value::Kind::Constant, known->second}; }
+        }
+
+        push(value);
+    }
+
+    auto store(int64_t const offset) -> void
+    {
+        auto const value = pop();
+        prepareWrite(offset);
+
+        auto const isSlot = offset > base_ && offset <= depth();
+        if (isSlot)
+        {
+            auto const lazy = value.kind == Value::Kind::Constant
+                              || (value.kind == Value::Kind::Register && (value.value <= base_ || value.value < offset));
+            if (lazy)
+            {
+                stack_[slotIndex(offset)] = value;
+                return;
+            }
+        }
+
+        writeRegister(offset, value, depth() + 1);
+        if (isSlot) { stack_[slotIndex(offset)] = Value {}; }
+    }
+
+    auto writeRegister(int64_t const dest, Value const& value, int64_t const position) -> void
+    {
+        switch (value.kind)
+        {
+            case Value::Kind::Constant: emitWrite(RegisterCode::MOVK, dest, value.value); break;
+            case Value::Kind::Register:
+            {
+                if (value.value != dest) { emitWrite(RegisterCode::MOV, dest, value.value); }
+                break;
+            }
+            case Value::Kind::Slot:
+            {
+                // retarget the instruction that produced the value
+                auto& instructions = trace_.instructions;
+                if (lastProducer_.has_value() && *lastProducer_ + 1 == instructions.size()
+                    && instructions.back().a == position)
+                {
+                    instructions.back().a = dest;
+                    constants_.erase(dest);
+                    break;
+                }
+                if (position != dest) { emitWrite(RegisterCode::MOV, dest, position); }
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Materializes every symbolic value that reads register, so it can
+     * be overwritten.
+     */
+    auto prepareWrite(int64_t const reg) -> void
+    {
+        for (auto i = std::size_t {0}; i < stack_.size(); ++i)
+        {
+            if (stack_[i].kind == Value::Kind::Register && stack_[i].value == reg) { materialize(i); }
+        }
+    }
+
+    auto materialize(std::size_t const index) -> void
+    {
+        auto& value = stack_[index];
+        if (value.kind == Value::Kind::Slot) { return; }
+        writeRegister(positionOf(index), value, positionOf(index));
+        value = Value {};
+    }
+
+    auto toRegister(Value const& value, int64_t const position) -> int64_t
+    {
+        switch (value.kind)
+        {
+            case Value::Kind::Register: return value.value;
+            case Value::Kind::Constant: emitWrite(RegisterCode::MOVK, position, value.value); return position;
+            case Value::Kind::Slot: return position;
+        }
+        return position;
+    }
+
+    auto popToRegister() -> int64_t
+    {
+        auto const value = pop();
+        return toRegister(value, depth() + 1);
+    }
+
+    /**
+     * @brief Emits an instruction writing register a and keeps track of the
+     * registers known to hold a constant.
+     */
+    auto emitWrite(RegisterCode::Type op, int64_t a, int64_t b = 0, int64_t c = 0) -> std::size_t
+    {
+        constants_.erase(a);
+        if (op == RegisterCode::MOVK) { constants_[a] = b; }
+        return emit(op, a, b, c);
+    }
+
+    auto emit(RegisterCode::Type op, int64_t a = 0, int64_t b = 0, int64_t c = 0) -> std::size_t
+    {
+        trace_.instructions.push_back(make(op, a, b, c));
+        return trace_.instructions.size() - 1;
+    }
+
+    [[nodiscard]] auto make(RegisterCode::Type op, int64_t a, int64_t b = 0, int64_t c = 0) const
+        -> RegisterInstruction
+    {
+        auto inst    = RegisterInstruction {};
+        inst.opcode  = op;
+        inst.a       = a;
+        inst.b       = b;
+        inst.c       = c;
+        inst.address = current_.instruction.address;
+        return inst;
+    }
+
+    auto push(Value const& value) -> void { stack_.push_back(value); }
+
+    auto pop() -> Value
+    {
+        // values below the header depth are not tracked
+        if (stack_.empty())
+        {
+            fail();
+            return {};
+        }
+        auto const value = stack_.back();
+        stack_.pop_back();
+        return value;
+    }
+
+    auto fail() -> void { failed_ = true; }
+
+    [[nodiscard]] auto addressOf(int64_t const index) const -> int64_t
+    {
+        return program_.instructions.at(static_cast<std::size_t>(index)).address;
+    }
+
+    [[nodiscard]] auto depth() const -> int64_t { return base_ + static_cast<int64_t>(stack_.size()); }
+    [[nodiscard]] auto positionOf(std::size_t index) const -> int64_t
+    {
+        return base_ + 1 + static_cast<int64_t>(index);
+    }
+    [[nodiscard]] auto slotIndex(int64_t position) const -> std::size_t
+    {
+        return static_cast<std::size_t>(position - base_ - 1);
+    }
+
+    DecodedProgram const& program_;
+    TraceRecorder const& recorder_;
+    Trace trace_ {};
+    TraceStep current_ {};
+
+    std::vector<Value> stack_ {};
+    std::map<int64_t, int64_t> constants_ {};  // register -> value written in this iteration
+    int64_t base_ {0};
+    bool failed_ {false};
+    std::optional<std::size_t> lastProducer_ {};
+};
+
+auto printInstruction(std::ostream& out, RegisterInstruction const& inst) -> void
+{
+    auto const opcode      = static_cast<RegisterCode::Type>(inst.opcode);
+    auto const numOperands = gsl::at(RegisterInstructions, inst.opcode).numberOfOperands;
+
+    out << fmt::format("{}", opcode);
+    if (numOperands >= 1) { out << fmt::format(" {}", inst.a); }
+    if (numOperands >= 2) { out << fmt::format(", {}", inst.b); }
+    if (numOperands >= 3) { out << fmt::format(", {}", inst.c); }
+    out << '\n';
+}
+}  // namespace
+
+auto TraceRecorder::start(int64_t const header, int64_t const frameOffset) -> void
+{
+    state_       = State::Recording;
+    header_      = header;
+    frameOffset_ = frameOffset;
+    steps_.clear();
+}
+
+auto TraceRecorder::record(int64_t const index, DecodedInstruction const& instruction, int64_t const next) -> State
+{
+    if (state_ != State::Recording) { return state_; }
+
+    switch (instruction.opcode)
+    {
+        case ByteCode::CALL:
+        case ByteCode::SPAWN:
+        case ByteCode::TAILCALL:
+        case ByteCode::CALLNATIVE:
+        case ByteCode::RET:
+        case ByteCode::EXIT:
+        case ByteCode::HALT:
+        case ByteCode::NOOP: state_ = State::Aborted; return state_;
+        default: break;
+    }
+
+    steps_.push_back(TraceStep {instruction, index, next});
+    if (next == header_) { state_ = State::Complete; }
+    else if (next <= index || steps_.size() >= MaxLength)
+    {
+        state_ = State::Aborted;
+    }
+    return state_;
+}
+
+auto TraceRecorder::reset() -> void
+{
+    state_ = State::Idle;
+    steps_.clear();
+}
+
+auto operator<<(std::ostream& out, Trace const& trace) -> std::ostream&
+{
+    out << fmt::format("trace {:04}: frame offset {}\n", trace.address, trace.frameOffset);
+    for (auto i = std::size_t {0}; i < trace.instructions.size(); ++i)
+    {
+        out << fmt::format("{:04}: ", i);
+        printInstruction(out, trace.instructions[i]);
+    }
+
+    for (auto i = std::size_t {0}; i < trace.exits.size(); ++i)
+    {
+        auto const& exit = trace.exits[i];
+        out << fmt::format("exit {}: {:04}, stack pointer {}\n", i, exit.address, exit.stackPointer);
+        for (auto const& inst : exit.restore)
+        {
+            out << "      ";
+            printInstruction(out, inst);
+        }
+    }
+    return out;
+}
+
+auto optimizeTrace(DecodedProgram const& program, TraceRecorder const& recorder) -> std::optional<Trace>
+{
+    return TraceOptimizer {program, recorder}.run();
+}
+
+}  // namespace tcc
@@ -0,0 +1,107 @@
+/**
+ * @file trace.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/decoder.hpp"
+#include "tcvm/vm/register_translator.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Leaves a trace when a guard fails. The pending values are written
+ * back before the interpreter resumes, so the VM state is the same as if the
+ * recorded path had been interpreted up to the guard.
+ */
+struct TraceExit
+{
+    int64_t address {0};                          // raw address to resume at
+    int64_t stackPointer {0};                     // relative to the frame pointer
+    std::vector<RegisterInstruction> restore {};  // MOV & MOVK only
+};
+
+/**
+ * @brief Optimized loop trace in register code.
+ *
+ * Registers are frame relative, same as in RegisterProgram. BRT & BRF are
+ * guards, their target is an index into exits. The last instruction is a BR
+ * back to the first one. A trace only runs in frames where the stack pointer
+ * is frameOffset slots above the frame pointer at the loop header.
+ */
+struct Trace
+{
+    int64_t header {0};       // decoded index of the loop header
+    int64_t address {0};      // raw address of the loop header
+    int64_t frameOffset {0};  // stack pointer - frame pointer at the header
+    std::vector<RegisterInstruction> instructions {};
+    std::vector<TraceExit> exits {};
+};
+
+auto operator<<(std::ostream& out, Trace const& trace) -> std::ostream&;
+
+/**
+ * @brief One executed instruction of a recorded trace.
+ */
+struct TraceStep
+{
+    DecodedInstruction instruction {};
+    int64_t index {0};  // decoded index
+    int64_t next {0};   // decoded index executed afterwards
+};
+
+/**
+ * @brief Records the path a loop takes, starting at its header.
+ *
+ * Recording completes when the path gets back to the header. It is aborted by
+ * calls including CALLNATIVE, returns, the end of the program, branches back
+ * to anything but the header and traces longer than MaxLength.
+ */
+class TraceRecorder
+{
+public:
+    enum class State
+    {
+        Idle,
+        Recording,
+        Complete,
+        Aborted,
+    };
+
+    static constexpr auto MaxLength = std::size_t {256};
+
+    auto start(int64_t header, int64_t frameOffset) -> void;
+    auto record(int64_t index, DecodedInstruction const& instruction, int64_t next) -> State;
+    auto reset() -> void;
+
+    [[nodiscard]] auto state() const noexcept -> State { return state_; }
+    [[nodiscard]] auto header() const noexcept -> int64_t { return header_; }
+    [[nodiscard]] auto frameOffset() const noexcept -> int64_t { return frameOffset_; }
+    [[nodiscard]] auto steps() const noexcept -> std::vector<TraceStep> const& { return steps_; }
+
+private:
+    State state_ {State::Idle};
+    int64_t header_ {0};
+    int64_t frameOffset_ {0};
+    std::vector<TraceStep> steps_ {};
+};
+
+/**
+ * @brief Turns a complete recording into a Trace.
+ *
+ * The operand stack is kept symbolic like in translateToRegisterCode(), so
+ * push/pop pairs become single register instructions. Constants are
+ * propagated through registers written in the same iteration, and guards on
+ * constant conditions are dropped. Returns std::nullopt if the stack depth at
+ * the end differs from the header or the loop pops below the header depth.
+ */
+auto optimizeTrace(DecodedProgram const& program, TraceRecorder const& recorder) -> std::optional<Trace>;
+
+}  // namespace tcc
@@ -0,0 +1,249 @@
+/**
+ * @file trace_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/trace.hpp"
+#include "tcvm/vm/jit.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+
+#include <algorithm>
+
+using tcc::ByteCode;
+using tcc::RegisterCode;
+using tcc::TraceRecorder;
+
+namespace
+{
+/**
+ * @brief Records one iteration starting at the header, conditional branches
+ * fall through.
+ */
+auto recordLoop(tcc::DecodedProgram const& program, int64_t headerAddress, int64_t frameOffset) -> TraceRecorder
+{
+    auto recorder = TraceRecorder {};
+    auto index    = program.indexAt(headerAddress);
+    recorder.start(index, frameOffset);
+    while (recorder.state() == TraceRecorder::State::Recording)
+    {
+        auto const& inst = program.instructions[static_cast<std::size_t>(index)];
+        auto const next  = inst.opcode == ByteCode::BR ? inst.operand : index + 1;
+        recorder.record(index, inst, next);
+        index = next;
+    }
+    return recorder;
+}
+
+auto opcodes(tcc::Trace const& trace) -> std::vector<int64_t>
+{
+    auto result = std::vector<int64_t> {};
+    std::transform(begin(trace.instructions), end(trace.instructions), std::back_inserter(result),
+                   [](auto const& inst) { return inst.opcode; });
+    return result;
+}
+
+// for (i = 0; i < 10; ++i) { sum += i; }
+auto const sumLoop = std::vector<int64_t> {
+    ByteCode::ICONST, 0,   // 0 i
+    ByteCode::ICONST, 0,   // 2 sum
+    ByteCode::LOAD,   0,   // 4 <-- header
+    ByteCode::ICONST, 10,  // 6
+    ByteCode::ILT,         // 8
+    ByteCode::BRF,    27,  // 9
+    ByteCode::LOAD,   1,   // 11
+    ByteCode::LOAD,   0,   // 13
+    ByteCode::IADD,        // 15
+    ByteCode::STORE,  1,   // 16
+    ByteCode::LOAD,   0,   // 18
+    ByteCode::ICONST, 1,   // 20
+    ByteCode::IADD,        // 22
+    ByteCode::STORE,  0,   // 23
+    ByteCode::BR,     4,   // 25
+    ByteCode::LOAD,   1,   // 27
+    ByteCode::EXIT,        // 29
+};
+
+// leaves the loop with two values on the stack that are only symbolic in the trace
+auto const pendingExit = std::vector<int64_t> {
+    ByteCode::ICONST, 0,    // 0 i
+    ByteCode::LOAD,   0,    // 2 <-- header
+    ByteCode::ICONST, 100,  // 4
+    ByteCode::LOAD,   0,    // 6
+    ByteCode::ICONST, 10,   // 8
+    ByteCode::ILT,          // 10
+    ByteCode::BRF,    24,   // 11
+    ByteCode::POP,          // 13
+    ByteCode::POP,          // 14
+    ByteCode::LOAD,   0,    // 15
+    ByteCode::ICONST, 1,    // 17
+    ByteCode::IADD,         // 19
+    ByteCode::STORE,  0,    // 20
+    ByteCode::BR,     2,    // 22
+    ByteCode::IADD,         // 24
+    ByteCode::EXIT,         // 25
+};
+}  // namespace
+
+TEST_CASE("tcvm: TraceRecorder", "[tcvm]")
+{
+    auto const program = tcc::decode(sumLoop, 0);
+
+    SECTION("complete loop")
+    {
+        auto const recorder = recordLoop(program, 4, 1);
+        REQUIRE(recorder.state() == TraceRecorder::State::Complete);
+        REQUIRE(recorder.steps().size() == 13);
+        REQUIRE(recorder.steps().back().next == recorder.header());
+    }
+
+    SECTION("aborted by calls and other loops")
+    {
+        auto recorder = TraceRecorder {};
+        recorder.start(2, 0);
+        auto call    = tcc::DecodedInstruction {};
+        call.opcode  = ByteCode::CALL;
+        call.operand = 0;
+        REQUIRE(recorder.record(2, call, 0) == TraceRecorder::State::Aborted);
+
+        recorder.start(2, 0);
+        auto branch    = tcc::DecodedInstruction {};
+        branch.opcode  = ByteCode::BR;
+        branch.operand = 1;
+        REQUIRE(recorder.record(3, branch, 1) == TraceRecorder::State::Aborted);
+
+        recorder.reset();
+        REQUIRE(recorder.state() == TraceRecorder::State::Idle);
+        REQUIRE(recorder.steps().empty());
+    }
+
+    SECTION("aborted when too long")
+    {
+        auto recorder = TraceRecorder {};
+        recorder.start(0, 0);
+        auto pop   = tcc::DecodedInstruction {};
+        pop.opcode = ByteCode::POP;
+        for (auto i = int64_t {1}; i < static_cast<int64_t>(TraceRecorder::MaxLength); ++i)
+        { REQUIRE(recorder.record(i, pop, i + 1) == TraceRecorder::State::Recording); }
+        REQUIRE(recorder.record(1000, pop, 1001) == TraceRecorder::State::Aborted);
+    }
+}
+
+TEST_CASE("tcvm: TraceOptimize", "[tcvm]")
+{
+    SECTION("push/pop pairs collapse into register instructions")
+    {
+        auto const program = tcc::decode(sumLoop, 0);
+        auto const trace   = tcc::optimizeTrace(program, recordLoop(program, 4, 1));
+        REQUIRE(trace.has_value());
+        REQUIRE(trace->address == 4);
+        REQUIRE(opcodes(trace.value())
+                == std::vector<int64_t> {RegisterCode::ILTK, RegisterCode::BRF, RegisterCode::IADD, RegisterCode::IADDK,
+                                         RegisterCode::BR});
+
+        // the increments write their locals directly
+        CHECK(trace->instructions[2].a == 1);
+        CHECK(trace->instructions[3].a == 0);
+
+        REQUIRE(trace->exits.size() == 1);
+        CHECK(trace->exits[0].address == 27);
+        CHECK(trace->exits[0].stackPointer == 1);
+        CHECK(trace->exits[0].restore.empty());
+    }
+
+    SECTION("constants propagate through registers")
+    {
+        auto const code = std::vector<int64_t> {
+            ByteCode::ICONST, 5,  // 0 <-- header
+            ByteCode::STORE,  2,  // 2
+            ByteCode::LOAD,   0,  // 4
+            ByteCode::LOAD,   2,  // 6 known to be 5
+            ByteCode::IADD,       // 8
+            ByteCode::STORE,  0,  // 9
+            ByteCode::ICONST, 1,  // 11
+            ByteCode::BRT,    15, // 13 constant, no guard
+            ByteCode::BR,     0,  // 15
+        };
+
+        auto const program = tcc::decode(code, 0);
+        auto const trace   = tcc::optimizeTrace(program, recordLoop(program, 0, 2));
+        REQUIRE(trace.has_value());
+        REQUIRE(opcodes(trace.value())
+                == std::vector<int64_t> {RegisterCode::MOVK, RegisterCode::IADDK, RegisterCode::BR});
+        CHECK(trace->instructions[1].c == 5);
+        CHECK(trace->exits.empty());
+    }
+
+    SECTION("guards restore pending values")
+    {
+        auto const program = tcc::decode(pendingExit, 0);
+        auto const trace   = tcc::optimizeTrace(program, recordLoop(program, 2, 0));
+        REQUIRE(trace.has_value());
+        REQUIRE(trace->exits.size() == 1);
+
+        auto const& exit = trace->exits[0];
+        CHECK(exit.address == 24);
+        CHECK(exit.stackPointer == 2);
+        REQUIRE(exit.restore.size() == 2);
+        CHECK(exit.restore[0].opcode == RegisterCode::MOV);
+        CHECK(exit.restore[1].opcode == RegisterCode::MOVK);
+        CHECK(exit.restore[1].b == 100);
+    }
+
+    SECTION("unbalanced stack")
+    {
+        auto const code = std::vector<int64_t> {
+            ByteCode::ICONST, 1,  // 0 <-- header
+            ByteCode::BR,     0,  // 2
+        };
+
+        auto const program = tcc::decode(code, 0);
+        REQUIRE_FALSE(tcc::optimizeTrace(program, recordLoop(program, 0, 0)).has_value());
+    }
+}
+
+#if defined(TCC_VM_HAS_JIT)
+
+TEST_CASE("tcvm: TraceCompileAndRun", "[tcvm]")
+{
+    auto stack    = std::vector<int64_t>(16);
+    auto context  = tcc::JitContext {};
+    context.stack = stack.data();
+
+    SECTION("runs until the loop condition fails")
+    {
+        auto const program = tcc::decode(sumLoop, 0);
+        auto const trace   = tcc::optimizeTrace(program, recordLoop(program, 4, 1));
+        REQUIRE(trace.has_value());
+        auto const native = tcc::compileTrace(trace.value());
+        REQUIRE(native.has_value());
+
+        context.stackPointer = 1;
+        REQUIRE(native->run(context) == 0);
+        CHECK(context.stackPointer == 1);
+        CHECK(context.framePointer == 0);
+        CHECK(context.instructionPointer == 27);
+        CHECK(stack[0] == 10);
+        CHECK(stack[1] == 45);
+    }
+
+    SECTION("side exits write pending values back")
+    {
+        auto const program = tcc::decode(pendingExit, 0);
+        auto const trace   = tcc::optimizeTrace(program, recordLoop(program, 2, 0));
+        REQUIRE(trace.has_value());
+        auto const native = tcc::compileTrace(trace.value());
+        REQUIRE(native.has_value());
+
+        stack[0]             = 3;
+        context.stackPointer = 0;
+        REQUIRE(native->run(context) == 0);
+        CHECK(context.stackPointer == 2);
+        CHECK(context.instructionPointer == 24);
+        CHECK(stack[0] == 10);
+        CHECK(stack[1] == 10);
+        CHECK(stack[2] == 100);
+    }
+}
+
+#endif
@@ -0,0 +1,375 @@
+/**
+ * @file verifier.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/verifier.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace tcc
+{
+namespace
+{
+constexpr auto Unvisited = std::numeric_limits<int64_t>::min();
+
+/**
+ * @brief Walks every reachable instruction once per function. The stack depth
+ * is tracked relative to the frame pointer: the entry point starts at -1 with
+ * the frame pointer at slot 0, a function starts at 0 with its return address
+ * in the frame pointer slot.
+ */
+class Verifier
+{
+public:
+    Verifier(std::vector<int64_t> const& code, int64_t entryPoint)
+        : code_ {code}
+        , size_ {static_cast<int64_t>(code.size())}
+        , depthAt_(code.size(), Unvisited)
+        , ownerAt_(code.size(), 0)
+        , isStart_(code.size() + 1, false)
+    {
+        result_.functions.push_back({entryPoint, 0, -1});
+        functionIndex_[entryPoint] = 0;
+
+        // unknown opcodes take one word, the walk rejects them once reached
+        for (auto address = int64_t {0}; address < size_;)
+        {
+            isStart_[static_cast<std::size_t>(address)] = true;
+            auto const opcode = code_[static_cast<std::size_t>(address)];
+            auto const known  = opcode > ByteCode::NOOP && opcode < ByteCode::NUM_OPCODES;
+            address += 1 + (known ? Instructions[static_cast<std::size_t>(opcode)].numberOfOperands : 0);
+        }
+        isStart_.back() = true;  // the trailing HALT
+    }
+
+    auto run() -> VerifierResult
+    {
+        auto const entryPoint = result_.functions.front().address;
+        if (entryPoint < 0 || entryPoint > size_)
+        {
+            fail(entryPoint, "entry point out of range");
+            return std::move(result_);
+        }
+        if (!isStart(entryPoint))
+        {
+            fail(entryPoint, "entry point inside an instruction");
+            return std::move(result_);
+        }
+
+        // CALLs append to functions while it is walked
+        for (auto function = std::size_t {0}; function < result_.functions.size(); ++function)
+        {
+            if (!walk(function)) { return std::move(result_); }
+        }
+
+        result_.stackSize = stackSize();
+        // a TAILCALL with more arguments than its caller moves the frame up
+        for (auto const& function : result_.functions)
+        {
+            result_.callHeadroom = std::max(result_.callHeadroom, function.arguments + function.maxStackDepth + 4);
+        }
+        return std::move(result_);
+    }
+
+private:
+    struct CallSite
+    {
+        std::size_t caller {0};
+        std::size_t callee {0};
+        int64_t depth {0};  // caller depth after pushing the arguments
+    };
+
+    auto walk(std::size_t const function) -> bool
+    {
+        auto const isEntry = function == 0;
+        floor_             = isEntry ? -1 : 0;
+        arguments_         = result_.functions[function].arguments;
+        function_          = function;
+
+        worklist_.clear();
+        if (!reach(result_.functions[function].address, floor_)) { return false; }
+
+        while (!worklist_.empty())
+        {
+            auto const address = worklist_.back();
+            worklist_.pop_back();
+            if (!step(address)) { return false; }
+        }
+        return true;
+    }
+
+    auto reach(int64_t const address, int64_t const depth) -> bool
+    {
+        if (address == size_) { return true; }  // runs into the trailing HALT
+        auto const index = static_cast<std::size_t>(address);
+        if (depthAt_[index] == Unvisited)
+        {
+            depthAt_[index] = depth;
+            ownerAt_[index] = function_;
+            worklist_.push_back(address);
+            return true;
+        }
+
+        if (ownerAt_[index] != function_) { return fail(address, "code shared between functions"); }
+        if (depthAt_[index] != depth) { return fail(address, "stack depth mismatch"); }
+        return true;
+    }
+
+    auto step(int64_t const address) -> bool
+    {
+        auto const opcode = code_[static_cast<std::size_t>(address)];
+        if (opcode <= ByteCode::NOOP || opcode >= ByteCode::NUM_OPCODES)
+        { return fail(address, "unknown instruction"); }
+
+        auto const numOps = Instructions[static_cast<std::size_t>(opcode)].numberOfOperands;
+        if (address + numOps >= size_) { return fail(address, "missing operand"); }
+
+        auto const operand = [&](int64_t const index) { return code_[static_cast<std::size_t>(address + 1 + index)]; };
+        auto const next    = address + 1 + numOps;
+        auto const depth   = depthAt_[static_cast<std::size_t>(address)];
+
+        if (auto const target = targetOperandIndex(opcode); target >= 0)
+        {
+            if (operand(target) < 0 || operand(target) > size_) { return fail(address, "branch target out of range"); }
+            if (!isStart(operand(target))) { return fail(address, "branch target inside an instruction"); }
+        }
+
+        // pops & pushes, then the successors
+        auto const apply = [&](int64_t const pops, int64_t const pushes) -> std::optional<int64_t> {
+            if (depth - pops < floor_)
+            {
+                fail(address, "stack underflow");
+                return std::nullopt;
+            }
+            auto const after   = depth - pops + pushes;
+            auto& info         = result_.functions[function_];
+            info.maxStackDepth = std::max(info.maxStackDepth, after);
+            return after;
+        };
+
+        switch (opcode)
+        {
+            case ByteCode::IADD:
+            case ByteCode::ISUB:
+            case ByteCode::IMUL:
+            case ByteCode::ILT:
+            case ByteCode::IEQ: return fallThrough(apply(2, 1), next);
+
+            case ByteCode::ICONST: return fallThrough(apply(0, 1), next);
+            case ByteCode::POP:
+            case ByteCode::PRINT: return fallThrough(apply(1, 0), next);
+
+            case ByteCode::GLOAD:
+            case ByteCode::GSTORE:
+            {
+                if (operand(0) < 0 || operand(0) >= MaxGlobals) { return fail(address, "global address out of range"); }
+                result_.globals = std::max(result_.globals, operand(0) + 1);
+                return fallThrough(opcode == ByteCode::GLOAD ? apply(0, 1) : apply(1, 0), next);
+            }
+
+            case ByteCode::LOAD:
+            case ByteCode::LOAD_ICONST_IADD:
+            case ByteCode::LOAD_ICONST_ISUB:
+            case ByteCode::LOAD_ICONST_ILT:
+            {
+                if (!isReadable(operand(0), depth)) { return fail(address, "local out of range"); }
+                return fallThrough(apply(0, 1), next);
+            }
+
+            case ByteCode::LOAD_LOAD_IADD:
+            {
+                if (!isReadable(operand(0), depth) || !isReadable(operand(1), depth))
+                { return fail(address, "local out of range"); }
+                return fallThrough(apply(0, 1), next);
+            }
+
+            case ByteCode::STORE:
+            {
+                if (!isWritable(operand(0), depth)) { return fail(address, "local out of range"); }
+                return fallThrough(apply(1, 0), next);
+            }
+
+            case ByteCode::BR: return reach(operand(0), depth);
+            case ByteCode::BRT:
+            case ByteCode::BRF:
+            {
+                auto const after = apply(1, 0);
+                return after.has_value() && reach(operand(0), after.value()) && reach(next, after.value());
+            }
+            case ByteCode::ILT_BRF:
+            {
+                auto const after = apply(2, 0);
+                return after.has_value() && reach(operand(0), after.value()) && reach(next, after.value());
+            }
+
+            case ByteCode::CALL:
+            case ByteCode::SPAWN: return call(address, operand(0), operand(1), depth, next);
+            case ByteCode::TAILCALL:
+            {
+                if (function_ == 0) { return fail(address, "tail call outside of a function"); }
+                return tailCall(address, operand(0), operand(1), depth);
+            }
+            case ByteCode::JOIN: return fallThrough(apply(1, 1), next);
+            case ByteCode::CALLNATIVE:
+            {
+                if (operand(0) < 0) { return fail(address, "native function out of range"); }
+                if (operand(1) < 0) { return fail(address, "stack underflow"); }
+                result_.natives = std::max(result_.natives, operand(0) + 1);
+                return fallThrough(apply(operand(1), 1), next);
+            }
+
+            case ByteCode::RET:
+            {
+                if (function_ == 0) { return fail(address, "return outside of a function"); }
+                return apply(1, 0).has_value();
+            }
+
+            case ByteCode::EXIT: return apply(1, 0).has_value();
+            case ByteCode::HALT: return true;
+            default: return fail(address, "unknown instruction");
+        }
+    }
+
+    auto addCallee(int64_t const address, int64_t const target, int64_t const numArgs) -> bool
+    {
+        if (target == size_) { return fail(address, "branch target out of range"); }
+
+        auto const [iter, inserted] = functionIndex_.insert({target, result_.functions.size()});
+        if (inserted) { result_.functions.push_back({target, numArgs, 0}); }
+        else if (iter->second == 0)
+        {
+            return fail(address, "call to the entry point");
+        }
+        else if (result_.functions[iter->second].arguments != numArgs)
+        {
+            return fail(address, "inconsistent argument count");
+        }
+        return true;
+    }
+
+    auto call(int64_t const address, int64_t const target, int64_t const numArgs, int64_t const depth,
+              int64_t const next) -> bool
+    {
+        if (numArgs < 0 || depth - numArgs < floor_) { return fail(address, "stack underflow"); }
+        if (!addCallee(address, target, numArgs)) { return false; }
+
+        calls_.push_back({function_, functionIndex_[target], depth});
+        auto& info         = result_.functions[function_];
+        info.maxStackDepth = std::max(info.maxStackDepth, depth + 3);
+        return reach(next, depth - numArgs + 1);
+    }
+
+    /**
+     * @brief The callee frame replaces the current one from its first
+     * argument on, so the callee frame pointer ends up numArgs - arguments_
+     * slots above ours. Recorded at the depth a CALL would need for that.
+     */
+    auto tailCall(int64_t const address, int64_t const target, int64_t const numArgs, int64_t const depth) -> bool
+    {
+        if (numArgs < 0 || depth - numArgs < floor_) { return fail(address, "stack underflow"); }
+        if (!addCallee(address, target, numArgs)) { return false; }
+        calls_.push_back({function_, functionIndex_[target], numArgs - arguments_ - 3});
+        return true;
+    }
+
+    /**
+     * @brief True if a linear walk from address 0 decodes an instruction at
+     * address, or address is the end of the code. Only valid in range.
+     */
+    [[nodiscard]] auto isStart(int64_t const address) const noexcept -> bool
+    {
+        return isStart_[static_cast<std::size_t>(address)];
+    }
+
+    auto fallThrough(std::optional<int64_t> const depth, int64_t const next) -> bool
+    {
+        return depth.has_value() && reach(next, depth.value());
+    }
+
+    /**
+     * @brief Slots a function may read: its arguments, the saved frame & its
+     * own stack. The entry point only has its own stack.
+     */
+    [[nodiscard]] auto isReadable(int64_t const offset, int64_t const depth) const noexcept -> bool
+    {
+        auto const lowest = function_ == 0 ? 0 : -(2 + arguments_);
+        return offset >= lowest && offset <= depth;
+    }
+
+    /**
+     * @brief Like isReadable() without the saved numArgs, frame pointer &
+     * return address.
+     */
+    [[nodiscard]] auto isWritable(int64_t const offset, int64_t const depth) const noexcept -> bool
+    {
+        if (!isReadable(offset, depth)) { return false; }
+        return function_ == 0 || offset < -2 || offset > 0;
+    }
+
+    /**
+     * @brief Slots the whole program needs. Each call adds the callee frame on
+     * top of the caller depth, a cycle in the call graph means the depth
+     * depends on the input.
+     */
+    auto stackSize() -> std::optional<int64_t>
+    {
+        auto const count = result_.functions.size();
+        auto need        = std::vector<int64_t>(count, Unvisited);
+        auto active      = std::vector<bool>(count, false);
+
+        auto visit = [&](auto& self, std::size_t function) -> bool {
+            if (need[function] != Unvisited) { return true; }
+            if (active[function]) { return false; }
+            active[function] = true;
+
+            auto deepest = result_.functions[function].maxStackDepth;
+            for (auto const& site : calls_)
+            {
+                if (site.caller != function) { continue; }
+                if (!self(self, site.callee)) { return false; }
+                deepest = std::max(deepest, site.depth + 3 + need[site.callee]);
+            }
+
+            active[function] = false;
+            need[function]   = deepest;
+            return true;
+        };
+
+        if (!visit(visit, 0)) { return std::nullopt; }
+        return std::max(need[0] + 1, int64_t {1});
+    }
+
+    auto fail(int64_t const address, std::string_view const error) -> bool
+    {
+        result_.error   = error;
+        result_.address = address;
+        return false;
+    }
+
+    std::vector<int64_t> const& code_;
+    int64_t size_ {0};
+    std::vector<int64_t> depthAt_;
+    std::vector<std::size_t> ownerAt_;
+    std::vector<bool> isStart_;
+    std::vector<int64_t> worklist_ {};
+    std::vector<CallSite> calls_ {};
+    std::map<int64_t, std::size_t> functionIndex_ {};
+
+    std::size_t function_ {0};
+    int64_t floor_ {-1};
+    int64_t arguments_ {0};
+    VerifierResult result_ {};
+};
+}  // namespace
+
+auto verify(std::vector<int64_t> const& code, int64_t entryPoint) -> VerifierResult
+{
+    return Verifier {code, entryPoint}.run();
+}
+
+auto verify(BinaryProgram const& program) -> VerifierResult { return verify(program.data, program.entryPoint); }
+
+}  // namespace tcc
@@ -0,0 +1,74 @@
+/**
+ * @file verifier.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Largest data segment a verified program may address, in slots. The
+ * binary format declares no data size, globals come from the operands.
+ */
+constexpr auto MaxGlobals = int64_t {1} << 20;
+
+/**
+ * @brief Frame layout of one function found by the verifier.
+ */
+struct FunctionInfo
+{
+    int64_t address {0};        // first instruction
+    int64_t arguments {0};      // numArgs of every CALL to it, 0 for the entry point
+    int64_t maxStackDepth {0};  // slots above the frame pointer, without callees
+};
+
+/**
+ * @brief Outcome of verify(). Only valid if error is empty.
+ */
+struct VerifierResult
+{
+    std::string_view error {};              // empty if the program was verified
+    int64_t address {0};                    // address of the offending instruction
+    std::vector<FunctionInfo> functions {};  // entry point first
+    int64_t globals {0};                    // highest global address + 1
+    int64_t natives {0};                    // highest native function index + 1
+    std::optional<int64_t> stackSize {};    // slots needed including calls, std::nullopt if recursive
+    int64_t callHeadroom {0};               // slots the largest callee frame needs above sp at its CALL
+
+    [[nodiscard]] auto ok() const noexcept -> bool { return error.empty(); }
+};
+
+/**
+ * @brief Checks a program once before it runs.
+ *
+ * Follows every path reachable from the entry point and from every call
+ * target. Opcodes, operands and branch targets have to be valid, the entry
+ * point and every branch or call target has to start an instruction of the
+ * code decoded from address 0, so all engines see the same instructions. Every
+ * jump target has to be reached with the same stack depth, no path may pop below
+ * its frame, LOAD & STORE have to stay inside their frame and STORE may not
+ * overwrite the saved numArgs, frame pointer or return address. GLOAD &
+ * GSTORE have to address a global below MaxGlobals. Each CALL
+ * target has to be called with the same number of arguments. SPAWN is checked
+ * like CALL, so stackSize also bounds the stack of every task. TAILCALL is
+ * only allowed inside a function, its callee frame replaces the current one.
+ * CALLNATIVE pops its arguments & pushes the result, the host functions are
+ * checked against their arity by resolveNatives().
+ *
+ * A verified program can't access memory outside a stack of stackSize slots
+ * and a data segment of globals slots or call past a table of natives host
+ * functions, so it can run without any checks. Recursive programs have no
+ * static stack bound.
+ */
+auto verify(std::vector<int64_t> const& code, int64_t entryPoint) -> VerifierResult;
+auto verify(BinaryProgram const& program) -> VerifierResult;
+
+}  // namespace tcc
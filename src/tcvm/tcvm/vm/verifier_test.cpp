@@ -0,0 +1,233 @@
+/**
+ * @file verifier_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/verifier.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/vm.hpp"
+
+using tcc::ByteCode;
+using tcc::VirtualMachine;
+
+namespace
+{
+auto errorOf(std::vector<int64_t> const& code, int64_t entryPoint = 0) -> std::string
+{
+    auto const result = tcc::verify(code, entryPoint);
+    return std::string {result.error};
+}
+}  // namespace
+
+TEST_CASE("tcvm: VerifyExamples", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createCompiledProgram(),                //
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+        tcvm::createParallelFibonacciProgram(12, 4),  //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto const result = tcc::verify(program);
+        REQUIRE(result.ok());
+        REQUIRE(tcc::verify(tcc::fuseSuperinstructions(program)).ok());
+    }
+}
+
+TEST_CASE("tcvm: VerifyStackSize", "[tcvm]")
+{
+    SECTION("function calls add their frames")
+    {
+        auto const program = tcvm::createAdditionProgram(10);
+        auto const result  = tcc::verify(program);
+        REQUIRE(result.ok());
+        REQUIRE(result.functions.size() == 2);
+        CHECK(result.functions[0].address == program.entryPoint);
+        CHECK(result.functions[1].address == 0);
+        CHECK(result.functions[1].arguments == 2);
+        CHECK(result.functions[1].maxStackDepth == 3);
+
+        // 2 arguments, numArgs, fp, return address & 3 slots of the callee
+        REQUIRE(result.stackSize.has_value());
+        REQUIRE(result.stackSize.value() == 8);
+    }
+
+    SECTION("tail calls replace the frame")
+    {
+        // g(x, y) { return f(y); } f(x) { return x; } main() { return g(1, 2); }
+        auto const code = std::vector<int64_t> {
+            ByteCode::LOAD,     -3,     // 0 <-- g
+            ByteCode::TAILCALL, 5,  1,  // 2
+            ByteCode::LOAD,     -3,     // 5 <-- f
+            ByteCode::RET,              // 7
+            ByteCode::ICONST,   1,      // 8 <-- main
+            ByteCode::ICONST,   2,      // 10
+            ByteCode::CALL,     0,  2,  // 12
+            ByteCode::EXIT,             // 15
+        };
+        auto const result = tcc::verify(code, 8);
+        REQUIRE(result.ok());
+        REQUIRE(result.functions.size() == 3);
+        CHECK(result.functions[2].arguments == 1);
+
+        // 2 arguments, numArgs, fp & return address, g pushes 1 more
+        REQUIRE(result.stackSize.value() == 6);
+        auto vm = VirtualMachine(code, 8, 0, 6, false);
+        REQUIRE(vm.cpu() == 2);
+    }
+
+    SECTION("recursion has no static bound")
+    {
+        auto const result = tcc::verify(tcvm::createFibonacciProgram(12));
+        REQUIRE(result.ok());
+        REQUIRE_FALSE(result.stackSize.has_value());
+    }
+
+    SECTION("globals")
+    {
+        auto const code = std::vector<int64_t> {
+            ByteCode::ICONST, 1,  //
+            ByteCode::GSTORE, 3,  //
+            ByteCode::GLOAD,  3,  //
+            ByteCode::EXIT,       //
+        };
+        auto const result = tcc::verify(code, 0);
+        REQUIRE(result.ok());
+        CHECK(result.globals == 4);
+        CHECK(result.stackSize.value() == 1);
+    }
+
+    SECTION("every engine runs with the exact stack size")
+    {
+        for (auto const& program : {tcvm::createAdditionProgram(10), tcvm::createMultipleFunctionsProgram(2)})
+        {
+            auto const result    = tcc::verify(program);
+            auto const stackSize = static_cast<uint64_t>(result.stackSize.value());
+            auto reference       = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+            auto const expected  = reference.cpu();
+
+            for (auto const engine : {VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                      VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                      VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact})
+            {
+                auto vm = VirtualMachine(program.data, program.entryPoint, 0, stackSize, false, std::cout, engine);
+                REQUIRE(vm.cpu() == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("tcvm: VerifyRejects", "[tcvm]")
+{
+    SECTION("unknown opcode & missing operand")
+    {
+        CHECK(errorOf({ByteCode::NUM_OPCODES}) == "unknown instruction");
+        CHECK(errorOf({ByteCode::NOOP}) == "unknown instruction");
+        CHECK(errorOf({ByteCode::ICONST}) == "missing operand");
+        CHECK(errorOf({ByteCode::HALT}, 3) == "entry point out of range");
+    }
+
+    SECTION("branch targets")
+    {
+        CHECK(errorOf({ByteCode::BR, 100}) == "branch target out of range");
+        CHECK(errorOf({ByteCode::BR, -1}) == "branch target out of range");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::CALL, 5, 1}) == "branch target out of range");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::HALT}, 1) == "entry point inside an instruction");
+    }
+
+    SECTION("branch into an operand")
+    {
+        // decoded engines & the switch engine would run different instructions
+        auto const code = std::vector<int64_t> {
+            ByteCode::BR,     3,                     // 0
+            ByteCode::ICONST, ByteCode::ICONST, 42,  // 2
+            ByteCode::EXIT,                          // 5
+        };
+        auto const result = tcc::verify(code, 0);
+        CHECK(result.error == "branch target inside an instruction");
+        CHECK(result.address == 0);
+
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::CALL, 1, 1, ByteCode::EXIT})
+              == "branch target inside an instruction");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::BRT, 1, ByteCode::HALT})
+              == "branch target inside an instruction");
+    }
+
+    SECTION("stack underflow")
+    {
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::IADD, ByteCode::EXIT}) == "stack underflow");
+        CHECK(errorOf({ByteCode::EXIT}) == "stack underflow");
+        CHECK(errorOf({ByteCode::CALL, 3, 1, ByteCode::HALT}) == "stack underflow");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::CALLNATIVE, 0, 2, ByteCode::EXIT}) == "stack underflow");
+        CHECK(errorOf({ByteCode::CALLNATIVE, -1, 0, ByteCode::EXIT}) == "native function out of range");
+
+        auto const result = tcc::verify({ByteCode::ICONST, 1, ByteCode::POP, ByteCode::POP}, 0);
+        CHECK(result.error == "stack underflow");
+        CHECK(result.address == 3);
+    }
+
+    SECTION("globals")
+    {
+        CHECK(errorOf({ByteCode::GLOAD, -1, ByteCode::EXIT}) == "global address out of range");
+        CHECK(errorOf({ByteCode::GLOAD, tcc::MaxGlobals, ByteCode::EXIT}) == "global address out of range");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::GSTORE, tcc::MaxGlobals, ByteCode::HALT})
+              == "global address out of range");
+        CHECK(errorOf({ByteCode::GLOAD, tcc::MaxGlobals - 1, ByteCode::EXIT}).empty());
+    }
+
+    SECTION("stack depth mismatch at a jump target")
+    {
+        // if (x) push 1; then join without popping it again
+        auto const code = std::vector<int64_t> {
+            ByteCode::ICONST, 1,  // 0
+            ByteCode::BRF,    6,  // 2
+            ByteCode::ICONST, 2,  // 4
+            ByteCode::HALT,       // 6
+        };
+        CHECK(errorOf(code) == "stack depth mismatch");
+    }
+
+    SECTION("frames")
+    {
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::RET}) == "return outside of a function");
+        CHECK(errorOf({ByteCode::TAILCALL, 0, 0}) == "tail call outside of a function");
+        CHECK(errorOf({ByteCode::LOAD, 0, ByteCode::EXIT}) == "local out of range");
+        CHECK(errorOf({ByteCode::ICONST, 1, ByteCode::LOAD, -1, ByteCode::EXIT}) == "local out of range");
+
+        // f(x) { store into the saved frame pointer }
+        auto const overwrite = std::vector<int64_t> {
+            ByteCode::ICONST, 1,        // 0
+            ByteCode::STORE,  -1,       // 2
+            ByteCode::LOAD,   -3,       // 4
+            ByteCode::RET,              // 6
+            ByteCode::ICONST, 1,        // 7 <-- main
+            ByteCode::CALL,   0,   1,   // 9
+            ByteCode::EXIT,             // 12
+        };
+        CHECK(errorOf(overwrite, 7) == "local out of range");
+    }
+
+    SECTION("calls")
+    {
+        // f called with 1 & 2 arguments
+        auto const code = std::vector<int64_t> {
+            ByteCode::LOAD,   -3,     // 0
+            ByteCode::RET,            // 2
+            ByteCode::ICONST, 1,      // 3 <-- main
+            ByteCode::CALL,   0, 1,   // 5
+            ByteCode::ICONST, 2,      // 8
+            ByteCode::CALL,   0, 2,   // 10
+            ByteCode::EXIT,           // 13
+        };
+        CHECK(errorOf(code, 3) == "inconsistent argument count");
+        CHECK(errorOf({ByteCode::CALL, 0, 0}) == "call to the entry point");
+    }
+}
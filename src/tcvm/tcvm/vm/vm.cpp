@@ -8,29 +8,463 @@
 
 namespace tcc
 {
+namespace
+{
+/**
+ * @brief Number of values an instruction pops from & pushes to the operand
+ * stack, RET & TAILCALL are checked against their frame separately, CALLNATIVE
+ * against its number of arguments.
+ */
+constexpr auto stackEffect(int64_t const opcode) noexcept -> std::pair<int64_t, int64_t>
+{
+    switch (opcode)
+    {
+        case ByteCode::IADD:
+        case ByteCode::ISUB:
+        case ByteCode::IMUL:
+        case ByteCode::ILT:
+        case ByteCode::IEQ: return {2, 1};
+        case ByteCode::BRT:
+        case ByteCode::BRF:
+        case ByteCode::STORE:
+        case ByteCode::GSTORE:
+        case ByteCode::PRINT:
+        case ByteCode::POP:
+        case ByteCode::RET:
+        case ByteCode::EXIT: return {1, 0};
+        case ByteCode::ICONST:
+        case ByteCode::LOAD:
+        case ByteCode::GLOAD:
+        case ByteCode::LOAD_ICONST_IADD:
+        case ByteCode::LOAD_ICONST_ISUB:
+        case ByteCode::LOAD_ICONST_ILT:
+        case ByteCode::LOAD_LOAD_IADD: return {0, 1};
+        case ByteCode::CALL:
+        case ByteCode::SPAWN: return {0, 3};
+        case ByteCode::JOIN: return {1, 1};
+        case ByteCode::ILT_BRF: return {2, 0};
+        default: return {0, 0};
+    }
+}
+
+std::atomic<bool> const neverCancelled {false};
+}  // namespace
+
 VirtualMachine::VirtualMachine(std::vector<int64_t> code, uint64_t const main, uint64_t const dataSize,
-                               uint64_t const stackSize, bool shouldTrace, std::ostream& out)
-    : m_instructionPointer_(main)
-    , m_code_(std::move(code))
-    , m_data_(dataSize)
-    , m_stack_(stackSize)
-    , m_shouldTrace_(shouldTrace)
-    , out_(out)
+                               uint64_t const stackSize, bool shouldTrace, std::ostream& out, Engine engine)
+    : m_stack_(stackSize), m_shouldTrace_(shouldTrace), out_(out), m_streamSink_(out), m_requestedEngine_(engine)
+{
+    load(std::move(code), main, dataSize);
+}
+
+VirtualMachine::VirtualMachine(VmSnapshot const& snapshot, bool shouldTrace, std::ostream& out, Engine engine)
+    : VirtualMachine({}, 0, 0, snapshot.registers().stackSize, shouldTrace, out, engine)
+{
+    restore(snapshot);
+}
+
+void VirtualMachine::load(std::vector<int64_t> code, uint64_t const main, uint64_t const dataSize)
+{
+    m_code_         = std::move(code);
+    m_callHeadroom_ = VmStack::CallHeadroom;
+    m_data_.assign(dataSize, 0);
+    reset(static_cast<int64_t>(main));
+
+    // Running off the end of the code returns -1, same as HALT.
+    m_code_.push_back(ByteCode::HALT);
+    prepare(nullptr);
+}
+
+/**
+ * @brief Builds the forms of m_code_ the engine executes, entered at the
+ * instruction pointer. Takes over those of prepared, which has to belong to
+ * the same code & requested engine, instead of building them again.
+ */
+void VirtualMachine::prepare(PreparedCode const* prepared)
+{
+    m_engine_          = m_requestedEngine_;
+    m_decoded_         = {};
+    m_registerProgram_ = {};
+    m_native_          = {};
+    m_compactProgram_  = {};
+    m_compactLayout_   = {};
+    m_hotLoops_.clear();
+    m_recorder_.reset();
+    m_resolvedTable_ = nullptr;
+
+    if (prepared != nullptr)
+    {
+        m_nativesUsed_     = prepared->nativesUsed;
+        m_engine_          = prepared->engine;
+        m_decoded_         = prepared->decoded;
+        m_registerProgram_ = prepared->registerProgram;
+        m_native_          = prepared->native;
+        m_compactProgram_  = prepared->compactProgram;
+        m_compactLayout_   = prepared->compactLayout;
+    }
+    else
+    {
+        m_nativesUsed_ = nativesUsed(m_code_);
+    }
+
+    auto const needsDecoded
+        = m_engine_ == Engine::Threaded || m_engine_ == Engine::TracingJit || m_metered_ || m_memoized_;
+    if (needsDecoded && m_decoded_.instructions.empty()) { m_decoded_ = decode(m_code_, m_instructionPointer_); }
+    if (m_memoized_)
+    {
+        m_pureArguments_ = analyzePurity(m_decoded_);
+        m_memoTable_.clear();
+    }
+    if (m_engine_ == Engine::Register && m_registerProgram_.instructions.empty())
+    {
+        auto program = translateToRegisterCode(m_code_, m_instructionPointer_);
+        if (program.has_value()) { m_registerProgram_ = std::move(program.value()); }
+        else
+        {
+            m_engine_ = Engine::Switch;
+        }
+    }
+    if (m_engine_ == Engine::Jit && m_native_ == nullptr)
+    {
+        auto native = compileToNative(m_code_);
+        if (native.has_value()) { m_native_ = std::make_shared<NativeCode const>(std::move(native.value())); }
+        else
+        {
+            m_engine_ = Engine::Switch;
+        }
+    }
+    if (m_engine_ == Engine::Compact && m_compactLayout_.addresses.empty())
+    {
+        auto program = toCompactCode(m_code_, m_instructionPointer_);
+        if (program.has_value())
+        {
+            m_compactLayout_  = layoutOf(program.value()).value();
+            m_compactProgram_ = std::move(program.value());
+        }
+        else
+        {
+            m_engine_ = Engine::Switch;
+        }
+    }
+}
+
+auto VirtualMachine::snapshot() const -> VmSnapshot
+{
+    auto const registers = VmSnapshot::Registers {
+        m_stackPointer_,
+        m_framePointer_,
+        m_instructionPointer_,
+        m_stack_.size(),
+        m_callHeadroom_,
+    };
+
+    auto prepared         = std::make_shared<PreparedCode>();
+    prepared->requested   = m_requestedEngine_;
+    prepared->engine      = m_engine_;
+    prepared->nativesUsed = m_nativesUsed_;
+    prepared->native      = m_native_;
+    if (!m_decoded_.instructions.empty())
+    {
+        prepared->decoded            = m_decoded_;
+        prepared->decoded.entryPoint = m_decoded_.indexAt(m_instructionPointer_);
+    }
+    prepared->compactProgram = m_compactProgram_;
+    prepared->compactLayout  = m_compactLayout_;
+
+    // register code only enters at jump targets & functions, forks continue at
+    // the instruction pointer
+    if (m_engine_ == Engine::Register)
+    {
+        auto program = translateToRegisterCode(m_code_, m_instructionPointer_);
+        if (program.has_value()) { prepared->registerProgram = std::move(program.value()); }
+        else
+        {
+            prepared->engine = Engine::Switch;
+        }
+    }
+
+    // without the HALT appended by load()
+    auto const liveStack = std::max(m_stackPointer_ + 1, int64_t {0});
+    return VmSnapshot {
+        std::vector<int64_t>(m_code_.begin(), std::prev(m_code_.end())),
+        m_data_,
+        std::vector<int64_t>(m_stack_.data(), std::next(m_stack_.data(), liveStack)),
+        registers,
+        std::move(prepared),
+    };
+}
+
+void VirtualMachine::restore(VmSnapshot const& snapshot)
+{
+    auto const code       = snapshot.code();
+    auto const& registers = snapshot.registers();
+
+    auto const sameCode = m_code_.size() == code.size() + 1 && std::equal(code.begin(), code.end(), m_code_.begin());
+    reset(registers.instructionPointer);
+    if (!sameCode)
+    {
+        m_code_.assign(code.begin(), code.end());
+        m_code_.push_back(ByteCode::HALT);
+
+        auto const& prepared = snapshot.prepared();
+        prepare(prepared != nullptr && prepared->requested == m_requestedEngine_ ? prepared.get() : nullptr);
+    }
+    setCallHeadroom(registers.callHeadroom);
+
+    if (!m_stack_.grow(registers.stackSize)) { m_stack_ = VmStack {registers.stackSize}; }
+    m_data_.assign(snapshot.data().begin(), snapshot.data().end());
+    std::copy(snapshot.stack().begin(), snapshot.stack().end(), m_stack_.data());
+    m_stackPointer_ = registers.stackPointer;
+    m_framePointer_ = registers.framePointer;
+}
+
+auto VirtualMachine::callStack() const -> std::vector<int64_t>
+{
+    // the entry point runs with fp 0, every call stores numArgs, fp & the return
+    // address below its frame pointer, so frames of calls start at 2
+    auto addresses = std::vector<int64_t> {m_instructionPointer_};
+    forEachReturnAddress(m_stack_.data(), m_framePointer_, m_stackPointer_,
+                         [&addresses](int64_t const address) { addresses.push_back(address); });
+    return addresses;
+}
+
+void VirtualMachine::swapContext(TaskContext& context) noexcept
 {
+    std::swap(m_stack_, context.stack);
+    std::swap(m_stackPointer_, context.stackPointer);
+    std::swap(m_framePointer_, context.framePointer);
+    std::swap(m_instructionPointer_, context.instructionPointer);
 }
 
+void VirtualMachine::setCallHeadroom(uint64_t const slots) noexcept
+{
+    m_callHeadroom_ = std::max(VmStack::CallHeadroom, static_cast<std::size_t>(slots));
+}
+
+void VirtualMachine::setMaxStackSize(uint64_t const slots)
+{
+    auto stack           = VmStack {std::min(m_stack_.size(), slots), slots};
+    auto const liveStack = std::clamp(m_stackPointer_ + 1, int64_t {0}, static_cast<int64_t>(stack.size()));
+    std::copy_n(m_stack_.data(), liveStack, stack.data());
+    m_stack_ = std::move(stack);
+}
+
+void VirtualMachine::enableMetering(int64_t const gas, std::atomic<bool> const* cancelled)
+{
+    if (m_decoded_.instructions.empty()) { m_decoded_ = decode(m_code_, m_instructionPointer_); }
+    m_metered_    = true;
+    m_gasLimit_   = gas;
+    m_gas_        = gas;
+    m_gasCharged_ = false;
+    m_cancelled_  = cancelled != nullptr ? cancelled : &neverCancelled;
+}
+
+void VirtualMachine::disableMetering()
+{
+    m_metered_   = false;
+    m_cancelled_ = nullptr;
+}
+
+void VirtualMachine::enableMemoization(std::size_t const capacity)
+{
+    if (m_decoded_.instructions.empty()) { m_decoded_ = decode(m_code_, m_instructionPointer_); }
+    m_memoized_      = true;
+    m_pureArguments_ = analyzePurity(m_decoded_);
+    m_memoTable_     = MemoTable {capacity};
+    m_memoStats_     = {};
+}
+
+void VirtualMachine::disableMemoization() { m_memoized_ = false; }
+
 auto VirtualMachine::cpu() -> int64_t
 {
-    while (static_cast<size_t>(m_instructionPointer_) < m_code_.size())
+    auto const exitCode = execute();
+    m_output_->flush();
+    return exitCode;
+}
+
+auto VirtualMachine::execute() -> int64_t
+{
+    m_runStatus_ = RunStatus::Finished;
+    if (m_nativesUsed_ > m_natives_.size())
+    {
+        m_runStatus_ = RunStatus::MissingNatives;
+        return -1;
+    }
+    if (!reserveEntry()) { return -1; }
+    if (m_tasks_ != nullptr) { return executeSwitch<ScheduledPolicy>(); }
+    if (!m_shouldTrace_ && !m_shouldCheck_ && !m_shouldCount_)
+    {
+        // Threaded continues from any instruction, not only where it stopped
+        if (m_metered_ && m_memoized_) { return executeThreaded<true, true>(); }
+        if (m_metered_) { return executeThreaded<true, false>(); }
+        if (m_memoized_) { return executeThreaded<false, true>(); }
+    }
+
+    if (!m_shouldTrace_ && !m_shouldCheck_ && !m_shouldCount_ && !m_interrupted_)
+    {
+        if (m_engine_ == Engine::Threaded) { return executeThreaded<false, false>(); }
+        if (m_engine_ == Engine::Register) { return executeRegister(); }
+        if (m_engine_ == Engine::Jit) { return executeJit(); }
+        if (m_engine_ == Engine::TracingJit) { return executeTracingJit(); }
+        if (m_engine_ == Engine::Compact) { return executeCompact(); }
+    }
+
+    return (this->*switchExecutor(false))();
+}
+
+auto VirtualMachine::run(int64_t const budget) -> RunResult
+{
+    if (m_exitCode_.has_value()) { return RunResult {RunStatus::Finished, m_exitCode_.value()}; }
+
+    if (m_nativesUsed_ > m_natives_.size())
+    {
+        m_runStatus_ = RunStatus::MissingNatives;
+        return RunResult {m_runStatus_, -1};
+    }
+
+    m_budget_    = budget;
+    m_runStatus_ = RunStatus::Finished;
+    if (!reserveEntry()) { return RunResult {m_runStatus_, -1}; }
+
+    auto const exitCode     = (this->*switchExecutor(true))();
+    auto const instructions = budget - m_budget_;
+    m_output_->flush();
+    if (m_runStatus_ != RunStatus::Finished)
+    {
+        m_interrupted_ = true;
+        return RunResult {m_runStatus_, 0, instructions};
+    }
+
+    m_exitCode_ = exitCode;
+    return RunResult {RunStatus::Finished, exitCode, instructions};
+}
+
+auto VirtualMachine::switchExecutor(bool const budgeted) const noexcept -> Executor
+{
+    static constexpr auto executors = makeSwitchExecutors(std::make_index_sequence<NumPolicies> {});
+    return executors[policyIndex(m_shouldTrace_, m_shouldCheck_, m_shouldCount_, budgeted, m_metered_)];
+}
+
+/**
+ * @brief Makes room for a call at stackPointer, the slow path of the check at
+ * every CALL. Sets the run status if the maximum stack size is reached.
+ */
+auto VirtualMachine::reserveFrame(int64_t const stackPointer) -> bool
+{
+    if (m_stack_.grow(static_cast<std::size_t>(stackPointer + 1) + m_callHeadroom_)) { return true; }
+    m_runStatus_ = RunStatus::StackOverflow;
+    return false;
+}
+
+/**
+ * @brief The frame the machine starts or continues in gets the same headroom
+ * as a CALL, no engine checks the stack before the next one.
+ */
+auto VirtualMachine::reserveEntry() -> bool
+{
+    return m_stackPointer_ <= m_stack_.callLimit(m_callHeadroom_) || reserveFrame(m_stackPointer_);
+}
+
+/**
+ * @brief Pays for the basic block at the instruction pointer. Returns false
+ * and leaves the state untouched if the program has to stop instead.
+ */
+auto VirtualMachine::chargeGas() -> bool
+{
+    if (m_cancelled_->load(std::memory_order_relaxed))
+    {
+        m_runStatus_   = RunStatus::Cancelled;
+        m_interrupted_ = true;
+        return false;
+    }
+
+    auto const index = static_cast<std::size_t>(m_decoded_.indexAt(m_instructionPointer_));
+    auto const cost  = m_decoded_.instructions[index].cost;
+    if (cost > m_gas_)
+    {
+        m_runStatus_   = RunStatus::OutOfGas;
+        m_interrupted_ = true;
+        return false;
+    }
+
+    m_gas_ -= cost;
+    m_gasCharged_ = true;
+    return true;
+}
+
+template <typename Policy>
+auto VirtualMachine::executeSwitch() -> int64_t
+{
+    if constexpr (Policy::metered)
     {
+        if (!m_gasCharged_ && !chargeGas()) { return -1; }
+    }
 
-        // checks
-        TCC_ASSERT((m_code_.size() > static_cast<std::size_t>(m_instructionPointer_)) && (m_instructionPointer_ >= 0),
-                   "instruction pointer out of range at: {}", m_instructionPointer_);
+    // shared with the other tasks of the host
+    [[maybe_unused]] auto const globals = Policy::scheduled ? m_tasks_->globals() : std::span<int64_t> {};
+
+    while (true)
+    {
+        // every instruction boundary is a safepoint, the state is complete here
+        if constexpr (Policy::budgeted)
+        {
+            if (m_suspendRequested_.load(std::memory_order_relaxed))
+            {
+                m_suspendRequested_.store(false, std::memory_order_relaxed);
+                m_runStatus_ = RunStatus::Suspended;
+                return 0;
+            }
+            if (m_budget_ <= 0)
+            {
+                m_runStatus_ = RunStatus::OutOfBudget;
+                return 0;
+            }
+            --m_budget_;
+        }
+
+        if constexpr (Policy::boundsChecking)
+        {
+            if (m_instructionPointer_ < 0 || static_cast<std::size_t>(m_instructionPointer_) >= m_code_.size())
+            {
+                m_output_->flush();
+                out_ << fmt::format("error: instruction pointer out of range at: {}\n", m_instructionPointer_);
+                m_runStatus_ = RunStatus::BoundsCheckFailed;
+                return -1;
+            }
+        }
 
         // fetch instructions
-        auto const opcode = m_code_[m_instructionPointer_];
-        if (m_shouldTrace_) { disassemble(opcode); }
+        [[maybe_unused]] auto const address = m_instructionPointer_;
+        auto const opcode                   = m_code_[m_instructionPointer_];
+
+        if constexpr (Policy::boundsChecking)
+        {
+            if (auto const error = checkInstruction(opcode); !error.empty())
+            {
+                m_output_->flush();
+                out_ << fmt::format("error: {} at: {}\n", error, m_instructionPointer_);
+                m_runStatus_ = RunStatus::BoundsCheckFailed;
+                return -1;
+            }
+        }
+
+        if constexpr (Policy::statistics)
+        {
+            m_stats_.instructions++;
+            if (opcode == ByteCode::CALL || opcode == ByteCode::SPAWN || opcode == ByteCode::TAILCALL)
+            {
+                m_stats_.calls++;
+#if defined(TCC_VM_HISTOGRAM)
+                m_histogram_.recordCall(address, m_code_[address + 1]);
+#endif
+            }
+#if defined(TCC_VM_HISTOGRAM)
+            m_histogram_.record(opcode);
+#endif
+        }
+
+        if constexpr (Policy::tracing) { disassemble(opcode); }
 
         m_instructionPointer_++;  // advance instruction pointer
 
@@ -116,9 +550,13 @@ auto VirtualMachine::cpu() -> int64_t
             {
                 auto const addr = m_code_[m_instructionPointer_];
                 m_instructionPointer_++;
-                auto const val = m_data_[addr];
                 m_stackPointer_++;
-                m_stack_[m_stackPointer_] = val;
+                if constexpr (Policy::scheduled)
+                { m_stack_[m_stackPointer_] = std::atomic_ref {globals[addr]}.load(std::memory_order_relaxed); }
+                else
+                {
+                    m_stack_[m_stackPointer_] = m_data_[addr];
+                }
                 break;
             }
 
@@ -135,7 +573,12 @@ auto VirtualMachine::cpu() -> int64_t
                 m_stackPointer_--;
                 auto const addr = m_code_[m_instructionPointer_];
                 m_instructionPointer_++;
-                m_data_[addr] = val;
+                if constexpr (Policy::scheduled)
+                { std::atomic_ref {globals[addr]}.store(val, std::memory_order_relaxed); }
+                else
+                {
+                    m_data_[addr] = val;
+                }
                 break;
             }
 
@@ -143,7 +586,8 @@ auto VirtualMachine::cpu() -> int64_t
             {
                 auto const val = m_stack_[m_stackPointer_];
                 m_stackPointer_--;
-                out_ << fmt::format("{}\n", val);
+                m_output_->print(val);
+                if constexpr (Policy::tracing) { m_output_->flush(); }
                 break;
             }
 
@@ -153,8 +597,44 @@ auto VirtualMachine::cpu() -> int64_t
                 break;
             }
 
+            // without a scheduler a task runs to completion right away, its
+            // result is the handle
             case ByteCode::CALL:
+            case ByteCode::SPAWN:
             {
+                // the arguments move to the stack of the task, the host runs it next
+                if constexpr (Policy::scheduled)
+                {
+                    if (opcode == ByteCode::SPAWN)
+                    {
+                        auto const addr    = m_code_[m_instructionPointer_++];
+                        auto const numArgs = m_code_[m_instructionPointer_++];
+                        auto const first   = m_stackPointer_ - numArgs + 1;
+                        auto const args    = std::span<int64_t const> {m_stack_.data() + first,
+                                                                    static_cast<std::size_t>(numArgs)};
+                        auto const handle  = m_tasks_->spawn(addr, args);
+                        if (!handle.has_value())
+                        {
+                            m_instructionPointer_ = address;
+                            m_runStatus_          = RunStatus::StackOverflow;
+                            return -1;
+                        }
+
+                        m_stackPointer_           = first;
+                        m_stack_[m_stackPointer_] = handle.value();
+                        m_runStatus_              = RunStatus::Yielded;
+                        return 0;
+                    }
+                }
+
+                // stop before the call, the state stays consistent
+                if (m_stackPointer_ > m_stack_.callLimit(m_callHeadroom_) && !reserveFrame(m_stackPointer_))
+                {
+                    --m_instructionPointer_;
+                    m_interrupted_ = true;
+                    return -1;
+                }
+
                 // expects all args on stack
                 auto const addr    = m_code_[m_instructionPointer_++];  // addr of function
                 auto const numArgs = m_code_[m_instructionPointer_++];  // how many args got
@@ -176,24 +656,252 @@ auto VirtualMachine::cpu() -> int64_t
                 auto const numArgs    = m_stack_[m_stackPointer_--];  // how many args to throw away
                 m_stackPointer_ -= numArgs;                           // pop args
                 m_stack_[++m_stackPointer_] = returnVal;              // leave result on stack
+
+                if constexpr (Policy::scheduled)
+                {
+                    if (m_instructionPointer_ == TaskHost::TaskReturn)
+                    {
+                        m_runStatus_ = RunStatus::Yielded;
+                        return 0;
+                    }
+                }
+                break;
+            }
+
+            // the new arguments & the saved numArgs, fp and return address of
+            // the current frame move down to where the current arguments start
+            case ByteCode::TAILCALL:
+            {
+                auto const addr    = m_code_[m_instructionPointer_++];
+                auto const numArgs = m_code_[m_instructionPointer_++];
+                auto const retAddr = m_stack_[m_framePointer_];
+                auto const savedFp = m_stack_[m_framePointer_ - 1];
+                auto const first   = m_framePointer_ - 2 - m_stack_[m_framePointer_ - 2];  // first current arg
+                for (auto i = int64_t {0}; i < numArgs; ++i)
+                { m_stack_[first + i] = m_stack_[m_stackPointer_ - numArgs + 1 + i]; }
+                m_stackPointer_             = first + numArgs - 1;
+                m_stack_[++m_stackPointer_] = numArgs;
+                m_stack_[++m_stackPointer_] = savedFp;
+                m_stack_[++m_stackPointer_] = retAddr;
+                m_framePointer_             = m_stackPointer_;
+                m_instructionPointer_       = addr;
+                break;
+            }
+
+            // parked on the JOIN itself, which runs again once the task completed
+            case ByteCode::JOIN:
+            {
+                if constexpr (Policy::scheduled)
+                {
+                    auto const result = m_tasks_->join(m_stack_[m_stackPointer_]);
+                    if (!result.has_value())
+                    {
+                        m_instructionPointer_ = address;
+                        m_runStatus_          = RunStatus::Yielded;
+                        return 0;
+                    }
+                    m_stack_[m_stackPointer_] = result.value();
+                }
+                break;
+            }
+
+            // the result replaces the arguments
+            case ByteCode::CALLNATIVE:
+            {
+                auto const index   = m_code_[m_instructionPointer_++];
+                auto const numArgs = m_code_[m_instructionPointer_++];
+                auto const first   = m_stackPointer_ - numArgs + 1;
+                m_stack_[first]    = m_natives_[static_cast<std::size_t>(index)](&m_stack_[first]);
+                m_stackPointer_    = first;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_IADD:
+            {
+                auto const offset           = m_code_[m_instructionPointer_++];
+                auto const val              = m_code_[m_instructionPointer_++];
+                m_stack_[++m_stackPointer_] = m_stack_[m_framePointer_ + offset] + val;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_ISUB:
+            {
+                auto const offset           = m_code_[m_instructionPointer_++];
+                auto const val              = m_code_[m_instructionPointer_++];
+                m_stack_[++m_stackPointer_] = m_stack_[m_framePointer_ + offset] - val;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_ILT:
+            {
+                auto const offset           = m_code_[m_instructionPointer_++];
+                auto const val              = m_code_[m_instructionPointer_++];
+                m_stack_[++m_stackPointer_] = m_stack_[m_framePointer_ + offset] < val ? 1 : 0;
+                break;
+            }
+
+            case ByteCode::LOAD_LOAD_IADD:
+            {
+                auto const first            = m_code_[m_instructionPointer_++];
+                auto const second           = m_code_[m_instructionPointer_++];
+                auto const a                = m_stack_[m_framePointer_ + first];
+                auto const b                = m_stack_[m_framePointer_ + second];
+                m_stack_[++m_stackPointer_] = a + b;
+                break;
+            }
+
+            case ByteCode::ILT_BRF:
+            {
+                auto const addr = m_code_[m_instructionPointer_++];
+                auto const b    = m_stack_[m_stackPointer_--];  // 2nd operand
+                auto const a    = m_stack_[m_stackPointer_--];  // 1st operand
+                if (!(a < b)) { m_instructionPointer_ = addr; }
                 break;
             }
 
             case ByteCode::EXIT:
             {
                 auto const exitCode = m_stack_[m_stackPointer_];
-                if (m_shouldTrace_) { out_ << fmt::format("---\nexit code: {}\n", exitCode); }
+                if constexpr (Policy::tracing) { out_ << fmt::format("---\nexit code: {}\n", exitCode); }
                 return exitCode;
             }
             case ByteCode::HALT: return -1;
-            default: TCC_ASSERT(false, "unknown instruction"); std::exit(EXIT_FAILURE);
+            default:
+            {
+                // stops at the instruction
+                --m_instructionPointer_;
+                m_runStatus_ = RunStatus::InvalidInstruction;
+                return -1;
+            }
+        }
+
+        if constexpr (Policy::statistics)
+        {
+            m_stats_.maxStackDepth = std::max(m_stats_.maxStackDepth, m_stackPointer_ + 1);
+#if defined(TCC_VM_HISTOGRAM)
+            if (opcode == ByteCode::BRT || opcode == ByteCode::BRF || opcode == ByteCode::ILT_BRF)
+            {
+                auto const fallThrough = address + 1 + Instructions[static_cast<std::size_t>(opcode)].numberOfOperands;
+                m_histogram_.recordBranch(address, opcode, m_instructionPointer_ != fallThrough);
+            }
+#endif
         }
+
+        // control entered the next block, including conditional fall through
+        if constexpr (Policy::metered)
+        {
+            if (endsBasicBlock(opcode))
+            {
+                m_gasCharged_ = false;
+                if (!chargeGas()) { return -1; }
+            }
+        }
+
+        // lets a running task notice that another one ended the program
+        if constexpr (Policy::scheduled)
+        {
+            if (m_instructionPointer_ <= address && m_tasks_->finished().load(std::memory_order_relaxed))
+            {
+                m_runStatus_ = RunStatus::Cancelled;
+                return -1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Validates the instruction at the instruction pointer against the
+ * current VM state & commits the stack slots it writes. Returns an empty
+ * string if it can be executed safely, otherwise a description of the problem.
+ */
+auto VirtualMachine::checkInstruction(int64_t const opcode) -> std::string_view
+{
+    if (opcode < 0 || opcode >= ByteCode::NUM_OPCODES) { return "unknown instruction"; }
+
+    auto const codeSize = static_cast<int64_t>(m_code_.size());
+    auto const numOps   = Instructions[static_cast<std::size_t>(opcode)].numberOfOperands;
+    if (m_instructionPointer_ + numOps >= codeSize) { return "missing operand"; }
+
+    auto const operand = [&](int64_t const index) { return m_code_[m_instructionPointer_ + 1 + index]; };
+    auto const isLocal = [&](int64_t const offset) {
+        auto const slot = m_framePointer_ + offset;
+        return slot >= 0 && slot <= m_stackPointer_;
+    };
+
+    if (auto const target = targetOperandIndex(opcode); target >= 0)
+    {
+        auto const address = operand(target);
+        if (address < 0 || address >= codeSize) { return "branch target out of range"; }
+    }
+
+    switch (opcode)
+    {
+        case ByteCode::GLOAD:
+        case ByteCode::GSTORE:
+        {
+            if (operand(0) < 0 || operand(0) >= static_cast<int64_t>(m_data_.size()))
+            { return "global address out of range"; }
+            break;
+        }
+        case ByteCode::LOAD:
+        case ByteCode::STORE:
+        case ByteCode::LOAD_ICONST_IADD:
+        case ByteCode::LOAD_ICONST_ISUB:
+        case ByteCode::LOAD_ICONST_ILT:
+        {
+            if (!isLocal(operand(0))) { return "local out of range"; }
+            break;
+        }
+        case ByteCode::LOAD_LOAD_IADD:
+        {
+            if (!isLocal(operand(0)) || !isLocal(operand(1))) { return "local out of range"; }
+            break;
+        }
+        case ByteCode::RET:
+        case ByteCode::TAILCALL:
+        {
+            // numArgs, fp & return address are stored at and below the frame pointer
+            if (m_framePointer_ < 2 || m_framePointer_ > m_stackPointer_) { return "frame out of range"; }
+            auto const numArgs = m_stack_[static_cast<std::size_t>(m_framePointer_ - 2)];
+            if (numArgs < 0 || numArgs > m_framePointer_ - 2) { return "frame out of range"; }
+
+            // the new arguments are above the frame pointer
+            if (opcode == ByteCode::TAILCALL && (operand(1) < 0 || operand(1) > m_stackPointer_ - m_framePointer_))
+            { return "stack out of range"; }
+            break;
+        }
+        case ByteCode::CALLNATIVE:
+        {
+            if (operand(0) < 0 || operand(0) >= static_cast<int64_t>(m_natives_.size()))
+            { return "native function out of range"; }
+            auto const numArgs = operand(1);
+            auto const depth   = m_stackPointer_ + 1;
+            if (numArgs < 0 || numArgs > depth || !m_stack_.grow(static_cast<std::size_t>(depth - numArgs + 1)))
+            { return "stack out of range"; }
+            return "";
+        }
+        default: break;
     }
 
-    return -1;
+    // commits the slots the instruction writes, up to the reservation
+    auto const [pops, pushes] = stackEffect(opcode);
+    auto const depth          = m_stackPointer_ + 1;
+    if (depth < pops || !m_stack_.grow(static_cast<std::size_t>(depth - pops + pushes)))
+    { return "stack out of range"; }
+    return "";
 }
 
+void VirtualMachine::setOutput(OutputSink* sink)
+{
+    m_output_->flush();
+    m_output_ = sink != nullptr ? sink : &m_streamSink_;
+}
+
+void VirtualMachine::setNatives(std::vector<NativeFunction> natives) { m_natives_ = std::move(natives); }
+
 void VirtualMachine::enableTracing(bool const shouldTrace) { m_shouldTrace_ = shouldTrace; }
+void VirtualMachine::enableBoundsChecking(bool const shouldCheck) { m_shouldCheck_ = shouldCheck; }
+void VirtualMachine::enableStatistics(bool const shouldCount) { m_shouldCount_ = shouldCount; }
 
 void VirtualMachine::disassemble(int64_t const opcode)
 {
@@ -219,7 +927,7 @@ void VirtualMachine::printStack()
 
     for (auto i = 0; i <= m_stackPointer_; i++)
     {
-        auto const var = m_stack_.at(i);
+        auto const var = m_stack_[i];
         out_ << fmt::format("{} ", var);
     }
     out_ << fmt::format("]");
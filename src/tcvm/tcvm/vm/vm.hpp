@@ -6,51 +6,404 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
 #include <sstream>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include "tcsl/tcsl.hpp"
+#include "tcvm/vm/decoder.hpp"
+#include "tcvm/vm/histogram.hpp"
+#include "tcvm/vm/jit.hpp"
+#include "tcvm/vm/memoization.hpp"
+#include "tcvm/vm/natives.hpp"
+#include "tcvm/vm/output_sink.hpp"
+#include "tcvm/vm/register_translator.hpp"
+#include "tcvm/vm/snapshot.hpp"
+#include "tcvm/vm/task_host.hpp"
+#include "tcvm/vm/trace.hpp"
+#include "tcvm/vm/vm_policy.hpp"
+#include "tcvm/vm/vm_stack.hpp"
 
 namespace tcc
 {
 class VirtualMachine
 {
 public:
-    explicit VirtualMachine(std::vector<int64_t> code,  //
-                            uint64_t main,              //
-                            uint64_t dataSize,          //
-                            uint64_t stackSize,         //
-                            bool shouldTrace  = true,   //
-                            std::ostream& out = std::cout);
+    /**
+     * @brief Instruction dispatch strategy used by cpu().
+     */
+    enum class Engine
+    {
+        Switch,      // central switch, supports tracing, bounds checking & statistics
+        Threaded,    // computed goto over the pre-decoded stream
+        Register,    // translated to register code, falls back to Switch if translation fails
+        Jit,         // native code on Linux x86-64, falls back to Switch on other platforms
+        TracingJit,  // pre-decoded stream, hot loops run as native traces
+        Compact,     // byte encoded program, see CompactProgram, falls back to Switch if encoding fails
+    };
+    // All engines fall back to Switch while tracing, bounds checking or
+    // statistics are enabled. With metering or memoization, Register, Jit,
+    // TracingJit & Compact run on Threaded.
+
+    /**
+     * @brief Why run() or cpu() returned.
+     */
+    enum class RunStatus
+    {
+        Finished,            // EXIT or HALT, the exit code is valid
+        OutOfBudget,         // executed the whole instruction budget
+        Suspended,           // suspend() was called
+        OutOfGas,            // the next basic block costs more than the remaining gas
+        Cancelled,           // the cancellation flag passed to enableMetering() was set or a task ended the program
+        StackOverflow,       // a CALL did not fit into the maximum stack size
+        InvalidInstruction,  // the engine can not execute the opcode at the instruction pointer
+        MissingNatives,      // CALLNATIVE indexes past the table passed to setNatives(), nothing ran
+        BoundsCheckFailed,   // enableBoundsChecking() stopped before an unsafe instruction & printed why
+        Yielded,             // a task stopped after SPAWN, before JOIN on a running task or after its last RET
+    };
+
+    struct RunResult
+    {
+        RunStatus status {RunStatus::Finished};
+        int64_t exitCode {0};
+        int64_t instructions {0};  // executed by this run()
+    };
+
+    explicit VirtualMachine(std::vector<int64_t> code,      //
+                            uint64_t main,                  //
+                            uint64_t dataSize,              //
+                            uint64_t stackSize,             //
+                            bool shouldTrace  = true,       //
+                            std::ostream& out = std::cout,  //
+                            Engine engine     = Engine::Switch);
+
+    /**
+     * @brief Forks a machine from a snapshot, see restore().
+     */
+    explicit VirtualMachine(VmSnapshot const& snapshot,     //
+                            bool shouldTrace  = true,       //
+                            std::ostream& out = std::cout,  //
+                            Engine engine     = Engine::Switch);
 
+    /**
+     * @brief Replaces the program, keeps the stack allocation & all options.
+     * Globals are resized to dataSize and cleared.
+     */
+    void load(std::vector<int64_t> code, uint64_t main, uint64_t dataSize);
+
+    /**
+     * @brief Runs the program until it finishes or is stopped by metering, in
+     * which case -1 is returned and status() tells why.
+     */
     auto cpu() -> int64_t;
 
+    /**
+     * @brief Captures the machine between two instructions, e.g. after a HALT
+     * or while run() is suspended. The next cpu() of a fork continues there.
+     */
+    [[nodiscard]] auto snapshot() const -> VmSnapshot;
+
+    /**
+     * @brief Continues from a snapshot, keeps all options. The stack grows to
+     * the size of the captured machine. Reloads the code only if it differs
+     * from the current one, so restoring into the same machine again keeps the
+     * decoded, translated or compiled program. New code is not verified, the
+     * snapshot carries its call headroom & the code prepared for the engine of
+     * the captured machine, see PreparedCode.
+     */
+    void restore(VmSnapshot const& snapshot);
+
+    /**
+     * @brief Executes at most budget instructions on the switch interpreter.
+     * The next run() or cpu() continues exactly where it stopped, a finished
+     * program keeps returning its exit code until reset().
+     */
+    auto run(int64_t budget) -> RunResult;
+
+    /**
+     * @brief Stops the current or next run() before its next instruction. Safe
+     * to call from another thread or from the host while the program runs,
+     * e.g. from an output sink.
+     */
+    void suspend() noexcept { m_suspendRequested_.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Limits execution to gas instructions. The cost of each basic block
+     * is computed at load time & charged when control enters the block, a
+     * block that does not fit stops the program before its first instruction.
+     * The cancellation flag is read every few thousand instructions, it may be
+     * shared by any number of machines. reset() refills the gas.
+     */
+    void enableMetering(int64_t gas, std::atomic<bool> const* cancelled = nullptr);
+    void disableMetering();
+
+    /**
+     * @brief Caches the results of calls to pure functions, see analyzePurity(),
+     * in a table of capacity slots. The table is kept until the code changes,
+     * so later runs of the same program start with the results of earlier
+     * ones. Tracing, bounds checking & statistics run every call.
+     */
+    void enableMemoization(std::size_t capacity = DefaultMemoCapacity);
+    void disableMemoization();
+
+    /**
+     * @brief Counters collected since the last reset() while memoization is enabled.
+     */
+    [[nodiscard]] auto memoStats() const noexcept -> MemoStats const& { return m_memoStats_; }
+
+    static constexpr auto DefaultMemoCapacity = std::size_t {4096};
+
+    /**
+     * @brief Gas left while metering is enabled.
+     */
+    [[nodiscard]] auto gas() const noexcept -> int64_t { return m_gas_; }
+
+    /**
+     * @brief How the last cpu() or run() ended.
+     */
+    [[nodiscard]] auto status() const noexcept -> RunStatus { return m_runStatus_; }
+
+    /**
+     * @brief The stack starts with the stackSize passed to the constructor and
+     * grows at calls up to slots, by default VmStack::DefaultReserve. A call
+     * that does not fit stops the program before the CALL with
+     * RunStatus::StackOverflow. Keeps the live part of the stack.
+     */
+    void setMaxStackSize(uint64_t slots);
+    [[nodiscard]] auto maxStackSize() const noexcept -> uint64_t { return m_stack_.reserved(); }
+
+    /**
+     * @brief Slots every CALL commits above the stack pointer, at least
+     * VmStack::CallHeadroom. Unchecked programs with larger frames need the
+     * VerifierResult::callHeadroom of their code, load() resets it.
+     */
+    void setCallHeadroom(uint64_t slots) noexcept;
+
+    /**
+     * @brief PRINT writes to sink instead of the stream passed to the
+     * constructor, nullptr switches back to the stream. The sink is flushed
+     * whenever cpu() or run() returns & must outlive the machine or the next
+     * setOutput(). Traces & errors are still written to the stream.
+     */
+    void setOutput(OutputSink* sink);
+
+    /**
+     * @brief Host functions CALLNATIVE indexes into, see resolveNatives().
+     * Kept by load(). A program with a CALLNATIVE past the end of the table
+     * does not start, cpu() & run() return -1 with RunStatus::MissingNatives.
+     */
+    void setNatives(std::vector<NativeFunction> natives);
+
+    /**
+     * @brief Runs the program as one of the green threads of host, nullptr
+     * runs SPAWN as a call again. cpu() then always runs the switch
+     * interpreter without tracing, checks or statistics & returns with
+     * RunStatus::Yielded whenever the host has to switch tasks, see
+     * ScheduledPolicy. The host must outlive the machine or the next call.
+     */
+    void setTaskHost(TaskHost* host) noexcept { m_tasks_ = host; }
+
+    /**
+     * @brief Exchanges stack & registers with context, so one machine can run
+     * many tasks in turn. Keeps the program & all options.
+     */
+    void swapContext(TaskContext& context) noexcept;
+
     void enableTracing(bool shouldTrace);
+    void enableBoundsChecking(bool shouldCheck);
+    void enableStatistics(bool shouldCount);
+
+    /**
+     * @brief Counters collected since the last reset() while statistics are enabled.
+     */
+    [[nodiscard]] auto stats() const noexcept -> ExecutionStats const& { return m_stats_; }
+
+#if defined(TCC_VM_HISTOGRAM)
+    /**
+     * @brief Opcode, pair, call site & branch counts collected since the last
+     * reset() while statistics are enabled.
+     */
+    [[nodiscard]] auto histogram() const noexcept -> OpcodeHistogram const& { return m_histogram_; }
+#endif
+
+    /**
+     * @brief The instruction pointer followed by the return address of every
+     * active call, innermost first, read from the frames CALL pushes. Only
+     * meaningful while the machine is stopped, e.g. after run() returned.
+     */
+    [[nodiscard]] auto callStack() const -> std::vector<int64_t>;
+
+    [[nodiscard]] auto engine() const noexcept -> Engine { return m_engine_; }
+    [[nodiscard]] auto globals() noexcept -> std::span<int64_t> { return m_data_; }
+
+    /**
+     * @brief Number of loop traces compiled by the TracingJit engine.
+     */
+    [[nodiscard]] auto compiledTraces() const noexcept -> std::size_t;
 
     void reset(int64_t const entryPoint)
     {
         m_stackPointer_       = -1;
         m_instructionPointer_ = entryPoint;
         m_framePointer_       = 0;
+        m_stats_              = {};
+#if defined(TCC_VM_HISTOGRAM)
+        m_histogram_.clear();
+#endif
+        m_exitCode_.reset();
+        m_interrupted_ = false;
+        m_suspendRequested_.store(false, std::memory_order_relaxed);
+        m_gas_        = m_gasLimit_;
+        m_gasCharged_ = false;
+        m_memoStats_  = {};
     }
 
 private:
+    using Executor = auto (VirtualMachine::*)() -> int64_t;
+
+    auto execute() -> int64_t;
+    void prepare(PreparedCode const* prepared);
+
+    template <typename Policy>
+    auto executeSwitch() -> int64_t;
+
+    template <std::size_t... Indices>
+    static constexpr auto makeSwitchExecutors(std::index_sequence<Indices...> /*unused*/) noexcept
+    {
+        return std::array<Executor, sizeof...(Indices)> {&VirtualMachine::executeSwitch<PolicyAt<Indices>>...};
+    }
+
+    [[nodiscard]] auto switchExecutor(bool budgeted) const noexcept -> Executor;
+    auto chargeGas() -> bool;
+    auto reserveFrame(int64_t stackPointer) -> bool;
+    auto reserveEntry() -> bool;
+
+    /**
+     * @brief Calls convert with the saved return address of every active
+     * call, innermost first. Frames of calls start at 2, see callStack().
+     */
+    template <typename Convert>
+    static auto forEachReturnAddress(int64_t* const stack, int64_t const fp, int64_t const sp, Convert convert) -> void
+    {
+        for (auto frame = fp; frame >= 2 && frame <= sp;)
+        {
+            convert(stack[frame]);
+            auto const caller = stack[frame - 1];
+            if (caller >= frame) { break; }
+            frame = caller;
+        }
+    }
+
+    [[nodiscard]] auto checkInstruction(int64_t opcode) -> std::string_view;
+    template <bool Metered, bool Memoized>
+    auto executeThreaded() -> int64_t;
+    auto executeRegister() -> int64_t;
+    auto executeJit() -> int64_t;
+    auto executeTracingJit() -> int64_t;
+    auto executeCompact() -> int64_t;
+
+    auto jitContext() -> JitContext;
+    auto finishRecording() -> void;
+
     void disassemble(int64_t opcode);
     void printStack();
     void printGlobalMemory();
 
     int64_t m_stackPointer_ {-1};
-    int64_t m_instructionPointer_;
+    int64_t m_instructionPointer_ {0};
     int64_t m_framePointer_ {0};
 
     std::vector<int64_t> m_code_;
     std::vector<int64_t> m_data_;
-    std::vector<int64_t> m_stack_;
+    VmStack m_stack_;
+    std::size_t m_callHeadroom_ {VmStack::CallHeadroom};  // slots above sp at every CALL, see setCallHeadroom()
 
     bool m_shouldTrace_ {true};
+    bool m_shouldCheck_ {false};
+    bool m_shouldCount_ {false};
+    ExecutionStats m_stats_ {};
+#if defined(TCC_VM_HISTOGRAM)
+    OpcodeHistogram m_histogram_ {};
+#endif
+
+    int64_t m_budget_ {0};
+    RunStatus m_runStatus_ {RunStatus::Finished};
+    std::optional<int64_t> m_exitCode_ {};  // set once run() reached EXIT or HALT
+    bool m_interrupted_ {false};            // run() stopped in the middle, only Switch can continue
+    std::atomic<bool> m_suspendRequested_ {false};
+
+    bool m_metered_ {false};
+    int64_t m_gasLimit_ {0};
+    int64_t m_gas_ {0};
+    bool m_gasCharged_ {false};  // the block at the instruction pointer is paid for
+    std::atomic<bool> const* m_cancelled_ {nullptr};
+
+    struct MemoFrame
+    {
+        int64_t framePointer {0};           // of the callee
+        MemoTable::Entry* entry {nullptr};  // receives the result on return
+        MemoTable::Key key {};
+    };
+
+    bool m_memoized_ {false};
+    std::vector<int64_t> m_pureArguments_ {};  // result of analyzePurity() for m_decoded_
+    MemoTable m_memoTable_ {};
+    std::vector<MemoFrame> m_memoFrames_ {};
+    MemoStats m_memoStats_ {};
+
     std::ostream& out_;
+    StreamSink m_streamSink_;  // PRINT to out_ without a sink
+    OutputSink* m_output_ {&m_streamSink_};
+    std::vector<NativeFunction> m_natives_ {};
+    std::size_t m_nativesUsed_ {0};  // nativesUsed() of m_code_
+    TaskHost* m_tasks_ {nullptr};
+    Engine m_requestedEngine_ {Engine::Switch};
+    Engine m_engine_ {Engine::Switch};  // m_requestedEngine_ or the fallback for the loaded program
+
+    DecodedProgram m_decoded_ {};
+    RegisterProgram m_registerProgram_ {};
+    std::shared_ptr<NativeCode const> m_native_ {};  // shared with snapshots & their forks
+    CompactProgram m_compactProgram_ {};
+    CompactLayout m_compactLayout_ {};
+
+    struct HotLoop
+    {
+        int64_t hits {0};
+        int64_t attempts {0};
+        int64_t frameOffset {0};
+        std::optional<NativeTrace> trace {};
+    };
+
+    std::map<int64_t, HotLoop> m_hotLoops_ {};  // decoded index of the loop header
+    TraceRecorder m_recorder_ {};
+    void* const* m_resolvedTable_ {nullptr};  // dispatch table the handlers point into
+};
+
+/**
+ * @brief The code of a snapshot in the forms the engine of the captured
+ * machine executes, entered at the instruction pointer of the snapshot.
+ * Machines that restore the snapshot with the same requested engine copy them
+ * instead of decoding, translating or compiling the code again & share the
+ * native code.
+ */
+struct PreparedCode
+{
+    VirtualMachine::Engine requested {VirtualMachine::Engine::Switch};
+    VirtualMachine::Engine engine {VirtualMachine::Engine::Switch};  // requested or its fallback
+    std::size_t nativesUsed {0};
+    DecodedProgram decoded {};  // empty unless the engine, metering or memoization needed it
+    RegisterProgram registerProgram {};
+    std::shared_ptr<NativeCode const> native {};
+    CompactProgram compactProgram {};
+    CompactLayout compactLayout {};
 };
-}  // namespace tcc
\ No newline at end of file
+}  // namespace tcc
@@ -0,0 +1,371 @@
+/**
+ * @file vm_compact.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm.hpp"
+#include "tcsl/tcsl.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TCC_VM_HAS_COMPUTED_GOTO 1
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_COMPUTED_GOTO)
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/**
+ * @brief Same semantics as executeSwitch(), but decodes the compact encoding
+ * while running. The whole opcode byte selects the handler, so every operand
+ * width has its own copy of the handlers with operands, which read them with
+ * a fixed size & never branch on the width.
+ *
+ * Saved return addresses are byte offsets while running. The frames of a
+ * resumed machine, e.g. forked from a snapshot taken inside a call, are
+ * converted on entry & turned back into ByteCode addresses when leaving, so
+ * Switch can continue after a stack overflow.
+ */
+auto VirtualMachine::executeCompact() -> int64_t
+{
+// one row of 64 handlers per operand width, indexed by the whole opcode byte.
+// Instructions without operands are always Int8, the rest of a row is invalid.
+#define TCC_VM_INVALID_5 &&opInvalid, &&opInvalid, &&opInvalid, &&opInvalid, &&opInvalid
+#define TCC_VM_DISPATCH_ROW(bits)                                                                                      \
+    &&opInvalid, &&opIAdd, &&opISub, &&opIMul, &&opILt, &&opIEq, &&opBr##bits, &&opBrt##bits, &&opBrf##bits,           \
+        &&opIConst##bits, &&opLoad##bits, &&opGLoad##bits, &&opStore##bits, &&opGStore##bits, &&opPrint, &&opPop,      \
+        &&opCall##bits, &&opRet, &&opExit, &&opHalt, &&opCall##bits, &&opJoin, &&opTailCall##bits,                     \
+        &&opCallNative##bits, &&opLoadIConstIAdd##bits, &&opLoadIConstISub##bits, &&opLoadIConstILt##bits,             \
+        &&opLoadLoadIAdd##bits, &&opILtBrf##bits, TCC_VM_INVALID_5, TCC_VM_INVALID_5, TCC_VM_INVALID_5,                \
+        TCC_VM_INVALID_5, TCC_VM_INVALID_5, TCC_VM_INVALID_5, TCC_VM_INVALID_5
+
+    static void* const dispatchTable[] = {
+        TCC_VM_DISPATCH_ROW(8),
+        TCC_VM_DISPATCH_ROW(16),
+        TCC_VM_DISPATCH_ROW(32),
+        TCC_VM_DISPATCH_ROW(64),
+    };
+    static_assert(ByteCode::NUM_OPCODES == 29, "update TCC_VM_DISPATCH_ROW");
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == 256);
+
+#undef TCC_VM_DISPATCH_ROW
+#undef TCC_VM_INVALID_5
+
+    auto const start = m_compactLayout_.offsetAt(m_instructionPointer_);
+    if (!start.has_value()) { return (this->*switchExecutor(false))(); }
+
+    auto const* const code    = m_compactProgram_.code();
+    auto const* const targets = m_compactProgram_.targets();
+    auto const codeSize       = static_cast<uint64_t>(m_compactProgram_.codeSize());
+    auto* const stack         = m_stack_.data();
+    auto* const data          = m_data_.data();
+    auto const* const natives = m_natives_.data();
+    auto stackLimit           = m_stack_.callLimit(m_callHeadroom_);
+
+    auto sp = m_stackPointer_;
+    auto fp = m_framePointer_;
+
+    auto convertible = true;
+    forEachReturnAddress(stack, fp, sp, [&](int64_t const returnAddress) {
+        convertible = convertible && m_compactLayout_.offsetAt(returnAddress).has_value();
+    });
+    if (!convertible) { return (this->*switchExecutor(false))(); }
+    forEachReturnAddress(stack, fp, sp, [&](int64_t& returnAddress) {
+        returnAddress = m_compactLayout_.offsetAt(returnAddress).value();
+    });
+
+    auto const* pc = code + start.value();
+    auto next      = int64_t {0};  // byte offset execution would continue at
+    auto result    = int64_t {-1};
+
+#define TCC_VM_OPERAND(bits, index) CompactCode::operand<int##bits##_t>(pc, index)
+#define TCC_VM_DISPATCH() goto* dispatchTable[*pc]
+#define TCC_VM_NEXT(bits, numOperands)                                                                                 \
+    {                                                                                                                  \
+        pc += 1 + (numOperands) * ((bits) / 8);                                                                        \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+// the target table is 4 byte aligned, the copy is a single load
+#define TCC_VM_JUMP(index)                                                                                             \
+    {                                                                                                                  \
+        auto offset = uint32_t {0};                                                                                    \
+        std::memcpy(&offset, targets + static_cast<std::size_t>(index) * sizeof(offset), sizeof(offset));              \
+        pc = code + offset;                                                                                            \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+// handlers of the instructions with operands, expanded once per width
+#define TCC_VM_OPERAND_HANDLERS(bits)                                                                                  \
+    opBr##bits:                                                                                                        \
+    {                                                                                                                  \
+        TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0));                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opBrt##bits:                                                                                                       \
+    {                                                                                                                  \
+        if (stack[sp--] != 0) { TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0)); }                                                \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opBrf##bits:                                                                                                       \
+    {                                                                                                                  \
+        if (stack[sp--] == 0) { TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0)); }                                                \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opIConst##bits:                                                                                                    \
+    {                                                                                                                  \
+        stack[++sp] = TCC_VM_OPERAND(bits, 0);                                                                         \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opLoad##bits:                                                                                                      \
+    {                                                                                                                  \
+        stack[sp + 1] = stack[fp + TCC_VM_OPERAND(bits, 0)];                                                           \
+        ++sp;                                                                                                          \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opGLoad##bits:                                                                                                     \
+    {                                                                                                                  \
+        stack[++sp] = data[TCC_VM_OPERAND(bits, 0)];                                                                   \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opStore##bits:                                                                                                     \
+    {                                                                                                                  \
+        stack[fp + TCC_VM_OPERAND(bits, 0)] = stack[sp--];                                                             \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opGStore##bits:                                                                                                    \
+    {                                                                                                                  \
+        data[TCC_VM_OPERAND(bits, 0)] = stack[sp--];                                                                   \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opCall##bits:                                                                                                      \
+    {                                                                                                                  \
+        if (sp > stackLimit)                                                                                           \
+        {                                                                                                              \
+            if (!reserveFrame(sp)) { goto overflow; }                                                                  \
+            stackLimit = m_stack_.callLimit(m_callHeadroom_);                                                          \
+        }                                                                                                              \
+                                                                                                                       \
+        stack[++sp] = TCC_VM_OPERAND(bits, 1);            /* save num args */                                          \
+        stack[++sp] = fp;                                 /* save frame pointer */                                     \
+        stack[++sp] = (pc - code) + 1 + 2 * ((bits) / 8); /* save return offset */                                     \
+        fp          = sp;                                                                                              \
+        TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0));                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opTailCall##bits:                                                                                                  \
+    {                                                                                                                  \
+        auto const numArgs = TCC_VM_OPERAND(bits, 1);                                                                  \
+        auto const retAddr = stack[fp];                                                                                \
+        auto const savedFp = stack[fp - 1];                                                                            \
+        auto const first   = fp - 2 - stack[fp - 2]; /* first current argument */                                      \
+        for (auto i = int64_t {0}; i < numArgs; ++i) { stack[first + i] = stack[sp - numArgs + 1 + i]; }               \
+        sp          = first + numArgs - 1;                                                                             \
+        stack[++sp] = numArgs; /* save num args */                                                                     \
+        stack[++sp] = savedFp; /* keep frame pointer of the caller */                                                  \
+        stack[++sp] = retAddr; /* keep return offset of the caller */                                                  \
+        fp          = sp;                                                                                              \
+        TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0));                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opCallNative##bits:                                                                                                \
+    {                                                                                                                  \
+        auto const first = sp - TCC_VM_OPERAND(bits, 1) + 1;                                                           \
+        stack[first]     = natives[TCC_VM_OPERAND(bits, 0)](stack + first);                                            \
+        sp               = first;                                                                                      \
+        TCC_VM_NEXT(bits, 2);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opLoadIConstIAdd##bits:                                                                                            \
+    {                                                                                                                  \
+        stack[sp + 1] = stack[fp + TCC_VM_OPERAND(bits, 0)] + TCC_VM_OPERAND(bits, 1);                                 \
+        ++sp;                                                                                                          \
+        TCC_VM_NEXT(bits, 2);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opLoadIConstISub##bits:                                                                                            \
+    {                                                                                                                  \
+        stack[sp + 1] = stack[fp + TCC_VM_OPERAND(bits, 0)] - TCC_VM_OPERAND(bits, 1);                                 \
+        ++sp;                                                                                                          \
+        TCC_VM_NEXT(bits, 2);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opLoadIConstILt##bits:                                                                                             \
+    {                                                                                                                  \
+        stack[sp + 1] = stack[fp + TCC_VM_OPERAND(bits, 0)] < TCC_VM_OPERAND(bits, 1) ? 1 : 0;                         \
+        ++sp;                                                                                                          \
+        TCC_VM_NEXT(bits, 2);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opLoadLoadIAdd##bits:                                                                                              \
+    {                                                                                                                  \
+        stack[sp + 1] = stack[fp + TCC_VM_OPERAND(bits, 0)] + stack[fp + TCC_VM_OPERAND(bits, 1)];                     \
+        ++sp;                                                                                                          \
+        TCC_VM_NEXT(bits, 2);                                                                                          \
+    }                                                                                                                  \
+                                                                                                                       \
+    opILtBrf##bits:                                                                                                    \
+    {                                                                                                                  \
+        auto const b = stack[sp--];                                                                                    \
+        auto const a = stack[sp--];                                                                                    \
+        if (!(a < b)) { TCC_VM_JUMP(TCC_VM_OPERAND(bits, 0)); }                                                        \
+        TCC_VM_NEXT(bits, 1);                                                                                          \
+    }
+
+    TCC_VM_DISPATCH();
+
+    TCC_VM_OPERAND_HANDLERS(8)
+    TCC_VM_OPERAND_HANDLERS(16)
+    TCC_VM_OPERAND_HANDLERS(32)
+    TCC_VM_OPERAND_HANDLERS(64)
+
+opIAdd:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a + b;
+    TCC_VM_NEXT(8, 0);
+}
+
+opISub:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a - b;
+    TCC_VM_NEXT(8, 0);
+}
+
+opIMul:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a * b;
+    TCC_VM_NEXT(8, 0);
+}
+
+opILt:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a < b ? 1 : 0;
+    TCC_VM_NEXT(8, 0);
+}
+
+opIEq:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a == b ? 1 : 0;
+    TCC_VM_NEXT(8, 0);
+}
+
+opPrint:
+{
+    m_output_->print(stack[sp--]);
+    TCC_VM_NEXT(8, 0);
+}
+
+opPop:
+{
+    --sp;
+    TCC_VM_NEXT(8, 0);
+}
+
+opRet:
+{
+    auto const returnVal = stack[sp];
+    auto const retOffset = stack[fp];
+    if (static_cast<uint64_t>(retOffset) >= codeSize)
+    {
+        next = pc - code;
+        goto leave;
+    }
+
+    sp                 = fp - 1;
+    fp                 = stack[sp--];
+    auto const numArgs = stack[sp--];
+    sp -= numArgs;
+    stack[++sp] = returnVal;
+    pc          = code + retOffset;
+    TCC_VM_DISPATCH();
+}
+
+opJoin:
+{
+    TCC_VM_NEXT(8, 0);
+}
+
+opExit:
+{
+    result = stack[sp];
+    next   = pc - code + 1;
+    goto leave;
+}
+
+opHalt:
+{
+    result = -1;
+    next   = pc - code + 1;
+    goto leave;
+}
+
+// stops at the instruction, result stays -1
+opInvalid:
+{
+    m_runStatus_ = RunStatus::InvalidInstruction;
+    next         = pc - code;
+    goto leave;
+}
+
+// before the CALL at pc
+overflow:
+{
+    m_interrupted_ = true;
+    next           = pc - code;
+    goto leave;
+}
+
+#undef TCC_VM_OPERAND_HANDLERS
+#undef TCC_VM_JUMP
+#undef TCC_VM_NEXT
+#undef TCC_VM_DISPATCH
+#undef TCC_VM_OPERAND
+
+leave:
+    forEachReturnAddress(stack, fp, sp, [&](int64_t& returnAddress) {
+        returnAddress = m_compactLayout_.addressAt(returnAddress).value_or(returnAddress);
+    });
+
+    m_stackPointer_       = sp;
+    m_instructionPointer_ = m_compactLayout_.addressAt(next).value_or(-1);
+    m_framePointer_       = fp;
+    return result;
+}
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#else
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+auto VirtualMachine::executeCompact() -> int64_t { return (this->*switchExecutor(false))(); }
+
+#endif
+
+}  // namespace tcc
@@ -0,0 +1,57 @@
+/**
+ * @file vm_jit.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm.hpp"
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+/**
+ * @brief Runs the native code compiled in the constructor. The registers are
+ * passed in & out through a JitContext, stack & globals are shared.
+ */
+auto VirtualMachine::executeJit() -> int64_t
+{
+    auto context = jitContext();
+    auto result  = m_native_->run(context);
+
+    // grown at a CALL, the native code continues there
+    while (context.stackOverflow != 0 && reserveFrame(context.stackPointer))
+    {
+        context.stackOverflow = 0;
+        context.stackLimit    = m_stack_.callLimit(m_callHeadroom_);
+        result                = m_native_->run(context);
+    }
+
+    m_stackPointer_       = context.stackPointer;
+    m_framePointer_       = context.framePointer;
+    m_instructionPointer_ = context.instructionPointer;
+
+    if (context.invalidInstruction != 0)
+    {
+        m_runStatus_ = RunStatus::InvalidInstruction;
+        return -1;
+    }
+
+    if (context.stackOverflow != 0) { m_interrupted_ = true; }
+    return result;
+}
+
+auto VirtualMachine::jitContext() -> JitContext
+{
+    auto context               = JitContext {};
+    context.stack              = m_stack_.data();
+    context.stackLimit         = m_stack_.callLimit(m_callHeadroom_);
+    context.data               = m_data_.data();
+    context.stackPointer       = m_stackPointer_;
+    context.framePointer       = m_framePointer_;
+    context.instructionPointer = m_instructionPointer_;
+    context.output             = m_output_;
+    context.natives            = m_natives_.data();
+    context.print              = [](JitContext* ctx, int64_t const value) { ctx->output->print(value); };
+    return context;
+}
+
+}  // namespace tcc
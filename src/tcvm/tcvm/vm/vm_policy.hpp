@@ -0,0 +1,82 @@
+/**
+ * @file vm_policy.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tcc
+{
+/**
+ * @brief Compile-time configuration of the switch interpreter. Every feature
+ * that is switched off is not compiled into the dispatch loop at all.
+ *
+ * tracing:        disassemble every instruction & print the exit code.
+ * boundsChecking: validate opcodes, operands, stack & memory accesses before
+ *                 executing an instruction, stop with an error instead of
+ *                 corrupting memory.
+ * statistics:     count executed instructions, calls & the maximum stack depth.
+ * budgeted:       stop before the next instruction once the instruction budget
+ *                 is used up or a suspension was requested.
+ * metered:        charge the gas of a basic block when control enters it, stop
+ *                 once the gas is used up or the cancellation flag is set.
+ * scheduled:      run SPAWN & JOIN on a TaskHost, stop whenever the host has
+ *                 to switch tasks. Not part of policyIndex(), the scheduled
+ *                 interpreter is never combined with the other features.
+ */
+template <bool Tracing, bool BoundsChecking, bool Statistics, bool Budgeted = false, bool Metered = false,
+          bool Scheduled = false>
+struct ExecutionPolicy
+{
+    static constexpr auto tracing        = Tracing;
+    static constexpr auto boundsChecking = BoundsChecking;
+    static constexpr auto statistics     = Statistics;
+    static constexpr auto budgeted       = Budgeted;
+    static constexpr auto metered        = Metered;
+    static constexpr auto scheduled      = Scheduled;
+};
+
+using ReleasePolicy   = ExecutionPolicy<false, false, false>;
+using CheckedPolicy   = ExecutionPolicy<false, true, false>;
+using ProfilingPolicy = ExecutionPolicy<false, false, true>;
+using DebugPolicy     = ExecutionPolicy<true, true, true>;
+using SlicedPolicy    = ExecutionPolicy<false, false, false, true>;
+using MeteredPolicy   = ExecutionPolicy<false, false, false, false, true>;
+using ScheduledPolicy = ExecutionPolicy<false, false, false, false, false, true>;
+
+/**
+ * @brief Packs the runtime options into an index, one bit per policy flag.
+ */
+constexpr auto policyIndex(bool tracing, bool boundsChecking, bool statistics, bool budgeted = false,
+                           bool metered = false) noexcept -> std::size_t
+{
+    return (tracing ? 1U : 0U) | (boundsChecking ? 2U : 0U) | (statistics ? 4U : 0U) | (budgeted ? 8U : 0U)
+           | (metered ? 16U : 0U);
+}
+
+/**
+ * @brief Inverse of policyIndex().
+ */
+template <std::size_t Index>
+using PolicyAt = ExecutionPolicy<(Index & 1U) != 0, (Index & 2U) != 0, (Index & 4U) != 0, (Index & 8U) != 0,
+                                 (Index & 16U) != 0>;
+
+constexpr auto NumPolicies = std::size_t {32};
+
+static_assert(policyIndex(false, false, false) == 0);
+static_assert(policyIndex(true, true, true, true, true) == NumPolicies - 1);
+
+/**
+ * @brief Collected while running with the statistics policy.
+ */
+struct ExecutionStats
+{
+    int64_t instructions {0};
+    int64_t calls {0};
+    int64_t maxStackDepth {0};
+};
+
+}  // namespace tcc
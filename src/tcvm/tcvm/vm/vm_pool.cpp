@@ -0,0 +1,181 @@
+/**
+ * @file vm_pool.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm_pool.hpp"
+#include "tcvm/vm/verifier.hpp"
+
+#include <algorithm>
+
+namespace tcc
+{
+namespace
+{
+// set on worker threads, so callbacks can submit to their own queue
+thread_local VmPool const* currentPool  = nullptr;
+thread_local std::size_t currentWorker = 0;
+}  // namespace
+
+VmPool::VmPool(VmPoolOptions options) : options_ {options}
+{
+    auto const threads = std::max(options_.threads, std::size_t {1});
+    workers_.reserve(threads);
+    for (auto i = std::size_t {0}; i < threads; ++i) { workers_.push_back(std::make_unique<Worker>()); }
+    for (auto i = std::size_t {0}; i < threads; ++i)
+    { workers_[i]->thread = std::thread([this, i] { run(i); }); }
+}
+
+VmPool::~VmPool()
+{
+    {
+        auto const lock = std::scoped_lock {sleepMutex_};
+        stopping_       = true;
+    }
+    wakeUp_.notify_all();
+    for (auto& worker : workers_) { worker->thread.join(); }
+}
+
+auto VmPool::submit(VmJob job) -> std::future<VmJobResult>
+{
+    // std::function has to be copyable
+    auto promise = std::make_shared<std::promise<VmJobResult>>();
+    auto result  = promise->get_future();
+    submit(std::move(job), [promise](VmJobResult done) { promise->set_value(std::move(done)); });
+    return result;
+}
+
+auto VmPool::submit(VmJob job, Callback callback) -> void
+{
+    auto const program = job.program != nullptr ? verified(job.program) : Verified {{}, "missing program"};
+    if (!program.error.empty())
+    {
+        auto result     = VmJobResult {};
+        result.exitCode = -1;
+        result.error    = program.error;
+        callback(std::move(result));
+        return;
+    }
+
+    auto const index = currentPool == this ? currentWorker : next_++ % workers_.size();
+
+    // counted first, a worker that sees the count before the task only retries
+    {
+        auto const lock = std::scoped_lock {sleepMutex_};
+        ++pending_;
+    }
+
+    {
+        auto& worker    = *workers_[index];
+        auto const lock = std::scoped_lock {worker.mutex};
+        worker.tasks.push_back(Task {std::move(job), std::move(callback), program.globals, program.callHeadroom});
+    }
+
+    wakeUp_.notify_one();
+}
+
+auto VmPool::verified(std::shared_ptr<BinaryProgram const> const& program) -> Verified
+{
+    auto const lock = std::scoped_lock {verifiedMutex_};
+    if (auto const known = verified_.find(program.get()); known != verified_.end())
+    {
+        if (known->second.program.lock() == program) { return known->second; }
+    }
+
+    auto const result = verify(*program);
+    auto entry        = Verified {program, result.error, static_cast<uint64_t>(result.globals),
+                           static_cast<uint64_t>(result.callHeadroom)};
+    if (result.ok() && static_cast<std::size_t>(result.natives) > options_.natives.size())
+    { entry.error = "native function out of range"; }
+
+    std::erase_if(verified_, [](auto const& known) { return known.second.program.expired(); });
+    verified_[program.get()] = entry;
+    return entry;
+}
+
+auto VmPool::run(std::size_t const index) -> void
+{
+    currentPool   = this;
+    currentWorker = index;
+
+    while (true)
+    {
+        if (auto task = tryPop(index); task.has_value())
+        {
+            {
+                auto const lock = std::scoped_lock {sleepMutex_};
+                --pending_;
+            }
+            execute(*workers_[index], task.value());
+            continue;
+        }
+
+        auto lock = std::unique_lock {sleepMutex_};
+        wakeUp_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) { return; }
+    }
+}
+
+auto VmPool::tryPop(std::size_t const index) -> std::optional<Task>
+{
+    {
+        auto& own       = *workers_[index];
+        auto const lock = std::scoped_lock {own.mutex};
+        if (!own.tasks.empty())
+        {
+            auto task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return task;
+        }
+    }
+
+    for (auto offset = std::size_t {1}; offset < workers_.size(); ++offset)
+    {
+        auto& victim    = *workers_[(index + offset) % workers_.size()];
+        auto const lock = std::scoped_lock {victim.mutex};
+        if (!victim.tasks.empty())
+        {
+            auto task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return task;
+        }
+    }
+
+    return std::nullopt;
+}
+
+auto VmPool::execute(Worker& worker, Task& task) -> void
+{
+    auto const& program = *task.job.program;
+    auto const dataSize = std::max({options_.dataSize, task.globals, static_cast<uint64_t>(task.job.inputs.size())});
+    auto const main     = static_cast<uint64_t>(program.entryPoint);
+
+    if (!worker.vm)
+    {
+        worker.vm = std::make_unique<VirtualMachine>(program.data, main, dataSize, options_.stackSize, false,
+                                                     worker.output, options_.engine);
+        worker.vm->setNatives(options_.natives);
+    }
+    else if (worker.loaded != task.job.program || worker.vm->globals().size() != dataSize)
+    {
+        worker.vm->load(program.data, main, dataSize);
+    }
+    else
+    {
+        worker.vm->reset(program.entryPoint);
+        std::fill(begin(worker.vm->globals()), end(worker.vm->globals()), 0);
+    }
+    worker.loaded = task.job.program;
+    worker.vm->setCallHeadroom(task.callHeadroom);
+
+    std::copy(begin(task.job.inputs), end(task.job.inputs), begin(worker.vm->globals()));
+    worker.output.str({});
+
+    auto result     = VmJobResult {};
+    result.exitCode = worker.vm->cpu();
+    result.status   = worker.vm->status();
+    result.output   = worker.output.str();
+    task.done(std::move(result));
+}
+
+}  // namespace tcc
@@ -0,0 +1,140 @@
+/**
+ * @file vm_pool.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tcsl/tcsl.hpp"
+#include "tcvm/vm/vm.hpp"
+
+namespace tcc
+{
+/**
+ * @brief One program run. Programs are shared, a worker that runs the same
+ * program twice in a row keeps its decoded, translated or compiled form.
+ */
+struct VmJob
+{
+    std::shared_ptr<BinaryProgram const> program {};
+    std::vector<int64_t> inputs {};  // copied into the first globals before the program starts
+};
+
+struct VmJobResult
+{
+    int64_t exitCode {0};
+    VirtualMachine::RunStatus status {VirtualMachine::RunStatus::Finished};  // how the program stopped
+    std::string output {};                                                   // everything the program printed
+    std::string_view error {};  // why the program was rejected, empty if it ran
+};
+
+struct VmPoolOptions
+{
+    std::size_t threads {std::thread::hardware_concurrency()};  // at least one
+    uint64_t stackSize {200};
+    uint64_t dataSize {0};  // grows to the number of inputs
+    VirtualMachine::Engine engine {VirtualMachine::Engine::Switch};
+    std::vector<NativeFunction> natives {};  // of every job, see VirtualMachine::setNatives()
+};
+
+/**
+ * @brief Runs jobs on a fixed set of worker threads.
+ *
+ * Programs are verified when they are submitted, once per shared program, so
+ * the workers run them unchecked. Rejected jobs, including jobs without a
+ * program, never reach a worker, their result carries the verifier error and
+ * an exit code of -1. The result of a job that ran carries the status of the
+ * machine, e.g. RunStatus::StackOverflow.
+ *
+ * Every worker owns a queue and one VirtualMachine that is reloaded for each
+ * job, so stacks & globals are allocated once per worker. Jobs submitted from
+ * outside the pool are distributed round robin, jobs submitted from a callback
+ * go to the queue of the calling worker. Idle workers steal from the back of
+ * the other queues. The destructor finishes all submitted jobs.
+ */
+class VmPool
+{
+public:
+    using Callback = std::function<void(VmJobResult)>;
+
+    explicit VmPool(VmPoolOptions options = {});
+    ~VmPool();
+
+    VmPool(VmPool const&) = delete;
+    VmPool(VmPool&&)      = delete;
+    auto operator=(VmPool const&) -> VmPool& = delete;
+    auto operator=(VmPool&&) -> VmPool& = delete;
+
+    auto submit(VmJob job) -> std::future<VmJobResult>;
+
+    /**
+     * @brief Calls callback on the worker thread that ran the job, or right
+     * away if the program was rejected. The callback must not throw.
+     */
+    auto submit(VmJob job, Callback callback) -> void;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return workers_.size(); }
+
+private:
+    struct Task
+    {
+        VmJob job {};
+        Callback done {};
+        uint64_t globals {0};       // data segment the program needs
+        uint64_t callHeadroom {0};  // see VirtualMachine::setCallHeadroom()
+    };
+
+    struct Verified
+    {
+        std::weak_ptr<BinaryProgram const> program {};  // the address may be reused once it expired
+        std::string_view error {};
+        uint64_t globals {0};
+        uint64_t callHeadroom {0};
+    };
+
+    struct Worker
+    {
+        std::mutex mutex {};
+        std::deque<Task> tasks {};
+        std::thread thread {};
+
+        std::stringstream output {};
+        std::unique_ptr<VirtualMachine> vm {};
+        std::shared_ptr<BinaryProgram const> loaded {};
+    };
+
+    auto verified(std::shared_ptr<BinaryProgram const> const& program) -> Verified;
+    auto run(std::size_t index) -> void;
+    auto tryPop(std::size_t index) -> std::optional<Task>;
+    auto execute(Worker& worker, Task& task) -> void;
+
+    VmPoolOptions options_;
+    std::vector<std::unique_ptr<Worker>> workers_ {};
+
+    std::mutex sleepMutex_ {};
+    std::condition_variable wakeUp_ {};
+    std::size_t pending_ {0};  // queued jobs, guarded by sleepMutex_
+    bool stopping_ {false};    // guarded by sleepMutex_
+    std::atomic<std::size_t> next_ {0};
+
+    std::mutex verifiedMutex_ {};
+    std::unordered_map<BinaryProgram const*, Verified> verified_ {};  // guarded by verifiedMutex_
+};
+
+}  // namespace tcc
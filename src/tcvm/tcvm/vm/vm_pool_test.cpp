@@ -0,0 +1,199 @@
+/**
+ * @file vm_pool_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/vm_pool.hpp"
+
+#include "catch2/catch.hpp"
+#include "tcsl/tcsl.hpp"
+#include "tcvm/examples.hpp"
+#include "tcvm/vm/verifier.hpp"
+
+#include <atomic>
+
+using tcc::ByteCode;
+using tcc::VirtualMachine;
+
+namespace
+{
+// print(g0); return g0 * g1;
+auto const multiply = std::make_shared<tcc::BinaryProgram const>(tcc::BinaryProgram {
+    1, "multiply", 0,
+    std::vector<int64_t> {
+        ByteCode::GLOAD, 0,  //
+        ByteCode::PRINT,     //
+        ByteCode::GLOAD, 0,  //
+        ByteCode::GLOAD, 1,  //
+        ByteCode::IMUL,      //
+        ByteCode::EXIT,      //
+    }});
+}  // namespace
+
+TEST_CASE("tcvm: VmPoolFutures", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit);
+
+    auto options   = tcc::VmPoolOptions {};
+    options.threads = 4;
+    options.engine  = engine;
+    auto pool       = tcc::VmPool {options};
+    REQUIRE(pool.size() == 4);
+
+    auto const fibonacci = std::make_shared<tcc::BinaryProgram const>(tcvm::createFibonacciProgram(10));
+
+    auto products = std::vector<std::future<tcc::VmJobResult>> {};
+    auto fibs     = std::vector<std::future<tcc::VmJobResult>> {};
+    for (auto i = int64_t {0}; i < 64; ++i)
+    {
+        products.push_back(pool.submit(tcc::VmJob {multiply, {i, 3}}));
+        fibs.push_back(pool.submit(tcc::VmJob {fibonacci, {}}));
+    }
+
+    for (auto i = int64_t {0}; i < 64; ++i)
+    {
+        auto const product = products[static_cast<std::size_t>(i)].get();
+        REQUIRE(product.exitCode == i * 3);
+        REQUIRE(product.output == fmt::format("{}\n", i));
+        REQUIRE(fibs[static_cast<std::size_t>(i)].get().exitCode == 55);
+    }
+}
+
+TEST_CASE("tcvm: VmPoolGlobalsAreClearedBetweenJobs", "[tcvm]")
+{
+    // return g1 + 1; g1 = 100;
+    auto const program = std::make_shared<tcc::BinaryProgram const>(tcc::BinaryProgram {
+        1, "globals", 0,
+        std::vector<int64_t> {
+            ByteCode::GLOAD, 1,     //
+            ByteCode::ICONST, 100,  //
+            ByteCode::GSTORE, 1,    //
+            ByteCode::ICONST, 1,    //
+            ByteCode::IADD,         //
+            ByteCode::EXIT,         //
+        }});
+
+    auto options    = tcc::VmPoolOptions {};
+    options.threads  = 1;
+    options.dataSize = 2;
+    auto pool        = tcc::VmPool {options};
+    for (auto i = 0; i < 3; ++i) { REQUIRE(pool.submit(tcc::VmJob {program, {}}).get().exitCode == 1); }
+    REQUIRE(pool.submit(tcc::VmJob {program, {0, 41}}).get().exitCode == 42);
+}
+
+TEST_CASE("tcvm: VmPoolCallbacks", "[tcvm]")
+{
+    auto sum       = std::atomic<int64_t> {0};
+    auto completed = std::atomic<int64_t> {0};
+
+    {
+        auto options   = tcc::VmPoolOptions {};
+        options.threads = 3;
+        auto pool       = tcc::VmPool {options};
+
+        for (auto i = int64_t {1}; i <= 32; ++i)
+        {
+            // every job submits a follow-up job from its worker thread
+            pool.submit(tcc::VmJob {multiply, {i, 2}}, [&, i](tcc::VmJobResult result) {
+                sum += result.exitCode;
+                ++completed;
+                pool.submit(tcc::VmJob {multiply, {i, 1}}, [&](tcc::VmJobResult next) {
+                    sum += next.exitCode;
+                    ++completed;
+                });
+            });
+        }
+    }
+
+    // the destructor finishes everything that was submitted
+    REQUIRE(completed == 64);
+    REQUIRE(sum == 3 * (32 * 33 / 2));
+}
+
+TEST_CASE("tcvm: VmPoolVerifiesPrograms", "[tcvm]")
+{
+    auto const program = [](std::vector<int64_t> code) {
+        return std::make_shared<tcc::BinaryProgram const>(tcc::BinaryProgram {1, "verify", 0, std::move(code)});
+    };
+
+    auto options    = tcc::VmPoolOptions {};
+    options.threads = 2;
+    auto pool       = tcc::VmPool {options};
+
+    // globals are sized by the verifier, not only by the inputs
+    auto const globals = program({ByteCode::ICONST, 7, ByteCode::GSTORE, 300, ByteCode::GLOAD, 300, ByteCode::EXIT});
+    REQUIRE(pool.submit(tcc::VmJob {globals, {}}).get().exitCode == 7);
+    REQUIRE(pool.submit(tcc::VmJob {globals, {1}}).get().exitCode == 7);
+
+    auto const underflow = pool.submit(tcc::VmJob {program({ByteCode::IADD, ByteCode::EXIT}), {}}).get();
+    REQUIRE(underflow.exitCode == -1);
+    REQUIRE(underflow.error == "stack underflow");
+
+    auto const far = program({ByteCode::GLOAD, tcc::MaxGlobals, ByteCode::EXIT});
+    REQUIRE(pool.submit(tcc::VmJob {far, {}}).get().error == "global address out of range");
+
+    auto const native = program({ByteCode::ICONST, -3, ByteCode::CALLNATIVE, 0, 1, ByteCode::EXIT});
+    REQUIRE(pool.submit(tcc::VmJob {native, {}}).get().error == "native function out of range");
+
+    auto const missing = pool.submit(tcc::VmJob {nullptr, {}}).get();
+    REQUIRE(missing.exitCode == -1);
+    REQUIRE(missing.error == "missing program");
+
+    auto rejected = std::atomic<bool> {false};
+    pool.submit(tcc::VmJob {far, {}}, [&](tcc::VmJobResult result) { rejected = !result.error.empty(); });
+    REQUIRE(rejected);
+}
+
+TEST_CASE("tcvm: VmPoolRunStatus", "[tcvm]")
+{
+    auto options    = tcc::VmPoolOptions {};
+    options.threads = 2;
+    auto pool       = tcc::VmPool {options};
+
+    auto const halt   = std::make_shared<tcc::BinaryProgram const>(tcc::BinaryProgram {1, "halt", 0, {ByteCode::HALT}});
+    auto const halted = pool.submit(tcc::VmJob {halt, {}}).get();
+    REQUIRE(halted.exitCode == -1);
+    REQUIRE(halted.status == VirtualMachine::RunStatus::Finished);
+
+    // 4 slots per call, beyond the default maximum stack size
+    auto const deep     = std::make_shared<tcc::BinaryProgram const>(tcvm::createEvenOddProgram(500'000, false));
+    auto const overflow = pool.submit(tcc::VmJob {deep, {}}).get();
+    REQUIRE(overflow.exitCode == -1);
+    REQUIRE(overflow.status == VirtualMachine::RunStatus::StackOverflow);
+    REQUIRE(overflow.error.empty());
+}
+
+TEST_CASE("tcvm: VmPoolDeepFrames", "[tcvm]")
+{
+    // countdown(3) called from a frame far deeper than VmStack::CallHeadroom
+    auto code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,    //
+        ByteCode::BRF,    13,    //
+        ByteCode::LOAD,   -3,    //
+        ByteCode::ICONST, 1,     //
+        ByteCode::ISUB,          //
+        ByteCode::CALL,   0, 1,  //
+        ByteCode::RET,           //
+        ByteCode::ICONST, 0,     //
+        ByteCode::RET,           //
+    };
+    auto const entryPoint = static_cast<int64_t>(code.size());
+    for (auto i = 0; i < 1'000; ++i) { code.insert(code.end(), {ByteCode::ICONST, 1}); }
+    code.insert(code.end(), 1'000, ByteCode::POP);
+    code.insert(code.end(), {ByteCode::ICONST, 3, ByteCode::CALL, 0, 1, ByteCode::EXIT});
+
+    auto options      = tcc::VmPoolOptions {};
+    options.threads   = 1;
+    options.stackSize = 8;
+    options.engine    = VirtualMachine::Engine::Threaded;
+    auto pool         = tcc::VmPool {options};
+
+    // the second job reuses the machine loaded for the first one
+    auto const deep = std::make_shared<tcc::BinaryProgram const>(tcc::BinaryProgram {1, "deep", entryPoint, code});
+    for (auto const& program : {multiply, deep, deep})
+    {
+        auto const result = pool.submit(tcc::VmJob {program, {2, 3}}).get();
+        REQUIRE(result.status == VirtualMachine::RunStatus::Finished);
+        REQUIRE(result.exitCode == (program == deep ? 0 : 6));
+    }
+}
@@ -0,0 +1,302 @@
+/**
+ * @file vm_register.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm.hpp"
+#include "tcsl/tcsl.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TCC_VM_HAS_COMPUTED_GOTO 1
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_COMPUTED_GOTO)
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+/**
+ * @brief Runs the register code translated from the stack code. Registers are
+ * addressed relative to the frame pointer, frames have the same layout as in
+ * the stack engines, but saved return addresses are register code indices.
+ */
+auto VirtualMachine::executeRegister() -> int64_t
+{
+    static void* const dispatchTable[] = {
+        &&opInvalid,  // NOOP
+        &&opMov,      //
+        &&opMovK,     //
+        &&opIAdd,     //
+        &&opIAddK,    //
+        &&opISub,     //
+        &&opISubK,    //
+        &&opIMul,     //
+        &&opIMulK,    //
+        &&opILt,      //
+        &&opILtK,     //
+        &&opIEq,      //
+        &&opIEqK,     //
+        &&opBr,       //
+        &&opBrt,      //
+        &&opBrf,      //
+        &&opGLoad,    //
+        &&opGStore,   //
+        &&opPrint,    //
+        &&opCall,     //
+        &&opRet,      //
+        &&opExit,     //
+        &&opHalt,     //
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == RegisterCode::NUM_OPCODES);
+
+    if (m_resolvedTable_ != dispatchTable)
+    {
+        for (auto& inst : m_registerProgram_.instructions) { inst.handler = dispatchTable[inst.opcode]; }
+        m_resolvedTable_ = dispatchTable;
+    }
+
+    auto const* const program = m_registerProgram_.instructions.data();
+    auto const programSize    = static_cast<uint64_t>(m_registerProgram_.instructions.size());
+    auto* const stack         = m_stack_.data();
+    auto* const data          = m_data_.data();
+    auto stackLimit           = m_stack_.callLimit(m_callHeadroom_);
+
+    auto fp     = m_framePointer_;
+    auto* frame = stack + fp;
+
+    // a snapshot may continue inside a block the translation didn't enter at
+    auto const ip = static_cast<uint64_t>(m_instructionPointer_);
+    if (ip < m_registerProgram_.indexOf.size() && m_registerProgram_.indexOf[ip] < 0)
+    { return (this->*switchExecutor(false))(); }
+
+    // saved return addresses become return indices, a snapshot may hold calls
+    auto convertible = true;
+    forEachReturnAddress(stack, fp, m_stackPointer_, [&](int64_t const returnAddress) {
+        convertible = convertible && m_registerProgram_.returnIndexAt(returnAddress).has_value();
+    });
+    if (!convertible) { return (this->*switchExecutor(false))(); }
+    forEachReturnAddress(stack, fp, m_stackPointer_, [&](int64_t& returnAddress) {
+        returnAddress = m_registerProgram_.returnIndexAt(returnAddress).value();
+    });
+
+    auto const* pc = program + m_registerProgram_.indexAt(m_instructionPointer_);
+    auto result    = int64_t {-1};
+
+#define TCC_VM_DISPATCH() goto*(pc->handler)
+#define TCC_VM_NEXT()                                                                                                  \
+    {                                                                                                                  \
+        ++pc;                                                                                                          \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+    TCC_VM_DISPATCH();
+
+opMov:
+{
+    frame[pc->a] = frame[pc->b];
+    TCC_VM_NEXT();
+}
+
+opMovK:
+{
+    frame[pc->a] = pc->b;
+    TCC_VM_NEXT();
+}
+
+opIAdd:
+{
+    frame[pc->a] = frame[pc->b] + frame[pc->c];
+    TCC_VM_NEXT();
+}
+
+opIAddK:
+{
+    frame[pc->a] = frame[pc->b] + pc->c;
+    TCC_VM_NEXT();
+}
+
+opISub:
+{
+    frame[pc->a] = frame[pc->b] - frame[pc->c];
+    TCC_VM_NEXT();
+}
+
+opISubK:
+{
+    frame[pc->a] = frame[pc->b] - pc->c;
+    TCC_VM_NEXT();
+}
+
+opIMul:
+{
+    frame[pc->a] = frame[pc->b] * frame[pc->c];
+    TCC_VM_NEXT();
+}
+
+opIMulK:
+{
+    frame[pc->a] = frame[pc->b] * pc->c;
+    TCC_VM_NEXT();
+}
+
+opILt:
+{
+    frame[pc->a] = frame[pc->b] < frame[pc->c] ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opILtK:
+{
+    frame[pc->a] = frame[pc->b] < pc->c ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opIEq:
+{
+    frame[pc->a] = frame[pc->b] == frame[pc->c] ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opIEqK:
+{
+    frame[pc->a] = frame[pc->b] == pc->c ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opBr:
+{
+    pc = program + pc->a;
+    TCC_VM_DISPATCH();
+}
+
+opBrt:
+{
+    if (frame[pc->a] != 0)
+    {
+        pc = program + pc->b;
+        TCC_VM_DISPATCH();
+    }
+    TCC_VM_NEXT();
+}
+
+opBrf:
+{
+    if (frame[pc->a] == 0)
+    {
+        pc = program + pc->b;
+        TCC_VM_DISPATCH();
+    }
+    TCC_VM_NEXT();
+}
+
+opGLoad:
+{
+    frame[pc->a] = data[pc->b];
+    TCC_VM_NEXT();
+}
+
+opGStore:
+{
+    data[pc->a] = frame[pc->b];
+    TCC_VM_NEXT();
+}
+
+opPrint:
+{
+    m_output_->print(frame[pc->a]);
+    TCC_VM_NEXT();
+}
+
+opCall:
+{
+    auto* const args   = frame + pc->c;
+    auto const numArgs = pc->b;
+    auto const sp      = fp + pc->c + numArgs - 1;  // the stack machine has the arguments on top
+    if (sp > stackLimit)
+    {
+        if (!reserveFrame(sp))
+        {
+            // stop before the call, the stack engines continue from here
+            m_stackPointer_ = sp;
+            m_interrupted_  = true;
+            goto leave;
+        }
+        stackLimit = m_stack_.callLimit(m_callHeadroom_);
+    }
+
+    args[numArgs]      = numArgs;             // save num args
+    args[numArgs + 1]  = fp;                  // save frame pointer
+    args[numArgs + 2]  = (pc + 1) - program;  // save return index
+    fp += pc->c + numArgs + 2;
+    frame = stack + fp;
+    pc    = program + pc->a;
+    TCC_VM_DISPATCH();
+}
+
+opRet:
+{
+    auto const returnVal = frame[pc->a];
+    auto const retIndex  = frame[0];
+    auto const numArgs   = frame[-2];
+    frame[-2 - numArgs]  = returnVal;  // result replaces the first argument
+    fp                   = frame[-1];
+    frame                = stack + fp;
+    if (static_cast<uint64_t>(retIndex) >= programSize) { goto leave; }
+    pc = program + retIndex;
+    TCC_VM_DISPATCH();
+}
+
+opExit:
+{
+    result          = frame[pc->a];
+    m_stackPointer_ = fp + pc->a;
+    goto leave;
+}
+
+opHalt:
+{
+    result = -1;
+    goto leave;
+}
+
+// stops at the instruction, result stays -1
+opInvalid:
+{
+    m_runStatus_ = RunStatus::InvalidInstruction;
+    goto leave;
+}
+
+#undef TCC_VM_NEXT
+#undef TCC_VM_DISPATCH
+
+leave:
+    // the saved frame pointers only descend, fp bounds the walk
+    forEachReturnAddress(stack, fp, fp, [&](int64_t& returnAddress) {
+        returnAddress = m_registerProgram_.returnAddressAt(returnAddress).value_or(returnAddress);
+    });
+
+    m_instructionPointer_ = pc->address;
+    m_framePointer_       = fp;
+    return result;
+}
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#else
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+auto VirtualMachine::executeRegister() -> int64_t { return (this->*switchExecutor(false))(); }
+
+#endif
+
+}  // namespace tcc
@@ -0,0 +1,105 @@
+/**
+ * @file vm_stack.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm_stack.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TCC_VM_HAS_MMAP 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_MMAP)
+
+namespace
+{
+auto pageSize() -> std::size_t { return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)); }
+
+// whole pages, in slots
+auto roundToPages(std::size_t const slots) -> std::size_t
+{
+    auto const perPage = pageSize() / sizeof(int64_t);
+    return (std::max(slots, std::size_t {1}) + perPage - 1) / perPage * perPage;
+}
+}  // namespace
+
+VmStack::VmStack(std::size_t const size, std::size_t const reserve)
+    : size_ {roundToPages(size)}, reserved_ {roundToPages(std::max(size, reserve))}
+{
+    // reserved without access & without swap, committed below
+    mappingSize_ = reserved_ * sizeof(int64_t) + 2 * pageSize();
+    mapping_     = ::mmap(nullptr, mappingSize_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping_ == MAP_FAILED)
+    {
+        mapping_ = nullptr;
+        throw std::bad_alloc {};
+    }
+
+    slots_ = reinterpret_cast<int64_t*>(static_cast<char*>(mapping_) + pageSize());
+    if (::mprotect(slots_, size_ * sizeof(int64_t), PROT_READ | PROT_WRITE) != 0)
+    {
+        ::munmap(mapping_, mappingSize_);
+        throw std::bad_alloc {};
+    }
+}
+
+VmStack::~VmStack()
+{
+    if (mapping_ != nullptr) { ::munmap(mapping_, mappingSize_); }
+}
+
+auto VmStack::grow(std::size_t const size) -> bool
+{
+    if (size <= size_) { return true; }
+    if (size > reserved_) { return false; }
+
+    // pages are only backed by memory once they are touched
+    auto const newSize = std::min(roundToPages(std::max(size, size_ * 2)), reserved_);
+    if (::mprotect(slots_ + size_, (newSize - size_) * sizeof(int64_t), PROT_READ | PROT_WRITE) != 0) { return false; }
+    size_ = newSize;
+    return true;
+}
+
+#else
+
+VmStack::VmStack(std::size_t const size, std::size_t const /*reserve*/)
+    : size_ {std::max(size, CallHeadroom * 2)}, reserved_ {size_}
+{
+    slots_ = new int64_t[size_] {};
+}
+
+VmStack::~VmStack() { delete[] slots_; }
+
+auto VmStack::grow(std::size_t const size) -> bool { return size <= size_; }
+
+#endif
+
+VmStack::VmStack(VmStack&& other) noexcept
+    : mapping_ {std::exchange(other.mapping_, nullptr)}
+    , mappingSize_ {std::exchange(other.mappingSize_, 0)}
+    , slots_ {std::exchange(other.slots_, nullptr)}
+    , size_ {std::exchange(other.size_, 0)}
+    , reserved_ {std::exchange(other.reserved_, 0)}
+{
+}
+
+auto VmStack::operator=(VmStack&& other) noexcept -> VmStack&
+{
+    auto tmp = VmStack {std::move(other)};
+    std::swap(mapping_, tmp.mapping_);
+    std::swap(mappingSize_, tmp.mappingSize_);
+    std::swap(slots_, tmp.slots_);
+    std::swap(size_, tmp.size_);
+    std::swap(reserved_, tmp.reserved_);
+    return *this;
+}
+
+}  // namespace tcc
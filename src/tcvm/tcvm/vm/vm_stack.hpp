@@ -0,0 +1,80 @@
+/**
+ * @file vm_stack.hpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tcc
+{
+/**
+ * @brief Operand stack of a VirtualMachine in a reserved range of virtual
+ * memory. Only the committed part at the bottom is readable & writable, it
+ * grows in place, so data() stays valid for the lifetime of the stack. Guard
+ * pages below the first & above the last slot and the uncommitted rest of the
+ * reservation fault on access instead of overwriting other memory.
+ *
+ * Nothing is checked on push or pop. The machine checks on entry & at every
+ * CALL that a headroom of slots is committed above its stack pointer and grows
+ * the stack otherwise. The headroom is CallHeadroom, or more if the verifier
+ * found a deeper frame, see VirtualMachine::setCallHeadroom(), so only a frame
+ * of an unverified program can push past it & hit unmapped memory.
+ *
+ * Without mmap the stack is a fixed allocation that never grows.
+ */
+class VmStack
+{
+public:
+    static constexpr auto CallHeadroom   = std::size_t {256};        // slots
+    static constexpr auto DefaultReserve = std::size_t {1} << 20U;  // slots, 8 MiB
+
+    VmStack() = default;
+
+    /**
+     * @brief Commits at least size slots of a reservation of at least
+     * reserve slots, both are rounded up to whole pages. Throws
+     * std::bad_alloc if the range can not be reserved.
+     */
+    explicit VmStack(std::size_t size, std::size_t reserve = DefaultReserve);
+    ~VmStack();
+
+    VmStack(VmStack const&) = delete;
+    auto operator=(VmStack const&) -> VmStack& = delete;
+
+    VmStack(VmStack&& other) noexcept;
+    auto operator=(VmStack&& other) noexcept -> VmStack&;
+
+    [[nodiscard]] auto data() const noexcept -> int64_t* { return slots_; }
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return size_; }          // committed slots
+    [[nodiscard]] auto reserved() const noexcept -> std::size_t { return reserved_; }  // maximum size
+
+    [[nodiscard]] auto operator[](int64_t const index) const noexcept -> int64_t& { return slots_[index]; }
+
+    /**
+     * @brief Highest stack pointer at which a CALL finds headroom committed
+     * slots above it.
+     */
+    [[nodiscard]] auto callLimit(std::size_t const headroom = CallHeadroom) const noexcept -> int64_t
+    {
+        return static_cast<int64_t>(size_) - static_cast<int64_t>(headroom) - 1;
+    }
+
+    /**
+     * @brief Commits at least size slots, at least doubling the committed
+     * part. Returns false & keeps the stack unchanged if size exceeds the
+     * reservation.
+     */
+    auto grow(std::size_t size) -> bool;
+
+private:
+    void* mapping_ {nullptr};  // guard pages around the reservation
+    std::size_t mappingSize_ {0};
+    int64_t* slots_ {nullptr};
+    std::size_t size_ {0};
+    std::size_t reserved_ {0};
+};
+
+}  // namespace tcc
@@ -0,0 +1,49 @@
+/**
+ * @file vm_stack_test.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+#include "tcvm/vm/vm_stack.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <utility>
+
+TEST_CASE("tcvm: VmStackGrowsInPlace", "[tcvm]")
+{
+    auto stack = tcc::VmStack {8, 100'000};
+    REQUIRE(stack.size() >= 2 * tcc::VmStack::CallHeadroom);
+    REQUIRE(stack.reserved() >= 100'000);
+    REQUIRE(stack.callLimit() == static_cast<int64_t>(stack.size() - tcc::VmStack::CallHeadroom) - 1);
+
+    auto* const data = stack.data();
+    auto const size  = stack.size();
+    for (auto i = int64_t {0}; i < static_cast<int64_t>(size); ++i) { stack[i] = i; }
+
+    REQUIRE(stack.grow(size + 1));
+    REQUIRE(stack.size() >= 2 * size);
+    REQUIRE(stack.data() == data);
+    REQUIRE(stack[static_cast<int64_t>(size) - 1] == static_cast<int64_t>(size) - 1);
+    stack[static_cast<int64_t>(stack.size()) - 1] = 42;
+
+    // never beyond the reservation
+    REQUIRE_FALSE(stack.grow(stack.reserved() + 1));
+    REQUIRE(stack.grow(stack.reserved()));
+    REQUIRE(stack.size() == stack.reserved());
+    REQUIRE(stack.grow(1));
+}
+
+TEST_CASE("tcvm: VmStackMove", "[tcvm]")
+{
+    auto stack = tcc::VmStack {1'000};
+    REQUIRE(stack.size() >= 1'000);
+    REQUIRE(stack.reserved() >= tcc::VmStack::DefaultReserve);
+    stack[999] = 7;
+
+    auto moved = std::move(stack);
+    REQUIRE(moved[999] == 7);
+    REQUIRE(stack.data() == nullptr);  // NOLINT(bugprone-use-after-move)
+
+    stack = tcc::VmStack {8, 8};
+    REQUIRE(stack.reserved() == stack.size());
+    REQUIRE_FALSE(stack.grow(stack.size() + 1));
+}
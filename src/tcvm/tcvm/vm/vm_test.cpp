@@ -7,6 +7,11 @@
 #include "catch2/catch.hpp"
 #include "tcsl/tcsl.hpp"
 #include "tcvm/examples.hpp"
+#include "tcvm/vm/superinstructions.hpp"
+#include "tcvm/vm/verifier.hpp"
+
+#include <limits>
+#include <thread>
 
 using tcc::ByteCode;
 using tcc::TestCase;
@@ -122,4 +127,916 @@ TEST_CASE("tcvm: MultipleFunctions", "[tcvm]")
     auto vm             = VirtualMachine(assembly.data, assembly.entryPoint, 0, 200, false);
     auto const exitCode = vm.cpu();
     REQUIRE(exitCode == 16);
-}
\ No newline at end of file
+}
+
+TEST_CASE("tcvm: ThreadedEngineMatchesSwitch", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto switchVM   = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                         VirtualMachine::Engine::Switch);
+        auto threadedVM = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                         VirtualMachine::Engine::Threaded);
+        REQUIRE(threadedVM.cpu() == switchVM.cpu());
+    }
+}
+
+TEST_CASE("tcvm: ThreadedEngineGlobalsAndPrint", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 143,  // 0
+        ByteCode::GSTORE, 0,    // 2
+        ByteCode::GLOAD,  0,    // 4
+        ByteCode::PRINT,        // 6
+        ByteCode::ICONST, 0,    // 7
+        ByteCode::BRT,    15,   // 9 never taken
+        ByteCode::ICONST, 1,    // 11
+        ByteCode::BRT,    16,   // 13 skip halt
+        ByteCode::HALT,         // 15
+        ByteCode::GLOAD,  0,    // 16
+        ByteCode::EXIT,         // 18
+    };
+
+    auto stream   = std::stringstream {};
+    auto vm       = VirtualMachine(assembly, 0, 1, 50, false, stream, VirtualMachine::Engine::Threaded);
+    auto exitCode = vm.cpu();
+
+    REQUIRE(exitCode == 143);
+    REQUIRE(stream.str() == "143\n");
+
+    SECTION("reset and run again")
+    {
+        vm.reset(0);
+        exitCode = vm.cpu();
+        REQUIRE(exitCode == 143);
+        REQUIRE(stream.str() == "143\n143\n");
+    }
+}
+
+TEST_CASE("tcvm: ThreadedEngineRunOffEnd", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 2,  //
+        ByteCode::POP,        //
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, VirtualMachine::Engine::Threaded);
+    REQUIRE(vm.cpu() == -1);
+}
+
+TEST_CASE("tcvm: RegisterEngineMatchesSwitch", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createCompiledProgram(),                //
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto switchVM   = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                         VirtualMachine::Engine::Switch);
+        auto registerVM = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                         VirtualMachine::Engine::Register);
+        REQUIRE(registerVM.engine() == VirtualMachine::Engine::Register);
+        REQUIRE(registerVM.cpu() == switchVM.cpu());
+    }
+}
+
+TEST_CASE("tcvm: RegisterEngineGlobalsAndPrint", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 143,  // 0
+        ByteCode::GSTORE, 0,    // 2
+        ByteCode::GLOAD,  0,    // 4
+        ByteCode::PRINT,        // 6
+        ByteCode::GLOAD,  0,    // 7
+        ByteCode::ICONST, 143,  // 9
+        ByteCode::IEQ,          // 11
+        ByteCode::BRT,    15,   // 12 skip halt
+        ByteCode::HALT,         // 14
+        ByteCode::GLOAD,  0,    // 15
+        ByteCode::EXIT,         // 17
+    };
+
+    auto stream   = std::stringstream {};
+    auto vm       = VirtualMachine(assembly, 0, 1, 50, false, stream, VirtualMachine::Engine::Register);
+    auto exitCode = vm.cpu();
+
+    REQUIRE(vm.engine() == VirtualMachine::Engine::Register);
+    REQUIRE(exitCode == 143);
+    REQUIRE(stream.str() == "143\n");
+
+    SECTION("reset and run again")
+    {
+        vm.reset(0);
+        exitCode = vm.cpu();
+        REQUIRE(exitCode == 143);
+        REQUIRE(stream.str() == "143\n143\n");
+    }
+}
+
+TEST_CASE("tcvm: RegisterEngineFallback", "[tcvm]")
+{
+    // depth at the join point differs between both paths
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::GLOAD,  0,  // 0
+        ByteCode::BRT,    8,  // 2
+        ByteCode::ICONST, 7,  // 4
+        ByteCode::ICONST, 8,  // 6
+        ByteCode::ICONST, 9,  // 8
+        ByteCode::EXIT,       // 10
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 1, 50, false, std::cout, VirtualMachine::Engine::Register);
+    REQUIRE(vm.engine() == VirtualMachine::Engine::Switch);
+    REQUIRE(vm.cpu() == 9);
+}
+
+TEST_CASE("tcvm: CompactEngineMatchesSwitch", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createCompiledProgram(),                //
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto switchVM  = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                       VirtualMachine::Engine::Switch);
+        auto compactVM = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                        VirtualMachine::Engine::Compact);
+        REQUIRE(compactVM.engine() == VirtualMachine::Engine::Compact);
+        REQUIRE(compactVM.cpu() == switchVM.cpu());
+        REQUIRE(compactVM.snapshot().registers().instructionPointer
+                == switchVM.snapshot().registers().instructionPointer);
+    }
+}
+
+TEST_CASE("tcvm: CompactEngineWideOperands", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 1LL << 40,  // 0
+        ByteCode::GSTORE, 300,        // 2
+        ByteCode::GLOAD,  300,        // 4
+        ByteCode::PRINT,              // 6
+        ByteCode::ICONST, -70'000,    // 7
+        ByteCode::EXIT,               // 9
+    };
+
+    auto stream = std::stringstream {};
+    auto vm     = VirtualMachine(assembly, 0, 301, 50, false, stream, VirtualMachine::Engine::Compact);
+    REQUIRE(vm.engine() == VirtualMachine::Engine::Compact);
+    REQUIRE(vm.cpu() == -70'000);
+    REQUIRE(stream.str() == "1099511627776\n");
+}
+
+TEST_CASE("tcvm: CompactEngineFallback", "[tcvm]")
+{
+    // branch into the operand of ICONST
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, ByteCode::EXIT,  // 0
+        ByteCode::BR,     1,               // 2
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, VirtualMachine::Engine::Compact);
+    REQUIRE(vm.engine() == VirtualMachine::Engine::Switch);
+    REQUIRE(vm.cpu() == ByteCode::EXIT);
+}
+
+TEST_CASE("tcvm: InvalidInstruction", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 1,  // 0
+        ByteCode::NOOP,       // 2
+        ByteCode::EXIT,       // 3
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, engine);
+    REQUIRE(vm.cpu() == -1);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::InvalidInstruction);
+    REQUIRE(vm.callStack().front() == 2);
+}
+
+TEST_CASE("tcvm: InvalidTarget", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Threaded, VirtualMachine::Engine::Register,
+                                 VirtualMachine::Engine::Jit, VirtualMachine::Engine::TracingJit);
+
+    // branch into the operand of ICONST, engines running decoded code stop
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::BR,     3,                     // 0
+        ByteCode::ICONST, ByteCode::ICONST, 42,  // 2
+        ByteCode::EXIT,                          // 5
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, engine);
+    REQUIRE(vm.engine() == engine);
+    REQUIRE(vm.cpu() == -1);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::InvalidInstruction);
+}
+
+TEST_CASE("tcvm: SuperinstructionsMatchAcrossEngines", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    auto const engines = {
+        VirtualMachine::Engine::Switch,    //
+        VirtualMachine::Engine::Threaded,  //
+        VirtualMachine::Engine::Register,  //
+        VirtualMachine::Engine::Compact,   //
+#if defined(TCC_VM_HAS_JIT)
+        VirtualMachine::Engine::Jit,  //
+#endif
+    };
+
+    for (auto const& program : programs)
+    {
+        auto const fused    = tcc::fuseSuperinstructions(program);
+        auto const expected = VirtualMachine(program.data, program.entryPoint, 0, 200, false).cpu();
+        for (auto const engine : engines)
+        {
+            auto vm = VirtualMachine(fused.data, fused.entryPoint, 0, 200, false, std::cout, engine);
+            REQUIRE(vm.engine() == engine);
+            REQUIRE(vm.cpu() == expected);
+        }
+    }
+}
+
+#if defined(TCC_VM_HAS_JIT)
+
+TEST_CASE("tcvm: JitEngineMatchesSwitch", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createCompiledProgram(),                //
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto switchVM = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                       VirtualMachine::Engine::Switch);
+        auto jitVM    = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                    VirtualMachine::Engine::Jit);
+        REQUIRE(jitVM.engine() == VirtualMachine::Engine::Jit);
+        REQUIRE(jitVM.cpu() == switchVM.cpu());
+    }
+}
+
+TEST_CASE("tcvm: JitEngineGlobalsAndPrint", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 143,  // 0
+        ByteCode::GSTORE, 0,    // 2
+        ByteCode::GLOAD,  0,    // 4
+        ByteCode::PRINT,        // 6
+        ByteCode::ICONST, 0,    // 7
+        ByteCode::BRT,    15,   // 9 never taken
+        ByteCode::ICONST, 1,    // 11
+        ByteCode::BRT,    16,   // 13 skip halt
+        ByteCode::HALT,         // 15
+        ByteCode::GLOAD,  0,    // 16
+        ByteCode::EXIT,         // 18
+    };
+
+    auto stream   = std::stringstream {};
+    auto vm       = VirtualMachine(assembly, 0, 1, 50, false, stream, VirtualMachine::Engine::Jit);
+    auto exitCode = vm.cpu();
+
+    REQUIRE(exitCode == 143);
+    REQUIRE(stream.str() == "143\n");
+
+    SECTION("reset and run again")
+    {
+        vm.reset(0);
+        exitCode = vm.cpu();
+        REQUIRE(exitCode == 143);
+        REQUIRE(stream.str() == "143\n143\n");
+    }
+}
+
+TEST_CASE("tcvm: JitEngineRunOffEnd", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 2,  //
+        ByteCode::POP,        //
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, VirtualMachine::Engine::Jit);
+    REQUIRE(vm.cpu() == -1);
+}
+
+TEST_CASE("tcvm: JitEngineTracingUsesSwitch", "[tcvm]")
+{
+    auto const program = tcvm::createAdditionProgram(10);
+    auto stream        = std::stringstream {};
+    auto vm = VirtualMachine(program.data, program.entryPoint, 0, 200, true, stream, VirtualMachine::Engine::Jit);
+
+    REQUIRE(vm.cpu() == 40);
+    REQUIRE_THAT(stream.str(), Catch::Contains("exit code: 40"));
+}
+
+#endif
+
+TEST_CASE("tcvm: TracingJitEngineMatchesSwitch", "[tcvm]")
+{
+    // for (i = 0; i < 40; ++i) { if (i == 30) print(i); g += 2; } return g;
+    auto const loop = std::vector<int64_t> {
+        ByteCode::ICONST, 0,   // 0 i
+        ByteCode::LOAD,   0,   // 2 <-- header
+        ByteCode::ICONST, 40,  // 4
+        ByteCode::ILT,         // 6
+        ByteCode::BRF,    35,  // 7
+        ByteCode::LOAD,   0,   // 9
+        ByteCode::ICONST, 30,  // 11
+        ByteCode::IEQ,         // 13
+        ByteCode::BRF,    19,  // 14 side exit once the trace is hot
+        ByteCode::LOAD,   0,   // 16
+        ByteCode::PRINT,       // 18
+        ByteCode::GLOAD,  0,   // 19
+        ByteCode::ICONST, 2,   // 21
+        ByteCode::IADD,        // 23
+        ByteCode::GSTORE, 0,   // 24
+        ByteCode::LOAD,   0,   // 26
+        ByteCode::ICONST, 1,   // 28
+        ByteCode::IADD,        // 30
+        ByteCode::STORE,  0,   // 31
+        ByteCode::BR,     2,   // 33
+        ByteCode::GLOAD,  0,   // 35
+        ByteCode::EXIT,        // 37
+    };
+
+    // int sum(n) { acc = 0; while (0 < n) { acc += n; n -= 1; } return acc; }
+    auto const function = std::vector<int64_t> {
+        ByteCode::ICONST, 0,      // 0 acc
+        ByteCode::ICONST, 0,      // 2 <-- header
+        ByteCode::LOAD,   -3,     // 4
+        ByteCode::ILT,            // 6
+        ByteCode::BRF,    25,     // 7
+        ByteCode::LOAD,   1,      // 9
+        ByteCode::LOAD,   -3,     // 11
+        ByteCode::IADD,           // 13
+        ByteCode::STORE,  1,      // 14
+        ByteCode::LOAD,   -3,     // 16
+        ByteCode::ICONST, 1,      // 18
+        ByteCode::ISUB,           // 20
+        ByteCode::STORE,  -3,     // 21
+        ByteCode::BR,     2,      // 23
+        ByteCode::LOAD,   1,      // 25
+        ByteCode::RET,            // 27
+        ByteCode::ICONST, 100,    // 28 <-- main
+        ByteCode::CALL,   0, 1,   // 30
+        ByteCode::ICONST, 50,     // 33
+        ByteCode::CALL,   0, 1,   // 35
+        ByteCode::IADD,           // 38
+        ByteCode::EXIT,           // 39
+    };
+
+    auto const loopProgram = tcc::BinaryProgram {1, "loop", 0, loop};
+    auto const programs    = {
+        loopProgram,                                       //
+        tcc::fuseSuperinstructions(loopProgram),           //
+        tcc::BinaryProgram {1, "function", 28, function},  //
+        tcvm::createFactorialProgram(7),                   //
+        tcvm::createFibonacciProgram(12),                  //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto switchOut = std::stringstream {};
+        auto traceOut  = std::stringstream {};
+        auto switchVM  = VirtualMachine(program.data, program.entryPoint, 1, 200, false, switchOut,
+                                       VirtualMachine::Engine::Switch);
+        auto traceVM   = VirtualMachine(program.data, program.entryPoint, 1, 200, false, traceOut,
+                                      VirtualMachine::Engine::TracingJit);
+        REQUIRE(traceVM.engine() == VirtualMachine::Engine::TracingJit);
+        REQUIRE(traceVM.cpu() == switchVM.cpu());
+        REQUIRE(traceOut.str() == switchOut.str());
+    }
+}
+
+#if defined(TCC_VM_HAS_JIT)
+
+TEST_CASE("tcvm: TracingJitEngineCompilesHotLoops", "[tcvm]")
+{
+    // for (i = 0; i < 1000; ++i) { } return i;
+    auto const assembly = std::vector<int64_t> {
+        ByteCode::ICONST, 0,     // 0 i
+        ByteCode::LOAD,   0,     // 2 <-- header
+        ByteCode::ICONST, 1000,  // 4
+        ByteCode::ILT,           // 6
+        ByteCode::BRF,    19,    // 7
+        ByteCode::LOAD,   0,     // 9
+        ByteCode::ICONST, 1,     // 11
+        ByteCode::IADD,          // 13
+        ByteCode::STORE,  0,     // 14
+        ByteCode::BR,     2,     // 16
+        ByteCode::HALT,          // 18
+        ByteCode::LOAD,   0,     // 19
+        ByteCode::EXIT,          // 21
+    };
+
+    auto vm = VirtualMachine(assembly, 0, 0, 50, false, std::cout, VirtualMachine::Engine::TracingJit);
+    REQUIRE(vm.compiledTraces() == 0);
+    REQUIRE(vm.cpu() == 1000);
+    REQUIRE(vm.compiledTraces() == 1);
+
+    vm.reset(0);
+    REQUIRE(vm.cpu() == 1000);
+    REQUIRE(vm.compiledTraces() == 1);
+}
+
+#endif
+
+TEST_CASE("tcvm: PoliciesMatchRelease", "[tcvm]")
+{
+    auto const programs = {
+        tcvm::createAdditionProgram(10),              //
+        tcvm::createFactorialProgram(7),              //
+        tcvm::createFibonacciProgram(12),             //
+        tcvm::createMultipleArgumentsProgram(10, 2),  //
+        tcvm::createMultipleFunctionsProgram(2),      //
+    };
+
+    for (auto const& program : programs)
+    {
+        auto release = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+        auto checked = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+        checked.enableBoundsChecking(true);
+        checked.enableStatistics(true);
+        REQUIRE(checked.cpu() == release.cpu());
+        REQUIRE(checked.stats().instructions > 0);
+        REQUIRE(release.stats().instructions == 0);
+    }
+}
+
+TEST_CASE("tcvm: StatisticsPolicy", "[tcvm]")
+{
+    auto const program = tcvm::createFactorialProgram(3);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+    vm.enableStatistics(true);
+    REQUIRE(vm.cpu() == 6);
+
+    auto const stats = vm.stats();
+    CHECK(stats.calls == 3);
+    CHECK(stats.maxStackDepth > 3 * 3);
+
+    vm.reset(program.entryPoint);
+    REQUIRE(vm.stats().instructions == 0);
+    REQUIRE(vm.cpu() == 6);
+    REQUIRE(vm.stats().instructions == stats.instructions);
+}
+
+TEST_CASE("tcvm: TailCalls", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    auto const calls = tcvm::createEvenOddProgram(21, false);
+    auto callsVm     = VirtualMachine(calls.data, calls.entryPoint, 0, 200, false, std::cout, engine);
+    REQUIRE(callsVm.cpu() == 0);
+
+    // every call adds 4 slots, the tail calls stay in the frame of the first call
+    auto const tail = tcvm::createEvenOddProgram(10'000, true);
+    auto tailVm     = VirtualMachine(tail.data, tail.entryPoint, 0, 8, false, std::cout, engine);
+    REQUIRE(tailVm.cpu() == 1);
+    tailVm.reset(tail.entryPoint);
+    REQUIRE(tailVm.cpu() == 1);
+
+    SECTION("memoization skips tail calls")
+    {
+        tailVm.enableMemoization();
+        tailVm.reset(tail.entryPoint);
+        REQUIRE(tailVm.cpu() == 1);
+        REQUIRE(tailVm.memoStats().misses == 0);
+    }
+}
+
+TEST_CASE("tcvm: TailCallStatistics", "[tcvm]")
+{
+    auto const calls = tcvm::createEvenOddProgram(21, false);
+    auto callsVm     = VirtualMachine(calls.data, calls.entryPoint, 0, 200, false);
+    callsVm.enableStatistics(true);
+    REQUIRE(callsVm.cpu() == 0);
+
+    auto const tail = tcvm::createEvenOddProgram(21, true);
+    auto tailVm     = VirtualMachine(tail.data, tail.entryPoint, 0, 200, false);
+    tailVm.enableStatistics(true);
+    tailVm.enableBoundsChecking(true);
+    REQUIRE(tailVm.cpu() == 0);
+
+    CHECK(tailVm.stats().calls == callsVm.stats().calls);
+    CHECK(tailVm.stats().instructions == callsVm.stats().instructions - 21);  // one RET per tail call
+    CHECK(callsVm.stats().maxStackDepth > 21 * 4);
+    CHECK(tailVm.stats().maxStackDepth == 6);
+}
+
+TEST_CASE("tcvm: StackGrowsAtCalls", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    // 4 slots per call, far beyond the initial size
+    auto const program = tcvm::createEvenOddProgram(50'001, false);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 8, false, std::cout, engine);
+    REQUIRE(vm.maxStackSize() >= tcc::VmStack::DefaultReserve);
+    REQUIRE(vm.cpu() == 0);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::Finished);
+
+    vm.reset(program.entryPoint);
+    REQUIRE(vm.cpu() == 0);
+}
+
+TEST_CASE("tcvm: StackOverflow", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    auto const program = tcvm::createEvenOddProgram(50'000, false);
+    auto vm            = VirtualMachine(program.data, program.entryPoint, 0, 8, false, std::cout, engine);
+    vm.setMaxStackSize(10'000);
+    REQUIRE(vm.maxStackSize() >= 10'000);
+    REQUIRE(vm.maxStackSize() < 20'000);
+    REQUIRE(vm.cpu() == -1);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::StackOverflow);
+
+    // stopped before the CALL, continues once the stack may grow further
+    vm.setMaxStackSize(tcc::VmStack::DefaultReserve);
+    REQUIRE(vm.cpu() == 1);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::Finished);
+
+    SECTION("budgeted")
+    {
+        vm.setMaxStackSize(10'000);
+        vm.reset(program.entryPoint);
+        auto const result = vm.run(1'000'000);
+        REQUIRE(result.status == VirtualMachine::RunStatus::StackOverflow);
+        REQUIRE(vm.run(1'000'000).status == VirtualMachine::RunStatus::StackOverflow);
+    }
+
+    SECTION("metered")
+    {
+        vm.setMaxStackSize(10'000);
+        vm.reset(program.entryPoint);
+        vm.enableMetering(10'000'000);
+        REQUIRE(vm.cpu() == -1);
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::StackOverflow);
+    }
+}
+
+TEST_CASE("tcvm: DeepFrames", "[tcvm]")
+{
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    // countdown(n) { return n ? countdown(n - 1) : 0; } called from a frame
+    // far deeper than VmStack::CallHeadroom
+    auto code = std::vector<int64_t> {
+        ByteCode::LOAD,   -3,    //
+        ByteCode::BRF,    13,    //
+        ByteCode::LOAD,   -3,    //
+        ByteCode::ICONST, 1,     //
+        ByteCode::ISUB,          //
+        ByteCode::CALL,   0, 1,  //
+        ByteCode::RET,           //
+        ByteCode::ICONST, 0,     //
+        ByteCode::RET,           //
+    };
+    auto const entryPoint = static_cast<int64_t>(code.size());
+    for (auto i = 0; i < 1'000; ++i) { code.insert(code.end(), {ByteCode::ICONST, 1}); }
+    code.insert(code.end(), 1'000, ByteCode::POP);
+    code.insert(code.end(), {ByteCode::ICONST, 3, ByteCode::CALL, 0, 1, ByteCode::EXIT});
+    auto const verified = tcc::verify(code, entryPoint);
+    REQUIRE(verified.ok());
+    REQUIRE(verified.callHeadroom > static_cast<int64_t>(tcc::VmStack::CallHeadroom));
+
+    auto vm = VirtualMachine(code, entryPoint, 0, 8, false, std::cout, engine);
+    vm.setCallHeadroom(static_cast<uint64_t>(verified.callHeadroom));
+    REQUIRE(vm.cpu() == 0);
+    REQUIRE(vm.status() == VirtualMachine::RunStatus::Finished);
+
+    vm.reset(entryPoint);
+    REQUIRE(vm.run(1'000'000).exitCode == 0);
+
+    // checks grow the stack without the headroom
+    auto checked = VirtualMachine(code, entryPoint, 0, 8, false, std::cout, engine);
+    checked.enableBoundsChecking(true);
+    REQUIRE(checked.cpu() == 0);
+    REQUIRE(checked.status() == VirtualMachine::RunStatus::Finished);
+}
+
+TEST_CASE("tcvm: BoundsCheckingPolicy", "[tcvm]")
+{
+    auto const run = [](std::vector<int64_t> const& assembly, uint64_t dataSize, uint64_t stackSize) {
+        auto stream = std::stringstream {};
+        auto vm     = VirtualMachine(assembly, 0, dataSize, stackSize, false, stream);
+        vm.enableBoundsChecking(true);
+        REQUIRE(vm.cpu() == -1);
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::BoundsCheckFailed);
+        return stream.str();
+    };
+
+    SECTION("stack underflow")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::ICONST, 1, ByteCode::IADD, ByteCode::EXIT};
+        REQUIRE_THAT(run(assembly, 0, 8), Catch::Contains("error: stack out of range at: 2"));
+    }
+
+    SECTION("stack overflow")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::ICONST, 1, ByteCode::BR, 0};
+        REQUIRE_THAT(run(assembly, 0, 8), Catch::Contains("error: stack out of range at: 0"));
+    }
+
+    SECTION("globals")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::GLOAD, 4, ByteCode::EXIT};
+        REQUIRE_THAT(run(assembly, 2, 8), Catch::Contains("error: global address out of range"));
+    }
+
+    SECTION("locals")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::ICONST, 1, ByteCode::LOAD, 3, ByteCode::EXIT};
+        REQUIRE_THAT(run(assembly, 0, 8), Catch::Contains("error: local out of range"));
+    }
+
+    SECTION("branch target")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::BR, 100};
+        REQUIRE_THAT(run(assembly, 0, 8), Catch::Contains("error: branch target out of range"));
+    }
+
+    SECTION("unknown opcode and missing operand")
+    {
+        REQUIRE_THAT(run({ByteCode::NUM_OPCODES}, 0, 8), Catch::Contains("error: unknown instruction"));
+        REQUIRE_THAT(run({ByteCode::CALL}, 0, 8), Catch::Contains("error: missing operand"));
+    }
+
+    SECTION("return without frame")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::ICONST, 1, ByteCode::RET};
+        REQUIRE_THAT(run(assembly, 0, 8), Catch::Contains("error: frame out of range"));
+    }
+}
+
+TEST_CASE("tcvm: RunWithBudget", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(10);
+
+    SECTION("single steps")
+    {
+        auto counted = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+        counted.enableStatistics(true);
+        REQUIRE(counted.cpu() == 55);
+
+        auto vm     = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+        auto slices = int64_t {0};
+        auto result = vm.run(1);
+        for (; result.status == VirtualMachine::RunStatus::OutOfBudget; result = vm.run(1)) { ++slices; }
+        REQUIRE(result.status == VirtualMachine::RunStatus::Finished);
+        REQUIRE(result.exitCode == 55);
+        REQUIRE(slices == counted.stats().instructions - 1);
+
+        // finished programs stay finished until reset
+        REQUIRE(vm.run(1).exitCode == 55);
+        vm.reset(program.entryPoint);
+        REQUIRE(vm.run(0).status == VirtualMachine::RunStatus::OutOfBudget);
+        REQUIRE(vm.cpu() == 55);
+    }
+
+    SECTION("round robin")
+    {
+        auto const programs = {
+            tcvm::createFactorialProgram(7),
+            tcvm::createFibonacciProgram(12),
+            tcvm::createMultipleFunctionsProgram(2),
+        };
+
+        auto vms      = std::vector<std::unique_ptr<VirtualMachine>> {};
+        auto expected = std::vector<int64_t> {};
+        for (auto const& p : programs)
+        {
+            expected.push_back(VirtualMachine(p.data, p.entryPoint, 0, 200, false).cpu());
+            vms.push_back(std::make_unique<VirtualMachine>(p.data, p.entryPoint, 0, 200, false));
+        }
+
+        auto results = std::vector<std::optional<int64_t>>(vms.size());
+        while (std::any_of(begin(results), end(results), [](auto const& r) { return !r.has_value(); }))
+        {
+            for (auto i = std::size_t {0}; i < vms.size(); ++i)
+            {
+                auto const result = vms[i]->run(16);
+                if (result.status == VirtualMachine::RunStatus::Finished) { results[i] = result.exitCode; }
+            }
+        }
+
+        for (auto i = std::size_t {0}; i < vms.size(); ++i) { REQUIRE(results[i] == expected[i]); }
+    }
+}
+
+TEST_CASE("tcvm: RunSuspend", "[tcvm]")
+{
+    SECTION("from an output sink")
+    {
+        auto const assembly = std::vector<int64_t> {
+            ByteCode::ICONST, 1,  //
+            ByteCode::PRINT,      //
+            ByteCode::ICONST, 2,  //
+            ByteCode::PRINT,      //
+            ByteCode::ICONST, 3,  //
+            ByteCode::EXIT,       //
+        };
+
+        // suspends the machine on every PRINT
+        auto vm     = VirtualMachine(assembly, 0, 0, 200, false);
+        auto values = std::vector<int64_t> {};
+        auto sink   = tcc::CallbackSink {[&](std::span<int64_t const> batch) {
+                                           values.insert(values.end(), batch.begin(), batch.end());
+                                           vm.suspend();
+                                       },
+                                       1};
+        vm.setOutput(&sink);
+
+        auto const first = vm.run(100);
+        REQUIRE(first.status == VirtualMachine::RunStatus::Suspended);
+        REQUIRE(first.instructions == 2);
+        REQUIRE(values == std::vector<int64_t> {1});
+        REQUIRE(vm.run(100).status == VirtualMachine::RunStatus::Suspended);
+        REQUIRE(values == std::vector<int64_t> {1, 2});
+        REQUIRE(vm.run(100).exitCode == 3);
+
+        // a suspend requested while stopped ends the next run() right away
+        vm.reset(0);
+        vm.suspend();
+        auto const idle = vm.run(100);
+        REQUIRE(idle.status == VirtualMachine::RunStatus::Suspended);
+        REQUIRE(idle.instructions == 0);
+    }
+
+    SECTION("from another thread")
+    {
+        auto const assembly = std::vector<int64_t> {ByteCode::BR, 0};
+        auto vm             = VirtualMachine(assembly, 0, 0, 200, false);
+        auto stopper        = std::thread {[&vm] { vm.suspend(); }};
+        auto const result   = vm.run(std::numeric_limits<int64_t>::max());
+        stopper.join();
+        REQUIRE(result.status == VirtualMachine::RunStatus::Suspended);
+    }
+}
+
+TEST_CASE("tcvm: GasMetering", "[tcvm]")
+{
+    auto const program = tcvm::createFibonacciProgram(10);
+
+    auto counted = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+    counted.enableStatistics(true);
+    counted.enableMetering(1'000'000);
+    REQUIRE(counted.cpu() == 55);
+    REQUIRE(counted.status() == VirtualMachine::RunStatus::Finished);
+
+    // every charged block ran to its end
+    auto const instructions = counted.stats().instructions;
+    REQUIRE(1'000'000 - counted.gas() == instructions);
+
+    auto const engine = GENERATE(VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded,
+                                 VirtualMachine::Engine::Register, VirtualMachine::Engine::Jit,
+                                 VirtualMachine::Engine::TracingJit, VirtualMachine::Engine::Compact);
+
+    SECTION("exact limit")
+    {
+        auto vm = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout, engine);
+        vm.enableMetering(instructions);
+        REQUIRE(vm.cpu() == 55);
+        REQUIRE(vm.gas() == 0);
+
+        vm.reset(program.entryPoint);
+        REQUIRE(vm.gas() == instructions);
+        REQUIRE(vm.cpu() == 55);
+    }
+
+    SECTION("out of gas & refill")
+    {
+        auto vm = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout, engine);
+        vm.enableMetering(instructions - 1);
+        REQUIRE(vm.cpu() == -1);
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::OutOfGas);
+        auto const used = instructions - 1 - vm.gas();
+
+        // continues at the block that did not fit
+        vm.enableMetering(instructions - used);
+        REQUIRE(vm.cpu() == 55);
+        REQUIRE(vm.gas() == 0);
+    }
+
+    SECTION("fused program")
+    {
+        auto const fused = tcc::fuseSuperinstructions(program);
+        REQUIRE(fused.data.size() < program.data.size());
+
+        auto vm = VirtualMachine(fused.data, fused.entryPoint, 0, 200, false, std::cout, engine);
+        vm.enableMetering(instructions);
+        REQUIRE(vm.cpu() == 55);
+        REQUIRE(vm.gas() == 0);
+    }
+}
+
+TEST_CASE("tcvm: GasMeteringRunAndSwitch", "[tcvm]")
+{
+    auto const program = tcvm::createFactorialProgram(5);
+
+    auto threaded = VirtualMachine(program.data, program.entryPoint, 0, 200, false, std::cout,
+                                   VirtualMachine::Engine::Threaded);
+    threaded.enableMetering(1'000);
+    REQUIRE(threaded.cpu() == 120);
+
+    // single steps don't pay for a block twice
+    auto sliced = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+    sliced.enableMetering(1'000);
+    auto result = sliced.run(1);
+    while (result.status == VirtualMachine::RunStatus::OutOfBudget) { result = sliced.run(1); }
+    REQUIRE(result.exitCode == 120);
+    REQUIRE(sliced.gas() == threaded.gas());
+
+    // stops with the same state as the threaded engine
+    auto limited = VirtualMachine(program.data, program.entryPoint, 0, 200, false);
+    limited.enableBoundsChecking(true);
+    limited.enableMetering(20);
+    REQUIRE(limited.run(1'000).status == VirtualMachine::RunStatus::OutOfGas);
+
+    threaded.reset(program.entryPoint);
+    threaded.enableMetering(20);
+    REQUIRE(threaded.cpu() == -1);
+    REQUIRE(threaded.gas() == limited.gas());
+}
+
+TEST_CASE("tcvm: GasMeteringCancellation", "[tcvm]")
+{
+    auto const assembly = std::vector<int64_t> {ByteCode::BR, 0};
+    auto cancelled      = std::atomic<bool> {false};
+
+    SECTION("from another thread")
+    {
+        auto vm = VirtualMachine(assembly, 0, 0, 200, false, std::cout, VirtualMachine::Engine::Threaded);
+        vm.enableMetering(std::numeric_limits<int64_t>::max(), &cancelled);
+        auto canceller = std::thread {[&cancelled] { cancelled = true; }};
+        REQUIRE(vm.cpu() == -1);
+        canceller.join();
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::Cancelled);
+    }
+
+    SECTION("shared flag")
+    {
+        cancelled = true;
+        for (auto const engine : {VirtualMachine::Engine::Switch, VirtualMachine::Engine::Threaded})
+        {
+            auto vm = VirtualMachine(assembly, 0, 0, 200, false, std::cout, engine);
+            vm.enableMetering(100, &cancelled);
+            vm.enableStatistics(engine == VirtualMachine::Engine::Switch);
+            REQUIRE(vm.cpu() == -1);
+            REQUIRE(vm.status() == VirtualMachine::RunStatus::Cancelled);
+            REQUIRE(vm.gas() == 100);
+        }
+    }
+
+    SECTION("without flag the gas runs out")
+    {
+        auto vm = VirtualMachine(assembly, 0, 0, 200, false, std::cout, VirtualMachine::Engine::Threaded);
+        vm.enableMetering(100);
+        REQUIRE(vm.cpu() == -1);
+        REQUIRE(vm.status() == VirtualMachine::RunStatus::OutOfGas);
+        REQUIRE(vm.gas() == 0);
+    }
+}
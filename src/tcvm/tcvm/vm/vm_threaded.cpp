@@ -0,0 +1,473 @@
+/**
+ * @file vm_threaded.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm.hpp"
+#include "tcsl/tcsl.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TCC_VM_HAS_COMPUTED_GOTO 1
+#endif
+
+namespace tcc
+{
+#if defined(TCC_VM_HAS_COMPUTED_GOTO)
+
+namespace
+{
+// instructions between two reads of the cancellation flag, plus one block
+constexpr auto CancellationInterval = int64_t {4096};
+}  // namespace
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+#pragma clang diagnostic ignored "-Wunused-label"
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma GCC diagnostic ignored "-Wunused-label"  // metering exits, only reached with Metered
+#endif
+
+/**
+ * @brief Same semantics as executeSwitch(), but runs on the pre-decoded
+ * instruction stream. Every handler jumps directly to the handler of the next
+ * instruction, so each one gets its own indirect branch, which the branch
+ * predictor can track separately. Registers are kept in locals and only written
+ * back to the members when leaving the loop.
+ *
+ * Metered: gas is only touched where control enters a basic block, the
+ * straight-line handlers are the same as without metering. Blocks are paid
+ * from a window of at most CancellationInterval gas, the cancellation flag is
+ * only read when the window is refilled, so a charge is a single compare.
+ *
+ * Memoized: calls of pure functions look up their result first. A miss
+ * remembers the frame & the result is stored when that frame returns.
+ */
+template <bool Metered, bool Memoized>
+auto VirtualMachine::executeThreaded() -> int64_t
+{
+    static void* const dispatchTable[] = {
+        &&opInvalid,     // NOOP
+        &&opIAdd,        //
+        &&opISub,        //
+        &&opIMul,        //
+        &&opILt,         //
+        &&opIEq,         //
+        &&opBr,          //
+        &&opBrt,         //
+        &&opBrf,         //
+        &&opIConst,      //
+        &&opLoad,        //
+        &&opGLoad,       //
+        &&opStore,       //
+        &&opGStore,      //
+        &&opPrint,       //
+        &&opPop,         //
+        &&opCall,        //
+        &&opRet,         //
+        &&opExit,        //
+        &&opHalt,        //
+        &&opCall,        // SPAWN
+        &&opJoin,        //
+        &&opTailCall,    //
+        &&opCallNative,  //
+
+        &&opLoadIConstIAdd,  //
+        &&opLoadIConstISub,  //
+        &&opLoadIConstILt,   //
+        &&opLoadLoadIAdd,    //
+        &&opILtBrf,          //
+    };
+    static_assert(sizeof(dispatchTable) / sizeof(dispatchTable[0]) == ByteCode::NUM_OPCODES);
+
+    if (m_resolvedTable_ != dispatchTable)
+    {
+        for (auto& instruction : m_decoded_.instructions) { instruction.handler = dispatchTable[instruction.opcode]; }
+        m_resolvedTable_ = dispatchTable;
+    }
+
+    auto const* const program = m_decoded_.instructions.data();
+    auto* const stack         = m_stack_.data();
+    auto* const data          = m_data_.data();
+    auto const* const natives = m_natives_.data();
+    auto stackLimit           = m_stack_.callLimit(m_callHeadroom_);
+
+    auto sp = m_stackPointer_;
+    auto fp = m_framePointer_;
+    auto ip = int64_t {};
+
+    auto const* pc = program + m_decoded_.indexAt(m_instructionPointer_);
+    auto result    = int64_t {-1};
+
+    auto window           = int64_t {0};  // the blocks are paid from here, refilled from gas
+    auto gas              = m_gas_;
+    auto const* cancelled = m_cancelled_;
+
+    auto const* const pure = m_pureArguments_.data();
+    m_memoFrames_.clear();  // results of calls pending from an earlier run are not stored
+
+#define TCC_VM_DISPATCH() goto*(pc->handler)
+#define TCC_VM_NEXT()                                                                                                  \
+    {                                                                                                                  \
+        ++pc;                                                                                                          \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+// pays for the block at pc, called after every transfer of control
+#define TCC_VM_CHARGE()                                                                                                \
+    if constexpr (Metered)                                                                                             \
+    {                                                                                                                  \
+        window -= pc->cost;                                                                                            \
+        if (window < 0) { goto refill; }                                                                               \
+    }
+
+// entering the next block by falling through a conditional branch
+#define TCC_VM_NEXT_BLOCK()                                                                                            \
+    {                                                                                                                  \
+        ++pc;                                                                                                          \
+        TCC_VM_CHARGE();                                                                                               \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+#define TCC_VM_JUMP(target)                                                                                            \
+    {                                                                                                                  \
+        pc = program + (target);                                                                                       \
+        TCC_VM_CHARGE();                                                                                               \
+        TCC_VM_DISPATCH();                                                                                             \
+    }
+
+    if constexpr (Metered)
+    {
+        if (cancelled->load(std::memory_order_relaxed)) { goto cancel; }
+        if (!m_gasCharged_) { TCC_VM_CHARGE(); }
+    }
+    TCC_VM_DISPATCH();
+
+opIAdd:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a + b;
+    TCC_VM_NEXT();
+}
+
+opISub:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a - b;
+    TCC_VM_NEXT();
+}
+
+opIMul:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a * b;
+    TCC_VM_NEXT();
+}
+
+opILt:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a < b ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opIEq:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp];
+    stack[sp]    = a == b ? 1 : 0;
+    TCC_VM_NEXT();
+}
+
+opBr:
+{
+    TCC_VM_JUMP(pc->operand);
+}
+
+opBrt:
+{
+    if (stack[sp--] != 0) { TCC_VM_JUMP(pc->operand); }
+    TCC_VM_NEXT_BLOCK();
+}
+
+opBrf:
+{
+    if (stack[sp--] == 0) { TCC_VM_JUMP(pc->operand); }
+    TCC_VM_NEXT_BLOCK();
+}
+
+opIConst:
+{
+    stack[++sp] = pc->operand;
+    TCC_VM_NEXT();
+}
+
+opLoad:
+{
+    stack[sp + 1] = stack[fp + pc->operand];
+    ++sp;
+    TCC_VM_NEXT();
+}
+
+opGLoad:
+{
+    stack[++sp] = data[pc->operand];
+    TCC_VM_NEXT();
+}
+
+opStore:
+{
+    stack[fp + pc->operand] = stack[sp--];
+    TCC_VM_NEXT();
+}
+
+opGStore:
+{
+    data[pc->operand] = stack[sp--];
+    TCC_VM_NEXT();
+}
+
+opPrint:
+{
+    m_output_->print(stack[sp--]);
+    TCC_VM_NEXT();
+}
+
+opPop:
+{
+    --sp;
+    TCC_VM_NEXT();
+}
+
+opCall:
+{
+    if (sp > stackLimit)
+    {
+        if (!reserveFrame(sp)) { goto overflow; }
+        stackLimit = m_stack_.callLimit(m_callHeadroom_);
+    }
+
+    if constexpr (Memoized)
+    {
+        auto const reads = pure[pc->operand];
+        if (reads >= 0 && reads <= pc->argument)
+        {
+            auto const arguments = std::span<int64_t const> {stack + sp + 1 - reads, static_cast<std::size_t>(reads)};
+            auto const key       = MemoTable::makeKey(pc->operand, arguments);
+            auto& entry          = m_memoTable_.slot(key);
+            if (entry.key == key)
+            {
+                ++m_memoStats_.hits;
+                sp -= pc->argument;
+                stack[++sp] = entry.value;
+                TCC_VM_NEXT_BLOCK();
+            }
+
+            ++m_memoStats_.misses;
+            m_memoFrames_.push_back(MemoFrame {sp + 3, &entry, key});
+        }
+    }
+
+    stack[++sp] = pc->argument;       // save num args
+    stack[++sp] = fp;                 // save frame pointer
+    stack[++sp] = (pc + 1)->address;  // save raw return address
+    fp          = sp;
+    pc          = program + pc->operand;
+    TCC_VM_CHARGE();
+    TCC_VM_DISPATCH();
+}
+
+opRet:
+{
+    auto const returnVal = stack[sp];
+    if constexpr (Memoized)
+    {
+        if (!m_memoFrames_.empty() && m_memoFrames_.back().framePointer == fp)
+        {
+            *m_memoFrames_.back().entry = MemoTable::Entry {m_memoFrames_.back().key, returnVal};
+            m_memoFrames_.pop_back();
+        }
+    }
+    sp                   = fp;
+    auto const retAddr   = stack[sp--];
+    fp                   = stack[sp--];
+    auto const numArgs   = stack[sp--];
+    sp -= numArgs;
+    stack[++sp] = returnVal;
+    pc          = program + m_decoded_.indexAt(retAddr);
+    TCC_VM_CHARGE();
+    TCC_VM_DISPATCH();
+}
+
+opJoin:
+{
+    TCC_VM_NEXT();
+}
+
+// not memoized, pure functions never contain a TAILCALL
+opTailCall:
+{
+    auto const numArgs = pc->argument;
+    auto const retAddr = stack[fp];
+    auto const savedFp = stack[fp - 1];
+    auto const first   = fp - 2 - stack[fp - 2];  // first current argument
+    for (auto i = int64_t {0}; i < numArgs; ++i) { stack[first + i] = stack[sp - numArgs + 1 + i]; }
+    sp          = first + numArgs - 1;
+    stack[++sp] = numArgs;  // save num args
+    stack[++sp] = savedFp;  // keep frame pointer of the caller
+    stack[++sp] = retAddr;  // keep return address of the caller
+    fp          = sp;
+    pc          = program + pc->operand;
+    TCC_VM_CHARGE();
+    TCC_VM_DISPATCH();
+}
+
+opCallNative:
+{
+    auto const first = sp - pc->argument + 1;
+    stack[first]     = natives[pc->operand](stack + first);
+    sp               = first;
+    TCC_VM_NEXT();
+}
+
+opLoadIConstIAdd:
+{
+    stack[sp + 1] = stack[fp + pc->operand] + pc->argument;
+    ++sp;
+    TCC_VM_NEXT();
+}
+
+opLoadIConstISub:
+{
+    stack[sp + 1] = stack[fp + pc->operand] - pc->argument;
+    ++sp;
+    TCC_VM_NEXT();
+}
+
+opLoadIConstILt:
+{
+    stack[sp + 1] = stack[fp + pc->operand] < pc->argument ? 1 : 0;
+    ++sp;
+    TCC_VM_NEXT();
+}
+
+opLoadLoadIAdd:
+{
+    stack[sp + 1] = stack[fp + pc->operand] + stack[fp + pc->argument];
+    ++sp;
+    TCC_VM_NEXT();
+}
+
+opILtBrf:
+{
+    auto const b = stack[sp--];
+    auto const a = stack[sp--];
+    if (!(a < b)) { TCC_VM_JUMP(pc->operand); }
+    TCC_VM_NEXT_BLOCK();
+}
+
+opExit:
+{
+    result = stack[sp];
+    ip     = pc->address + 1;
+    goto leave;
+}
+
+opHalt:
+{
+    result = -1;
+    ip     = pc->address + 1;
+    goto leave;
+}
+
+// stops at the instruction, result stays -1
+opInvalid:
+{
+    m_runStatus_ = RunStatus::InvalidInstruction;
+    goto stop;
+}
+
+// the block at pc did not fit into the window, it still owes -window
+refill:
+{
+    if (cancelled->load(std::memory_order_relaxed))
+    {
+        window += pc->cost;
+        m_gasCharged_ = false;
+        goto cancel;
+    }
+
+    auto const amount = std::min(gas, CancellationInterval - window);
+    window += amount;
+    gas -= amount;
+    if (window < 0)
+    {
+        window += pc->cost;
+        m_gasCharged_ = false;
+        m_runStatus_  = RunStatus::OutOfGas;
+        goto stop;
+    }
+    TCC_VM_DISPATCH();
+}
+
+cancel:
+{
+    m_runStatus_ = RunStatus::Cancelled;
+    goto stop;
+}
+
+// the block of the CALL is paid for
+overflow:
+{
+    if constexpr (Metered) { m_gasCharged_ = true; }
+    goto stop;
+}
+
+// before the instruction at pc
+stop:
+    m_interrupted_ = true;
+    ip             = pc->address;
+
+#undef TCC_VM_JUMP
+#undef TCC_VM_NEXT_BLOCK
+#undef TCC_VM_CHARGE
+#undef TCC_VM_NEXT
+#undef TCC_VM_DISPATCH
+
+leave:
+    m_stackPointer_       = sp;
+    m_instructionPointer_ = ip;
+    m_framePointer_       = fp;
+    if constexpr (Metered) { m_gas_ = gas + window; }
+    return result;
+}
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#else
+#pragma GCC diagnostic pop
+#endif
+
+#else
+
+// memoization only saves time, the switch interpreter runs every call
+template <bool Metered, bool Memoized>
+auto VirtualMachine::executeThreaded() -> int64_t
+{
+    return executeSwitch<ExecutionPolicy<false, false, false, false, Metered>>();
+}
+
+#endif
+
+template auto VirtualMachine::executeThreaded<false, false>() -> int64_t;
+template auto VirtualMachine::executeThreaded<false, true>() -> int64_t;
+template auto VirtualMachine::executeThreaded<true, false>() -> int64_t;
+template auto VirtualMachine::executeThreaded<true, true>() -> int64_t;
+
+}  // namespace tcc
@@ -0,0 +1,280 @@
+/**
+ * @file vm_tracing_jit.cpp
+ * @copyright Copyright 2019-2020 Tobias Hienzsch. MIT license.
+ */
+
+#include "tcvm/vm/vm.hpp"
+#include "tcsl/tcsl.hpp"
+
+namespace tcc
+{
+namespace
+{
+constexpr auto HotLoopThreshold = int64_t {16};  // backward branches before a loop gets recorded
+constexpr auto MaxTraceAttempts = int64_t {3};   // aborted recordings before a loop stays interpreted
+
+constexpr auto isBranch(int64_t const opcode) noexcept -> bool
+{
+    return opcode != ByteCode::CALL && opcode != ByteCode::SPAWN && opcode != ByteCode::TAILCALL
+           && targetOperandIndex(opcode) >= 0;
+}
+}  // namespace
+
+/**
+ * @brief Interprets the pre-decoded stream and counts how often each backward
+ * branch is taken. Once a loop header gets hot, the next iteration is recorded,
+ * optimized & compiled. Afterwards reaching the header runs the native trace
+ * until one of its guards fails, the trace leaves the stack, frame and
+ * instruction pointer exactly as the interpreter would have.
+ */
+auto VirtualMachine::executeTracingJit() -> int64_t
+{
+    auto const& program = m_decoded_.instructions;
+    auto* const stack   = m_stack_.data();
+    auto* const data    = m_data_.data();
+    auto* const natives = m_natives_.data();
+
+    auto sp    = m_stackPointer_;
+    auto fp    = m_framePointer_;
+    auto index = m_decoded_.indexAt(m_instructionPointer_);
+
+    auto leave = [&](int64_t const ip, int64_t const result) {
+        m_stackPointer_       = sp;
+        m_instructionPointer_ = ip;
+        m_framePointer_       = fp;
+        return result;
+    };
+
+    while (true)
+    {
+        auto const& inst = program[static_cast<std::size_t>(index)];
+        auto next        = index + 1;
+
+        switch (inst.opcode)
+        {
+            case ByteCode::IADD:
+            {
+                auto const b = stack[sp--];
+                stack[sp] += b;
+                break;
+            }
+
+            case ByteCode::ISUB:
+            {
+                auto const b = stack[sp--];
+                stack[sp] -= b;
+                break;
+            }
+
+            case ByteCode::IMUL:
+            {
+                auto const b = stack[sp--];
+                stack[sp] *= b;
+                break;
+            }
+
+            case ByteCode::ILT:
+            {
+                auto const b = stack[sp--];
+                stack[sp]    = stack[sp] < b ? 1 : 0;
+                break;
+            }
+
+            case ByteCode::IEQ:
+            {
+                auto const b = stack[sp--];
+                stack[sp]    = stack[sp] == b ? 1 : 0;
+                break;
+            }
+
+            case ByteCode::BR: next = inst.operand; break;
+            case ByteCode::BRT:
+            {
+                if (stack[sp--] != 0) { next = inst.operand; }
+                break;
+            }
+            case ByteCode::BRF:
+            {
+                if (stack[sp--] == 0) { next = inst.operand; }
+                break;
+            }
+
+            case ByteCode::ICONST: stack[++sp] = inst.operand; break;
+            case ByteCode::LOAD:
+            {
+                stack[sp + 1] = stack[fp + inst.operand];
+                ++sp;
+                break;
+            }
+            case ByteCode::GLOAD: stack[++sp] = data[inst.operand]; break;
+            case ByteCode::STORE: stack[fp + inst.operand] = stack[sp--]; break;
+            case ByteCode::GSTORE: data[inst.operand] = stack[sp--]; break;
+            case ByteCode::PRINT: m_output_->print(stack[sp--]); break;
+            case ByteCode::POP: --sp; break;
+
+            case ByteCode::CALL:
+            case ByteCode::SPAWN:
+            {
+                if (sp > m_stack_.callLimit(m_callHeadroom_) && !reserveFrame(sp))
+                {
+                    m_interrupted_ = true;
+                    return leave(inst.address, -1);
+                }
+
+                stack[++sp] = inst.argument;                                     // save num args
+                stack[++sp] = fp;                                                // save frame pointer
+                stack[++sp] = program[static_cast<std::size_t>(next)].address;  // save raw return address
+                fp          = sp;
+                next        = inst.operand;
+                break;
+            }
+
+            case ByteCode::RET:
+            {
+                auto const returnVal = stack[sp];
+                sp                   = fp;
+                auto const retAddr   = stack[sp--];
+                fp                   = stack[sp--];
+                auto const numArgs   = stack[sp--];
+                sp -= numArgs;
+                stack[++sp] = returnVal;
+                next        = m_decoded_.indexAt(retAddr);
+                break;
+            }
+
+            case ByteCode::TAILCALL:
+            {
+                auto const retAddr = stack[fp];
+                auto const savedFp = stack[fp - 1];
+                auto const first   = fp - 2 - stack[fp - 2];  // first current argument
+                for (auto i = int64_t {0}; i < inst.argument; ++i)
+                { stack[first + i] = stack[sp - inst.argument + 1 + i]; }
+                sp          = first + inst.argument - 1;
+                stack[++sp] = inst.argument;  // save num args
+                stack[++sp] = savedFp;        // keep frame pointer of the caller
+                stack[++sp] = retAddr;        // keep raw return address of the caller
+                fp          = sp;
+                next        = inst.operand;
+                break;
+            }
+
+            case ByteCode::JOIN: break;
+
+            case ByteCode::CALLNATIVE:
+            {
+                auto const first = sp - inst.argument + 1;
+                stack[first]     = natives[inst.operand](stack + first);
+                sp               = first;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_IADD:
+            {
+                stack[sp + 1] = stack[fp + inst.operand] + inst.argument;
+                ++sp;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_ISUB:
+            {
+                stack[sp + 1] = stack[fp + inst.operand] - inst.argument;
+                ++sp;
+                break;
+            }
+
+            case ByteCode::LOAD_ICONST_ILT:
+            {
+                stack[sp + 1] = stack[fp + inst.operand] < inst.argument ? 1 : 0;
+                ++sp;
+                break;
+            }
+
+            case ByteCode::LOAD_LOAD_IADD:
+            {
+                stack[sp + 1] = stack[fp + inst.operand] + stack[fp + inst.argument];
+                ++sp;
+                break;
+            }
+
+            case ByteCode::ILT_BRF:
+            {
+                auto const b = stack[sp--];
+                auto const a = stack[sp--];
+                if (!(a < b)) { next = inst.operand; }
+                break;
+            }
+
+            case ByteCode::EXIT: return leave(inst.address + 1, stack[sp]);
+            case ByteCode::HALT: return leave(inst.address + 1, -1);
+            default:
+            {
+                m_runStatus_ = RunStatus::InvalidInstruction;
+                return leave(inst.address, -1);
+            }
+        }
+
+        if (m_recorder_.state() == TraceRecorder::State::Recording)
+        {
+            m_recorder_.record(index, inst, next);
+            finishRecording();
+        }
+
+        if (isBranch(inst.opcode) && next <= index && m_recorder_.state() == TraceRecorder::State::Idle)
+        {
+            auto& loop = m_hotLoops_[next];
+            if (loop.trace.has_value() && sp - fp == loop.frameOffset)
+            {
+                auto context               = jitContext();
+                context.stackPointer       = sp;
+                context.framePointer       = fp;
+                context.instructionPointer = program[static_cast<std::size_t>(next)].address;
+                loop.trace->run(context);
+
+                sp   = context.stackPointer;
+                fp   = context.framePointer;
+                next = m_decoded_.indexAt(context.instructionPointer);
+            }
+            else if (!loop.trace.has_value() && loop.attempts < MaxTraceAttempts && ++loop.hits >= HotLoopThreshold)
+            {
+                m_recorder_.start(next, sp - fp);
+            }
+        }
+
+        index = next;
+    }
+}
+
+/**
+ * @brief Compiles a complete recording, or counts the attempt against the loop
+ * if the recording was aborted or could not be compiled.
+ */
+auto VirtualMachine::finishRecording() -> void
+{
+    auto const state = m_recorder_.state();
+    if (state != TraceRecorder::State::Complete && state != TraceRecorder::State::Aborted) { return; }
+
+    auto& loop = m_hotLoops_[m_recorder_.header()];
+    if (state == TraceRecorder::State::Complete)
+    {
+        if (auto const trace = optimizeTrace(m_decoded_, m_recorder_); trace.has_value())
+        {
+            loop.trace       = compileTrace(trace.value());
+            loop.frameOffset = trace->frameOffset;
+        }
+    }
+
+    if (!loop.trace.has_value())
+    {
+        loop.hits = 0;
+        loop.attempts++;
+    }
+    m_recorder_.reset();
+}
+
+auto VirtualMachine::compiledTraces() const noexcept -> std::size_t
+{
+    auto const hasTrace = [](auto const& loop) { return loop.second.trace.has_value(); };
+    return static_cast<std::size_t>(std::count_if(begin(m_hotLoops_), end(m_hotLoops_), hasTrace));
+}
+
+}  // namespace tcc
@@ -5,15 +5,127 @@
 
 #include "tcc/compiler/compiler.hpp"
 #include "tcsl/tcsl.hpp"
+#include "tcvm/vm/jit.hpp"
+#include "tcvm/vm/scheduler.hpp"
+#include "tcvm/vm/verifier.hpp"
 #include "tcvm/vm/vm.hpp"
 
 #include "catch2/catch.hpp"
 
-TEST_CASE("integration: CompileAndRunConstant", "[integration]")
+#include <array>
+
+namespace
 {
-    auto source = std::string {R"(
+constexpr auto constantSource = R"(
         int main() { return 1;}
-    )"};
+    )";
+
+constexpr auto additionSource = R"(
+        int main() { return 1+2+3+4;}
+    )";
+
+constexpr auto subtractionSource = R"(
+        int main() { return 30-20-9;}
+    )";
+
+constexpr auto multiplicationSource = R"(
+        int main() { return 10*10*5;}
+    )";
+
+constexpr auto mixedExpressionSource = R"(
+        int main() { return 10*10*5+10-20;}
+    )";
+
+constexpr auto localVarsSource = R"(
+        int main() {
+            int x = (1+2+3+4)*2;
+            int y = 10*5-10;
+            return x+y;
+        }
+    )";
+
+constexpr auto fCallMinimalSource = R"(
+        int foo(a, b) { return a + b; }
+        int main()
+        {
+            int x = 1;
+            int y = 2;
+            return foo(x, y);
+        }
+    )";
+
+constexpr auto fCallNestedSource = R"(
+        int foo(a) { return a * 2; }
+        int main()
+        {
+            int x = 1 + 4;
+            int y = foo(foo(x * 2));
+            return x + y;
+        }
+    )";
+
+constexpr auto fCallLocalsSource = R"(
+        int foo(a)
+        {
+            int b = 30;
+            int q = 10 * 2;
+            int p = b - q;
+            int c = p * 15;
+            return c + a;
+        }
+
+        int main()
+        {
+            int x = 1 + 4;
+            int y = foo(foo(x));
+            return x + y;
+        }
+    )";
+
+constexpr auto spawnJoinSource = R"(
+        int square(a)
+        {
+            return a * a;
+        }
+
+        int main()
+        {
+            int x = 7;
+            int h = spawn(square(x));
+            int y = 1 + 2;
+            return join(h) + y;
+        }
+    )";
+
+constexpr auto tailCallsSource = R"(
+        int add(a) { return a + 10; }
+        int twice(b) { int c = b * 2; return add(c); }
+        int main()
+        {
+            int x = 4;
+            return twice(x);
+        }
+    )";
+
+// every program of the CompileAndRun tests, the backends have to agree on all of them
+constexpr auto compileAndRunSources = std::array {
+    constantSource,
+    additionSource,
+    subtractionSource,
+    multiplicationSource,
+    mixedExpressionSource,
+    localVarsSource,
+    fCallMinimalSource,
+    fCallNestedSource,
+    fCallLocalsSource,
+    spawnJoinSource,
+    tailCallsSource,
+};
+}  // namespace
+
+TEST_CASE("integration: CompileAndRunConstant", "[integration]")
+{
+    auto source = std::string {constantSource};
 
     for (auto optLevel : {0, 1})
     {
@@ -39,9 +151,7 @@ TEST_CASE("integration: CompileAndRunConstant", "[integration]")
 
 TEST_CASE("integration: CompileAndRunAddition", "[integration]")
 {
-    auto source = std::string {R"(
-        int main() { return 1+2+3+4;}
-    )"};
+    auto source = std::string {additionSource};
 
     for (auto optLevel : {0, 1})
     {
@@ -67,9 +177,7 @@ TEST_CASE("integration: CompileAndRunAddition", "[integration]")
 
 TEST_CASE("integration: CompileAndRunSubtraction", "[integration]")
 {
-    auto source = std::string {R"(
-        int main() { return 30-20-9;}
-    )"};
+    auto source = std::string {subtractionSource};
 
     for (auto optLevel : {0, 1})
     {
@@ -95,9 +203,7 @@ TEST_CASE("integration: CompileAndRunSubtraction", "[integration]")
 
 TEST_CASE("integration: CompileAndRunMultiplication", "[integration]")
 {
-    auto source = std::string {R"(
-        int main() { return 10*10*5;}
-    )"};
+    auto source = std::string {multiplicationSource};
 
     for (auto optLevel : {0, 1})
     {
@@ -123,9 +229,7 @@ TEST_CASE("integration: CompileAndRunMultiplication", "[integration]")
 
 TEST_CASE("integration: CompileAndRunMixedExpression", "[integration]")
 {
-    auto source = std::string {R"(
-        int main() { return 10*10*5+10-20;}
-    )"};
+    auto source = std::string {mixedExpressionSource};
 
     for (auto optLevel : {0, 1})
     {
@@ -151,13 +255,7 @@ TEST_CASE("integration: CompileAndRunMixedExpression", "[integration]")
 
 TEST_CASE("integration: CompileAndRunLocalVars", "[integration]")
 {
-    auto source = std::string {R"(
-        int main() {
-            int x = (1+2+3+4)*2;
-            int y = 10*5-10;
-            return x+y;
-        }
-    )"};
+    auto source = std::string {localVarsSource};
     for (auto optLevel : {0, 1})
     {
         auto options     = tcc::CompilerOptions {};
@@ -181,15 +279,7 @@ TEST_CASE("integration: CompileAndRunLocalVars", "[integration]")
 
 TEST_CASE("integration: CompileAndRunFCallMinimal", "[integration]")
 {
-    auto source = std::string {R"(
-        int foo(a, b) { return a + b; }
-        int main()
-        {
-            int x = 1;
-            int y = 2;
-            return foo(x, y);
-        }
-    )"};
+    auto source = std::string {fCallMinimalSource};
     for (auto optLevel : {0, 1})
     {
         auto options     = tcc::CompilerOptions {};
@@ -213,15 +303,7 @@ TEST_CASE("integration: CompileAndRunFCallMinimal", "[integration]")
 
 TEST_CASE("integration: CompileAndRunFCallNested", "[integration]")
 {
-    auto source = std::string {R"(
-        int foo(a) { return a * 2; }
-        int main()
-        {
-            int x = 1 + 4;
-            int y = foo(foo(x * 2));
-            return x + y;
-        }
-    )"};
+    auto source = std::string {fCallNestedSource};
     for (auto optLevel : {0, 1})
     {
         auto options     = tcc::CompilerOptions {};
@@ -245,23 +327,7 @@ TEST_CASE("integration: CompileAndRunFCallNested", "[integration]")
 
 TEST_CASE("integration: CompileAndRunFCallLocals", "[integration]")
 {
-    auto source = std::string {R"(
-        int foo(a)
-        {
-            int b = 30;
-            int q = 10 * 2;
-            int p = b - q;
-            int c = p * 15;
-            return c + a;
-        }
-
-        int main()
-        {
-            int x = 1 + 4;
-            int y = foo(foo(x));
-            return x + y;
-        }
-    )"};
+    auto source = std::string {fCallLocalsSource};
     for (auto optLevel : {0, 1})
     {
         auto options     = tcc::CompilerOptions {};
@@ -282,3 +348,227 @@ TEST_CASE("integration: CompileAndRunFCallLocals", "[integration]")
         REQUIRE_THAT(stream.str(), Catch::Contains("exit code: 310"));
     }
 }
+
+TEST_CASE("integration: CompileAndRunSpawnJoin", "[integration]")
+{
+    auto source = std::string {spawnJoinSource};
+    for (auto optLevel : {0, 1})
+    {
+        auto options     = tcc::CompilerOptions {};
+        options.source   = source;
+        options.optLevel = optLevel;
+
+        auto compiler = tcc::Compiler {options};
+
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        auto const entryPoint = compiler.getEntryPoint();
+        auto const assembly   = compiler.getAssembly();
+        REQUIRE(std::find(begin(assembly), end(assembly), tcc::ByteCode::SPAWN) != end(assembly));
+        REQUIRE(tcc::verify(assembly, entryPoint).ok());
+
+        auto vm = tcc::VirtualMachine(assembly, entryPoint, 0, 200, false);
+        REQUIRE(vm.cpu() == 52);
+
+        auto schedulerOptions    = tcc::SchedulerOptions {};
+        schedulerOptions.threads = 2;
+        auto scheduler           = tcc::Scheduler {schedulerOptions};
+        REQUIRE(scheduler.run(assembly, entryPoint) == 52);
+        REQUIRE(scheduler.stats().tasks == 1);
+    }
+}
+
+TEST_CASE("integration: CompileAndRunTailCalls", "[integration]")
+{
+    auto source = std::string {tailCallsSource};
+    for (auto optLevel : {0, 1})
+    {
+        auto options     = tcc::CompilerOptions {};
+        options.source   = source;
+        options.optLevel = optLevel;
+
+        auto compiler = tcc::Compiler {options};
+
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        auto const entryPoint = compiler.getEntryPoint();
+        auto const assembly   = compiler.getAssembly();
+        auto const tailCalls  = std::count(begin(assembly), end(assembly), tcc::ByteCode::TAILCALL);
+        REQUIRE(tailCalls == (optLevel == 0 ? 0 : 2));
+        REQUIRE(tcc::verify(assembly, entryPoint).ok());
+
+        for (auto const engine : {tcc::VirtualMachine::Engine::Switch, tcc::VirtualMachine::Engine::Threaded,
+                                  tcc::VirtualMachine::Engine::Register, tcc::VirtualMachine::Engine::Jit,
+                                  tcc::VirtualMachine::Engine::TracingJit, tcc::VirtualMachine::Engine::Compact})
+        {
+            auto vm = tcc::VirtualMachine(assembly, entryPoint, 0, 200, false, std::cout, engine);
+            REQUIRE(vm.cpu() == 18);
+        }
+
+        auto scheduler = tcc::Scheduler {};
+        REQUIRE(scheduler.run(assembly, entryPoint) == 18);
+    }
+}
+
+TEST_CASE("integration: TailRecursionRunsInConstantStack", "[integration]")
+{
+    // without conditionals these never return, optimized they loop forever
+    auto const sources = {
+        R"(
+            int spin(a) { int b = a + 1; return spin(b); }
+            int main() { int x = 0; return spin(x); }
+        )",
+        R"(
+            int ping(a) { int b = a + 1; return pong(b); }
+            int pong(c) { int d = c + 1; return ping(d); }
+            int main() { int x = 0; return ping(x); }
+        )",
+    };
+
+    for (auto const* source : sources)
+    {
+        for (auto optLevel : {0, 1})
+        {
+            auto options     = tcc::CompilerOptions {};
+            options.source   = source;
+            options.optLevel = optLevel;
+
+            auto compiler = tcc::Compiler {options};
+            REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+            auto const entryPoint = compiler.getEntryPoint();
+            auto const assembly   = compiler.getAssembly();
+            REQUIRE(tcc::verify(assembly, entryPoint).ok());
+
+            // plain calls overflow the small stack, tail calls keep running
+            auto out = std::stringstream {};
+            auto vm  = tcc::VirtualMachine(assembly, entryPoint, 0, 32, false, out);
+            vm.setMaxStackSize(1'024);
+            vm.enableBoundsChecking(true);
+            auto const result = vm.run(100'000);
+            REQUIRE(out.str().empty());
+            if (optLevel == 0) { REQUIRE(result.status == tcc::VirtualMachine::RunStatus::StackOverflow); }
+            else
+            {
+                REQUIRE(result.status == tcc::VirtualMachine::RunStatus::OutOfBudget);
+
+                auto threaded = tcc::VirtualMachine(assembly, entryPoint, 0, 32, false, out,
+                                                    tcc::VirtualMachine::Engine::Threaded);
+                threaded.enableMetering(100'000);
+                REQUIRE(threaded.cpu() == -1);
+                REQUIRE(threaded.status() == tcc::VirtualMachine::RunStatus::OutOfGas);
+            }
+        }
+    }
+}
+
+TEST_CASE("integration: CompiledProgramsVerify", "[integration]")
+{
+    auto const sources = {
+        R"(int main() { return 1+2+3+4; })",
+        R"(int main() { int x = 1 + 4; int y = x * 3; return x - y; })",
+        R"(
+            int foo(a) { int b = 30; int c = b * 15; return c + a; }
+            int main() { int x = 1 + 4; int y = foo(foo(x)); return x + y; }
+        )",
+    };
+
+    for (auto const* source : sources)
+    {
+        for (auto optLevel : {0, 1})
+        {
+            auto options     = tcc::CompilerOptions {};
+            options.source   = source;
+            options.optLevel = optLevel;
+
+            auto compiler = tcc::Compiler {options};
+            REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+            auto const assembly   = compiler.getAssembly();
+            auto const entryPoint = compiler.getEntryPoint();
+            auto const result     = tcc::verify(assembly, entryPoint);
+            INFO(result.error << " at: " << result.address);
+            REQUIRE(result.ok());
+            REQUIRE(result.stackSize.has_value());
+
+            auto reference = tcc::VirtualMachine(assembly, entryPoint, 0, 200, false);
+            auto exact     = tcc::VirtualMachine(assembly, entryPoint, static_cast<uint64_t>(result.globals),
+                                             static_cast<uint64_t>(result.stackSize.value()), false);
+            REQUIRE(exact.cpu() == reference.cpu());
+        }
+    }
+}
+
+TEST_CASE("integration: NativeCodeMatchesVm", "[integration]")
+{
+    for (auto const* source : compileAndRunSources)
+    {
+        for (auto optLevel : {0, 1})
+        {
+            auto options     = tcc::CompilerOptions {};
+            options.source   = source;
+            options.optLevel = optLevel;
+            options.format   = tcc::OutputFormat::Object;
+
+            auto compiler = tcc::Compiler {options};
+            REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+            auto vm = tcc::VirtualMachine(compiler.getAssembly(), compiler.getEntryPoint(), 0, 200, false);
+
+            // tcc_main ignores its argument, so it runs like jit code
+            auto const& native = compiler.getNativeProgram();
+            REQUIRE(native.ok());
+            auto memory = tcc::ExecutableMemory::create(native.text);
+            REQUIRE(memory.has_value());
+            auto context = tcc::JitContext {};
+            REQUIRE(memory->call(context, native.entry) == vm.cpu());
+        }
+    }
+}
+
+TEST_CASE("integration: CompileAndRunRuntimeFunctions", "[integration]")
+{
+    auto source = std::string {R"(
+        extern int print(x);
+        extern int exit(c);
+        int twice(a) { int b = print(a); return b * 2; }
+        int main()
+        {
+            int a = 21;
+            int x = twice(a);
+            int y = exit(x);
+            return 0;
+        }
+    )"};
+    for (auto optLevel : {0, 1})
+    {
+        auto options     = tcc::CompilerOptions {};
+        options.source   = source;
+        options.optLevel = optLevel;
+
+        auto compiler = tcc::Compiler {options};
+        REQUIRE(compiler.run() == EXIT_SUCCESS);
+
+        // print & exit need no host functions
+        auto const entryPoint = compiler.getEntryPoint();
+        auto const assembly   = compiler.getAssembly();
+        REQUIRE(compiler.getNatives().empty());
+        REQUIRE(std::find(begin(assembly), end(assembly), tcc::ByteCode::CALLNATIVE) == end(assembly));
+        REQUIRE(tcc::verify(assembly, entryPoint).ok());
+
+        for (auto const engine : {tcc::VirtualMachine::Engine::Switch, tcc::VirtualMachine::Engine::Threaded,
+                                  tcc::VirtualMachine::Engine::Register, tcc::VirtualMachine::Engine::Jit,
+                                  tcc::VirtualMachine::Engine::TracingJit, tcc::VirtualMachine::Engine::Compact})
+        {
+            auto stream = std::stringstream {};
+            auto vm     = tcc::VirtualMachine(assembly, entryPoint, 0, 200, false, stream, engine);
+            REQUIRE(vm.cpu() == 42);
+            REQUIRE(stream.str() == "21\n");
+        }
+
+        auto stream    = std::stringstream {};
+        auto scheduler = tcc::Scheduler {};
+        REQUIRE(scheduler.run(assembly, entryPoint, stream) == 42);
+        REQUIRE(stream.str() == "21\n");
+    }
+}